@@ -0,0 +1,176 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_BOOTPROF_HPP_
+#define ROM_BOOTPROF_HPP_
+
+#include <mc1/mmio.h>
+
+#include <cstdint>
+
+// Boot stage profiler.
+//
+// Each profiled stage is timed with the 64-bit CLKCNT cycle counter. The profiler keeps
+// min/avg/max statistics per stage, and the most recent events in a ring buffer.
+//
+// The profile lives in the ROM BSS (i.e. in VRAM) as the C symbol rom_boot_prof, so that a test
+// bench or a debugger can read it (find the address with mrisc32-elf-nm out/rom.elf). The block
+// starts with BOOTPROF_MAGIC once it has been initialized.
+//
+// Profiling is enabled with ENABLE_BOOTPROF. Otherwise all the functions are empty.
+
+// Profiled stages. The first stages have the same order as boot_state_t in main.cpp.
+enum class boot_stage_t : uint32_t {
+  INITIALIZE,
+  RUN_DIAGNOSTICS,
+  WAIT_FOR_SDCARD,
+  MOUNT_FAT,
+  LOAD_MC1BOOT,
+  MOSAIC_INIT,
+  SPLASH_INIT,
+  ELF32_LOAD,
+  FRAME_UPDATE,
+  NUM_STAGES
+};
+
+#define BOOTPROF_MAGIC 0x46525042U  // "BPRF"
+#define BOOTPROF_NUM_STAGES 9
+#define BOOTPROF_RING_SIZE 32  // Must be a power of two.
+
+static_assert(static_cast<int>(boot_stage_t::NUM_STAGES) == BOOTPROF_NUM_STAGES,
+              "BOOTPROF_NUM_STAGES is out of sync");
+
+struct boot_prof_stats_t {
+  uint32_t count;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint32_t total_cycles_lo;  // 64-bit sum of all the durations.
+  uint32_t total_cycles_hi;
+};
+
+struct boot_prof_event_t {
+  uint32_t stage;
+  uint32_t start_lo;  // CLKCNT when the stage started.
+  uint32_t start_hi;
+  uint32_t cycles;    // Duration of the stage.
+};
+
+struct boot_prof_t {
+  uint32_t magic;
+  uint32_t num_events;  // Total number of events (the ring buffer index is num_events % RING_SIZE).
+  boot_prof_stats_t stats[BOOTPROF_NUM_STAGES];
+  boot_prof_event_t ring[BOOTPROF_RING_SIZE];
+};
+
+#ifdef ENABLE_BOOTPROF
+// Defined in main.cpp.
+extern "C" boot_prof_t rom_boot_prof;
+#endif
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+#ifdef ENABLE_BOOTPROF
+inline uint64_t bootprof_clkcnt() {
+  // Read the 64-bit counter (retry if the high word changed while reading the low word).
+  uint32_t hi;
+  uint32_t lo;
+  do {
+    hi = MMIO(CLKCNTHI);
+    lo = MMIO(CLKCNTLO);
+  } while (MMIO(CLKCNTHI) != hi);
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+inline void bootprof_init() {
+  auto& prof = rom_boot_prof;
+  prof.num_events = 0U;
+  for (auto& stats : prof.stats) {
+    stats.count = 0U;
+    stats.min_cycles = ~0U;
+    stats.max_cycles = 0U;
+    stats.total_cycles_lo = 0U;
+    stats.total_cycles_hi = 0U;
+  }
+  prof.magic = BOOTPROF_MAGIC;
+}
+
+inline void bootprof_record(const boot_stage_t stage, const uint64_t start) {
+  const auto cycles64 = bootprof_clkcnt() - start;
+  const auto cycles = cycles64 < 0xffffffffU ? static_cast<uint32_t>(cycles64) : 0xffffffffU;
+
+  auto& prof = rom_boot_prof;
+  auto& stats = prof.stats[static_cast<uint32_t>(stage)];
+  ++stats.count;
+  stats.min_cycles = cycles < stats.min_cycles ? cycles : stats.min_cycles;
+  stats.max_cycles = cycles > stats.max_cycles ? cycles : stats.max_cycles;
+  const auto total_lo = stats.total_cycles_lo + cycles;
+  stats.total_cycles_hi += total_lo < cycles ? 1U : 0U;
+  stats.total_cycles_lo = total_lo;
+
+  auto& event = prof.ring[prof.num_events & (BOOTPROF_RING_SIZE - 1)];
+  event.stage = static_cast<uint32_t>(stage);
+  event.start_lo = static_cast<uint32_t>(start);
+  event.start_hi = static_cast<uint32_t>(start >> 32);
+  event.cycles = cycles;
+  ++prof.num_events;
+}
+
+// Time the lifetime of the scope object (or until stop() is called).
+class bootprof_scope_t {
+public:
+  explicit bootprof_scope_t(const boot_stage_t stage)
+      : m_stage(stage), m_start(bootprof_clkcnt()), m_running(true) {
+  }
+
+  ~bootprof_scope_t() {
+    stop();
+  }
+
+  // Record the stage now (e.g. before jumping to code that never returns).
+  void stop() {
+    if (m_running) {
+      bootprof_record(m_stage, m_start);
+      m_running = false;
+    }
+  }
+
+private:
+  const boot_stage_t m_stage;
+  const uint64_t m_start;
+  bool m_running;
+};
+#else
+inline void bootprof_init() {
+}
+
+class bootprof_scope_t {
+public:
+  explicit bootprof_scope_t(const boot_stage_t) {
+  }
+
+  void stop() {
+  }
+};
+#endif
+
+}  // namespace
+
+#endif  // ROM_BOOTPROF_HPP_
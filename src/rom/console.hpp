@@ -18,6 +18,15 @@
 //  3. This notice may not be removed or altered from any source distribution.
 //--------------------------------------------------------------------------------------------------
 
+#include "bootprof.hpp"
+#include "log_ring.hpp"
+#ifdef ENABLE_MEMBENCH
+#include "membench.hpp"
+#endif
+#include "sector_cache.hpp"
+#include "vcp_builder.hpp"
+#include "vram_arena.hpp"
+
 #include <mc1/leds.h>
 #include <mc1/mmio.h>
 #include <mc1/vconsole.h>
@@ -41,79 +50,55 @@ constexpr uint32_t linker_constant(const char* ptr) {
   return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ptr));
 }
 
-template <int N>
-constexpr int digit_scalei() {
-  int scale = 1;
-  for (int i = 0; i < N; ++i) {
-    scale *= 10;
-  }
-  return scale;
-}
-
-template <int N>
-constexpr float digit_scalef() {
-  float scale = 1.0F;
-  for (int i = 0; i < N; ++i) {
-    scale *= 10.0F;
-  }
-  return scale;
-}
-
-template <int N>
-void vcon_print_float(const float x) {
-  auto xi = static_cast<int>(x * digit_scalef<N>());
-  constexpr auto iscale = digit_scalei<N>();
-  vcon_print_dec(xi / iscale);
-  if (N > 0) {
-    auto frac = xi % iscale;
-    char buf[N + 2];
-    buf[0] = '.';
-    buf[N + 1] = 0;
-    for (int i = N; i >= 1; --i) {
-      buf[i] = '0' + (frac % 10);
-      frac /= 10;
-    }
-    vcon_print(buf);
-  }
-}
+// All console output goes through the log, which is rendered by console_t::flush().
+log_ring_t s_console_log;
 
-void print_size(uint32_t size) {
-  static const char* SIZE_SUFFIX[] = {" bytes", " KB", " MB", " GB"};
-  int size_div = 0;
-  while (size >= 1024u && (size & 1023u) == 0u) {
-    size = size >> 10;
-    ++size_div;
-  }
-  vcon_print_dec(static_cast<int>(size));
-  vcon_print(SIZE_SUFFIX[size_div]);
-}
+// True while the console is shown (the log is only rendered when there is console memory).
+bool s_console_shown = false;
 
 void print_addr_and_size(const char* str, const uint32_t addr, const uint32_t size) {
-  vcon_print(str);
-  vcon_print("0x");
-  vcon_print_hex(addr);
-  vcon_print(", ");
-  print_size(size);
-  vcon_print("\n");
+  s_console_log.print(str);
+  s_console_log.print("0x");
+  s_console_log.print_hex(addr);
+  s_console_log.print(", ");
+  s_console_log.print_size(size);
+  s_console_log.print("\n");
 }
 
 // Console class.
 class console_t {
 public:
-  void init(void* mem) {
-    m_vcon_mem = mem;
+  // Maximum number of characters to render per frame.
+  static const uint32_t MAX_CHARS_PER_FRAME = 128U;
+
+  // Allocate the console memory and show the console. Returns false if it does not fit in VRAM.
+  bool init(vram_arena_t& arena) {
+    m_arena = &arena;
+    m_vcon_mem = arena.alloc_bytes(vcon_memory_requirement());
+    if (m_vcon_mem == nullptr) {
+      return false;
+    }
 
     // Show the console.
     vcon_init(m_vcon_mem);
     vcon_set_colors(0, 0xff000000U);
     vcon_show(LAYER_2);
+    s_console_shown = true;
 
     // Print a welcome message.
-    vcon_print("\n                      **** MC1 - The MRISC32 computer ****\n\n");
+    s_console_log.print("\n                      **** MC1 - The MRISC32 computer ****\n\n");
+    return true;
   }
 
+  // Render all pending output (e.g. the boot statistics that are printed right before the boot
+  // executable is loaded) and hide the console.
   void deinit() {
-    vcp_set_prg(LAYER_2, nullptr);
+    if (s_console_shown) {
+      while (!s_console_log.flush(MAX_CHARS_PER_FRAME)) {
+      }
+      vcp_program_t::hide(LAYER_2);
+      s_console_shown = false;
+    }
   }
 
   void run_diagnostics() {
@@ -123,19 +108,24 @@ public:
     print_addr_and_size("XRAM:     ", XRAM_START, MMIO(XRAMSIZE));
     print_addr_and_size(
         "\nbss:      ", linker_constant(&__bss_start), linker_constant(&__bss_size));
+    print_vram_usage(m_arena->stats());
 
     // Print CPU info.
-    vcon_print("\n\nCPU Freq: ");
-    vcon_print_float<2>(static_cast<float>(MMIO(CPUCLK)) * (1.0F / 1000000.0F));
-    vcon_print(" MHz\n\n");
+    s_console_log.print("\n\nCPU Freq: ");
+    s_console_log.print_fixed2(static_cast<int>(static_cast<float>(MMIO(CPUCLK)) * 0.0001F));
+    s_console_log.print(" MHz\n\n");
+
+#ifdef ENABLE_MEMBENCH
+    run_membench();
+#endif
 
 #ifdef ENABLE_SELFTEST
     // Run the selftest.
-    vcon_print("Selftest: ");
+    s_console_log.print("Selftest: ");
     if (selftest_run(selftest_callback)) {
-      vcon_print(" PASS\n\n");
+      s_console_log.print(" PASS\n\n");
     } else {
-      vcon_print(" FAIL\n\n");
+      s_console_log.print(" FAIL\n\n");
     }
 #endif
 
@@ -147,16 +137,132 @@ public:
   }
 
   static void print(const char* msg) {
-    vcon_print(msg);
+    s_console_log.print(msg);
   }
 
+  // Render pending console output (call once per frame).
+  static void flush() {
+    if (s_console_shown) {
+      (void)s_console_log.flush(MAX_CHARS_PER_FRAME);
+    }
+  }
+
+#ifdef ENABLE_BOOTPROF
+  static void print_boot_profile() {
+    static const char* STAGE_NAMES[BOOTPROF_NUM_STAGES] = {"Initialize   ",
+                                                           "Diagnostics  ",
+                                                           "SD card init ",
+                                                           "Mount FAT    ",
+                                                           "Load MC1BOOT ",
+                                                           "Mosaic init  ",
+                                                           "Splash init  ",
+                                                           "ELF32 load   ",
+                                                           "Frame update "};
+    s_console_log.print("\nBoot profile (count, min/avg/max kcycles)\n");
+    for (int k = 0; k < BOOTPROF_NUM_STAGES; ++k) {
+      const auto& stats = rom_boot_prof.stats[k];
+      if (stats.count == 0U) {
+        continue;
+      }
+
+      // Note: Avoid 64-bit division (the average only needs to be approximate).
+      const auto total_kcycles = stats.total_cycles_hi * 4294967U + stats.total_cycles_lo / 1000U;
+      s_console_log.print(STAGE_NAMES[k]);
+      s_console_log.print_dec(static_cast<int>(stats.count));
+      s_console_log.print(", ");
+      s_console_log.print_dec(static_cast<int>(stats.min_cycles / 1000U));
+      s_console_log.print("/");
+      s_console_log.print_dec(static_cast<int>(total_kcycles / stats.count));
+      s_console_log.print("/");
+      s_console_log.print_dec(static_cast<int>(stats.max_cycles / 1000U));
+      s_console_log.print("\n");
+    }
+  }
+
+  static void print_cache_stats(const sector_cache_t::stats_t& stats) {
+    s_console_log.print("Sector cache: ");
+    s_console_log.print_dec(static_cast<int>(stats.hits));
+    s_console_log.print(" hits, ");
+    s_console_log.print_dec(static_cast<int>(stats.misses));
+    s_console_log.print(" misses, ");
+    s_console_log.print_dec(static_cast<int>(stats.blocks_read));
+    s_console_log.print(" blocks in ");
+    s_console_log.print_dec(static_cast<int>(stats.read_cmds));
+    s_console_log.print(" reads\n");
+  }
+#endif
+
 private:
+  static void print_vram_usage(const vram_arena_t::stats_t& stats) {
+    s_console_log.print("VRAM heap: ");
+    s_console_log.print_size(stats.used);
+    s_console_log.print(" used, ");
+    s_console_log.print_size(stats.size - stats.used);
+    s_console_log.print(" free\n");
+    if (stats.num_failed != 0U) {
+      s_console_log.print("VRAM heap overflow: ");
+      s_console_log.print_dec(static_cast<int>(stats.num_failed));
+      s_console_log.print(" failed allocation(s), first: ");
+      s_console_log.print_size(stats.first_failed);
+      s_console_log.print("\n");
+    }
+  }
+
+#ifdef ENABLE_MEMBENCH
+  static const uint32_t MEMBENCH_SIZE = 16384U;
+  static const uint32_t MEMBENCH_MIN_SIZE = 4096U;
+  static const uint32_t MEMBENCH_ALIGN = 128U;
+
+  void run_membench() {
+    // VRAM: Use a scratch buffer in the free VRAM (it is released at the next frame).
+    auto size = MEMBENCH_SIZE;
+    while (size >= MEMBENCH_MIN_SIZE && size + MEMBENCH_ALIGN > m_arena->bytes_free()) {
+      size >>= 1;
+    }
+    if (size >= MEMBENCH_MIN_SIZE) {
+      auto* buf = m_arena->alloc_scratch<uint32_t>(size / 4U, MEMBENCH_ALIGN);
+      print_membench("VRAM", membench_t::run(buf, size));
+    }
+
+    // XRAM: Use the start of XRAM (it is not used until the boot executable is loaded).
+    if (MMIO(XRAMSIZE) >= MEMBENCH_SIZE) {
+      auto* xram = reinterpret_cast<uint32_t*>(XRAM_START);
+      print_membench("XRAM", membench_t::run(xram, MEMBENCH_SIZE));
+    }
+    s_console_log.print("\n");
+  }
+
+  static void print_membench(const char* name, const membench_t::result_t& r) {
+    s_console_log.print(name);
+    s_console_log.print(" r/w/copy: ");
+    print_triple(r.read, r.write, r.copy);
+    s_console_log.print(", vector: ");
+    print_triple(r.vread, r.vwrite, r.vcopy);
+    s_console_log.print(" MB/s\n     seq/stride/random: ");
+    s_console_log.print_fixed2(static_cast<int>(r.seq_latency_x100));
+    s_console_log.print("/");
+    s_console_log.print_fixed2(static_cast<int>(r.stride_latency_x100));
+    s_console_log.print("/");
+    s_console_log.print_fixed2(static_cast<int>(r.random_latency_x100));
+    s_console_log.print(" cycles/load\n");
+  }
+
+  static void print_triple(const uint32_t a, const uint32_t b, const uint32_t c) {
+    s_console_log.print_dec(static_cast<int>(a));
+    s_console_log.print("/");
+    s_console_log.print_dec(static_cast<int>(b));
+    s_console_log.print("/");
+    s_console_log.print_dec(static_cast<int>(c));
+  }
+#endif
+
 #ifdef ENABLE_SELFTEST
   static void selftest_callback(int pass, int /* test_no */) {
-    vcon_print(pass ? "*" : "!");
+    s_console_log.print(pass ? "*" : "!");
   }
 #endif
 
+  vram_arena_t* m_arena;
   void* m_vcon_mem;
   bool m_diags_have_been_run = false;
 };
@@ -97,7 +97,7 @@ _start:
 
 
     ; ------------------------------------------------------------------------
-    ; Set up the stack (0.5 KiB at top of VRAM).
+    ; Set up the stack at the top of VRAM (see vram_arena_t::STACK_SIZE).
     ; ------------------------------------------------------------------------
 
     ldi     r1, #MMIO_START
@@ -0,0 +1,247 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+#ifndef ROM_ELF_LOADER_HPP_
+#define ROM_ELF_LOADER_HPP_
+
+#include "lzg_stream.hpp"
+
+#include <mc1/mfat_mc1.h>
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __MRISC32_VECTOR_OPS__
+// Vectorized memory clear (implemented in zero_fill.s).
+extern "C" void zero_fill_words(uint32_t* dst, uint32_t count);
+#endif
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Streaming ELF32 executable loader.
+//
+// The loader first reads and validates the ELF header and all the program headers, so that the
+// caller can check where the loadable segments will end up before anything is written to memory.
+// Each PT_LOAD segment is then read with a single mfat_read() straight to its load address (with
+// no staging buffer), and the rest of the segment (the BSS) is cleared with a vector store loop.
+//
+// Segments that have the PF_MC1_LZG flag set hold LZG compressed data (see host/lzgpack.cpp).
+// They are read one SD card block at a time, and each block is decompressed straight to the load
+// address before the next block is read.
+class elf_loader_t {
+public:
+  static const uint32_t MAX_SEGMENTS = 8U;
+
+  // Program header flag for LZG compressed segments (in the PF_MASKOS range).
+  static const uint32_t PF_MC1_LZG = 0x00100000U;
+
+  ~elf_loader_t() {
+    close();
+  }
+
+  // Open the file and read the headers. Returns false if the file is not a valid executable.
+  bool open(const char* path) {
+    close();
+    m_fd = mfat_open(path, MFAT_O_RDONLY);
+    if (m_fd < 0) {
+      return false;
+    }
+
+    elf32_ehdr_t ehdr;
+    if (!read_at(0U, &ehdr, sizeof(ehdr)) || ehdr.e_ident[0] != 0x7f || ehdr.e_ident[1] != 'E' ||
+        ehdr.e_ident[2] != 'L' || ehdr.e_ident[3] != 'F' || ehdr.e_ident[4] != ELFCLASS32 ||
+        ehdr.e_ident[5] != ELFDATA2LSB || ehdr.e_type != ET_EXEC ||
+        ehdr.e_phentsize != sizeof(elf32_phdr_t)) {
+      close();
+      return false;
+    }
+    m_entry = ehdr.e_entry;
+
+    m_num_segments = 0U;
+    for (uint32_t i = 0U; i < ehdr.e_phnum; ++i) {
+      elf32_phdr_t phdr;
+      if (!read_at(ehdr.e_phoff + i * sizeof(phdr), &phdr, sizeof(phdr))) {
+        close();
+        return false;
+      }
+      if (phdr.p_type != PT_LOAD || phdr.p_memsz == 0U) {
+        continue;
+      }
+      if (m_num_segments == MAX_SEGMENTS ||
+          (phdr.p_filesz > phdr.p_memsz && (phdr.p_flags & PF_MC1_LZG) == 0U)) {
+        close();
+        return false;
+      }
+      auto& seg = m_segments[m_num_segments++];
+      seg.offset = phdr.p_offset;
+      seg.addr = phdr.p_paddr;
+      seg.file_size = phdr.p_filesz;
+      seg.mem_size = phdr.p_memsz;
+      seg.compressed = (phdr.p_flags & PF_MC1_LZG) != 0U;
+    }
+    return true;
+  }
+
+  // Check if any of the loadable segments overlaps the memory range [begin, end).
+  bool overlaps(const void* begin, const void* end) const {
+    const auto first = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(begin));
+    const auto last = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(end));
+    for (uint32_t i = 0U; i < m_num_segments; ++i) {
+      const auto& seg = m_segments[i];
+      if (seg.addr < last && first < seg.addr + seg.mem_size) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Load all the segments to memory. Returns false if the file could not be read.
+  bool load(uint32_t* entry_address) {
+    if (m_fd < 0) {
+      return false;
+    }
+    for (uint32_t i = 0U; i < m_num_segments; ++i) {
+      const auto& seg = m_segments[i];
+      auto* dst = reinterpret_cast<uint8_t*>(static_cast<uintptr_t>(seg.addr));
+      uint32_t size = seg.file_size;
+      if (seg.compressed) {
+        const auto decoded_size = read_lzg(seg, dst);
+        if (decoded_size < 0) {
+          return false;
+        }
+        size = static_cast<uint32_t>(decoded_size);
+      } else if (size > 0U && !read_at(seg.offset, dst, size)) {
+        return false;
+      }
+      zero_fill(dst + size, seg.mem_size - size);
+    }
+    *entry_address = m_entry;
+    return true;
+  }
+
+  void close() {
+    if (m_fd >= 0) {
+      (void)mfat_close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+private:
+  static const uint8_t ELFCLASS32 = 1U;
+  static const uint8_t ELFDATA2LSB = 1U;
+  static const uint16_t ET_EXEC = 2U;
+  static const uint32_t PT_LOAD = 1U;
+
+  struct elf32_ehdr_t {
+    uint8_t e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+  };
+
+  struct elf32_phdr_t {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+  };
+
+  static_assert(sizeof(elf32_ehdr_t) == 52U, "Bad ELF header size");
+  static_assert(sizeof(elf32_phdr_t) == 32U, "Bad ELF program header size");
+
+  struct segment_t {
+    uint32_t offset;
+    uint32_t addr;
+    uint32_t file_size;
+    uint32_t mem_size;
+    bool compressed;
+  };
+
+  static const uint32_t CHUNK_SIZE = 512U;
+
+  bool read_at(const uint32_t offset, void* buf, const uint32_t size) {
+    return mfat_lseek(m_fd, offset, MFAT_SEEK_SET) == offset &&
+           mfat_read(m_fd, buf, size) == static_cast<int64_t>(size);
+  }
+
+  // Read and decompress an LZG compressed segment. Returns the decoded size, or -1 on failure.
+  int32_t read_lzg(const segment_t& seg, uint8_t* dst) {
+    if (mfat_lseek(m_fd, seg.offset, MFAT_SEEK_SET) != seg.offset) {
+      return -1;
+    }
+    lzg_stream_t lzg;
+    lzg.init(dst, seg.mem_size);
+    uint8_t buf[CHUNK_SIZE];
+    for (uint32_t left = seg.file_size; left > 0U;) {
+      const auto size = left < CHUNK_SIZE ? left : CHUNK_SIZE;
+      if (mfat_read(m_fd, buf, size) != static_cast<int64_t>(size) || !lzg.feed(buf, size)) {
+        return -1;
+      }
+      left -= size;
+    }
+    return lzg.finish();
+  }
+
+  static void zero_fill(uint8_t* dst, uint32_t size) {
+#ifdef __MRISC32_VECTOR_OPS__
+    // Clear unaligned head and tail bytes separately.
+    while (size > 0U && (reinterpret_cast<uintptr_t>(dst) & 3U) != 0U) {
+      *dst++ = 0U;
+      --size;
+    }
+    if (size >= 4U) {
+      zero_fill_words(reinterpret_cast<uint32_t*>(dst), size >> 2);
+      dst += size & ~3U;
+      size &= 3U;
+    }
+    while (size > 0U) {
+      *dst++ = 0U;
+      --size;
+    }
+#else
+    std::memset(dst, 0, size);
+#endif
+  }
+
+  int m_fd = -1;
+  uint32_t m_entry = 0U;
+  uint32_t m_num_segments = 0U;
+  segment_t m_segments[MAX_SEGMENTS];
+};
+
+}  // namespace
+
+#endif  // ROM_ELF_LOADER_HPP_
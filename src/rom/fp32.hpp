@@ -22,77 +22,157 @@
 #define ROM_FP32_HPP_
 
 #include <cstdint>
+#include <type_traits>
 
 // Note: Using an anonymous namespace saves a few bytes of code size.
 namespace {
 
-// A simple fixed-point class for manipulating unsigned values.
+// A simple fixed-point class template.
 // Note: This is mostly to avoid using floating-point instructions in the ROM code.
 //
-// The internal fixed point format is 12.20 bits, which gives us a valid range of
-// 0.000000 - 4095.999999 and 6 decimals precision. This format is suitable for representing 2D
-// screen coordinates and sizes.
+// T is the storage type (int32_t or uint32_t), and FRACT_BITS is the number of fractional bits.
+// All operations are constexpr, so tables can be generated at compile time, and all divisions by
+// integers are rounding divisions.
 //
 // Usage example:
 //
 //  uint32_t a = 3434U;
 //  uint32_t b = 12U;
-//  uint32_t c = static_cast<uint32_t>((0.24_fp32 * a) / b);
-
-class fp32_t {
+//  uint32_t c = ((0.24_fp32 * a) / b).round();
+template <typename T, uint32_t FRACT_BITS>
+class fixed_t {
 public:
-  explicit fp32_t(uint32_t i) : m_fpbits(i << FP_SHIFT) {
+  static_assert(sizeof(T) == 4U && FRACT_BITS > 0U && FRACT_BITS < 31U, "Unsupported format");
+  using int_t = T;
+
+  constexpr fixed_t() : m_bits(0) {
+  }
+  constexpr explicit fixed_t(const T i) : m_bits(static_cast<T>(i * ONE)) {
+  }
+  constexpr explicit fixed_t(const long double d) : m_bits(to_bits(d)) {
   }
-  constexpr explicit fp32_t(long double& d) : m_fpbits(to_fpbits(d)) {
+
+  static constexpr fixed_t from_bits(const T bits) {
+    fixed_t x;
+    x.m_bits = bits;
+    return x;
   }
 
-  operator uint32_t() const {
-    // Rounding cast.
-    return (m_fpbits + (1U << (FP_SHIFT - 1U))) >> FP_SHIFT;
+  constexpr T bits() const {
+    return m_bits;
   }
 
-  fp32_t& operator+=(const fp32_t y) {
-    m_fpbits += y.m_fpbits;
+  // Rounding conversion to an integer (halves are rounded up).
+  constexpr T round() const {
+    return static_cast<T>(m_bits + (ONE >> 1)) >> FRACT_BITS;
+  }
+  constexpr T floor() const {
+    return m_bits >> FRACT_BITS;
+  }
+  constexpr T ceil() const {
+    return static_cast<T>(m_bits + (ONE - 1)) >> FRACT_BITS;
+  }
+
+  // Convert to another fixed-point format (truncates when reducing the number of fractional bits).
+  template <typename T2, uint32_t FRACT_BITS2>
+  constexpr fixed_t<T2, FRACT_BITS2> convert() const {
+    if constexpr (FRACT_BITS2 >= FRACT_BITS) {
+      // Scale with a multiplication, since left-shifting a negative value is undefined.
+      constexpr auto SCALE = static_cast<T2>(static_cast<T2>(1) << (FRACT_BITS2 - FRACT_BITS));
+      return fixed_t<T2, FRACT_BITS2>::from_bits(static_cast<T2>(static_cast<T2>(m_bits) * SCALE));
+    } else {
+      return fixed_t<T2, FRACT_BITS2>::from_bits(
+          static_cast<T2>(m_bits >> (FRACT_BITS - FRACT_BITS2)));
+    }
+  }
+
+  constexpr fixed_t& operator+=(const fixed_t y) {
+    m_bits += y.m_bits;
+    return *this;
+  }
+  constexpr fixed_t& operator-=(const fixed_t y) {
+    m_bits -= y.m_bits;
+    return *this;
+  }
+  constexpr fixed_t& operator*=(const T y) {
+    m_bits *= y;
     return *this;
   }
-  fp32_t& operator*=(const uint32_t y) {
-    m_fpbits *= y;
+  constexpr fixed_t& operator*=(const fixed_t y) {
+    // Rounding multiplication with a 64-bit intermediate result.
+    using wide_t = typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type;
+    const auto p = static_cast<wide_t>(m_bits) * static_cast<wide_t>(y.m_bits);
+    m_bits = static_cast<T>((p + (static_cast<wide_t>(1) << (FRACT_BITS - 1U))) >> FRACT_BITS);
     return *this;
   }
-  fp32_t& operator/=(const uint32_t y) {
-    // Rounding division.
-    m_fpbits = (m_fpbits + (y >> 1U)) / y;
+  constexpr fixed_t& operator/=(const T y) {
+    // Rounding division (away from zero for halves). The rounding offset follows the sign of
+    // the quotient.
+    if constexpr (std::is_signed<T>::value) {
+      if ((m_bits < 0) != (y < 0)) {
+        m_bits = (m_bits - y / 2) / y;
+        return *this;
+      }
+    }
+    m_bits = (m_bits + y / 2) / y;
     return *this;
   }
 
+  constexpr bool operator==(const fixed_t y) const {
+    return m_bits == y.m_bits;
+  }
+  constexpr bool operator!=(const fixed_t y) const {
+    return m_bits != y.m_bits;
+  }
+  constexpr bool operator<(const fixed_t y) const {
+    return m_bits < y.m_bits;
+  }
+
 private:
-  static constexpr uint32_t FP_SHIFT = 20U;
+  static constexpr T ONE = static_cast<T>(1) << FRACT_BITS;
 
-  static constexpr uint32_t to_fpbits(long double& d) {
-    auto i = static_cast<uint32_t>(d);
-    auto f = static_cast<uint32_t>((d - static_cast<long double>(i)) *
-                                   static_cast<long double>(1U << FP_SHIFT));
-    return (i << FP_SHIFT) | f;
+  static constexpr T to_bits(const long double d) {
+    // Round to nearest.
+    return static_cast<T>(d * static_cast<long double>(ONE) + (d < 0.0L ? -0.5L : 0.5L));
   }
 
-  uint32_t m_fpbits;
+  T m_bits;
 };
 
-constexpr fp32_t operator""_fp32(long double x) {
-  return fp32_t(x);
+template <typename T, uint32_t FRACT_BITS>
+constexpr fixed_t<T, FRACT_BITS> operator+(fixed_t<T, FRACT_BITS> x,
+                                           const fixed_t<T, FRACT_BITS> y) {
+  return x += y;
 }
-
-fp32_t operator+(fp32_t x, const fp32_t& y) {
-  x += y;
-  return x;
+template <typename T, uint32_t FRACT_BITS>
+constexpr fixed_t<T, FRACT_BITS> operator-(fixed_t<T, FRACT_BITS> x,
+                                           const fixed_t<T, FRACT_BITS> y) {
+  return x -= y;
 }
-fp32_t operator*(fp32_t x, const uint32_t& y) {
-  x *= y;
-  return x;
+template <typename T, uint32_t FRACT_BITS>
+constexpr fixed_t<T, FRACT_BITS> operator*(fixed_t<T, FRACT_BITS> x,
+                                           const fixed_t<T, FRACT_BITS> y) {
+  return x *= y;
 }
-fp32_t operator/(fp32_t x, const uint32_t& y) {
-  x /= y;
-  return x;
+template <typename T, uint32_t FRACT_BITS>
+constexpr fixed_t<T, FRACT_BITS> operator*(fixed_t<T, FRACT_BITS> x, const T y) {
+  return x *= y;
+}
+template <typename T, uint32_t FRACT_BITS>
+constexpr fixed_t<T, FRACT_BITS> operator/(fixed_t<T, FRACT_BITS> x, const T y) {
+  return x /= y;
+}
+
+// Unsigned 12.20 format, which gives us a valid range of 0.000000 - 4095.999999 and 6 decimals
+// precision. This format is suitable for representing 2D screen coordinates and sizes.
+using fp32_t = fixed_t<uint32_t, 20U>;
+
+// Signed 16.16 format. This is the format of the VCR_XOFFS and VCR_XINCR video control registers
+// (which use the low 24 bits, i.e. 8.16).
+using vcr_fp_t = fixed_t<int32_t, 16U>;
+
+constexpr fp32_t operator""_fp32(long double x) {
+  return fp32_t(x);
 }
 
 }  // namespace
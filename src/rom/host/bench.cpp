@@ -0,0 +1,254 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Frame cost benchmark for the ROM animation code, running on the host.
+//
+// The numbers are host CPU numbers, so they are only useful for comparing different versions of
+// the ROM code with each other (e.g. to catch regressions in the per-frame hot paths).
+
+#include "mc1_host.hpp"
+
+#include "bootprof.hpp"
+#include "mosaic.hpp"
+#ifdef ENABLE_SPLASH
+#include "splash.hpp"
+#endif
+
+#include <mc1/mmio.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+using host_clock_t = std::chrono::steady_clock;
+
+struct options_t {
+  uint32_t frames = 1000U;
+  bool boot = true;
+  mc1_host::config_t config;
+};
+
+void print_usage(const char* prg) {
+  std::printf("Usage: %s [options]\n", prg);
+  std::printf("  --frames N    Number of frames to run (default: 1000)\n");
+  std::printf("  --width W     Video width (default: 1920)\n");
+  std::printf("  --height H    Video height (default: 1080)\n");
+  std::printf("  --fps F       Video refresh rate (default: 60)\n");
+  std::printf("  --no-boot     Do not run the boot state machine benchmark\n");
+}
+
+bool parse_args(int argc, char** argv, options_t& opts) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const bool has_value = (i + 1) < argc;
+    if (std::strcmp(arg, "--frames") == 0 && has_value) {
+      opts.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--width") == 0 && has_value) {
+      opts.config.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--height") == 0 && has_value) {
+      opts.config.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--fps") == 0 && has_value) {
+      opts.config.fps = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--no-boot") == 0) {
+      opts.boot = false;
+    } else {
+      print_usage(argv[0]);
+      return false;
+    }
+  }
+  return opts.frames > 0U && opts.config.width > 0U && opts.config.height > 0U &&
+         opts.config.fps > 0U;
+}
+
+void print_result(const char* name, const mc1_host::frame_stats_t& stats, uint32_t bytes) {
+  const auto avg_ns = stats.frames > 0U ? stats.total_ns / stats.frames : 0U;
+  std::printf("%-24s %9llu ns/frame (min %llu, max %llu)",
+              name,
+              static_cast<unsigned long long>(avg_ns),
+              static_cast<unsigned long long>(stats.min_ns),
+              static_cast<unsigned long long>(stats.max_ns));
+  if (bytes > 0U) {
+    std::printf(", %u bytes/frame written to VRAM", bytes);
+  }
+  std::printf("\n");
+}
+
+// Count the number of VRAM bytes that fun() writes to. Two passes with different fill patterns
+// are used so that words that are written with the fill value are also caught, so fun() must do
+// the same thing every time it is called. The VRAM contents are restored afterwards.
+template <typename F>
+uint32_t count_vram_bytes_written(F fun) {
+  auto* vram = mc1_host::vram();
+  const auto num_words = mc1_host::vram_words();
+  std::vector<uint32_t> saved(vram, vram + num_words);
+  std::vector<bool> written(num_words, false);
+  static const uint32_t FILL[2] = {0x5a5a5a5aU, 0xa5a5a5a5U};
+  for (auto fill : FILL) {
+    for (uint32_t i = 0U; i < num_words; ++i) {
+      vram[i] = fill;
+    }
+    fun();
+    for (uint32_t i = 0U; i < num_words; ++i) {
+      if (vram[i] != fill) {
+        written[i] = true;
+      }
+    }
+  }
+  std::memcpy(vram, saved.data(), num_words * sizeof(uint32_t));
+
+  uint32_t count = 0U;
+  for (uint32_t i = 0U; i < num_words; ++i) {
+    count += written[i] ? 4U : 0U;
+  }
+  return count;
+}
+
+// Wait for the next (virtual) frame, like the ROM main loop does.
+void wait_for_next_frame() {
+  const auto frame_no = MMIO(VIDFRAMENO);
+  while (MMIO(VIDFRAMENO) == frame_no) {
+  }
+}
+
+// Time fun(t) for t = 0, 1, ..., frames - 1 (one call per frame).
+template <typename F>
+mc1_host::frame_stats_t time_frames(const uint32_t frames, F fun) {
+  mc1_host::frame_stats_t stats;
+  for (uint32_t t = 0U; t < frames; ++t) {
+    wait_for_next_frame();
+    const auto t0 = host_clock_t::now();
+    fun(t);
+    const auto dt = host_clock_t::now() - t0;
+    const auto ns =
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count());
+    if (t == 0U || ns < stats.min_ns) {
+      stats.min_ns = ns;
+    }
+    if (t == 0U || ns > stats.max_ns) {
+      stats.max_ns = ns;
+    }
+    stats.total_ns += ns;
+    ++stats.frames;
+  }
+  return stats;
+}
+
+void bench_mosaic(const options_t& opts) {
+  mc1_host::reset(opts.config);
+  vram_arena_t arena;
+  arena.init();
+  mosaic_t mosaic;
+  (void)mosaic.init(arena);
+  const auto stats = time_frames(opts.frames, [&mosaic](uint32_t t) { mosaic.update(t); });
+  const auto bytes = count_vram_bytes_written([&mosaic]() {
+    auto copy = mosaic;
+    copy.update(123U);
+  });
+  print_result("mosaic_t::update", stats, bytes);
+}
+
+#ifdef ENABLE_SPLASH
+void bench_splash(const options_t& opts) {
+  mc1_host::reset(opts.config);
+  vram_arena_t arena;
+  arena.init();
+  splash_t splash;
+  (void)splash.init(arena);
+  const auto stats = time_frames(opts.frames, [&splash](uint32_t t) { splash.update(t); });
+  const auto bytes = count_vram_bytes_written([&splash]() {
+    // Note: Update a copy, so that both passes use the same (back) buffer.
+    auto copy = splash;
+    wait_for_next_frame();
+    copy.update(123U);
+  });
+  print_result("splash_t::update", stats, bytes);
+}
+#endif
+
+#ifdef ENABLE_BOOTPROF
+void print_boot_profile() {
+  static const char* STAGE_NAMES[BOOTPROF_NUM_STAGES] = {"INITIALIZE",
+                                                         "RUN_DIAGNOSTICS",
+                                                         "WAIT_FOR_SDCARD",
+                                                         "MOUNT_FAT",
+                                                         "LOAD_MC1BOOT",
+                                                         "MOSAIC_INIT",
+                                                         "SPLASH_INIT",
+                                                         "ELF32_LOAD",
+                                                         "FRAME_UPDATE"};
+  const auto& prof = rom_boot_prof;
+  if (prof.magic != BOOTPROF_MAGIC) {
+    std::printf("No boot profile\n");
+    return;
+  }
+  std::printf("\nBoot profile (CPU cycles, %u events)\n", prof.num_events);
+  std::printf("%-16s %8s %10s %10s %10s\n", "stage", "count", "min", "avg", "max");
+  for (int k = 0; k < BOOTPROF_NUM_STAGES; ++k) {
+    const auto& stats = prof.stats[k];
+    if (stats.count == 0U) {
+      continue;
+    }
+    const auto total =
+        (static_cast<uint64_t>(stats.total_cycles_hi) << 32) | stats.total_cycles_lo;
+    std::printf("%-16s %8u %10u %10llu %10u\n",
+                STAGE_NAMES[k],
+                stats.count,
+                stats.min_cycles,
+                static_cast<unsigned long long>(total / stats.count),
+                stats.max_cycles);
+  }
+}
+#endif
+
+bool bench_boot(const options_t& opts) {
+  mc1_host::reset(opts.config);
+  mc1_host::frame_stats_t stats;
+  if (!mc1_host::run_rom(opts.frames, stats)) {
+    std::printf("The boot loop did not reach the frame limit\n");
+    return false;
+  }
+  print_result("boot loop (main)", stats, 0U);
+#ifdef ENABLE_BOOTPROF
+  print_boot_profile();
+#endif
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  options_t opts;
+  if (!parse_args(argc, argv, opts)) {
+    return 1;
+  }
+
+  std::printf("%u frames @ %ux%u\n", opts.frames, opts.config.width, opts.config.height);
+  bench_mosaic(opts);
+#ifdef ENABLE_SPLASH
+  bench_splash(opts);
+#endif
+  if (opts.boot && !bench_boot(opts)) {
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,35 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Stand-in for the boot splash image (out/boot-splash.c) in the host build.
+//
+// Only the MCI header is present. It has the same dimensions and pixel format as
+// media/boot-splash.png when converted with "png2mci --lzg --pal4", and the host mci_decode
+// functions synthesize the pixels and the palette.
+
+extern const unsigned char boot_splash_mci[] __attribute__((aligned(4))) = {
+    0x4d, 0x43, 0x49, 0x31,  // Magic ("MCI1")
+    0x00, 0x01,              // Width (256)
+    0x5d, 0x01,              // Height (349)
+    0x03, 0x00,              // Pixel format (CMODE_PAL4)
+    0x01, 0x00,              // Compression (LZG)
+    0x10, 0x00,              // Number of palette colors (16)
+    0x00, 0x00,              // Reserved
+};
@@ -0,0 +1,207 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+// Test for the streaming ELF loader: Load a synthetic executable into the emulated VRAM and check
+// the segment contents, the cleared BSS and that nothing outside of the segments is touched. The
+// same executable is also loaded in LZG compressed form (see host/lzgpack.cpp).
+
+#include "lzgpack.hpp"
+#include "mc1_host.hpp"
+
+#include "elf_loader.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+const char* const PATH = "MC1BOOT.EXE";
+const uint32_t FILL_BYTE = 0xaaU;
+
+struct segment_desc_t {
+  uint32_t type;
+  uint32_t vram_offset;
+  uint32_t file_size;
+  uint32_t mem_size;
+};
+
+const segment_desc_t SEGMENTS[] = {
+    {1U, 0x1000U, 3000U, 3000U},  // Text.
+    {4U, 0x0000U, 16U, 16U},      // A note (not loaded).
+    {1U, 0x2003U, 37U, 1000U},    // Unaligned data + BSS.
+    {1U, 0x3000U, 0U, 64U},       // BSS only.
+};
+const uint32_t NUM_SEGMENTS = sizeof(SEGMENTS) / sizeof(SEGMENTS[0]);
+
+uint32_t vram_addr(const uint32_t offset) {
+  return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(mc1_host::vram())) + offset;
+}
+
+uint8_t content_byte(const uint32_t seg, const uint32_t i) {
+  return static_cast<uint8_t>(seg * 31U + i * 7U + 1U);
+}
+
+void put16(std::vector<uint8_t>& buf, const uint32_t offset, const uint32_t x) {
+  buf[offset] = static_cast<uint8_t>(x);
+  buf[offset + 1U] = static_cast<uint8_t>(x >> 8);
+}
+
+void put32(std::vector<uint8_t>& buf, const uint32_t offset, const uint32_t x) {
+  put16(buf, offset, x);
+  put16(buf, offset + 2U, x >> 16);
+}
+
+uint32_t get32(const std::vector<uint8_t>& buf, const uint32_t offset) {
+  return static_cast<uint32_t>(buf[offset]) | (static_cast<uint32_t>(buf[offset + 1U]) << 8) |
+         (static_cast<uint32_t>(buf[offset + 2U]) << 16) |
+         (static_cast<uint32_t>(buf[offset + 3U]) << 24);
+}
+
+std::vector<uint8_t> make_elf() {
+  const uint32_t PHOFF = 52U;
+  uint32_t data_offset = PHOFF + NUM_SEGMENTS * 32U;
+  std::vector<uint8_t> elf(data_offset);
+
+  const uint8_t ident[] = {0x7f, 'E', 'L', 'F', 1, 1, 1};
+  std::memcpy(elf.data(), ident, sizeof(ident));
+  put16(elf, 16U, 2U);                      // e_type = ET_EXEC
+  put32(elf, 20U, 1U);                      // e_version
+  put32(elf, 24U, vram_addr(0x1000U) + 8);  // e_entry
+  put32(elf, 28U, PHOFF);                   // e_phoff
+  put16(elf, 40U, 52U);                     // e_ehsize
+  put16(elf, 42U, 32U);                     // e_phentsize
+  put16(elf, 44U, NUM_SEGMENTS);            // e_phnum
+
+  for (uint32_t seg = 0U; seg < NUM_SEGMENTS; ++seg) {
+    const auto& desc = SEGMENTS[seg];
+    const auto phdr = PHOFF + seg * 32U;
+    put32(elf, phdr, desc.type);
+    put32(elf, phdr + 4U, data_offset);
+    put32(elf, phdr + 8U, vram_addr(desc.vram_offset));
+    put32(elf, phdr + 12U, vram_addr(desc.vram_offset));
+    put32(elf, phdr + 16U, desc.file_size);
+    put32(elf, phdr + 20U, desc.mem_size);
+    for (uint32_t i = 0U; i < desc.file_size; ++i) {
+      elf.push_back(content_byte(seg, i));
+    }
+    data_offset += desc.file_size;
+  }
+  return elf;
+}
+
+bool check(const bool cond, const char* what) {
+  if (!cond) {
+    std::printf("FAIL: %s\n", what);
+  }
+  return cond;
+}
+
+bool load(const std::vector<uint8_t>& elf, uint32_t* entry_address) {
+  mc1_host::reset(mc1_host::config_t());
+  std::memset(mc1_host::vram(), FILL_BYTE, mc1_host::VRAM_SIZE);
+  mc1_host::attach_file(PATH, elf.data(), static_cast<uint32_t>(elf.size()));
+  elf_loader_t loader;
+  const auto success = loader.open(PATH) && loader.load(entry_address);
+  mc1_host::attach_file(nullptr, nullptr, 0U);
+  return success;
+}
+
+bool test_load(const bool compressed) {
+  const auto elf = compressed ? mc1_host::lzg_pack_elf(make_elf()) : make_elf();
+  uint32_t entry_address = 0U;
+  if (!check(load(elf, &entry_address), "could not load the executable") ||
+      !check(entry_address == vram_addr(0x1000U) + 8U, "bad entry address")) {
+    return false;
+  }
+  if (compressed) {
+    // The text segment should be compressed, but the data segment is too small to gain anything.
+    const auto text_flags = get32(elf, 52U + 24U);
+    const auto data_flags = get32(elf, 52U + 2U * 32U + 24U);
+    if (!check((text_flags & elf_loader_t::PF_MC1_LZG) != 0U, "text segment not compressed") ||
+        !check((data_flags & elf_loader_t::PF_MC1_LZG) == 0U, "data segment compressed")) {
+      return false;
+    }
+  }
+
+  // Check every byte of VRAM.
+  const auto* vram = reinterpret_cast<const uint8_t*>(mc1_host::vram());
+  for (uint32_t offset = 0U; offset < mc1_host::VRAM_SIZE; ++offset) {
+    uint32_t expected = FILL_BYTE;
+    for (uint32_t seg = 0U; seg < NUM_SEGMENTS; ++seg) {
+      const auto& desc = SEGMENTS[seg];
+      if (desc.type == 1U && offset >= desc.vram_offset &&
+          offset < desc.vram_offset + desc.mem_size) {
+        const auto i = offset - desc.vram_offset;
+        expected = i < desc.file_size ? content_byte(seg, i) : 0U;
+      }
+    }
+    if (vram[offset] != expected) {
+      std::printf("FAIL: VRAM offset 0x%x: 0x%02x != 0x%02x\n", offset, vram[offset], expected);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool test_overlaps() {
+  const auto elf = make_elf();
+  mc1_host::attach_file(PATH, elf.data(), static_cast<uint32_t>(elf.size()));
+  elf_loader_t loader;
+  const auto opened = loader.open(PATH);
+  mc1_host::attach_file(nullptr, nullptr, 0U);
+  const auto* vram = reinterpret_cast<const uint8_t*>(mc1_host::vram());
+  return check(opened, "could not open the executable") &&
+         check(loader.overlaps(&vram[0x1100], &vram[0x1200]), "missed an overlap") &&
+         check(loader.overlaps(&vram[0x0f00], &vram[0x1001]), "missed an overlap") &&
+         check(!loader.overlaps(&vram[0x0f00], &vram[0x1000]), "false overlap") &&
+         check(!loader.overlaps(&vram[0x0000], &vram[0x0100]), "false overlap (note segment)") &&
+         check(!loader.overlaps(&vram[0x3040], &vram[0x4000]), "false overlap");
+}
+
+bool test_bad_files() {
+  uint32_t entry_address = 0U;
+  auto elf = make_elf();
+  elf[1] = 'X';
+  if (!check(!load(elf, &entry_address), "accepted a bad ELF magic")) {
+    return false;
+  }
+
+  elf = make_elf();
+  put16(elf, 16U, 3U);  // ET_DYN
+  if (!check(!load(elf, &entry_address), "accepted a shared object")) {
+    return false;
+  }
+
+  elf = make_elf();
+  elf.resize(elf.size() - 1U);
+  return check(!load(elf, &entry_address), "accepted a truncated file");
+}
+}  // namespace
+
+int main() {
+  bool success = true;
+  success = test_load(false) && success;
+  success = test_load(true) && success;
+  success = test_overlaps() && success;
+  success = test_bad_files() && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host shim for <mc1/mci_decode.h>.
+//
+// The host shim does not decode real MCI data. The "image" only carries a header, and the pixels
+// and palette are synthesized (see libmc1_host.cpp). This keeps the host build independent of
+// png2mci, while giving the ROM code the same image dimensions and pixel format to work with.
+
+#ifndef MC1_MCI_DECODE_H_
+#define MC1_MCI_DECODE_H_
+
+#include <stdint.h>
+
+typedef struct {
+  uint32_t magic;
+  uint16_t width;
+  uint16_t height;
+  uint16_t pixel_format;
+  uint16_t compression;
+  uint16_t num_pal_colors;
+  uint16_t reserved;
+} mci_header_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const mci_header_t* mci_get_header(const void* data);
+uint32_t mci_get_stride(const mci_header_t* hdr);
+uint32_t mci_get_pixels_size(const mci_header_t* hdr);
+void mci_decode_pixels(const void* data, void* pixels);
+void mci_decode_palette(const void* data, void* palette);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_MCI_DECODE_H_
@@ -0,0 +1,34 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host shim for <mc1/memory.h>.
+//
+// The MC1 memory map is only used for address reporting on the host. VRAM is backed by an
+// emulated memory area (see mc1_host.cpp), and VRAM pointers are real host pointers.
+
+#ifndef MC1_MEMORY_H_
+#define MC1_MEMORY_H_
+
+#define ROM_START 0x00000000
+#define VRAM_START 0x40000000
+#define XRAM_START 0x80000000
+#define MMIO_START 0xc0000000
+
+#endif  // MC1_MEMORY_H_
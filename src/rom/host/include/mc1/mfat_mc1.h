@@ -0,0 +1,71 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host shim for <mc1/mfat_mc1.h>.
+//
+// Only the parts of the MFAT API that the ROM uses are declared. Mounting always fails, but a test
+// can attach a single file (see mc1_host::attach_file()) that can be opened and read.
+
+#ifndef MC1_MFAT_MC1_H_
+#define MC1_MFAT_MC1_H_
+
+#include <stdint.h>
+
+#define MFAT_O_RDONLY 1
+
+#define MFAT_SEEK_SET 0
+#define MFAT_SEEK_CUR 1
+#define MFAT_SEEK_END 2
+
+typedef int (*mfat_read_block_fun_t)(char* ptr, unsigned block_no, void* custom);
+typedef int (*mfat_write_block_fun_t)(const char* ptr, unsigned block_no, void* custom);
+
+typedef struct {
+  int year;
+  int month;
+  int day;
+  int hour;
+  int minute;
+  int second;
+} mfat_time_t;
+
+typedef struct {
+  uint32_t st_mode;
+  mfat_time_t st_mtim;
+  uint32_t st_size;
+} mfat_stat_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int mfat_mount(mfat_read_block_fun_t read_fun, mfat_write_block_fun_t write_fun, void* custom);
+void mfat_unmount(void);
+int mfat_stat(const char* path, mfat_stat_t* stat);
+int mfat_open(const char* path, int oflag);
+int mfat_close(int fd);
+int64_t mfat_read(int fd, void* buf, uint32_t nbyte);
+int64_t mfat_lseek(int fd, int64_t offset, int whence);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_MFAT_MC1_H_
@@ -0,0 +1,147 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host shim for <mc1/mmio.h>.
+//
+// The register offsets match rtl/mmio.vhd. MMIO(reg) evaluates to an lvalue in the emulated
+// register file, and every evaluation goes through mc1_host_mmio_reg() so that dynamic registers
+// (CLKCNT*, VIDFRAMENO, VIDY) can be updated from the emulated clock.
+
+#ifndef MC1_MMIO_H_
+#define MC1_MMIO_H_
+
+#include <mc1/memory.h>
+
+#include <stdint.h>
+
+#define CLKCNTLO 0
+#define CLKCNTHI 4
+#define CPUCLK 8
+#define VRAMSIZE 12
+#define XRAMSIZE 16
+#define VIDWIDTH 20
+#define VIDHEIGHT 24
+#define VIDFPS 28
+#define VIDFRAMENO 32
+#define VIDY 36
+#define SWITCHES 40
+#define BUTTONS 44
+#define KEYPTR 48
+#define MOUSEPOS 52
+#define MOUSEBTNS 56
+#define SDIN 60
+#define SEGDISP0 64
+#define SEGDISP1 68
+#define SEGDISP2 72
+#define SEGDISP3 76
+#define SEGDISP4 80
+#define SEGDISP5 84
+#define SEGDISP6 88
+#define SEGDISP7 92
+#define LEDS 96
+#define SDOUT 100
+#define SDWE 104
+#define PERFSEL 108
+#define PERFCNT 112
+#define PERFCTL 116
+#define KEYBUF 128
+#define DMASRC 192
+#define DMADST 196
+#define DMAWIDTH 200
+#define DMAHEIGHT 204
+#define DMASSTRIDE 208
+#define DMADSTRIDE 212
+#define DMAFILL 216
+#define DMACTL 220
+#define DMASTAT 224
+#define SPICTL 228
+#define SPIDIV 232
+#define SPITX 236
+#define SPIRX 240
+#define SPISTAT 244
+#define SPIRDCNT 248
+
+// Performance counters (write the index to PERFSEL, and read the value from PERFCNT). There are
+// three counters per crossbar port: E.g. PERF_XBAR_VRAM + PERF_STALLS is the number of cycles
+// during which a VRAM request was stalled.
+#define PERF_XBAR_CPUD 0
+#define PERF_XBAR_CPUI 3
+#define PERF_XBAR_ROM 6
+#define PERF_XBAR_VRAM 9
+#define PERF_XBAR_XRAM 12
+#define PERF_XBAR_MMIO 15
+#define PERF_GRANTS 0
+#define PERF_STALLS 1
+#define PERF_PENDING 2
+
+// Video and XRAM performance counters. The video counters count video clock cycles.
+#define PERF_VID1_PREFETCH_HITS 18
+#define PERF_VID1_PREFETCH_MISSES 19
+#define PERF_VID1_PREFETCH_SPECULATIVE 20
+#define PERF_VID1_VCPP_STALLS 21
+#define PERF_VID2_VCPP_STALLS 22
+#define PERF_XRAM_FIFO_FULL 23
+#define PERF_NUM_COUNTERS 24
+
+// XRAM line fetch statistics for video layer 1 (the only layer that can show rows from XRAM).
+// These are read with PERFSEL/PERFCNT, but they are not counters and are not affected by PERFCTL.
+#define PERF_LINE_FETCH_MIN_MARGIN 24  // Smallest margin in video clock cycles (0xffffff = none).
+#define PERF_LINE_FETCH_UNDERRUNS 25   // Number of rows that were not fetched in time.
+
+// PERFCTL bits.
+#define PERFCTL_FREEZE 1   // Stop counting while set.
+#define PERFCTL_CLEAR 2    // Write 1 to clear all the counters.
+
+// DMA engine. A transfer is DMAHEIGHT rows of DMAWIDTH words, with byte addresses and byte strides.
+#define DMACTL_START 1     // Write 1 to start a transfer.
+#define DMACTL_FILL 2      // Fill the destination with DMAFILL (instead of copying).
+#define DMASTAT_BUSY 1
+#define DMASTAT_DONE 2
+#define DMASTAT_ERR 4
+
+// SPI master for the SD card, with SCK = CPUCLK / (2 * (SPIDIV + 1)). Writing to SPITX sends an
+// entry, reading from SPIRX pops a received entry, and writing a count to SPIRDCNT receives that
+// many entries (while sending 0xff). Entries are bytes, or words with the bytes in memory order.
+#define SPICTL_ENABLE 1    // The SPI master drives the SD card pins (instead of SDOUT/SDWE).
+#define SPICTL_CS 2        // Assert CS (DAT3).
+#define SPICTL_WORD 4      // Transfer words instead of bytes.
+#define SPICTL_DUPLEX 8    // Also receive the entries that are written to SPITX.
+#define SPISTAT_BUSY 1
+#define SPISTAT_TXFULL 2
+#define SPISTAT_RXEMPTY 4
+#define SPISTAT_RXLEVEL_SHIFT 8  // Bits 15..8: Number of entries in the RX FIFO.
+#define SPISTAT_PRESENT 0x80000000U
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+volatile uint32_t* mc1_host_mmio_reg(uint32_t offset);
+
+// Emulates a jump to the ROM reset vector (there is no such thing on the host).
+void mc1_host_soft_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define MMIO(reg) (*mc1_host_mmio_reg(reg))
+
+#endif  // MC1_MMIO_H_
@@ -0,0 +1,54 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host shim for <mc1/sdcard.h>.
+//
+// The SD card is emulated with a memory buffer (see mc1_host::attach_sdcard()). Without a card,
+// sdcard_init() fails, which keeps the boot state machine in its "insert bootable SD card" loop.
+
+#ifndef MC1_SDCARD_H_
+#define MC1_SDCARD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*sdcard_log_func_t)(const char* msg);
+
+typedef struct {
+  sdcard_log_func_t log_func;
+  int protocol_version;
+  int is_sdhc;
+  size_t num_blocks;
+} sdctx_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool sdcard_init(sdctx_t* ctx, sdcard_log_func_t log_func);
+bool sdcard_read(sdctx_t* ctx, void* ptr, size_t first_block, size_t num_blocks);
+bool sdcard_write(sdctx_t* ctx, const void* ptr, size_t first_block, size_t num_blocks);
+size_t sdcard_get_size(sdctx_t* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_SDCARD_H_
@@ -0,0 +1,110 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host shim for <mc1/vcp.h>.
+//
+// The instruction encodings match rtl/vid_vcpp.vhd. VCP addresses are word offsets into the
+// emulated VRAM.
+
+#ifndef MC1_VCP_H_
+#define MC1_VCP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Video control registers.
+#define VCR_ADDR 0
+#define VCR_XOFFS 1
+#define VCR_XINCR 2
+#define VCR_HSTRT 3
+#define VCR_HSTOP 4
+#define VCR_CMODE 5
+#define VCR_RMODE 6
+#define VCR_LADDR 7   // XRAM word address of the row to show on the next line (starts a fetch).
+#define VCR_LSIZE 8   // Number of words to fetch into the XRAM line buffer.
+#define VCR_YINCR 9   // ADDR increment per image row (signed, in words).
+#define VCR_YSTEP 10  // Image rows per raster line (unsigned 8.16 fixed point).
+#define VCR_GCOL0 11  // Left color of the gradient color mode (BGR888).
+#define VCR_GCOL1 12  // Right color of the gradient color mode (BGR888).
+#define VCR_NUM_REGS 13
+
+// Color modes.
+#define CMODE_RGBA8888 0
+#define CMODE_RGBA5551 1
+#define CMODE_PAL8 2
+#define CMODE_PAL4 3
+#define CMODE_PAL2 4
+#define CMODE_PAL1 5
+#define CMODE_GRADIENT 6
+
+// The gradient weight is the integer x coordinate shifted left by n bits (CMODE bits 6..4).
+#define CMODE_GSHIFT(n) ((n) << 4)
+
+typedef enum { LAYER_1 = 1, LAYER_2 = 2 } layer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t mc1_host_vram[];
+
+static inline uint32_t to_vcp_addr(uintptr_t cpu_addr) {
+  return (uint32_t)((cpu_addr - (uintptr_t)&mc1_host_vram[0]) >> 2);
+}
+
+static inline uint32_t vcp_emit_jmp(uint32_t addr) {
+  return 0x00000000u | (addr & 0x00ffffffu);
+}
+
+static inline uint32_t vcp_emit_jsr(uint32_t addr) {
+  return 0x10000000u | (addr & 0x00ffffffu);
+}
+
+static inline uint32_t vcp_emit_rts(void) {
+  return 0x20000000u;
+}
+
+static inline uint32_t vcp_emit_nop(void) {
+  return 0x30000000u;
+}
+
+static inline uint32_t vcp_emit_waitx(int x) {
+  return 0x40000000u | ((uint32_t)x & 0x0000ffffu);
+}
+
+static inline uint32_t vcp_emit_waity(int y) {
+  return 0x50000000u | ((uint32_t)y & 0x0000ffffu);
+}
+
+static inline uint32_t vcp_emit_setpal(uint32_t first, uint32_t count) {
+  return 0x60000000u | ((first & 255u) << 8) | ((count - 1u) & 255u);
+}
+
+static inline uint32_t vcp_emit_setreg(uint32_t reg, uint32_t value) {
+  return 0x80000000u | ((reg & 15u) << 24) | (value & 0x00ffffffu);
+}
+
+void vcp_set_prg(layer_t layer, const uint32_t* prg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_VCP_H_
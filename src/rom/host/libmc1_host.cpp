@@ -0,0 +1,302 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Host implementations of the parts of libmc1 that the ROM uses.
+
+#include "mc1_host.hpp"
+
+#include <mc1/elf32.h>
+#include <mc1/leds.h>
+#include <mc1/mci_decode.h>
+#include <mc1/mfat_mc1.h>
+#include <mc1/mmio.h>
+#include <mc1/sdcard.h>
+#include <mc1/vconsole.h>
+#include <mc1/vcp.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+bool console_enabled() {
+  static const bool s_enabled = std::getenv("MC1_HOST_CONSOLE") != nullptr;
+  return s_enabled;
+}
+
+uint32_t* s_vcon_mem;
+std::string s_console_output;
+
+// Emulated SD card.
+const uint8_t* s_sdcard_data;
+uint32_t s_sdcard_num_blocks;
+mc1_host::sdcard_stats_t s_sdcard_stats;
+
+// Emulated file (there is at most one, with file descriptor 0).
+const char* s_file_path;
+const uint8_t* s_file_data;
+uint32_t s_file_size;
+uint32_t s_file_pos;
+bool s_file_open;
+}  // namespace
+
+void mc1_host::attach_sdcard(const uint8_t* data, const uint32_t num_blocks) {
+  s_sdcard_data = data;
+  s_sdcard_num_blocks = data != nullptr ? num_blocks : 0U;
+  s_sdcard_stats = sdcard_stats_t();
+}
+
+mc1_host::sdcard_stats_t mc1_host::sdcard_stats() {
+  return s_sdcard_stats;
+}
+
+std::string mc1_host::take_console_output() {
+  std::string output;
+  output.swap(s_console_output);
+  return output;
+}
+
+void mc1_host::attach_file(const char* path, const uint8_t* data, const uint32_t size) {
+  s_file_path = path;
+  s_file_data = data;
+  s_file_size = data != nullptr ? size : 0U;
+  s_file_pos = 0U;
+  s_file_open = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// vcp.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" void vcp_set_prg(layer_t layer, const uint32_t* prg) {
+  // Each layer has a four word entry point at VRAM word address 4 * layer.
+  auto* layer_start = &mc1_host_vram[4 * static_cast<int>(layer)];
+  if (prg != nullptr) {
+    layer_start[0] = vcp_emit_jmp(to_vcp_addr(reinterpret_cast<uintptr_t>(prg)));
+  } else {
+    // Transparent layer.
+    layer_start[0] = vcp_emit_setpal(0, 1);
+    layer_start[1] = 0x00000000U;
+    layer_start[2] = vcp_emit_waity(32767);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// mci_decode.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" const mci_header_t* mci_get_header(const void* data) {
+  return reinterpret_cast<const mci_header_t*>(data);
+}
+
+extern "C" uint32_t mci_get_stride(const mci_header_t* hdr) {
+  static const uint32_t BPP[] = {32U, 16U, 8U, 4U, 2U, 1U};
+  const auto bits = static_cast<uint32_t>(hdr->width) * BPP[hdr->pixel_format];
+  return ((bits + 31U) / 32U) * 4U;
+}
+
+extern "C" uint32_t mci_get_pixels_size(const mci_header_t* hdr) {
+  return mci_get_stride(hdr) * hdr->height;
+}
+
+extern "C" void mci_decode_pixels(const void* data, void* pixels) {
+  // Synthesize a deterministic pattern (diagonal bands) instead of decoding the image.
+  const auto* hdr = mci_get_header(data);
+  const auto words_per_row = mci_get_stride(hdr) / 4U;
+  auto* dst = reinterpret_cast<uint32_t*>(pixels);
+  for (uint32_t y = 0U; y < hdr->height; ++y) {
+    for (uint32_t x = 0U; x < words_per_row; ++x) {
+      *dst++ = (x + y) * 0x01234567U;
+    }
+  }
+}
+
+extern "C" void mci_decode_palette(const void* data, void* palette) {
+  // Synthesize a gray scale palette with a transparent first color.
+  const auto* hdr = mci_get_header(data);
+  auto* dst = reinterpret_cast<uint32_t*>(palette);
+  const uint32_t num_colors = hdr->num_pal_colors;
+  for (uint32_t k = 0U; k < num_colors; ++k) {
+    const auto i = num_colors > 1U ? (k * 255U) / (num_colors - 1U) : 255U;
+    const auto alpha = k == 0U ? 0U : 255U;
+    dst[k] = (alpha << 24) | (i << 16) | (i << 8) | i;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// leds.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" void set_leds(uint32_t bits) {
+  MMIO(LEDS) = bits;
+}
+
+extern "C" void sevseg_print(const char* text) {
+  if (console_enabled()) {
+    std::fprintf(stderr, "[sevseg] %s\n", text);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// sdcard.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" bool sdcard_init(sdctx_t* ctx, sdcard_log_func_t log_func) {
+  ctx->log_func = log_func;
+  ctx->protocol_version = 2;
+  ctx->is_sdhc = 1;
+  ctx->num_blocks = s_sdcard_num_blocks;
+  return s_sdcard_data != nullptr;
+}
+
+extern "C" bool sdcard_read(sdctx_t*, void* ptr, size_t first_block, size_t num_blocks) {
+  // Note: One call is one (multi-block) read command.
+  ++s_sdcard_stats.read_cmds;
+  if (s_sdcard_data == nullptr || first_block + num_blocks > s_sdcard_num_blocks) {
+    return false;
+  }
+  s_sdcard_stats.blocks_read += static_cast<uint32_t>(num_blocks);
+  std::memcpy(ptr, &s_sdcard_data[first_block * 512U], num_blocks * 512U);
+  return true;
+}
+
+extern "C" bool sdcard_write(sdctx_t*, const void*, size_t, size_t) {
+  return false;
+}
+
+extern "C" size_t sdcard_get_size(sdctx_t* ctx) {
+  return ctx->num_blocks;
+}
+
+//--------------------------------------------------------------------------------------------------
+// mfat_mc1.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" int mfat_mount(mfat_read_block_fun_t, mfat_write_block_fun_t, void*) {
+  return -1;
+}
+
+extern "C" void mfat_unmount(void) {
+}
+
+extern "C" int mfat_stat(const char* path, mfat_stat_t* stat) {
+  if (s_file_data == nullptr || std::strcmp(path, s_file_path) != 0) {
+    return -1;
+  }
+  *stat = mfat_stat_t();
+  stat->st_size = s_file_size;
+  return 0;
+}
+
+extern "C" int mfat_open(const char* path, int) {
+  if (s_file_data == nullptr || s_file_open || std::strcmp(path, s_file_path) != 0) {
+    return -1;
+  }
+  s_file_open = true;
+  s_file_pos = 0U;
+  return 0;
+}
+
+extern "C" int mfat_close(int fd) {
+  if (fd != 0 || !s_file_open) {
+    return -1;
+  }
+  s_file_open = false;
+  return 0;
+}
+
+extern "C" int64_t mfat_read(int fd, void* buf, uint32_t nbyte) {
+  if (fd != 0 || !s_file_open) {
+    return -1;
+  }
+  const auto count = nbyte < s_file_size - s_file_pos ? nbyte : s_file_size - s_file_pos;
+  std::memcpy(buf, &s_file_data[s_file_pos], count);
+  s_file_pos += count;
+  return count;
+}
+
+extern "C" int64_t mfat_lseek(int fd, int64_t offset, int whence) {
+  if (fd != 0 || !s_file_open) {
+    return -1;
+  }
+  int64_t pos = offset;
+  if (whence == MFAT_SEEK_CUR) {
+    pos += s_file_pos;
+  } else if (whence == MFAT_SEEK_END) {
+    pos += s_file_size;
+  }
+  if (pos < 0 || pos > s_file_size) {
+    return -1;
+  }
+  s_file_pos = static_cast<uint32_t>(pos);
+  return pos;
+}
+
+//--------------------------------------------------------------------------------------------------
+// elf32.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" int elf32_load(const char*, uint32_t*) {
+  return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// vconsole.h
+//--------------------------------------------------------------------------------------------------
+
+extern "C" unsigned vcon_memory_requirement(void) {
+  return 4U;
+}
+
+extern "C" void vcon_init(void* addr) {
+  // The text is not rendered, so the console VCP is just an empty program.
+  s_vcon_mem = reinterpret_cast<uint32_t*>(addr);
+  s_vcon_mem[0] = vcp_emit_waity(32767);
+}
+
+extern "C" void vcon_show(layer_t layer) {
+  vcp_set_prg(layer, s_vcon_mem);
+}
+
+extern "C" void vcon_clear(void) {
+}
+
+extern "C" void vcon_set_colors(uint32_t, uint32_t) {
+}
+
+extern "C" void vcon_print(const char* text) {
+  s_console_output += text;
+  if (console_enabled()) {
+    std::fputs(text, stderr);
+  }
+}
+
+extern "C" void vcon_print_hex(unsigned x) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%08x", x);
+  vcon_print(buf);
+}
+
+extern "C" void vcon_print_dec(int x) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%d", x);
+  vcon_print(buf);
+}
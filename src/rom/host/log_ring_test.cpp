@@ -0,0 +1,127 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+// Test for the deferred console log: Check that the rendered text is the same as if it had been
+// printed directly, that each flush is bounded, and that overflowing the log is handled.
+
+#include "mc1_host.hpp"
+
+#include "log_ring.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace {
+bool check_output(const std::string& actual, const std::string& expected, const char* what) {
+  if (actual != expected) {
+    std::printf("FAIL: %s: \"%s\" != \"%s\"\n", what, actual.c_str(), expected.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool test_format() {
+  (void)mc1_host::take_console_output();
+  log_ring_t log;
+  log.print("Dec: ");
+  log.print_dec(-1234);
+  log.print(", hex: ");
+  log.print_hex(0xbeefU);
+  log.print(", sizes: ");
+  log.print_size(256U * 1024U);
+  log.print("/");
+  log.print_size(3U * 1024U * 1024U);
+  log.print("/");
+  log.print_size(1000U);
+  log.print(", fixed: ");
+  log.print_fixed2(10005);
+  log.print("\n");
+
+  // Nothing is rendered until the log is flushed.
+  if (!check_output(mc1_host::take_console_output(), "", "output before flush")) {
+    return false;
+  }
+  const auto empty = log.flush(1000U);
+  return check_output(mc1_host::take_console_output(),
+                      "Dec: -1234, hex: 0000beef, sizes: 256 KB/3 MB/1000 bytes, fixed: 100.05\n",
+                      "formatted output") &&
+         empty && log.empty();
+}
+
+bool test_bounded_flush() {
+  (void)mc1_host::take_console_output();
+  log_ring_t log;
+  std::string expected;
+  for (int i = 0; i < 20; ++i) {
+    const std::string line = "SD card log line " + std::to_string(i) + "\n";
+    log.print(line.c_str());
+    expected += line;
+  }
+
+  std::string output;
+  int flushes = 0;
+  while (!log.flush(50U)) {
+    const auto chunk = mc1_host::take_console_output();
+    if (chunk.size() > 50U) {
+      std::printf("FAIL: A flush rendered %zu characters\n", chunk.size());
+      return false;
+    }
+    output += chunk;
+    ++flushes;
+  }
+  output += mc1_host::take_console_output();
+  return check_output(output, expected, "bounded flush") && flushes >= 7;
+}
+
+bool test_overflow() {
+  (void)mc1_host::take_console_output();
+  log_ring_t log;
+  const std::string line(100U, 'x');
+  for (uint32_t i = 0U; i < 2U * log_ring_t::SIZE / 100U; ++i) {
+    log.print(line.c_str());
+  }
+  log.print_dec(42);  // Dropped (the log is full).
+  (void)log.flush(1000U);
+  log.print_dec(17);
+  while (!log.flush(1000U)) {
+  }
+
+  // The output ends with the text that fitted, a marker for the dropped text and then the text
+  // that was printed after the flush.
+  const auto output = mc1_host::take_console_output();
+  const auto expected_tail = std::string("xx[...]17");
+  return check_output(output.substr(output.size() - expected_tail.size()),
+                      expected_tail,
+                      "overflow") &&
+         check_output(std::to_string(output.size()),
+                      std::to_string(log_ring_t::SIZE + 5U + 2U),
+                      "overflow size");
+}
+}  // namespace
+
+int main() {
+  bool success = true;
+  success = test_format() && success;
+  success = test_bounded_flush() && success;
+  success = test_overflow() && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+// Round-trip test for the LZG packer (host/lzgpack.cpp) and the streaming LZG decoder in the ROM
+// (lzg_stream.hpp): Compress different kinds of data, and decode it with different chunk sizes.
+
+#include "lzgpack.hpp"
+
+#include "lzg_stream.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+std::vector<uint8_t> make_random(const uint32_t size, uint32_t seed) {
+  std::vector<uint8_t> data(size);
+  for (auto& x : data) {
+    seed = seed * 1103515245U + 12345U;
+    x = static_cast<uint8_t>(seed >> 16);
+  }
+  return data;
+}
+
+// Something that looks a bit like code: short and long distance repeats, runs and all symbols.
+std::vector<uint8_t> make_structured(const uint32_t size) {
+  const auto random = make_random(4096U, 1U);
+  std::vector<uint8_t> data;
+  uint32_t seed = 7U;
+  while (data.size() < size) {
+    seed = seed * 1103515245U + 12345U;
+    const auto kind = (seed >> 16) % 4U;
+    const auto len = 1U + ((seed >> 8) % 200U);
+    if (kind == 0U) {
+      data.insert(data.end(), len, static_cast<uint8_t>(seed >> 24));
+    } else if (kind == 1U || data.size() < 4096U) {
+      const auto start = (seed >> 4) % (random.size() - len);
+      data.insert(data.end(), random.begin() + start, random.begin() + start + len);
+    } else {
+      const auto distance = 1U + (seed >> 3) % (kind == 2U ? 64U : data.size() - 1U);
+      for (uint32_t i = 0U; i < len; ++i) {
+        data.push_back(data[data.size() - distance]);
+      }
+    }
+  }
+  data.resize(size);
+  return data;
+}
+
+bool decode(const std::vector<uint8_t>& packed,
+            const uint32_t chunk_size,
+            std::vector<uint8_t>& decoded) {
+  lzg_stream_t lzg;
+  lzg.init(decoded.data(), static_cast<uint32_t>(decoded.size()));
+  for (size_t pos = 0U; pos < packed.size(); pos += chunk_size) {
+    const auto size = std::min(static_cast<size_t>(chunk_size), packed.size() - pos);
+    if (!lzg.feed(&packed[pos], static_cast<uint32_t>(size))) {
+      return false;
+    }
+  }
+  return lzg.finish() == static_cast<int32_t>(decoded.size());
+}
+
+bool test_round_trip(const char* name, const std::vector<uint8_t>& data) {
+  const auto packed = mc1_host::lzg_encode(data.data(), static_cast<uint32_t>(data.size()));
+  std::printf("%-10s %7zu -> %7zu bytes\n", name, data.size(), packed.size());
+  for (const uint32_t chunk_size : {1U, 3U, 512U, 65536U}) {
+    std::vector<uint8_t> decoded(data.size());
+    if (!decode(packed, chunk_size, decoded) || decoded != data) {
+      std::printf("FAIL: %s (chunk size %u)\n", name, chunk_size);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool test_corrupt() {
+  const auto data = make_structured(10000U);
+  const auto packed = mc1_host::lzg_encode(data.data(), static_cast<uint32_t>(data.size()));
+  for (size_t pos = 0U; pos < packed.size(); pos += 97U) {
+    auto corrupt = packed;
+    corrupt[pos] ^= 0x21U;
+    std::vector<uint8_t> decoded(data.size());
+    if (decode(corrupt, 512U, decoded)) {
+      std::printf("FAIL: A corrupt byte at offset %zu was not detected\n", pos);
+      return false;
+    }
+  }
+
+  // The decoded data must not be larger than the destination buffer.
+  std::vector<uint8_t> decoded(data.size() - 1U);
+  if (decode(packed, 512U, decoded)) {
+    std::printf("FAIL: Buffer overflow was not detected\n");
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+int main() {
+  bool success = true;
+  success = test_round_trip("empty", {}) && success;
+  success = test_round_trip("zeros", std::vector<uint8_t>(100000U, 0U)) && success;
+  success = test_round_trip("random", make_random(20000U, 42U)) && success;
+  success = test_round_trip("structured", make_structured(300000U)) && success;
+  success = test_corrupt() && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
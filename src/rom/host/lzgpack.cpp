@@ -0,0 +1,248 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+#include "lzgpack.hpp"
+
+#include "elf_loader.hpp"
+
+#include <algorithm>
+
+namespace {
+const uint32_t HEADER_SIZE = 16U;
+const uint32_t MIN_MATCH = 3U;
+const uint32_t MAX_MATCH = 128U;
+const uint32_t MAX_OFFSET = 2056U + 524287U;
+const uint32_t MAX_CHAIN = 256U;
+const uint32_t HASH_SIZE = 65536U;
+
+const uint8_t LENGTH_LUT[32] = {2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15, 16, 17,
+                                18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 35, 48, 72, 128};
+
+// Index of the longest encodable length that is not longer than length (length >= 3).
+uint32_t length_index(const uint32_t length) {
+  uint32_t idx = 31U;
+  while (LENGTH_LUT[idx] > length) {
+    --idx;
+  }
+  return idx;
+}
+
+uint32_t hash3(const uint8_t* p) {
+  const auto x = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                 (static_cast<uint32_t>(p[2]) << 16);
+  return (x * 2654435761U) >> 16;
+}
+
+uint32_t get16le(const std::vector<uint8_t>& buf, const size_t pos) {
+  return static_cast<uint32_t>(buf[pos]) | (static_cast<uint32_t>(buf[pos + 1U]) << 8);
+}
+
+uint32_t get32le(const std::vector<uint8_t>& buf, const size_t pos) {
+  return get16le(buf, pos) | (get16le(buf, pos + 2U) << 16);
+}
+
+void put16le(std::vector<uint8_t>& buf, const size_t pos, const uint32_t x) {
+  buf[pos] = static_cast<uint8_t>(x);
+  buf[pos + 1U] = static_cast<uint8_t>(x >> 8);
+}
+
+void put32le(std::vector<uint8_t>& buf, const size_t pos, const uint32_t x) {
+  put16le(buf, pos, x);
+  put16le(buf, pos + 2U, x >> 16);
+}
+
+void put32be(std::vector<uint8_t>& buf, const size_t pos, const uint32_t x) {
+  for (int i = 0; i < 4; ++i) {
+    buf[pos + i] = static_cast<uint8_t>(x >> (24 - 8 * i));
+  }
+}
+}  // namespace
+
+std::vector<uint8_t> mc1_host::lzg_encode(const uint8_t* data, const uint32_t size) {
+  // Use the four least common symbols as markers (distant, medium, short and near copy).
+  uint32_t hist[256] = {};
+  for (uint32_t i = 0U; i < size; ++i) {
+    ++hist[data[i]];
+  }
+  uint8_t symbols[256];
+  for (uint32_t i = 0U; i < 256U; ++i) {
+    symbols[i] = static_cast<uint8_t>(i);
+  }
+  std::stable_sort(symbols, symbols + 256, [&hist](const uint8_t a, const uint8_t b) {
+    return hist[a] < hist[b];
+  });
+  const uint8_t m_distant = symbols[0];
+  const uint8_t m_medium = symbols[1];
+  const uint8_t m_short = symbols[2];
+  const uint8_t m_near = symbols[3];
+  bool is_marker[256] = {};
+  for (uint32_t i = 0U; i < 4U; ++i) {
+    is_marker[symbols[i]] = true;
+  }
+
+  std::vector<uint8_t> out(HEADER_SIZE);
+  out.insert(out.end(), {m_distant, m_medium, m_short, m_near});
+
+  // Greedy LZ77 matching with hash chains.
+  std::vector<int32_t> head(HASH_SIZE, -1);
+  std::vector<int32_t> prev(size);
+  uint32_t pos = 0U;
+  while (pos < size) {
+    uint32_t best_len = 0U;
+    uint32_t best_offset = 0U;
+    if (pos + MIN_MATCH <= size) {
+      const auto max_len = std::min(MAX_MATCH, size - pos);
+      uint32_t steps = 0U;
+      for (auto cand = head[hash3(&data[pos])];
+           cand >= 0 && steps < MAX_CHAIN && pos - static_cast<uint32_t>(cand) <= MAX_OFFSET;
+           cand = prev[cand], ++steps) {
+        uint32_t len = 0U;
+        while (len < max_len && data[static_cast<uint32_t>(cand) + len] == data[pos + len]) {
+          ++len;
+        }
+        if (len > best_len) {
+          best_len = len;
+          best_offset = pos - static_cast<uint32_t>(cand);
+          if (len == max_len) {
+            break;
+          }
+        }
+      }
+    }
+
+    // Pick the cheapest copy token, and only use it if it is shorter than the literals.
+    uint32_t consumed = 1U;
+    if (best_len >= MIN_MATCH) {
+      const auto idx = length_index(best_len);
+      const auto len = static_cast<uint32_t>(LENGTH_LUT[idx]);
+      if (best_offset <= 8U) {
+        out.push_back(m_near);
+        out.push_back(static_cast<uint8_t>(((best_offset - 1U) << 5) | idx));
+        consumed = len;
+      } else if (best_offset <= 71U && best_len <= 6U) {
+        out.push_back(m_short);
+        out.push_back(static_cast<uint8_t>(((best_len - 3U) << 6) | (best_offset - 8U)));
+        consumed = best_len;
+      } else if (best_offset <= 2055U && len > 3U) {
+        const auto offset = best_offset - 8U;
+        out.push_back(m_medium);
+        out.push_back(static_cast<uint8_t>(((offset >> 8) << 5) | idx));
+        out.push_back(static_cast<uint8_t>(offset));
+        consumed = len;
+      } else if (best_offset > 2055U && len > 4U) {
+        const auto offset = best_offset - 2056U;
+        out.push_back(m_distant);
+        out.push_back(static_cast<uint8_t>(((offset >> 16) << 5) | idx));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        out.push_back(static_cast<uint8_t>(offset));
+        consumed = len;
+      }
+    }
+    if (consumed == 1U) {
+      out.push_back(data[pos]);
+      if (is_marker[data[pos]]) {
+        out.push_back(0U);
+      }
+    }
+
+    for (const auto end = pos + consumed; pos < end; ++pos) {
+      if (pos + MIN_MATCH <= size) {
+        const auto h = hash3(&data[pos]);
+        prev[pos] = head[h];
+        head[h] = static_cast<int32_t>(pos);
+      }
+    }
+  }
+
+  // Fall back to the copy method if the data did not compress.
+  uint8_t method = 1U;
+  if (out.size() - HEADER_SIZE >= size) {
+    out.resize(HEADER_SIZE);
+    out.insert(out.end(), data, data + size);
+    method = 0U;
+  }
+
+  uint32_t a = 1U;
+  uint32_t b = 0U;
+  for (size_t i = HEADER_SIZE; i < out.size(); ++i) {
+    a = (a + out[i]) & 0xffffU;
+    b = (b + a) & 0xffffU;
+  }
+  out[0] = 'L';
+  out[1] = 'Z';
+  out[2] = 'G';
+  put32be(out, 3U, size);
+  put32be(out, 7U, static_cast<uint32_t>(out.size() - HEADER_SIZE));
+  put32be(out, 11U, (b << 16) | a);
+  out[15] = method;
+  return out;
+}
+
+std::vector<uint8_t> mc1_host::lzg_pack_elf(const std::vector<uint8_t>& elf) {
+  const uint32_t EHDR_SIZE = 52U;
+  const uint32_t PHDR_SIZE = 32U;
+  if (elf.size() < EHDR_SIZE || elf[0] != 0x7f || elf[1] != 'E' || elf[2] != 'L' ||
+      elf[3] != 'F' || elf[4] != 1U || elf[5] != 1U || get16le(elf, 42U) != PHDR_SIZE) {
+    return {};
+  }
+  const auto phoff = get32le(elf, 28U);
+  const auto phnum = get16le(elf, 44U);
+  if (phoff + phnum * PHDR_SIZE > elf.size()) {
+    return {};
+  }
+
+  // ELF header (without section headers), followed by the program headers.
+  std::vector<uint8_t> out(elf.begin(), elf.begin() + EHDR_SIZE);
+  put32le(out, 28U, EHDR_SIZE);
+  put32le(out, 32U, 0U);  // e_shoff
+  put16le(out, 46U, 0U);  // e_shentsize
+  put16le(out, 48U, 0U);  // e_shnum
+  put16le(out, 50U, 0U);  // e_shstrndx
+  out.insert(out.end(), elf.begin() + phoff, elf.begin() + phoff + phnum * PHDR_SIZE);
+
+  // Segment data.
+  for (uint32_t i = 0U; i < phnum; ++i) {
+    const auto phdr = EHDR_SIZE + i * PHDR_SIZE;
+    const auto type = get32le(out, phdr);
+    const auto offset = get32le(out, phdr + 4U);
+    auto flags = get32le(out, phdr + 24U);
+    auto file_size = get32le(out, phdr + 16U);
+    if (offset + file_size > elf.size()) {
+      return {};
+    }
+    const auto* data = &elf[offset];
+    std::vector<uint8_t> packed;
+    if (type == 1U && file_size > 0U) {
+      packed = lzg_encode(data, file_size);
+      if (packed.size() < file_size) {
+        data = packed.data();
+        file_size = static_cast<uint32_t>(packed.size());
+        flags |= elf_loader_t::PF_MC1_LZG;
+      }
+    }
+    out.resize((out.size() + 3U) & ~static_cast<size_t>(3U));
+    put32le(out, phdr + 4U, static_cast<uint32_t>(out.size()));
+    put32le(out, phdr + 16U, file_size);
+    put32le(out, phdr + 24U, flags);
+    out.insert(out.end(), data, data + file_size);
+  }
+  return out;
+}
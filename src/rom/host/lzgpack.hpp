@@ -0,0 +1,43 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+#ifndef ROM_HOST_LZGPACK_HPP_
+#define ROM_HOST_LZGPACK_HPP_
+
+#include <cstdint>
+#include <vector>
+
+namespace mc1_host {
+
+// Compress data into the liblzg format (LZG1, or the copy method if the data does not compress),
+// which can be decoded by lzg_stream_t (see lzg_stream.hpp) and by liblzg.
+std::vector<uint8_t> lzg_encode(const uint8_t* data, uint32_t size);
+
+// Compress the PT_LOAD segments of an ELF32 executable for the ROM ELF loader (elf_loader.hpp).
+//
+// Each segment that gets smaller when it is compressed is replaced by its LZG compressed data, and
+// is marked with the PF_MC1_LZG program header flag (p_filesz is the compressed size). The section
+// headers are dropped. Returns an empty vector if the input is not an ELF32 executable.
+std::vector<uint8_t> lzg_pack_elf(const std::vector<uint8_t>& elf);
+
+}  // namespace mc1_host
+
+#endif  // ROM_HOST_LZGPACK_HPP_
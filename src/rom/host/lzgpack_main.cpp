@@ -0,0 +1,80 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+// Compress a boot executable (e.g. MC1BOOT.EXE) for the ROM ELF loader.
+//
+// Usage: lzgpack INFILE OUTFILE
+
+#include "lzgpack.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+bool read_file(const char* path, std::vector<uint8_t>& data) {
+  auto* f = std::fopen(path, "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t count;
+  while ((count = std::fread(buf, 1, sizeof(buf), f)) > 0U) {
+    data.insert(data.end(), buf, buf + count);
+  }
+  const auto success = std::ferror(f) == 0;
+  std::fclose(f);
+  return success;
+}
+
+bool write_file(const char* path, const std::vector<uint8_t>& data) {
+  auto* f = std::fopen(path, "wb");
+  if (f == nullptr) {
+    return false;
+  }
+  const auto success = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+  return (std::fclose(f) == 0) && success;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::printf("Usage: %s INFILE OUTFILE\n", argv[0]);
+    std::printf("Compress the loadable segments of an ELF32 executable for the MC1 ROM.\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> elf;
+  if (!read_file(argv[1], elf)) {
+    std::fprintf(stderr, "Error: Unable to read %s\n", argv[1]);
+    return 1;
+  }
+  const auto packed = mc1_host::lzg_pack_elf(elf);
+  if (packed.empty()) {
+    std::fprintf(stderr, "Error: %s is not an ELF32 executable\n", argv[1]);
+    return 1;
+  }
+  if (!write_file(argv[2], packed)) {
+    std::fprintf(stderr, "Error: Unable to write %s\n", argv[2]);
+    return 1;
+  }
+  std::printf("%s: %zu -> %zu bytes\n", argv[2], elf.size(), packed.size());
+  return 0;
+}
@@ -0,0 +1,252 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include "mc1_host.hpp"
+
+#include <mc1/mmio.h>
+
+#include <chrono>
+#include <csetjmp>
+#include <cstdlib>
+#include <cstring>
+
+// The emulated VRAM. The ROM linker symbols that refer to VRAM are defined relative to it, so that
+// the ROM code can use them just as it does on the real machine.
+extern "C" {
+alignas(4096) uint32_t mc1_host_vram[mc1_host::VRAM_SIZE / 4U];
+}
+
+__asm__(
+    "\t.globl\t__vram_free_start\n"
+    "\t.set\t__vram_free_start, mc1_host_vram + 256\n"
+    "\t.globl\t__bss_start\n"
+    "\t.set\t__bss_start, mc1_host_vram + 256\n"
+    "\t.globl\t__bss_size\n"
+    "\t.set\t__bss_size, 0\n"
+    "\t.globl\t__rom_size\n"
+    "\t.set\t__rom_size, 0\n");
+
+extern "C" int mc1_rom_main(int argc, char** argv);
+
+namespace mc1_host {
+namespace {
+using host_clock_t = std::chrono::steady_clock;
+
+const uint64_t NS_PER_S = 1000000000U;
+
+// MMIO registers (one word per register, indexed by byte offset / 4).
+uint32_t s_mmio[64];
+
+config_t s_config;
+video_timing_t s_timing;
+host_clock_t::time_point s_t0;
+uint64_t s_skipped_ns;
+uint64_t s_frame_ns;
+
+// Frame bookkeeping.
+uint32_t s_last_frame_no;
+const void* s_last_read_site;
+uint64_t s_last_read_ns;
+bool s_working;
+uint64_t s_work_start_ns;
+frame_stats_t* s_stats;
+uint32_t s_max_frames;
+std::jmp_buf* s_exit_jmp;
+
+uint64_t virtual_ns() {
+  const auto dt = host_clock_t::now() - s_t0;
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count()) +
+         s_skipped_ns;
+}
+
+uint64_t ns_to_cycles(const uint64_t ns) {
+  // Split the calculation to avoid overflow.
+  return (ns / NS_PER_S) * s_config.cpu_clk + ((ns % NS_PER_S) * s_config.cpu_clk) / NS_PER_S;
+}
+
+void end_of_frame_work(const uint64_t now_ns) {
+  s_working = false;
+  if (s_stats == nullptr) {
+    return;
+  }
+
+  const auto work_ns = now_ns - s_work_start_ns;
+  auto& stats = *s_stats;
+  if (stats.frames == 0U || work_ns < stats.min_ns) {
+    stats.min_ns = work_ns;
+  }
+  if (stats.frames == 0U || work_ns > stats.max_ns) {
+    stats.max_ns = work_ns;
+  }
+  stats.total_ns += work_ns;
+  ++stats.frames;
+
+  if (stats.frames >= s_max_frames && s_exit_jmp != nullptr) {
+    std::longjmp(*s_exit_jmp, 1);
+  }
+}
+
+// Note: A polling loop is detected as two consecutive reads from the same call site that return
+// the same frame number. The ROM may read VIDFRAMENO from other places while working on a frame
+// (e.g. to check if a new frame has started) without that being mistaken for polling.
+uint32_t read_frame_no(const void* site) {
+  auto now_ns = virtual_ns();
+  auto frame_no = static_cast<uint32_t>(now_ns / s_frame_ns);
+  if (frame_no == s_last_frame_no && site == s_last_read_site) {
+    // The ROM is polling, i.e. it was done with the current frame at the previous read.
+    if (s_working) {
+      end_of_frame_work(s_last_read_ns);
+    }
+
+    // Skip ahead to the start of the next frame, where the ROM starts working again.
+    const auto next_frame_ns = (static_cast<uint64_t>(frame_no) + 1U) * s_frame_ns;
+    s_skipped_ns += next_frame_ns - now_ns;
+    now_ns = next_frame_ns;
+    ++frame_no;
+    s_working = true;
+    s_work_start_ns = now_ns;
+  } else if (!s_working) {
+    s_working = true;
+    s_work_start_ns = now_ns;
+  }
+
+  // Note: If the frame number changed while the ROM was working (i.e. the ROM did not finish in
+  // time), the work continues until the ROM polls, so the overrun is included in the statistics.
+  s_last_frame_no = frame_no;
+  s_last_read_site = site;
+  s_last_read_ns = now_ns;
+  return frame_no;
+}
+
+void update_reg(const uint32_t offset, const void* site) {
+  auto& reg = s_mmio[offset / 4U];
+  switch (offset) {
+    case CLKCNTLO:
+      reg = static_cast<uint32_t>(ns_to_cycles(virtual_ns()));
+      break;
+    case CLKCNTHI:
+      reg = static_cast<uint32_t>(ns_to_cycles(virtual_ns()) >> 32);
+      break;
+    case VIDFRAMENO:
+      reg = read_frame_no(site);
+      break;
+    case VIDY: {
+      // Note: The frame starts with the vertical blanking interval (negative y).
+      const auto lines = s_timing.height + s_timing.v_blank;
+      const auto frame_pos_ns = virtual_ns() % s_frame_ns;
+      const auto line = static_cast<uint32_t>((frame_pos_ns * lines) / s_frame_ns);
+      reg = line - s_timing.v_blank;
+    } break;
+    default:
+      break;
+  }
+}
+}  // namespace
+
+video_timing_t video_timing(const uint32_t width, const uint32_t height) {
+  static const video_timing_t TIMINGS[] = {
+      {1920U, 1080U, 88U + 44U + 148U, 4U + 5U + 36U},
+      {1280U, 720U, 110U + 40U + 220U, 5U + 5U + 20U},
+      {800U, 600U, 40U + 128U + 88U, 1U + 4U + 23U},
+      {640U, 480U, 16U + 96U + 48U, 10U + 2U + 33U},
+  };
+  for (const auto& timing : TIMINGS) {
+    if (timing.width == width && timing.height == height) {
+      return timing;
+    }
+  }
+  return video_timing_t{width, height, (width * 280U) / 1920U, (height * 45U) / 1080U};
+}
+
+void reset(const config_t& config) {
+  s_config = config;
+  s_timing = video_timing(config.width, config.height);
+  std::memset(mc1_host_vram, 0, sizeof(mc1_host_vram));
+  std::memset(s_mmio, 0, sizeof(s_mmio));
+  s_mmio[CPUCLK / 4U] = config.cpu_clk;
+  s_mmio[VRAMSIZE / 4U] = config.vram_size < VRAM_SIZE ? config.vram_size : VRAM_SIZE;
+  s_mmio[XRAMSIZE / 4U] = 0U;
+  s_mmio[VIDWIDTH / 4U] = config.width;
+  s_mmio[VIDHEIGHT / 4U] = config.height;
+  s_mmio[VIDFPS / 4U] = config.fps << 16;
+
+  s_t0 = host_clock_t::now();
+  s_skipped_ns = 0U;
+  s_frame_ns = NS_PER_S / config.fps;
+  // The ROM starts working right away (the first frame includes the initialization). Note that
+  // the first VIDFRAMENO read must not be mistaken for polling.
+  s_last_frame_no = ~0U;
+  s_last_read_site = nullptr;
+  s_last_read_ns = 0U;
+  s_working = true;
+  s_work_start_ns = 0U;
+  s_stats = nullptr;
+  s_max_frames = 0U;
+  s_exit_jmp = nullptr;
+}
+
+uint32_t* vram() {
+  return &mc1_host_vram[0];
+}
+
+uint32_t vram_words() {
+  return VRAM_SIZE / 4U;
+}
+
+bool run_rom(const uint32_t max_frames, frame_stats_t& stats) {
+  stats = frame_stats_t();
+  if (max_frames == 0U) {
+    return true;
+  }
+
+  std::jmp_buf exit_jmp;
+  s_stats = &stats;
+  s_max_frames = max_frames;
+  s_exit_jmp = &exit_jmp;
+
+  // Note: The ROM objects that are alive when we jump out of main() are trivially destructible,
+  // so skipping their destructors is fine.
+  const auto reason = setjmp(exit_jmp);
+  if (reason == 0) {
+    char arg0[] = "rom";
+    char* argv[] = {arg0, nullptr};
+    (void)mc1_rom_main(1, argv);
+  }
+
+  s_stats = nullptr;
+  s_exit_jmp = nullptr;
+  return reason == 1;
+}
+
+}  // namespace mc1_host
+
+extern "C" volatile uint32_t* mc1_host_mmio_reg(uint32_t offset) {
+  // Mirror the 6-bit word address decoding of rtl/mmio.vhd.
+  offset &= 0xfcU;
+  mc1_host::update_reg(offset, __builtin_return_address(0));
+  return &mc1_host::s_mmio[offset / 4U];
+}
+
+extern "C" void mc1_host_soft_reset(void) {
+  if (mc1_host::s_exit_jmp != nullptr) {
+    std::longjmp(*mc1_host::s_exit_jmp, 2);
+  }
+  std::abort();
+}
@@ -0,0 +1,103 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_HOST_MC1_HOST_HPP_
+#define ROM_HOST_MC1_HOST_HPP_
+
+#include <cstdint>
+#include <string>
+
+// Emulated MC1 machine for running the ROM code natively on a development host.
+//
+// The emulation covers what the ROM needs in order to run: the MMIO registers, a block of VRAM
+// and the VCP layer entry points. Time is virtual: the host clock drives it while the ROM is
+// working, but when the ROM starts polling VIDFRAMENO (i.e. it waits for the next frame) time
+// skips ahead to the next frame. Thus a frame costs exactly as much host time as the ROM spends
+// working on it, which is what the frame statistics report.
+namespace mc1_host {
+
+// Size of the emulated VRAM (same as the DE0-CV configuration).
+constexpr uint32_t VRAM_SIZE = 256U * 1024U;
+
+// Words 0..63 of VRAM are reserved for the VCP layer entry points and the ROM stack/bss area,
+// just as on the real machine. __vram_free_start points to the first word after this area.
+constexpr uint32_t VRAM_RESERVED_SIZE = 256U;
+
+struct config_t {
+  uint32_t cpu_clk = 100000000U;
+  uint32_t width = 1920U;
+  uint32_t height = 1080U;
+  uint32_t fps = 60U;
+  uint32_t vram_size = VRAM_SIZE;  // Reported by MMIO(VRAMSIZE) (at most VRAM_SIZE).
+};
+
+// Video timing (see C_1920_1080 etc in rtl/vid_types.vhd).
+struct video_timing_t {
+  uint32_t width;
+  uint32_t height;
+  uint32_t h_blank;  // front porch + sync width + back porch
+  uint32_t v_blank;
+};
+
+// Get the video timing for a given resolution. Unknown resolutions get CEA-861 1080p-like blanking
+// intervals.
+video_timing_t video_timing(uint32_t width, uint32_t height);
+
+struct frame_stats_t {
+  uint32_t frames = 0U;
+  uint64_t total_ns = 0U;
+  uint64_t min_ns = 0U;
+  uint64_t max_ns = 0U;
+};
+
+// Reset the machine: clear VRAM and the MMIO registers, and restart the virtual clock.
+void reset(const config_t& config);
+
+// Emulated VRAM.
+uint32_t* vram();
+uint32_t vram_words();
+
+// Attach an emulated SD card (data = num_blocks 512-byte blocks, or nullptr for no card). The data
+// must stay valid while the card is attached.
+void attach_sdcard(const uint8_t* data, uint32_t num_blocks);
+
+struct sdcard_stats_t {
+  uint32_t read_cmds = 0U;
+  uint32_t blocks_read = 0U;
+};
+
+// SD card statistics since the card was attached.
+sdcard_stats_t sdcard_stats();
+
+// Get (and clear) the text that has been printed to the console (vcon_print() etc).
+std::string take_console_output();
+
+// Attach an emulated file that the MFAT API can open (data = nullptr removes the file). The data
+// must stay valid while the file is attached. This is independent of the SD card: mfat_mount()
+// always fails, but mfat_open() etc work on the attached file.
+void attach_file(const char* path, const uint8_t* data, uint32_t size);
+
+// Run the ROM main() until it has worked on max_frames frames. Returns false if the ROM did not
+// reach the frame limit (e.g. if it requested a soft reset).
+bool run_rom(uint32_t max_frames, frame_stats_t& stats);
+
+}  // namespace mc1_host
+
+#endif  // ROM_HOST_MC1_HOST_HPP_
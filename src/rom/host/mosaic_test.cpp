@@ -0,0 +1,196 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Equivalence test for the mosaic.
+//
+// This test renders frames with the video pipeline model (video_sim.cpp), and compares every pixel
+// with a straightforward per-tile implementation of the original algorithm, using the semantics of
+// the MRISC32 packed byte instructions. The test covers the mosaic variant that is selected by the
+// build flags (see mosaic.hpp):
+//
+//  * ENABLE_MOSAIC_GRADIENT: The VCP sets the left and right colors of each tile row, and the
+//    hardware interpolates between them. No pixel data may be read from VRAM.
+//  * ENABLE_MOSAIC_PAL8: Each tile gets the color of its palette entry (groups of tiles share one
+//    palette entry).
+//  * Otherwise: Every tile is an RGBA8888 pixel that is filled one row at a time with precomputed
+//    weight vectors (using the same arithmetic as the vector kernel in mosaic_fill.s).
+
+#include "mc1_host.hpp"
+#include "video_sim.hpp"
+
+#include "mosaic.hpp"
+
+#include <cstdio>
+
+namespace {
+const int MOSAIC_W = 64;
+const int MOSAIC_H = (MOSAIC_W * 9) / 16;
+#if defined(ENABLE_MOSAIC_PAL8) && !defined(ENABLE_MOSAIC_GRADIENT)
+const int NUM_COLS = 16;
+const int NUM_ROWS = 16;
+#else
+const int NUM_COLS = MOSAIC_W;
+const int NUM_ROWS = MOSAIC_H;
+#endif
+
+uint32_t ref_mulhiu_b(const uint32_t a, const uint32_t b) {
+  uint32_t result = 0U;
+  for (int shift = 0; shift < 32; shift += 8) {
+    const auto p = ((a >> shift) & 255U) * ((b >> shift) & 255U);
+    result |= (p >> 8) << shift;
+  }
+  return result;
+}
+
+uint32_t ref_lerp(const uint32_t c1, const uint32_t c2, const uint32_t w2) {
+  const uint32_t w1 = 255U - w2;
+  return ref_mulhiu_b(w1 * 0x01010101U, c1) + ref_mulhiu_b(w2 * 0x01010101U, c2);
+}
+
+uint32_t ref_tri_wave(const uint32_t t) {
+  const uint32_t t_mod = t & 511U;
+  return t_mod <= 255U ? t_mod : 511U - t_mod;
+}
+
+uint32_t ref_make_color(const uint32_t t) {
+  return ref_tri_wave(t) | (ref_tri_wave(t + 90U) << 8) | (ref_tri_wave(160U - t) << 16);
+}
+
+uint32_t ref_tile(const uint32_t t, const int col, const int row) {
+  const uint32_t p11 = ref_make_color(t);
+  const uint32_t p12 = ref_make_color(t + 3433U);
+  const uint32_t p21 = ref_make_color(1150U - t);
+  const uint32_t p22 = ref_make_color(t + 13150U);
+  const int color_col = (col * NUM_COLS) / MOSAIC_W;
+  const int color_row = (row * NUM_ROWS) / MOSAIC_H;
+  const uint32_t wy = static_cast<uint32_t>(color_row << 8) / NUM_ROWS;
+  const uint32_t wx = static_cast<uint32_t>(color_col << 8) / NUM_COLS;
+  return ref_lerp(ref_lerp(p11, p21, wy), ref_lerp(p12, p22, wy), wx);
+}
+
+// Render the current frame and check every pixel (layer 2 is empty, so the frame is the mosaic).
+bool check_frame(const mc1_host::config_t& config, const uint32_t t) {
+  mc1_host::video_sim_t sim(mc1_host::video_timing(config.width, config.height),
+                            mc1_host::vram(),
+                            mc1_host::vram_words());
+  sim.run_frame();
+  const auto& fb = sim.framebuffer();
+  const auto xincr = (0x010000U * MOSAIC_W) / config.width;
+#ifndef ENABLE_MOSAIC_GRADIENT
+  // The tile rows are stepped by the hardware (YSTEP).
+  const auto ystep = ((static_cast<uint32_t>(MOSAIC_H) << 16) + config.height - 1U) / config.height;
+#endif
+  for (uint32_t y = 0U; y < config.height; ++y) {
+#ifdef ENABLE_MOSAIC_GRADIENT
+    const auto row = static_cast<int>((y * MOSAIC_H) / config.height);
+#else
+    const auto row = static_cast<int>((y * ystep) >> 16);
+#endif
+    for (uint32_t x = 0U; x < config.width; ++x) {
+      const auto col = static_cast<int>((x * xincr) >> 16);
+      const auto expected = ref_tile(t, col, row);
+      const auto actual = fb[y * config.width + x] & 0x00ffffffU;
+      if (actual != expected) {
+        std::printf("FAIL: %ux%u, t=%u, x=%u, y=%u: 0x%06x != 0x%06x\n",
+                    config.width,
+                    config.height,
+                    t,
+                    x,
+                    y,
+                    actual,
+                    expected);
+        return false;
+      }
+    }
+  }
+
+#ifdef ENABLE_MOSAIC_GRADIENT
+  // The gradient mosaic must not read any pixel data from VRAM.
+  const auto stats = sim.frame_stats();
+  if (stats.pixel_words[0] != 0U) {
+    std::printf("FAIL: %u pixel words were read\n", stats.pixel_words[0]);
+    return false;
+  }
+#endif
+  return true;
+}
+
+// Check a few frames of the complete animation cycle (the colors repeat every 512 frames).
+bool test_update(const uint32_t width, const uint32_t height, const uint32_t t_step) {
+  mc1_host::config_t config;
+  config.width = width;
+  config.height = height;
+  mc1_host::reset(config);
+  vram_arena_t arena;
+  arena.init();
+  mosaic_t mosaic;
+  (void)mosaic.init(arena);
+  if (!check_frame(config, 0U)) {
+    return false;
+  }
+
+  for (uint32_t t = 1U; t < 512U; t += t_step) {
+    mosaic.update(t);
+    if (!check_frame(config, t)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifndef ENABLE_MOSAIC_GRADIENT
+// Check the row kernel reference with weights and colors that exercise all byte lanes, and with
+// lengths that are not a multiple of any vector length.
+bool test_fill_row() {
+  uint32_t weights[2 * 37];
+  uint32_t dst[37];
+  for (uint32_t count = 1U; count <= 37U; count += 4U) {
+    for (uint32_t x = 0U; x < count; ++x) {
+      const uint32_t w2 = (x * 255U) / count;
+      weights[x] = (255U - w2) * 0x01010101U;
+      weights[count + x] = w2 * 0x01010101U;
+    }
+    const uint32_t c1 = 0xff80017fU;
+    const uint32_t c2 = 0x00ff7f80U;
+    mosaic_t::fill_row_ref(dst, c1, c2, weights, count);
+    for (uint32_t x = 0U; x < count; ++x) {
+      const auto expected = ref_lerp(c1, c2, (x * 255U) / count);
+      if (dst[x] != expected) {
+        std::printf("FAIL: count=%u, x=%u: 0x%08x != 0x%08x\n", count, x, dst[x], expected);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+#endif
+}  // namespace
+
+int main() {
+  bool success = true;
+#ifndef ENABLE_MOSAIC_GRADIENT
+  success = test_fill_row() && success;
+#endif
+  success = test_update(640U, 360U, 7U) && success;
+  success = test_update(800U, 600U, 101U) && success;
+  success = test_update(1920U, 1080U, 255U) && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
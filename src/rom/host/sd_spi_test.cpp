@@ -0,0 +1,355 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Test for the SD card SPI driver (sd_spi.hpp): The driver runs against an emulated SPI master and
+// a byte level model of an SD card in SPI mode, which behaves like test/sd_card_model.vhd.
+//
+// The host MMIO shim can not see register writes, so this test replaces MMIO() with a proxy that
+// forwards the SPI register accesses to the emulated SPI master.
+
+#include "mc1_host.hpp"
+
+#include <mc1/mmio.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace {
+uint32_t spi_reg_read(uint32_t offset);
+void spi_reg_write(uint32_t offset, uint32_t value);
+
+class spi_reg_t {
+public:
+  explicit spi_reg_t(const uint32_t offset) : m_offset(offset) {
+  }
+
+  operator uint32_t() const {
+    return spi_reg_read(m_offset);
+  }
+
+  spi_reg_t& operator=(const uint32_t value) {
+    spi_reg_write(m_offset, value);
+    return *this;
+  }
+
+private:
+  const uint32_t m_offset;
+};
+}  // namespace
+
+#undef MMIO
+#define MMIO(reg) spi_reg_t(reg)
+
+#include "sd_spi.hpp"
+
+namespace {
+const uint32_t CPU_HZ = 100000000U;
+const uint32_t FIFO_DEPTH = 16U;
+
+uint8_t data_byte(const uint32_t block_no, const uint32_t offset) {
+  return static_cast<uint8_t>(block_no * 31U + offset);
+}
+
+// An initialized SDHC card that supports CMD12, CMD17 and CMD18 (other commands are illegal). While
+// a multi-block read is in progress, the card keeps sending data until it has received CMD12, and
+// then it sends a stuff byte (with bit 7 clear), NCR, R1 and a busy period.
+class sd_card_t {
+public:
+  explicit sd_card_t(const uint32_t read_wait_bytes) : m_read_wait_bytes(read_wait_bytes) {
+  }
+
+  uint8_t xfer(const uint8_t mosi) {
+    if (!m_tx.empty()) {
+      const auto byte = m_tx.front();
+      m_tx.pop_front();
+      return byte;
+    }
+    if (m_streaming) {
+      return stream(mosi);
+    }
+
+    // Wait for a command (start bit = 0, transmission bit = 1).
+    if (m_cmd_len == 0U && (mosi & 0xc0U) != 0x40U) {
+      return 0xffU;
+    }
+    m_cmd[m_cmd_len++] = mosi;
+    if (m_cmd_len == 6U) {
+      m_cmd_len = 0U;
+      command();
+    }
+    return 0xffU;
+  }
+
+  // True if the card is waiting for a command.
+  bool idle() const {
+    return m_tx.empty() && !m_streaming && m_cmd_len == 0U;
+  }
+
+private:
+  static const uint8_t STUFF_BYTE = 0x3fU;
+
+  void command() {
+    const auto idx = m_cmd[0] & 0x3fU;
+    const auto arg = (static_cast<uint32_t>(m_cmd[1]) << 24) |
+                     (static_cast<uint32_t>(m_cmd[2]) << 16) |
+                     (static_cast<uint32_t>(m_cmd[3]) << 8) | static_cast<uint32_t>(m_cmd[4]);
+
+    m_tx.push_back(0xffU);  // NCR
+    switch (idx) {
+      case SD_CMD_STOP_TRANSMISSION:
+        m_tx.push_back(0x00U);
+        break;
+      case SD_CMD_READ_SINGLE_BLOCK:
+        m_tx.push_back(0x00U);
+        for (uint32_t i = 0U; i < frame_size(); ++i) {
+          m_tx.push_back(frame_byte(arg, i));
+        }
+        break;
+      case SD_CMD_READ_MULTIPLE_BLOCK:
+        m_tx.push_back(0x00U);
+        m_streaming = true;
+        m_block = arg;
+        m_pos = 0U;
+        m_stop_count = 0U;
+        break;
+      default:
+        m_tx.push_back(0x04U);  // Illegal command.
+        break;
+    }
+  }
+
+  uint8_t stream(const uint8_t mosi) {
+    const auto byte = frame_byte(m_block, m_pos);
+    if (++m_pos == frame_size()) {
+      m_pos = 0U;
+      ++m_block;
+    }
+
+    if (m_stop_count > 0U) {
+      // Receiving the argument and the CRC of CMD12.
+      if (--m_stop_count == 0U) {
+        m_streaming = false;
+        m_tx.push_back(STUFF_BYTE);
+        m_tx.push_back(0xffU);  // NCR
+        m_tx.push_back(0x00U);  // R1
+        m_tx.push_back(0x00U);  // Busy
+        m_tx.push_back(0x00U);
+      }
+    } else if (mosi == (0x40U | SD_CMD_STOP_TRANSMISSION)) {
+      m_stop_count = 5U;
+    }
+    return byte;
+  }
+
+  // Wait bytes, data token, data and CRC.
+  uint32_t frame_size() const {
+    return m_read_wait_bytes + 1U + SD_SPI_BLOCK_SIZE + 2U;
+  }
+
+  uint8_t frame_byte(const uint32_t block_no, const uint32_t pos) const {
+    if (pos < m_read_wait_bytes) {
+      return 0xffU;
+    }
+    if (pos == m_read_wait_bytes) {
+      return SD_DATA_TOKEN;
+    }
+    const auto offset = pos - m_read_wait_bytes - 1U;
+    return offset < SD_SPI_BLOCK_SIZE ? data_byte(block_no, offset) : 0x00U;
+  }
+
+  const uint32_t m_read_wait_bytes;
+  std::deque<uint8_t> m_tx;
+  uint8_t m_cmd[6];
+  uint32_t m_cmd_len = 0U;
+  bool m_streaming = false;
+  uint32_t m_block = 0U;
+  uint32_t m_pos = 0U;
+  uint32_t m_stop_count = 0U;
+};
+
+// The SPI master (see rtl/spi_master.vhd). Receive-only transfers are carried out as long as there
+// is room in the RX FIFO.
+class spi_master_t {
+public:
+  void attach(sd_card_t* card) {
+    m_card = card;
+    m_ctl = 0U;
+    m_rx.clear();
+    m_rd_count = 0U;
+  }
+
+  uint32_t read(const uint32_t offset) {
+    fill();
+    switch (offset) {
+      case CPUCLK:
+        return CPU_HZ;
+      case SPICTL:
+        return m_ctl;
+      case SPIDIV:
+        return m_div;
+      case SPIRX: {
+        const auto data = m_rx.empty() ? 0U : m_rx.front();
+        if (!m_rx.empty()) {
+          m_rx.pop_front();
+        }
+        fill();
+        return data;
+      }
+      case SPISTAT:
+        return SPISTAT_PRESENT | (m_rd_count > 0U ? SPISTAT_BUSY : 0U) |
+               (m_rx.empty() ? SPISTAT_RXEMPTY : 0U) |
+               (static_cast<uint32_t>(m_rx.size()) << SPISTAT_RXLEVEL_SHIFT);
+      default:
+        return 0U;
+    }
+  }
+
+  void write(const uint32_t offset, const uint32_t value) {
+    fill();
+    switch (offset) {
+      case SPICTL:
+        m_ctl = value;
+        break;
+      case SPIDIV:
+        m_div = value;
+        break;
+      case SPITX: {
+        const auto data = transfer(value);
+        if ((m_ctl & SPICTL_DUPLEX) != 0U) {
+          m_rx.push_back(data);
+        }
+        break;
+      }
+      case SPIRDCNT:
+        m_rd_count += value;
+        fill();
+        break;
+      default:
+        break;
+    }
+  }
+
+  uint32_t div() const {
+    return m_div;
+  }
+
+  uint32_t ctl() const {
+    return m_ctl;
+  }
+
+private:
+  void fill() {
+    while (m_rd_count > 0U && m_rx.size() < FIFO_DEPTH) {
+      m_rx.push_back(transfer(0xffffffffU));
+      --m_rd_count;
+    }
+  }
+
+  uint32_t transfer(const uint32_t data) {
+    const auto num_bytes = (m_ctl & SPICTL_WORD) != 0U ? 4 : 1;
+    uint32_t result = 0U;
+    for (int i = 0; i < num_bytes; ++i) {
+      uint32_t byte = 0xffU;
+      if ((m_ctl & (SPICTL_ENABLE | SPICTL_CS)) == (SPICTL_ENABLE | SPICTL_CS) && m_card != nullptr) {
+        byte = m_card->xfer(static_cast<uint8_t>(data >> (8 * i)));
+      }
+      result |= byte << (8 * i);
+    }
+    return result;
+  }
+
+  sd_card_t* m_card = nullptr;
+  uint32_t m_ctl = 0U;
+  uint32_t m_div = 0U;
+  std::deque<uint32_t> m_rx;
+  uint32_t m_rd_count = 0U;
+};
+
+spi_master_t s_spi;
+
+uint32_t spi_reg_read(const uint32_t offset) {
+  return s_spi.read(offset);
+}
+
+void spi_reg_write(const uint32_t offset, const uint32_t value) {
+  s_spi.write(offset, value);
+}
+
+bool check(const bool cond, const char* what) {
+  if (!cond) {
+    std::printf("FAIL: %s\n", what);
+  }
+  return cond;
+}
+
+// Read blocks with sd_read(), and check that they were read with the SPI master (sdcard_read()
+// has no card to read from), and that the card is ready for the next command.
+bool read_blocks(sd_card_t& card, const uint32_t first_block, const uint32_t num_blocks) {
+  sdctx_t sdctx = {};
+  sdctx.is_sdhc = 1;
+  std::vector<uint8_t> buf(num_blocks * SD_SPI_BLOCK_SIZE);
+  if (!sd_read(&sdctx, buf.data(), first_block, num_blocks)) {
+    std::printf("FAIL: Could not read %u block(s) at %u\n", num_blocks, first_block);
+    return false;
+  }
+  for (uint32_t i = 0U; i < num_blocks * SD_SPI_BLOCK_SIZE; ++i) {
+    const auto block_no = first_block + i / SD_SPI_BLOCK_SIZE;
+    if (buf[i] != data_byte(block_no, i % SD_SPI_BLOCK_SIZE)) {
+      std::printf("FAIL: Bad data for block %u, byte %u\n", block_no, i % SD_SPI_BLOCK_SIZE);
+      return false;
+    }
+  }
+  return check(mc1_host::sdcard_stats().read_cmds == 0U, "sdcard_read() was used") &&
+         check(card.idle(), "the card is not waiting for a command") &&
+         check(s_spi.ctl() == 0U, "the SD card pins were not handed back");
+}
+
+bool test_single_block() {
+  sd_card_t card(4U);
+  s_spi.attach(&card);
+  return read_blocks(card, 5U, 1U) &&
+         check(CPU_HZ / (2U * (s_spi.div() + 1U)) <= SD_SPI_MAX_HZ, "SCK is too fast");
+}
+
+// CMD12 is sent while the card is sending the wait bytes (or the data) of the next block, and the
+// card must be back in the command state after the stop.
+bool test_multi_block(const uint32_t read_wait_bytes) {
+  sd_card_t card(read_wait_bytes);
+  s_spi.attach(&card);
+  if (!read_blocks(card, 100U, 3U) || !read_blocks(card, 7U, 1U) || !read_blocks(card, 200U, 2U)) {
+    std::printf("FAIL: Multi-block read with %u wait bytes\n", read_wait_bytes);
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+int main() {
+  mc1_host::reset(mc1_host::config_t());
+  bool success = true;
+  success = test_single_block() && success;
+  for (uint32_t read_wait_bytes = 0U; read_wait_bytes <= 6U; ++read_wait_bytes) {
+    success = test_multi_block(read_wait_bytes) && success;
+  }
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
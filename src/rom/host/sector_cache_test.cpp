@@ -0,0 +1,163 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Test for the SD card sector cache: Check that the cache always returns the right data, and that
+// it reduces the number of SD card read commands for typical FAT access patterns.
+
+#include "mc1_host.hpp"
+
+#include "sector_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+const uint32_t NUM_BLOCKS = 1024U;
+
+class fixture_t {
+public:
+  fixture_t() : m_card(NUM_BLOCKS * 512U) {
+    // Fill each block with a pattern that identifies the block.
+    for (uint32_t i = 0U; i < NUM_BLOCKS * 128U; ++i) {
+      const auto word = (i / 128U) * 0x10001U + (i % 128U) * 0x100U;
+      for (int k = 0; k < 4; ++k) {
+        m_card[i * 4U + k] = static_cast<uint8_t>(word >> (8 * k));
+      }
+    }
+    mc1_host::reset(mc1_host::config_t());
+    mc1_host::attach_sdcard(m_card.data(), NUM_BLOCKS);
+    (void)sdcard_init(&m_sdctx, nullptr);
+    m_arena.init();
+    (void)m_cache.init(m_arena);
+  }
+
+  ~fixture_t() {
+    mc1_host::attach_sdcard(nullptr, 0U);
+  }
+
+  bool read(const uint32_t block_no) {
+    uint8_t buf[512];
+    if (!m_cache.read(&m_sdctx, buf, block_no)) {
+      std::printf("FAIL: Could not read block %u\n", block_no);
+      return false;
+    }
+    if (std::memcmp(buf, &m_card[block_no * 512U], 512U) != 0) {
+      std::printf("FAIL: Bad data for block %u\n", block_no);
+      return false;
+    }
+    return true;
+  }
+
+  sector_cache_t& cache() {
+    return m_cache;
+  }
+
+private:
+  std::vector<uint8_t> m_card;
+  sdctx_t m_sdctx;
+  vram_arena_t m_arena;
+  sector_cache_t m_cache;
+};
+
+bool check(const bool cond, const char* what) {
+  if (!cond) {
+    std::printf("FAIL: %s\n", what);
+  }
+  return cond;
+}
+
+// A file that is read from start to end should be read with multi-block commands.
+bool test_sequential() {
+  fixture_t f;
+  for (uint32_t b = 100U; b < 164U; ++b) {
+    if (!f.read(b)) {
+      return false;
+    }
+  }
+  const auto sd = mc1_host::sdcard_stats();
+  const auto& stats = f.cache().stats();
+  std::printf("sequential: %u hits, %u misses, %u SD reads (%u blocks)\n",
+              stats.hits,
+              stats.misses,
+              sd.read_cmds,
+              sd.blocks_read);
+  return check(sd.read_cmds <= 64U / sector_cache_t::READ_AHEAD + 1U, "too many read commands");
+}
+
+// Interleaved FAT lookups and file reads, as when following a cluster chain.
+bool test_fat_chain() {
+  fixture_t f;
+  const uint32_t FAT_BLOCK = 10U;
+  for (uint32_t cluster = 0U; cluster < 16U; ++cluster) {
+    if (!f.read(FAT_BLOCK + cluster / 8U)) {
+      return false;
+    }
+    for (uint32_t b = 0U; b < 4U; ++b) {
+      if (!f.read(200U + cluster * 4U + b)) {
+        return false;
+      }
+    }
+  }
+  const auto sd = mc1_host::sdcard_stats();
+  const auto& stats = f.cache().stats();
+  std::printf("FAT chain:  %u hits, %u misses, %u SD reads (%u blocks)\n",
+              stats.hits,
+              stats.misses,
+              sd.read_cmds,
+              sd.blocks_read);
+  return check(stats.hits >= 14U, "the FAT blocks were not cached") &&
+         check(sd.read_cmds < 80U, "too many read commands");
+}
+
+// Read-ahead must not fail at the end of the card, and random access must still be correct.
+bool test_edges() {
+  fixture_t f;
+  for (uint32_t b = NUM_BLOCKS - 3U; b < NUM_BLOCKS; ++b) {
+    if (!f.read(b)) {
+      return false;
+    }
+  }
+  uint32_t x = 12345U;
+  for (int i = 0; i < 1000; ++i) {
+    x = x * 1103515245U + 12345U;
+    if (!f.read((x >> 8) % 40U)) {
+      return false;
+    }
+  }
+
+  // A disabled cache reads directly from the card.
+  f.cache().disable();
+  const auto cmds_before = mc1_host::sdcard_stats().read_cmds;
+  if (!f.read(5U) || !f.read(5U)) {
+    return false;
+  }
+  return check(mc1_host::sdcard_stats().read_cmds == cmds_before + 2U, "the cache was used");
+}
+}  // namespace
+
+int main() {
+  bool success = true;
+  success = test_sequential() && success;
+  success = test_fat_chain() && success;
+  success = test_edges() && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
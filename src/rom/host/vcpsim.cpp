@@ -0,0 +1,215 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Run the ROM boot loop for a number of frames, and then render the resulting video frame with the
+// software video pipeline model. The tool reports the VCP cost per scanline, and can write the
+// frame to a PPM file or compare it with a golden PPM file.
+
+#include "mc1_host.hpp"
+#include "video_sim.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+struct options_t {
+  uint32_t frames = 60U;
+  bool print_lines = false;
+  const char* ppm_file = nullptr;
+  const char* golden_file = nullptr;
+  mc1_host::config_t config;
+};
+
+void print_usage(const char* prg) {
+  std::printf("Usage: %s [options]\n", prg);
+  std::printf("  --frames N       Number of ROM frames to run before rendering (default: 60)\n");
+  std::printf("  --width W        Video width (default: 1920)\n");
+  std::printf("  --height H       Video height (default: 1080)\n");
+  std::printf("  --lines          Print statistics for every scanline with VCP activity\n");
+  std::printf("  --ppm FILE       Write the rendered frame to a PPM file\n");
+  std::printf("  --compare FILE   Compare the rendered frame with a PPM file\n");
+}
+
+bool parse_args(int argc, char** argv, options_t& opts) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const bool has_value = (i + 1) < argc;
+    if (std::strcmp(arg, "--frames") == 0 && has_value) {
+      opts.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--width") == 0 && has_value) {
+      opts.config.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--height") == 0 && has_value) {
+      opts.config.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--lines") == 0) {
+      opts.print_lines = true;
+    } else if (std::strcmp(arg, "--ppm") == 0 && has_value) {
+      opts.ppm_file = argv[++i];
+    } else if (std::strcmp(arg, "--compare") == 0 && has_value) {
+      opts.golden_file = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return false;
+    }
+  }
+  return opts.frames > 0U && opts.config.width > 0U && opts.config.height > 0U;
+}
+
+bool write_ppm(const char* file_name, const mc1_host::video_sim_t& sim) {
+  auto* f = std::fopen(file_name, "wb");
+  if (f == nullptr) {
+    std::fprintf(stderr, "Unable to open %s\n", file_name);
+    return false;
+  }
+  const auto& timing = sim.timing();
+  std::fprintf(f, "P6\n%u %u\n255\n", timing.width, timing.height);
+  std::vector<uint8_t> rgb;
+  rgb.reserve(sim.framebuffer().size() * 3U);
+  for (const auto abgr : sim.framebuffer()) {
+    rgb.push_back(static_cast<uint8_t>(abgr));
+    rgb.push_back(static_cast<uint8_t>(abgr >> 8));
+    rgb.push_back(static_cast<uint8_t>(abgr >> 16));
+  }
+  const bool success = std::fwrite(rgb.data(), 1U, rgb.size(), f) == rgb.size();
+  std::fclose(f);
+  return success;
+}
+
+// Returns the number of differing pixels, or -1 if the file could not be read.
+long compare_ppm(const char* file_name, const mc1_host::video_sim_t& sim) {
+  auto* f = std::fopen(file_name, "rb");
+  if (f == nullptr) {
+    std::fprintf(stderr, "Unable to open %s\n", file_name);
+    return -1;
+  }
+  unsigned width;
+  unsigned height;
+  unsigned max_val;
+  const auto& timing = sim.timing();
+  if (std::fscanf(f, "P6 %u %u %u", &width, &height, &max_val) != 3 || max_val != 255U ||
+      width != timing.width || height != timing.height || std::fgetc(f) == EOF) {
+    std::fprintf(stderr, "%s: Unsupported PPM file or wrong dimensions\n", file_name);
+    std::fclose(f);
+    return -1;
+  }
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3U);
+  const bool success = std::fread(rgb.data(), 1U, rgb.size(), f) == rgb.size();
+  std::fclose(f);
+  if (!success) {
+    std::fprintf(stderr, "%s: Short read\n", file_name);
+    return -1;
+  }
+
+  long num_diffs = 0;
+  const auto& fb = sim.framebuffer();
+  for (size_t i = 0U; i < fb.size(); ++i) {
+    const auto golden = static_cast<uint32_t>(rgb[i * 3U]) |
+                        (static_cast<uint32_t>(rgb[i * 3U + 1U]) << 8) |
+                        (static_cast<uint32_t>(rgb[i * 3U + 2U]) << 16);
+    if ((fb[i] & 0x00ffffffU) != golden) {
+      ++num_diffs;
+    }
+  }
+  return num_diffs;
+}
+
+void print_line_stats(const mc1_host::video_sim_t& sim) {
+  std::printf("\n    y | L1 vcp  pix margin | L2 vcp  pix margin\n");
+  for (const auto& line : sim.line_stats()) {
+    const auto& l1 = line.layer[0];
+    const auto& l2 = line.layer[1];
+    if (l1.vcp_words == 0U && l2.vcp_words == 0U) {
+      continue;
+    }
+    std::printf("%5d | %6u %4u %6d | %6u %4u %6d%s\n",
+                line.y,
+                l1.vcp_words,
+                l1.pixel_words,
+                l1.hblank_margin,
+                l2.vcp_words,
+                l2.pixel_words,
+                l2.hblank_margin,
+                (line.y >= 0 && (l1.hblank_margin < 0 || l2.hblank_margin < 0))
+                    ? "  <-- over budget"
+                    : "");
+  }
+  std::printf("\n");
+}
+
+void print_frame_stats(const mc1_host::video_sim_t& sim) {
+  const auto stats = sim.frame_stats();
+  std::printf("h-blank budget: %u cycles/line\n", sim.timing().h_blank);
+  for (int k = 0; k < mc1_host::video_sim_t::NUM_LAYERS; ++k) {
+    std::printf(
+        "Layer %d: %7u VCP words, %7u pixel words, min margin %5d (y=%d), %u lines over budget\n",
+        k + 1,
+        stats.vcp_words[k],
+        stats.pixel_words[k],
+        stats.min_hblank_margin[k],
+        stats.min_hblank_margin_y[k],
+        stats.lines_over_budget[k]);
+  }
+  std::printf("Frame hash: %08x\n", sim.framebuffer_hash());
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  options_t opts;
+  if (!parse_args(argc, argv, opts)) {
+    return 1;
+  }
+
+  // Let the ROM produce its VCP:s and pixel data.
+  mc1_host::reset(opts.config);
+  mc1_host::frame_stats_t rom_stats;
+  if (!mc1_host::run_rom(opts.frames, rom_stats)) {
+    std::fprintf(stderr, "The boot loop did not reach the frame limit\n");
+    return 1;
+  }
+
+  // Render two frames: The palettes are not reset between frames, so the first frame may depend
+  // on the (unknown) power-on state.
+  const auto timing = mc1_host::video_timing(opts.config.width, opts.config.height);
+  mc1_host::video_sim_t sim(timing, mc1_host::vram(), mc1_host::vram_words());
+  sim.run_frame();
+  sim.run_frame();
+
+  if (opts.print_lines) {
+    print_line_stats(sim);
+  }
+  print_frame_stats(sim);
+
+  if (opts.ppm_file != nullptr && !write_ppm(opts.ppm_file, sim)) {
+    return 1;
+  }
+  if (opts.golden_file != nullptr) {
+    const auto num_diffs = compare_ppm(opts.golden_file, sim);
+    if (num_diffs != 0) {
+      if (num_diffs > 0) {
+        std::printf("%ld pixels differ from %s\n", num_diffs, opts.golden_file);
+      }
+      return 1;
+    }
+    std::printf("The frame matches %s\n", opts.golden_file);
+  }
+
+  return 0;
+}
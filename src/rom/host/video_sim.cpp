@@ -0,0 +1,384 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include "video_sim.hpp"
+
+#include <mc1/vcp.h>
+
+#include <cstring>
+
+namespace mc1_host {
+namespace {
+// Default register values (see rtl/vid_regs.vhd).
+const uint32_t DEFAULT_REGS[VCR_NUM_REGS] = {
+    0x000000U,  // ADDR
+    0x000000U,  // XOFFS
+    0x004000U,  // XINCR
+    0x000000U,  // HSTRT
+    0x000000U,  // HSTOP
+    0x000002U,  // CMODE
+    0x000135U,  // RMODE
+    0x000000U,  // LADDR
+    0x000000U,  // LSIZE
+    0x000000U,  // YINCR
+    0x010000U,  // YSTEP
+    0x000000U,  // GCOL0
+    0x000000U,  // GCOL1
+};
+
+int32_t sext24(const uint32_t x) {
+  return static_cast<int32_t>(x << 8) >> 8;
+}
+
+uint32_t abgr16_to_abgr32(const uint32_t x) {
+  const auto a = (x & 0x8000U) != 0U ? 255U : 0U;
+  const auto b5 = (x >> 10) & 31U;
+  const auto g5 = (x >> 5) & 31U;
+  const auto r5 = x & 31U;
+  const auto b = (b5 << 3) | (b5 >> 2);
+  const auto g = (g5 << 3) | (g5 >> 2);
+  const auto r = (r5 << 3) | (r5 >> 2);
+  return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+// Scale each 8-bit component of a BGR888 color by w/256 (rounding down).
+uint32_t scale_bgr888(const uint32_t c, const uint32_t w) {
+  uint32_t result = 0U;
+  for (uint32_t shift = 0U; shift < 24U; shift += 8U) {
+    result |= ((((c >> shift) & 255U) * w) >> 8) << shift;
+  }
+  return result;
+}
+
+// log2(pixels per word) for a given color mode.
+uint32_t log2_pixels_per_word(const uint32_t cmode) {
+  return cmode <= CMODE_PAL1 ? cmode : 0U;
+}
+
+uint32_t blend_factor(const uint32_t sel, const uint32_t alpha1, const uint32_t alpha2) {
+  switch (sel) {
+    case 2U:
+      return alpha1 + 1U;
+    case 3U:
+      return alpha2 + 1U;
+    case 4U:
+      return 256U - alpha1;
+    case 5U:
+      return 256U - alpha2;
+    default:
+      // Note: "minus one" (1) is not supported by the hardware either.
+      return 256U;
+  }
+}
+}  // namespace
+
+video_sim_t::video_sim_t(const video_timing_t& timing,
+                         const uint32_t* vram,
+                         const uint32_t vram_words)
+    : m_timing(timing),
+      m_vram(vram),
+      m_vram_mask(vram_words - 1U),
+      m_framebuffer(timing.width * timing.height) {
+  std::memset(m_layers, 0, sizeof(m_layers));
+  for (int k = 0; k < NUM_LAYERS; ++k) {
+    m_layers[k].start_addr = 4U * static_cast<uint32_t>(k + 1);
+    m_layers[k].prev_addr = 0x123456U;  // Unlikely address (same as rtl/vid_pixel.vhd).
+  }
+}
+
+void video_sim_t::restart_frame() {
+  for (auto& layer : m_layers) {
+    layer.pc = layer.start_addr;
+    layer.state = vcp_state_t::RUN;
+    layer.stall = 0U;
+    layer.yfrac = 0U;
+    std::memcpy(layer.regs, DEFAULT_REGS, sizeof(layer.regs));
+  }
+}
+
+void video_sim_t::run_frame() {
+  const auto x_start = -static_cast<int32_t>(m_timing.h_blank);
+  const auto y_start = -static_cast<int32_t>(m_timing.v_blank);
+  const auto width = static_cast<int32_t>(m_timing.width);
+  const auto height = static_cast<int32_t>(m_timing.height);
+  const auto line_cycles = static_cast<uint32_t>(width - x_start);
+
+  restart_frame();
+  m_line_stats.clear();
+  m_line_stats.reserve(static_cast<size_t>(height - y_start));
+
+  for (auto y = y_start; y < height; ++y) {
+    line_stats_t stats;
+    std::memset(&stats, 0, sizeof(stats));
+    stats.y = y;
+    bool went_idle[NUM_LAYERS] = {false, false};
+
+    // Per-line ADDR increment (the hardware applies the steps at the start of the line, before the
+    // VCP can run).
+    for (auto& layer : m_layers) {
+      next_line(layer);
+    }
+
+    for (auto x = x_start; x < width; ++x) {
+      const auto cycle = static_cast<uint32_t>(x - x_start);
+
+      // Pixel pipelines.
+      bool port_busy = false;
+      uint32_t colors[NUM_LAYERS];
+      for (int k = 0; k < NUM_LAYERS; ++k) {
+        bool fetched;
+        colors[k] = pixel(m_layers[k], x, y, fetched);
+        if (fetched) {
+          ++stats.layer[k].pixel_words;
+          port_busy = true;
+        }
+      }
+      if (x >= 0 && y >= 0) {
+        m_framebuffer[static_cast<size_t>(y * width + x)] =
+            blend(colors[0], colors[1], m_layers[1].regs[VCR_RMODE]);
+      }
+
+      // VCP:s (layer 2 has priority).
+      for (int k = NUM_LAYERS - 1; k >= 0; --k) {
+        auto& layer = m_layers[k];
+        if (layer.stall > 0U) {
+          --layer.stall;
+          continue;
+        }
+        if (vcp_wait(layer, x, y)) {
+          if (!went_idle[k]) {
+            went_idle[k] = true;
+            stats.layer[k].busy_cycles = cycle;
+          }
+          continue;
+        }
+        if (!port_busy) {
+          vcp_cycle(layer);
+          ++stats.layer[k].vcp_words;
+          port_busy = true;
+        }
+      }
+    }
+
+    for (int k = 0; k < NUM_LAYERS; ++k) {
+      auto& layer_stats = stats.layer[k];
+      if (!went_idle[k]) {
+        layer_stats.busy_cycles = line_cycles;
+      }
+      layer_stats.hblank_margin =
+          static_cast<int32_t>(m_timing.h_blank) - static_cast<int32_t>(layer_stats.busy_cycles);
+    }
+    m_line_stats.push_back(stats);
+  }
+}
+
+uint32_t video_sim_t::pixel(layer_t& layer, const int32_t x, const int32_t y, bool& fetched) {
+  const auto* regs = layer.regs;
+  const auto hstrt = sext24(regs[VCR_HSTRT]);
+  const auto hstop = sext24(regs[VCR_HSTOP]);
+  const bool active = x >= hstrt && x < hstop;
+  const bool is_hstrt = x == hstrt;
+
+  // X coordinate (16.16 fixed point).
+  if (is_hstrt) {
+    layer.xpos = static_cast<uint32_t>(sext24(regs[VCR_XOFFS]));
+  } else if (active) {
+    layer.xpos += static_cast<uint32_t>(sext24(regs[VCR_XINCR]));
+  }
+
+  // Fetch a new pixel word if necessary (note: only the lower nine address bits are compared).
+  const auto cmode = regs[VCR_CMODE] & 15U;
+  const auto log2_ppw = log2_pixels_per_word(cmode);
+  const auto pixel_idx = layer.xpos >> 16;
+  fetched = false;
+  if (active && cmode == CMODE_GRADIENT) {
+    // The gradient color mode does not read any memory.
+  } else if (active) {
+    const auto offs = static_cast<uint32_t>(static_cast<int32_t>(layer.xpos) >> (16U + log2_ppw));
+    const auto addr = (regs[VCR_ADDR] + offs) & 0xffffffU;
+    if (((addr ^ layer.prev_addr) & 0x1ffU) != 0U || is_hstrt) {
+      layer.data = read_vram(addr);
+      layer.prev_addr = addr;
+      fetched = true;
+    }
+  } else {
+    layer.data = 0U;
+  }
+
+  if (x < 0 || y < 0) {
+    return 0U;
+  }
+
+  // Extract the pixel color.
+  const auto bits_per_pixel = 32U >> log2_ppw;
+  const auto shift = (pixel_idx & ((1U << log2_ppw) - 1U)) * bits_per_pixel;
+  if (active && cmode == CMODE_RGBA8888) {
+    return layer.data;
+  }
+  if (active && cmode == CMODE_GRADIENT) {
+    const auto w = (pixel_idx << ((regs[VCR_CMODE] >> 4) & 7U)) & 255U;
+    return 0xff000000U | (scale_bgr888(regs[VCR_GCOL0], 255U - w) +
+                          scale_bgr888(regs[VCR_GCOL1], w));
+  }
+  if (active && cmode == CMODE_RGBA5551) {
+    return abgr16_to_abgr32((layer.data >> shift) & 0xffffU);
+  }
+  const auto idx_mask = log2_ppw >= 3U ? ((1U << bits_per_pixel) - 1U) : 255U;
+  return layer.palette[(layer.data >> shift) & idx_mask];
+}
+
+bool video_sim_t::vcp_wait(layer_t& layer, const int32_t x, const int32_t y) {
+  // Note: The hardware compares 16-bit sign extended raster coordinates with the argument.
+  if (layer.state == vcp_state_t::WAITX) {
+    if (static_cast<int16_t>(x) != layer.wait_arg) {
+      return true;
+    }
+    layer.state = vcp_state_t::RUN;
+  } else if (layer.state == vcp_state_t::WAITY) {
+    if (static_cast<int16_t>(y) != layer.wait_arg) {
+      return true;
+    }
+    layer.state = vcp_state_t::RUN;
+  }
+  return false;
+}
+
+void video_sim_t::next_line(layer_t& layer) {
+  const auto acc = layer.regs[VCR_YSTEP] + layer.yfrac;
+  const auto steps = (acc >> 16) & 255U;
+  layer.yfrac = acc & 0xffffU;
+  layer.regs[VCR_ADDR] = (layer.regs[VCR_ADDR] + steps * layer.regs[VCR_YINCR]) & 0xffffffU;
+}
+
+void video_sim_t::vcp_cycle(layer_t& layer) {
+  const auto word = read_vram(layer.pc);
+  layer.pc = (layer.pc + 1U) & 0xffffffU;
+
+  if (layer.state == vcp_state_t::PALETTE) {
+    layer.palette[layer.pal_addr & 255U] = word;
+    ++layer.pal_addr;
+    if (--layer.pal_left == 0U) {
+      layer.state = vcp_state_t::RUN;
+    }
+    return;
+  }
+
+  switch (word >> 28) {
+    case 0x0:  // JMP
+      layer.pc = word & 0xffffffU;
+      layer.stall = C_JUMP_PENALTY;
+      break;
+    case 0x1:  // JSR
+      layer.stack[layer.sp & 15U] = layer.pc;
+      ++layer.sp;
+      layer.pc = word & 0xffffffU;
+      layer.stall = C_JUMP_PENALTY;
+      break;
+    case 0x2:  // RTS
+      --layer.sp;
+      layer.pc = layer.stack[layer.sp & 15U];
+      layer.stall = C_JUMP_PENALTY;
+      break;
+    case 0x4:  // WAITX
+      layer.state = vcp_state_t::WAITX;
+      layer.wait_arg = static_cast<int16_t>(word & 0xffffU);
+      break;
+    case 0x5:  // WAITY
+      layer.state = vcp_state_t::WAITY;
+      layer.wait_arg = static_cast<int16_t>(word & 0xffffU);
+      break;
+    case 0x6:  // SETPAL
+      layer.state = vcp_state_t::PALETTE;
+      layer.pal_addr = (word >> 8) & 255U;
+      layer.pal_left = (word & 255U) + 1U;
+      break;
+    case 0x8: {  // SETREG
+      // Note: Only four register address bits are decoded by rtl/vid_regs.vhd. The XRAM line buffer
+      // (LADDR/LSIZE) is not simulated, so those registers have no effect.
+      const auto reg = (word >> 24) & 15U;
+      if (reg < VCR_NUM_REGS) {
+        layer.regs[reg] = word & 0xffffffU;
+      }
+      if (reg == VCR_ADDR) {
+        layer.yfrac = 0U;
+      }
+    } break;
+    default:  // NOP and undefined instructions
+      break;
+  }
+}
+
+uint32_t video_sim_t::blend(const uint32_t c1, const uint32_t c2, const uint32_t method) {
+  const auto alpha1 = c1 >> 24;
+  const auto alpha2 = c2 >> 24;
+  const auto f1 = blend_factor(method & 7U, alpha1, alpha2);
+  const auto f2 = blend_factor((method >> 4) & 7U, alpha1, alpha2);
+  uint32_t result = 0xff000000U;
+  for (uint32_t shift = 0U; shift < 24U; shift += 8U) {
+    auto x = (((c1 >> shift) & 255U) * f1 + ((c2 >> shift) & 255U) * f2) >> 8;
+    if (x > 255U) {
+      x = 255U;
+    }
+    result |= x << shift;
+  }
+  return result;
+}
+
+video_sim_t::frame_stats_t video_sim_t::frame_stats() const {
+  frame_stats_t stats;
+  std::memset(&stats, 0, sizeof(stats));
+  for (int k = 0; k < NUM_LAYERS; ++k) {
+    stats.min_hblank_margin[k] = static_cast<int32_t>(m_timing.h_blank);
+    stats.min_hblank_margin_y[k] = 0;
+  }
+  for (const auto& line : m_line_stats) {
+    for (int k = 0; k < NUM_LAYERS; ++k) {
+      const auto& layer = line.layer[k];
+      stats.vcp_words[k] += layer.vcp_words;
+      stats.pixel_words[k] += layer.pixel_words;
+
+      // Note: The VCP may run past the horizontal blanking interval during vertical blanking.
+      if (line.y < 0) {
+        continue;
+      }
+      if (layer.hblank_margin < stats.min_hblank_margin[k]) {
+        stats.min_hblank_margin[k] = layer.hblank_margin;
+        stats.min_hblank_margin_y[k] = line.y;
+      }
+      if (layer.hblank_margin < 0) {
+        ++stats.lines_over_budget[k];
+      }
+    }
+  }
+  return stats;
+}
+
+uint32_t video_sim_t::framebuffer_hash() const {
+  uint32_t hash = 2166136261U;
+  for (auto pixel : m_framebuffer) {
+    for (int k = 0; k < 4; ++k) {
+      hash = (hash ^ (pixel & 255U)) * 16777619U;
+      pixel >>= 8;
+    }
+  }
+  return hash;
+}
+
+}  // namespace mc1_host
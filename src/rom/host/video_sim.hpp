@@ -0,0 +1,155 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_HOST_VIDEO_SIM_HPP_
+#define ROM_HOST_VIDEO_SIM_HPP_
+
+#include "mc1_host.hpp"
+
+#include <mc1/vcp.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mc1_host {
+
+// Software model of the MC1 video pipeline (rtl/video.vhd).
+//
+// The simulation runs one raster cycle (pixel clock) at a time, from the start of the vertical
+// blanking interval to the last visible pixel, just like rtl/vid_raster.vhd. For each layer it
+// executes the VCP (rtl/vid_vcpp.vhd), updates the video control registers (rtl/vid_regs.vhd) and
+// the palette, generates pixels (rtl/vid_pixel.vhd), and finally the two layers are blended
+// (rtl/vid_blend.vhd).
+//
+// The VRAM read port is modelled as one 32-bit word per cycle. Pixel fetches are served first,
+// then the layer 2 VCP, then the layer 1 VCP (cf. the read port priorities in rtl/video.vhd and
+// rtl/video_layer.vhd). A taken jump (JMP, JSR, RTS) costs C_JUMP_PENALTY extra cycles. Other
+// pipeline latencies, the layer 1 pixel prefetcher and dithering are not modelled.
+class video_sim_t {
+public:
+  static const int NUM_LAYERS = 2;
+
+  struct layer_line_stats_t {
+    // Number of words that the VCP fetched (instructions + palette data).
+    uint32_t vcp_words;
+
+    // Number of pixel words that the pixel pipeline fetched.
+    uint32_t pixel_words;
+
+    // Number of cycles from the start of the line (i.e. the start of horizontal blanking) until
+    // the VCP went idle (WAITX/WAITY). Zero if the VCP was idle during the entire line.
+    uint32_t busy_cycles;
+
+    // Horizontal blanking budget minus busy_cycles. A negative margin means that the VCP was still
+    // busy when the active part of the line started, so VCR/palette changes meant for this line
+    // may take effect in the middle of the line.
+    int32_t hblank_margin;
+  };
+
+  struct line_stats_t {
+    int32_t y;
+    layer_line_stats_t layer[NUM_LAYERS];
+  };
+
+  // Note: The hblank margin statistics only include visible lines (y >= 0).
+  struct frame_stats_t {
+    uint32_t vcp_words[NUM_LAYERS];
+    uint32_t pixel_words[NUM_LAYERS];
+    int32_t min_hblank_margin[NUM_LAYERS];
+    int32_t min_hblank_margin_y[NUM_LAYERS];
+    uint32_t lines_over_budget[NUM_LAYERS];
+  };
+
+  // Note: vram_words must be a power of two (addresses wrap around, as in the hardware).
+  video_sim_t(const video_timing_t& timing, const uint32_t* vram, uint32_t vram_words);
+
+  // Simulate one complete frame.
+  void run_frame();
+
+  const video_timing_t& timing() const {
+    return m_timing;
+  }
+
+  // The composited image of the last frame (ABGR32, width * height pixels).
+  const std::vector<uint32_t>& framebuffer() const {
+    return m_framebuffer;
+  }
+
+  // Per-line statistics of the last frame (blanking lines included, starting at y = -v_blank).
+  const std::vector<line_stats_t>& line_stats() const {
+    return m_line_stats;
+  }
+
+  frame_stats_t frame_stats() const;
+
+  // A 32-bit FNV-1a hash of the framebuffer (for golden frame comparisons).
+  uint32_t framebuffer_hash() const;
+
+private:
+  static const uint32_t C_JUMP_PENALTY = 2U;
+
+  enum class vcp_state_t { RUN, WAITX, WAITY, PALETTE };
+
+  struct layer_t {
+    uint32_t start_addr;
+
+    // VCP state.
+    uint32_t pc;
+    uint32_t stack[16];  // Same depth as rtl/vid_vcpp_stack.vhd.
+    uint32_t sp;
+    vcp_state_t state;
+    int32_t wait_arg;
+    uint32_t pal_addr;
+    uint32_t pal_left;
+    uint32_t stall;
+
+    // Video control registers and palette.
+    uint32_t regs[VCR_NUM_REGS];
+    uint32_t yfrac;  // Fractional row accumulator for YSTEP.
+    uint32_t palette[256];
+
+    // Pixel pipeline state.
+    uint32_t xpos;
+    uint32_t prev_addr;
+    uint32_t data;
+  };
+
+  void restart_frame();
+  uint32_t pixel(layer_t& layer, int32_t x, int32_t y, bool& fetched);
+  static void next_line(layer_t& layer);
+  void vcp_cycle(layer_t& layer);
+  static bool vcp_wait(layer_t& layer, int32_t x, int32_t y);
+  static uint32_t blend(uint32_t c1, uint32_t c2, uint32_t method);
+
+  uint32_t read_vram(uint32_t addr) const {
+    return m_vram[addr & m_vram_mask];
+  }
+
+  const video_timing_t m_timing;
+  const uint32_t* m_vram;
+  const uint32_t m_vram_mask;
+  layer_t m_layers[NUM_LAYERS];
+  std::vector<uint32_t> m_framebuffer;
+  std::vector<line_stats_t> m_line_stats;
+};
+
+}  // namespace mc1_host
+
+#endif  // ROM_HOST_VIDEO_SIM_HPP_
@@ -0,0 +1,137 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Test for the VRAM arena allocator: Check alignment, overflow handling and the statistics, and
+// that the ROM stays within the VRAM size that the hardware reports.
+
+#include "mc1_host.hpp"
+
+#include "vram_arena.hpp"
+
+#include <cstdio>
+
+namespace {
+bool check(const bool cond, const char* what) {
+  if (!cond) {
+    std::printf("FAIL: %s\n", what);
+  }
+  return cond;
+}
+
+uintptr_t addr(const void* ptr) {
+  return reinterpret_cast<uintptr_t>(ptr);
+}
+
+bool test_alloc() {
+  alignas(256) static uint8_t mem[1024];
+  vram_arena_t arena;
+  arena.init(mem, sizeof(mem));
+
+  auto* a = arena.alloc_bytes(3U, 1U);
+  auto* b = arena.alloc<uint32_t>(2U);
+  auto* c = arena.alloc_bytes(10U, 128U);
+  bool ok = check(a == &mem[0], "first allocation") &&
+            check(addr(b) == addr(&mem[4]), "word alignment") &&
+            check(addr(c) == addr(&mem[128]), "128 byte alignment") &&
+            check(arena.stats().used == 138U, "used bytes") &&
+            check(arena.bytes_free() == 1024U - 138U, "free bytes") &&
+            check(!arena.overflowed(), "overflow");
+
+  // Scratch memory is allocated from the top, and is released in one go.
+  auto* s1 = arena.alloc_scratch<uint32_t>(64U);
+  auto* s2 = arena.alloc_scratch_bytes(100U, 64U);
+  ok = ok && check(addr(s1) == addr(&mem[1024 - 256]), "first scratch allocation") &&
+       check(addr(s2) == addr(&mem[1024 - 256 - 128]), "scratch alignment") &&
+       check(arena.stats().scratch_used == 384U, "used scratch bytes") &&
+       check(arena.stats().high_water == 138U + 384U, "high-water mark");
+  arena.release_scratch();
+  ok = ok && check(arena.stats().scratch_used == 0U, "released scratch bytes") &&
+       check(arena.bytes_free() == 1024U - 138U, "free bytes after release") &&
+       check(arena.stats().high_water == 138U + 384U, "high-water mark after release");
+
+  // Allocations that do not fit fail without changing the arena.
+  ok = ok && check(arena.alloc_bytes(1024U - 138U + 1U, 1U) == nullptr, "too large allocation") &&
+       check(arena.alloc_bytes(1024U - 138U, 4U) == nullptr, "too large aligned allocation") &&
+       check(arena.alloc_scratch_bytes(2000U, 4U) == nullptr, "too large scratch allocation") &&
+       check(arena.alloc<uint32_t>(0x40000000U) == nullptr, "wrapping allocation") &&
+       check(arena.stats().used == 138U, "used bytes after overflow") &&
+       check(arena.overflowed(), "no overflow reported") &&
+       check(arena.stats().num_failed == 4U, "number of failed allocations") &&
+       check(arena.stats().first_failed == 1024U - 138U + 1U, "first failed allocation");
+
+  // The remaining memory can still be used.
+  auto* d = arena.alloc_bytes(1024U - 138U, 1U);
+  return ok && check(d == &mem[138], "last allocation") && check(arena.bytes_free() == 0U, "full");
+}
+
+// The arena ends STACK_SIZE bytes below the top of VRAM, as given by MMIO(VRAMSIZE).
+bool test_vram_size() {
+  mc1_host::config_t config;
+  config.vram_size = 64U * 1024U;
+  mc1_host::reset(config);
+  vram_arena_t arena;
+  arena.init();
+  const auto expected_size =
+      config.vram_size - mc1_host::VRAM_RESERVED_SIZE - vram_arena_t::STACK_SIZE;
+  bool ok = check(arena.stats().size == expected_size, "arena size");
+  ok = ok && check(addr(arena.alloc_bytes(expected_size)) ==
+                       addr(mc1_host::vram()) + mc1_host::VRAM_RESERVED_SIZE,
+                   "arena start");
+
+  config.vram_size = 2048U;
+  mc1_host::reset(config);
+  arena.init();
+  return ok && check(arena.stats().size == 0U, "arena size for tiny VRAM");
+}
+
+// Boot the ROM on a machine with too little VRAM for everything: The parts that do not fit must be
+// left out, and nothing may be written above the arena.
+bool test_small_vram_boot() {
+  const uint32_t FILL_WORD = 0x5a5aa5a5U;
+  mc1_host::config_t config;
+  config.vram_size = 16U * 1024U;
+  mc1_host::reset(config);
+  const auto arena_end = (config.vram_size - vram_arena_t::STACK_SIZE) / 4U;
+  for (uint32_t i = arena_end; i < mc1_host::vram_words(); ++i) {
+    mc1_host::vram()[i] = FILL_WORD;
+  }
+
+  mc1_host::frame_stats_t stats;
+  if (!check(mc1_host::run_rom(10U, stats), "the ROM did not run")) {
+    return false;
+  }
+  for (uint32_t i = arena_end; i < mc1_host::vram_words(); ++i) {
+    if (mc1_host::vram()[i] != FILL_WORD) {
+      std::printf("FAIL: VRAM word %u (above the arena) was overwritten\n", i);
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+int main() {
+  bool success = true;
+  success = test_alloc() && success;
+  success = test_vram_size() && success;
+  success = test_small_vram_boot() && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
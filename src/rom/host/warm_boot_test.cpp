@@ -0,0 +1,149 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+// Test for the warm restart handoff block: Check that a saved block restores the SD card context
+// exactly once, and that it is rejected if it has been corrupted or if the card has been changed.
+
+#include "mc1_host.hpp"
+
+#include "warm_boot.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+const uint32_t NUM_BLOCKS = 64U;
+
+bool check(const bool cond, const char* what) {
+  if (!cond) {
+    std::printf("FAIL: %s\n", what);
+  }
+  return cond;
+}
+
+void log_fun(const char*) {
+}
+
+class fixture_t {
+public:
+  fixture_t() : m_card(NUM_BLOCKS * 512U) {
+    for (uint32_t i = 0U; i < m_card.size(); ++i) {
+      m_card[i] = static_cast<uint8_t>(i * 7U + (i >> 9));
+    }
+    mc1_host::reset(mc1_host::config_t());
+    mc1_host::attach_sdcard(m_card.data(), NUM_BLOCKS);
+    (void)sdcard_init(&m_sdctx, nullptr);
+  }
+
+  ~fixture_t() {
+    mc1_host::attach_sdcard(nullptr, 0U);
+  }
+
+  std::vector<uint8_t>& card() {
+    return m_card;
+  }
+
+  sdctx_t* sdctx() {
+    return &m_sdctx;
+  }
+
+private:
+  std::vector<uint8_t> m_card;
+  sdctx_t m_sdctx;
+};
+
+bool test_round_trip() {
+  fixture_t f;
+  bool ok = check(!warm_boot_t::take(f.sdctx(), log_fun), "took a block that was never saved");
+
+  warm_boot_t::save(f.sdctx());
+  sdctx_t sdctx = sdctx_t();
+  ok = ok && check(warm_boot_t::take(&sdctx, log_fun), "could not take the saved block") &&
+       check(sdctx.num_blocks == NUM_BLOCKS && sdctx.is_sdhc == f.sdctx()->is_sdhc &&
+                 sdctx.protocol_version == f.sdctx()->protocol_version,
+             "bad SD card context") &&
+       check(sdctx.log_func == log_fun, "the log function was not set");
+
+  // The block can only be taken once.
+  return ok && check(!warm_boot_t::take(&sdctx, log_fun), "took the block twice");
+}
+
+bool test_corrupted() {
+  fixture_t f;
+  const auto* begin = reinterpret_cast<const uint8_t*>(warm_boot_t::memory_begin());
+  const auto* end = reinterpret_cast<const uint8_t*>(warm_boot_t::memory_end());
+  const auto size = static_cast<uint32_t>(end - begin);
+  if (!check(size <= warm_boot_t::MAX_SIZE, "the block is too large")) {
+    return false;
+  }
+  for (uint32_t offset = 0U; offset < size; offset += 4U) {
+    warm_boot_t::save(f.sdctx());
+    auto* byte = &reinterpret_cast<uint8_t*>(mc1_host::vram())[warm_boot_t::VRAM_OFFSET + offset];
+    *byte ^= 0x10U;
+    sdctx_t sdctx;
+    if (warm_boot_t::take(&sdctx, log_fun)) {
+      std::printf("FAIL: took a block that was corrupted at offset %u\n", offset);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool test_card_changed() {
+  fixture_t f;
+  sdctx_t sdctx;
+
+  // A different card (the first block has changed).
+  warm_boot_t::save(f.sdctx());
+  f.card()[100] ^= 1U;
+  bool ok = check(!warm_boot_t::take(&sdctx, log_fun), "took the block for a different card");
+  f.card()[100] ^= 1U;
+
+  // No card.
+  warm_boot_t::save(f.sdctx());
+  mc1_host::attach_sdcard(nullptr, 0U);
+  ok = ok && check(!warm_boot_t::take(&sdctx, log_fun), "took the block without a card");
+  return ok;
+}
+
+// A warm restart that can not load the boot executable (the host can not mount the card) must fall
+// back to a cold start with the boot animation.
+bool test_rom_fallback() {
+  fixture_t f;
+  warm_boot_t::save(f.sdctx());
+  mc1_host::frame_stats_t stats;
+  if (!check(mc1_host::run_rom(5U, stats), "the ROM did not run")) {
+    return false;
+  }
+  sdctx_t sdctx;
+  return check(!warm_boot_t::take(&sdctx, log_fun), "the block was not taken by the ROM") &&
+         check(mc1_host::vram()[4] != 0U, "the mosaic is not shown");
+}
+}  // namespace
+
+int main() {
+  bool success = true;
+  success = test_round_trip() && success;
+  success = test_corrupted() && success;
+  success = test_card_changed() && success;
+  success = test_rom_fallback() && success;
+  std::printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
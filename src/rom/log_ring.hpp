@@ -0,0 +1,207 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_LOG_RING_HPP_
+#define ROM_LOG_RING_HPP_
+
+#include <mc1/vconsole.h>
+
+#include <cstdint>
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Deferred console log.
+//
+// Printing to the console renders glyphs into VRAM, and formatting numbers needs divisions, so
+// log calls only append the text (and numbers in binary form) to a ring buffer. flush() does the
+// formatting and rendering later, a bounded number of characters at a time (e.g. once per frame
+// in the vertical blanking interval).
+//
+// There is one producer and one consumer, and they never run concurrently, so the ring buffer
+// needs no locking. If the buffer is full, new log text is dropped and "[...]" is printed in its
+// place.
+class log_ring_t {
+public:
+  static const uint32_t SIZE = 2048U;  // Must be a power of two.
+
+  void print(const char* str) {
+    for (; *str != 0; ++str) {
+      const auto c = static_cast<uint8_t>(*str);
+      if (!reserve(1U)) {
+        return;
+      }
+      put(c < NUM_TAGS ? '?' : c);
+    }
+  }
+
+  void print_dec(const int x) {
+    put_record(TAG_DEC, static_cast<uint32_t>(x));
+  }
+
+  void print_hex(const uint32_t x) {
+    put_record(TAG_HEX, x);
+  }
+
+  // Print a size in bytes (using the largest whole unit, e.g. "128 KB").
+  void print_size(const uint32_t size) {
+    put_record(TAG_SIZE, size);
+  }
+
+  // Print a number with two decimals (x is the number times 100, and must not be negative).
+  void print_fixed2(const int x) {
+    put_record(TAG_FIXED2, static_cast<uint32_t>(x));
+  }
+
+  bool empty() const {
+    return m_head == m_tail;
+  }
+
+  // Render at most max_chars characters (numbers count as ten characters). Returns true if the
+  // log is empty afterwards.
+  bool flush(uint32_t max_chars) {
+    char buf[CHUNK_SIZE + 1];
+    uint32_t len = 0U;
+    while (!empty() && max_chars > 0U) {
+      const auto c = get();
+      if (c >= NUM_TAGS) {
+        buf[len++] = static_cast<char>(c);
+        --max_chars;
+        if (len == CHUNK_SIZE) {
+          buf[len] = 0;
+          vcon_print(buf);
+          len = 0U;
+        }
+        continue;
+      }
+
+      if (len > 0U) {
+        buf[len] = 0;
+        vcon_print(buf);
+        len = 0U;
+      }
+      render_record(c);
+      max_chars = max_chars > 10U ? max_chars - 10U : 0U;
+    }
+    if (len > 0U) {
+      buf[len] = 0;
+      vcon_print(buf);
+    }
+    return empty();
+  }
+
+private:
+  static const uint32_t CHUNK_SIZE = 32U;
+
+  // Tags for records (all other byte values are plain characters).
+  static const uint8_t TAG_DEC = 1U;
+  static const uint8_t TAG_HEX = 2U;
+  static const uint8_t TAG_SIZE = 3U;
+  static const uint8_t TAG_FIXED2 = 4U;
+  static const uint8_t TAG_DROPPED = 5U;
+  static const uint8_t NUM_TAGS = 6U;
+
+  // Reserve space for size bytes (plus a pending "dropped" tag). Returns false if the log is full.
+  bool reserve(const uint32_t size) {
+    const auto needed = size + (m_dropped ? 1U : 0U);
+    if (SIZE - (m_head - m_tail) < needed) {
+      m_dropped = true;
+      return false;
+    }
+    if (m_dropped) {
+      put(TAG_DROPPED);
+      m_dropped = false;
+    }
+    return true;
+  }
+
+  void put(const uint8_t c) {
+    m_buf[m_head & (SIZE - 1U)] = c;
+    ++m_head;
+  }
+
+  uint8_t get() {
+    const auto c = m_buf[m_tail & (SIZE - 1U)];
+    ++m_tail;
+    return c;
+  }
+
+  void put_record(const uint8_t tag, const uint32_t x) {
+    // Records are written as a whole or not at all.
+    if (!reserve(5U)) {
+      return;
+    }
+    put(tag);
+    for (int shift = 0; shift < 32; shift += 8) {
+      put(static_cast<uint8_t>(x >> shift));
+    }
+  }
+
+  uint32_t get_u32() {
+    uint32_t x = 0U;
+    for (int shift = 0; shift < 32; shift += 8) {
+      x |= static_cast<uint32_t>(get()) << shift;
+    }
+    return x;
+  }
+
+  void render_record(const uint8_t tag) {
+    if (tag == TAG_DROPPED) {
+      vcon_print("[...]");
+      return;
+    }
+    const auto x = get_u32();
+    switch (tag) {
+      case TAG_DEC:
+        vcon_print_dec(static_cast<int>(x));
+        break;
+      case TAG_HEX:
+        vcon_print_hex(x);
+        break;
+      case TAG_SIZE: {
+        static const char* SIZE_SUFFIX[] = {" bytes", " KB", " MB", " GB"};
+        auto size = x;
+        int size_div = 0;
+        while (size >= 1024u && (size & 1023u) == 0u) {
+          size = size >> 10;
+          ++size_div;
+        }
+        vcon_print_dec(static_cast<int>(size));
+        vcon_print(SIZE_SUFFIX[size_div]);
+      } break;
+      default: {
+        const auto xi = static_cast<int>(x);
+        vcon_print_dec(xi / 100);
+        char frac[4] = {'.', static_cast<char>('0' + (xi % 100) / 10),
+                        static_cast<char>('0' + xi % 10), 0};
+        vcon_print(frac);
+      } break;
+    }
+  }
+
+  uint8_t m_buf[SIZE];
+  uint32_t m_head = 0U;  // Total number of bytes written.
+  uint32_t m_tail = 0U;  // Total number of bytes read.
+  bool m_dropped = false;
+};
+
+}  // namespace
+
+#endif  // ROM_LOG_RING_HPP_
@@ -0,0 +1,265 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+
+#ifndef ROM_LZG_STREAM_HPP_
+#define ROM_LZG_STREAM_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Streaming LZG decoder.
+//
+// The compressed data (in the liblzg format: a 16 byte header followed by the encoded data) is fed
+// to the decoder in arbitrarily sized chunks, e.g. one SD card block at a time, and the decoded
+// data is written straight to the destination buffer. Back references are resolved against the
+// destination buffer, so the decoder needs no window memory of its own.
+class lzg_stream_t {
+public:
+  static const uint32_t HEADER_SIZE = 16U;
+
+  void init(uint8_t* dst, const uint32_t capacity) {
+    m_dst_start = dst;
+    m_dst = dst;
+    m_dst_end = dst + capacity;
+    m_header_len = 0U;
+    m_tok_len = 0U;
+    m_checksum_a = 1U;
+    m_checksum_b = 0U;
+    m_encoded_left = 0U;
+    m_error = false;
+  }
+
+  // Decode the next chunk of compressed data. Returns false if the data is invalid.
+  bool feed(const uint8_t* src, uint32_t size) {
+    // Collect the header and the markers.
+    while (size > 0U && m_header_len < HEADER_SIZE + 4U && !m_error) {
+      m_header[m_header_len++] = *src++;
+      --size;
+      if (m_header_len == HEADER_SIZE) {
+        parse_header();
+      } else if (m_header_len > HEADER_SIZE) {
+        update_checksum(&m_header[m_header_len - 1U], 1U);
+      }
+    }
+    if (size == 0U || m_error) {
+      return !m_error;
+    }
+    if (size > m_encoded_left) {
+      m_error = true;
+      return false;
+    }
+    m_encoded_left -= size;
+    update_checksum(src, size);
+
+    if (m_header[15] == METHOD_COPY) {
+      if (size > static_cast<uint32_t>(m_dst_end - m_dst)) {
+        m_error = true;
+        return false;
+      }
+      std::memcpy(m_dst, src, size);
+      m_dst += size;
+      return true;
+    }
+
+    const auto* end = src + size;
+
+    // Complete a token that was split between two chunks.
+    while (m_tok_len > 0U && src < end) {
+      m_tok[m_tok_len++] = *src++;
+      if (m_tok_len >= token_size(m_tok, m_tok_len)) {
+        (void)decode_token(m_tok);
+        m_tok_len = 0U;
+      }
+    }
+
+    // Decode all the complete tokens in the chunk (a token is at most four bytes long).
+    while (end - src >= 4 && !m_error) {
+      src += decode_token(src);
+    }
+
+    // Save a trailing partial token.
+    while (src < end && !m_error) {
+      m_tok[m_tok_len++] = *src++;
+      if (m_tok_len >= token_size(m_tok, m_tok_len)) {
+        (void)decode_token(m_tok);
+        m_tok_len = 0U;
+      }
+    }
+    return !m_error;
+  }
+
+  // Check that all the data has been decoded. Returns the decoded size, or -1 on failure.
+  int32_t finish() const {
+    const auto checksum = (m_checksum_b << 16) | m_checksum_a;
+    if (m_error || m_header_len < HEADER_SIZE + 4U || m_encoded_left != 0U || m_tok_len != 0U ||
+        checksum != get32(&m_header[11]) ||
+        static_cast<uint32_t>(m_dst - m_dst_start) != m_decoded_size) {
+      return -1;
+    }
+    return static_cast<int32_t>(m_decoded_size);
+  }
+
+private:
+  static const uint8_t METHOD_COPY = 0U;
+  static const uint8_t METHOD_LZG1 = 1U;
+
+  static uint32_t get32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+  }
+
+  static uint32_t decode_length(const uint8_t b) {
+    static const uint8_t LUT[32] = {2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12,
+                                    13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
+                                    24, 25, 26, 27, 28, 29, 35, 48, 72, 128};
+    return LUT[b & 31U];
+  }
+
+  void parse_header() {
+    m_decoded_size = get32(&m_header[3]);
+    m_encoded_left = get32(&m_header[7]);
+    if (m_header[0] != 'L' || m_header[1] != 'Z' || m_header[2] != 'G' ||
+        m_decoded_size > static_cast<uint32_t>(m_dst_end - m_dst)) {
+      m_error = true;
+    } else if (m_header[15] == METHOD_COPY) {
+      // There are no markers for the copy method.
+      m_header_len = HEADER_SIZE + 4U;
+    } else if (m_header[15] != METHOD_LZG1 || m_encoded_left < 4U) {
+      m_error = true;
+    } else {
+      m_encoded_left -= 4U;
+    }
+  }
+
+  void update_checksum(const uint8_t* src, const uint32_t size) {
+    // Same as the liblzg checksum (two 16-bit running sums).
+    uint32_t a = m_checksum_a;
+    uint32_t b = m_checksum_b;
+    for (uint32_t i = 0U; i < size; ++i) {
+      a = (a + src[i]) & 0xffffU;
+      b = (b + a) & 0xffffU;
+    }
+    m_checksum_a = a;
+    m_checksum_b = b;
+  }
+
+  bool is_marker(const uint8_t symbol) const {
+    return symbol == m_header[16] || symbol == m_header[17] || symbol == m_header[18] ||
+           symbol == m_header[19];
+  }
+
+  // Size of the token that starts with tok (len = number of available bytes, at least one).
+  uint32_t token_size(const uint8_t* tok, const uint32_t len) const {
+    if (!is_marker(tok[0])) {
+      return 1U;
+    }
+    if (len < 2U || tok[1] == 0U) {
+      return 2U;
+    }
+    if (tok[0] == m_header[16]) {
+      return 4U;
+    }
+    return tok[0] == m_header[17] ? 3U : 2U;
+  }
+
+  // Decode a complete token. Returns the token size.
+  uint32_t decode_token(const uint8_t* tok) {
+    const auto symbol = tok[0];
+    if (!is_marker(symbol)) {
+      put_literal(symbol);
+      return 1U;
+    }
+
+    const auto b = tok[1];
+    if (b == 0U) {
+      // A literal marker symbol.
+      put_literal(symbol);
+      return 2U;
+    }
+
+    uint32_t length;
+    uint32_t offset;
+    uint32_t token_size;
+    if (symbol == m_header[16]) {
+      // Distant copy.
+      length = decode_length(b);
+      offset = ((static_cast<uint32_t>(b & 0xe0U) << 11) | (static_cast<uint32_t>(tok[2]) << 8) |
+                tok[3]) +
+               2056U;
+      token_size = 4U;
+    } else if (symbol == m_header[17]) {
+      // Medium copy.
+      length = decode_length(b);
+      offset = ((static_cast<uint32_t>(b & 0xe0U) << 3) | tok[2]) + 8U;
+      token_size = 3U;
+    } else if (symbol == m_header[18]) {
+      // Short copy.
+      length = (b >> 6) + 3U;
+      offset = (b & 63U) + 8U;
+      token_size = 2U;
+    } else {
+      // Near copy (including RLE).
+      length = decode_length(b);
+      offset = (b >> 5) + 1U;
+      token_size = 2U;
+    }
+
+    if (offset > static_cast<uint32_t>(m_dst - m_dst_start) ||
+        length > static_cast<uint32_t>(m_dst_end - m_dst)) {
+      m_error = true;
+      return token_size;
+    }
+    const auto* copy_src = m_dst - offset;
+    for (uint32_t i = 0U; i < length; ++i) {
+      m_dst[i] = copy_src[i];
+    }
+    m_dst += length;
+    return token_size;
+  }
+
+  void put_literal(const uint8_t symbol) {
+    if (m_dst == m_dst_end) {
+      m_error = true;
+      return;
+    }
+    *m_dst++ = symbol;
+  }
+
+  uint8_t* m_dst_start;
+  uint8_t* m_dst;
+  uint8_t* m_dst_end;
+  uint32_t m_decoded_size;
+  uint32_t m_encoded_left;
+  uint32_t m_checksum_a;
+  uint32_t m_checksum_b;
+  uint8_t m_header[HEADER_SIZE + 4U];  // Header + markers.
+  uint32_t m_header_len;
+  uint8_t m_tok[4];
+  uint32_t m_tok_len;
+  bool m_error;
+};
+
+}  // namespace
+
+#endif  // ROM_LZG_STREAM_HPP_
@@ -18,7 +18,12 @@
 //  3. This notice may not be removed or altered from any source distribution.
 //--------------------------------------------------------------------------------------------------
 
+#include "bootprof.hpp"
+#include "elf_loader.hpp"
 #include "mosaic.hpp"
+#include "sector_cache.hpp"
+#include "vram_arena.hpp"
+#include "warm_boot.hpp"
 
 #ifdef ENABLE_SPLASH
 #include "splash.hpp"
@@ -27,15 +32,18 @@
 #include "console.hpp"
 #endif
 
-#include <mc1/elf32.h>
 #include <mc1/leds.h>
 #include <mc1/mfat_mc1.h>
 #include <mc1/sdcard.h>
 
 #include <cstdint>
 
-// Defined by the linker script.
-extern char __vram_free_start;
+#ifdef ENABLE_BOOTPROF
+// The boot profile (in BSS, see bootprof.hpp).
+extern "C" {
+boot_prof_t rom_boot_prof;
+}
+#endif
 
 namespace {
 // Name of the boot executable file.
@@ -58,11 +66,21 @@ enum class boot_status_t {
   NO_BOOTEXE,
 };
 
+static_assert(static_cast<int>(boot_state_t::LOAD_MC1BOOT) ==
+                  static_cast<int>(boot_stage_t::LOAD_MC1BOOT),
+              "boot_stage_t does not match boot_state_t");
+
 // Frame sync class.
 class frame_sync_t {
 public:
   frame_sync_t() : m_t(0) {
     m_last_frame_no = MMIO(VIDFRAMENO);
+    m_frame_start = MMIO(CLKCNTLO);
+
+    // Number of CPU cycles per frame (VIDFPS is the refresh rate * 65536).
+    const auto fps_x256 = MMIO(VIDFPS) >> 8;
+    const auto frame_cycles = (MMIO(CPUCLK) / (fps_x256 > 0U ? fps_x256 : 60U * 256U)) << 8;
+    m_work_budget = frame_cycles - frame_cycles / 4U;
   }
 
   void wait_for_next_frame() {
@@ -72,10 +90,23 @@ public:
     do {
       frame_no = MMIO(VIDFRAMENO);
     } while (frame_no == old_frame_no);
+    start_frame(frame_no);
+  }
 
-    // Increment T by the number of frames that has passed since the last time we were called.
-    m_t += frame_no - m_last_frame_no;
-    m_last_frame_no = frame_no;
+  // Check if a new frame has started, without waiting.
+  bool poll() {
+    const auto frame_no = MMIO(VIDFRAMENO);
+    if (frame_no == m_last_frame_no) {
+      return false;
+    }
+    start_frame(frame_no);
+    return true;
+  }
+
+  // Returns true if there is time left for more work in the current frame (we leave a quarter of
+  // the frame as a margin, since a boot step can not be interrupted).
+  bool has_time_left() const {
+    return (MMIO(CLKCNTLO) - m_frame_start) < m_work_budget;
   }
 
   uint32_t t() const {
@@ -83,17 +114,95 @@ public:
   }
 
 private:
+  void start_frame(const uint32_t frame_no) {
+    // Increment T by the number of frames that has passed since the last frame.
+    m_t += frame_no - m_last_frame_no;
+    m_last_frame_no = frame_no;
+    m_frame_start = MMIO(CLKCNTLO);
+  }
+
   uint32_t m_t;
   uint32_t m_last_frame_no;
+  uint32_t m_frame_start;
+  uint32_t m_work_budget;
+};
+
+// The boot animation (the background mosaic and the splash screen).
+class animation_t {
+public:
+  // Parts that do not fit in VRAM are left out.
+  void init(vram_arena_t& arena) {
+    {
+      bootprof_scope_t prof(boot_stage_t::MOSAIC_INIT);
+      m_has_mosaic = m_mosaic.init(arena);
+    }
+#ifdef ENABLE_SPLASH
+    {
+      bootprof_scope_t prof(boot_stage_t::SPLASH_INIT);
+      m_has_splash = m_splash.init(arena);
+    }
+#endif
+    m_active = true;
+  }
+
+  void deinit() {
+#ifdef ENABLE_SPLASH
+    if (m_has_splash) {
+      m_splash.deinit();
+    }
+#endif
+    if (m_has_mosaic) {
+      m_mosaic.deinit();
+    }
+    m_active = false;
+  }
+
+  void update(const uint32_t t) {
+    if (!m_active) {
+      return;
+    }
+    bootprof_scope_t prof(boot_stage_t::FRAME_UPDATE);
+#ifdef ENABLE_SPLASH
+    if (m_has_splash) {
+      m_splash.update(t);
+    }
+#endif
+    if (m_has_mosaic) {
+      m_mosaic.update(t);
+    }
+  }
+
+private:
+  mosaic_t m_mosaic;
+#ifdef ENABLE_SPLASH
+  splash_t m_splash;
+  bool m_has_splash = false;
+#endif
+  bool m_has_mosaic = false;
+  bool m_active = false;
+};
+
+// Context for the SD card block reader. Long running boot steps (e.g. mounting the FAT file
+// system) read many blocks, so the animation is kept alive from the block reader.
+struct loader_ctx_t {
+  sdctx_t sdctx;
+  sector_cache_t cache;
+  frame_sync_t* frame_sync;
+  animation_t* animation;
 };
 
 // Boot function type.
 using boot_fun_t = void();
 
 int read_block_fun(char* ptr, unsigned block_no, void* custom) {
-  auto* ctx = reinterpret_cast<sdctx_t*>(custom);
-  sdcard_read(ctx, ptr, block_no, 1);
-  return 0;
+  auto* ctx = reinterpret_cast<loader_ctx_t*>(custom);
+  const auto success = ctx->cache.read(&ctx->sdctx, ptr, block_no);
+
+  // Update the animation if a new frame has started while we were busy.
+  if (ctx->frame_sync->poll()) {
+    ctx->animation->update(ctx->frame_sync->t());
+  }
+  return success ? 0 : -1;
 }
 
 int write_block_fun(const char*, unsigned, void*) {
@@ -113,28 +222,31 @@ void sdcard_log_fun(const char* msg) {
 
 extern "C" int main(int, char**) {
   sevseg_print("OLLEH ");  // Print a friendly "HELLO".
+  bootprof_init();
 
-  mosaic_t mosaic;
-#ifdef ENABLE_SPLASH
-  splash_t splash;
-#endif
+  vram_arena_t arena;
+  animation_t animation;
 #ifdef ENABLE_CONSOLE
   console_t console;
 #endif
-  sdctx_t sdctx;
   frame_sync_t frame_sync;
+  loader_ctx_t loader_ctx;
+  loader_ctx.frame_sync = &frame_sync;
+  loader_ctx.animation = &animation;
 
   auto status = boot_status_t::NONE;
   auto previous_status = boot_status_t::NONE;
   auto state = boot_state_t::INITIALIZE;
+  bool warm_start = false;
   while (true) {
     // Update splash screen.
     if (state != boot_state_t::INITIALIZE) {
       frame_sync.wait_for_next_frame();
-#ifdef ENABLE_SPLASH
-      splash.update(frame_sync.t());
+      arena.release_scratch();
+      animation.update(frame_sync.t());
+#ifdef ENABLE_CONSOLE
+      console_t::flush();
 #endif
-      mosaic.update(frame_sync.t());
 
       if (status != previous_status) {
 #ifdef ENABLE_CONSOLE
@@ -161,95 +273,145 @@ extern "C" int main(int, char**) {
       }
     }
 
-    // Boot state machine.
-    switch (state) {
-      //--------------------------------------------------------------------------------------------
-      // INITIALIZE
-      //--------------------------------------------------------------------------------------------
-      default:
-      case boot_state_t::INITIALIZE: {
-        auto* mem = reinterpret_cast<void*>(&__vram_free_start);
-        mem = mosaic.init(mem);
-#ifdef ENABLE_SPLASH
-        mem = splash.init(mem);
-#endif
+    // Boot state machine: Run as many boot steps as we can during this frame, until a step fails
+    // (e.g. there is no SD card) or the work budget for the frame has been used.
+    bool progress;
+    do {
+      bootprof_scope_t prof(static_cast<boot_stage_t>(state));
+      progress = true;
+      switch (state) {
+        //------------------------------------------------------------------------------------------
+        // INITIALIZE
+        //------------------------------------------------------------------------------------------
+        default:
+        case boot_state_t::INITIALIZE: {
+          arena.init();
+          warm_start = warm_boot_t::take(&loader_ctx.sdctx, sdcard_log_fun);
+          if (warm_start) {
+            // Warm restart: The SD card is already initialized, so skip the boot animation (the
+            // video stays blank) and go straight to loading the boot executable.
+            (void)loader_ctx.cache.init(arena);
+            state = boot_state_t::MOUNT_FAT;
+          } else {
+            // Note: The console is allocated first, so that it can report if the other parts do
+            // not fit in VRAM (see console_t::run_diagnostics()).
 #ifdef ENABLE_CONSOLE
-        console.init(mem);
+            (void)console.init(arena);
 #endif
-        state = boot_state_t::RUN_DIAGNOSTICS;
-      } break;
+            animation.init(arena);
+            (void)loader_ctx.cache.init(arena);
+            state = boot_state_t::RUN_DIAGNOSTICS;
+          }
+        } break;
 
-      //--------------------------------------------------------------------------------------------
-      // RUN_DIAGNOSTICS
-      //--------------------------------------------------------------------------------------------
-      case boot_state_t::RUN_DIAGNOSTICS: {
+        //------------------------------------------------------------------------------------------
+        // RUN_DIAGNOSTICS
+        //------------------------------------------------------------------------------------------
+        case boot_state_t::RUN_DIAGNOSTICS: {
 #ifdef ENABLE_CONSOLE
-        if (!console.diags_have_been_run()) {
-          console.run_diagnostics();
-        }
+          if (!console.diags_have_been_run()) {
+            console.run_diagnostics();
+          }
 #endif
-        state = boot_state_t::WAIT_FOR_SDCARD;
-      } break;
-
-      //--------------------------------------------------------------------------------------------
-      // WAIT_FOR_SDCARD
-      //--------------------------------------------------------------------------------------------
-      case boot_state_t::WAIT_FOR_SDCARD: {
-        if (sdcard_init(&sdctx, sdcard_log_fun)) {
-          state = boot_state_t::MOUNT_FAT;
-        } else {
-          status = boot_status_t::NO_SDCARD;
-        }
-      } break;
-
-      //--------------------------------------------------------------------------------------------
-      // MOUNT_FAT
-      //--------------------------------------------------------------------------------------------
-      case boot_state_t::MOUNT_FAT: {
-        if (mfat_mount(&read_block_fun, &write_block_fun, &sdctx) == 0) {
-          state = boot_state_t::LOAD_MC1BOOT;
-        } else {
-          // Retry the SD card step until we find a valid FAT formatted SD card.
-          status = boot_status_t::NO_FAT;
           state = boot_state_t::WAIT_FOR_SDCARD;
-        }
-      } break;
-
-      //--------------------------------------------------------------------------------------------
-      // LOAD_MC1BOOT
-      //--------------------------------------------------------------------------------------------
-      case boot_state_t::LOAD_MC1BOOT: {
-        // Stat the boot exe file to see if it exists.
-        mfat_stat_t stat;
-        if (mfat_stat(BOOT_EXE, &stat) == 0) {
-          // Deinitialize video (blank it while loading the boot executable).
+        } break;
+
+        //------------------------------------------------------------------------------------------
+        // WAIT_FOR_SDCARD
+        //------------------------------------------------------------------------------------------
+        case boot_state_t::WAIT_FOR_SDCARD: {
+          if (sdcard_init(&loader_ctx.sdctx, sdcard_log_fun)) {
+            loader_ctx.cache.invalidate();
+            state = boot_state_t::MOUNT_FAT;
+          } else {
+            status = boot_status_t::NO_SDCARD;
+            progress = false;
+          }
+        } break;
+
+        //------------------------------------------------------------------------------------------
+        // MOUNT_FAT
+        //------------------------------------------------------------------------------------------
+        case boot_state_t::MOUNT_FAT: {
+          if (mfat_mount(&read_block_fun, &write_block_fun, &loader_ctx) == 0) {
+            state = boot_state_t::LOAD_MC1BOOT;
+          } else {
+            // Retry the SD card step until we find a valid FAT formatted SD card (a failed warm
+            // restart falls back to a cold start).
+            status = boot_status_t::NO_FAT;
+            state = warm_start ? boot_state_t::INITIALIZE : boot_state_t::WAIT_FOR_SDCARD;
+            progress = false;
+          }
+        } break;
+
+        //------------------------------------------------------------------------------------------
+        // LOAD_MC1BOOT
+        //------------------------------------------------------------------------------------------
+        case boot_state_t::LOAD_MC1BOOT: {
+          // Stat the boot exe file to see if it exists.
+          mfat_stat_t stat;
+          if (mfat_stat(BOOT_EXE, &stat) == 0) {
+            // Deinitialize video (blank it while loading the boot executable). The boot profile is
+            // only printed once, when all the stages up to here have been recorded.
 #ifdef ENABLE_CONSOLE
-          console.deinit();
+#ifdef ENABLE_BOOTPROF
+            console_t::print_boot_profile();
+            console_t::print_cache_stats(loader_ctx.cache.stats());
 #endif
-#ifdef ENABLE_SPLASH
-          splash.deinit();
+            console.deinit();
 #endif
-          mosaic.deinit();
-
-          // Try to load the boot executable.
-          uint32_t entry_address = 0;
-          if (elf32_load(BOOT_EXE, &entry_address)) {
-            // Call the boot function.
-            auto* boot_fun = reinterpret_cast<boot_fun_t*>(entry_address);
-            boot_fun();
-          }
+            animation.deinit();
 
-          // If we got this far we either could not load the EXE file, or the EXE file has finished
-          // executing and returned. In either case we can not trust the contents of RAM (e.g. the
-          // stack), so we need to soft reset.
-          __asm__ volatile("\tj\tz, #0x00000200");
-        }
+            // Try to load the boot executable.
+            uint32_t entry_address = 0;
+            bool loaded = false;
+            bool keep_handoff = false;
+            {
+              bootprof_scope_t prof_load(boot_stage_t::ELF32_LOAD);
+              elf_loader_t loader;
+              if (loader.open(BOOT_EXE)) {
+                // Keep the read-ahead cache unless the executable is loaded over the cache memory.
+                if (loader.overlaps(loader_ctx.cache.memory_begin(),
+                                    loader_ctx.cache.memory_end())) {
+                  loader_ctx.cache.disable();
+                }
+                keep_handoff =
+                    !loader.overlaps(warm_boot_t::memory_begin(), warm_boot_t::memory_end());
+                loaded = loader.load(&entry_address);
+              }
+            }
+            if (loaded) {
+              // Let the ROM do a warm restart when the boot executable returns (unless the
+              // executable is loaded over the handoff block).
+              if (keep_handoff) {
+                warm_boot_t::save(&loader_ctx.sdctx);
+              }
 
-        // Retry the SD card step until we find a bootable SD card.
-        status = boot_status_t::NO_BOOTEXE;
-        state = boot_state_t::WAIT_FOR_SDCARD;
-      } break;
-    }
+              // Call the boot function (record the load stage first, since the boot function does
+              // not return to this scope).
+              prof.stop();
+              auto* boot_fun = reinterpret_cast<boot_fun_t*>(entry_address);
+              boot_fun();
+            }
+
+            // If we got this far we either could not load the EXE file, or the EXE file has
+            // finished executing and returned. In either case we can not trust the contents of RAM
+            // (e.g. the stack), so we need to soft reset.
+#ifdef __MRISC32__
+            __asm__ volatile("\tj\tz, #0x00000200");
+#else
+            mc1_host_soft_reset();
+#endif
+          }
+
+          // Retry the SD card step until we find a bootable SD card (a failed warm restart falls
+          // back to a cold start).
+          status = boot_status_t::NO_BOOTEXE;
+          state = warm_start ? boot_state_t::INITIALIZE : boot_state_t::WAIT_FOR_SDCARD;
+          progress = false;
+        } break;
+      }
+    } while (progress && frame_sync.has_time_left());
   }
 
   return 0;
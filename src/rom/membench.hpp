@@ -0,0 +1,206 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_MEMBENCH_HPP_
+#define ROM_MEMBENCH_HPP_
+
+#include <mc1/mmio.h>
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __MRISC32_VECTOR_OPS__
+// Vector kernels (implemented in membench.s and zero_fill.s).
+extern "C" void membench_vread(const uint32_t* src, uint32_t count);
+extern "C" void membench_vcopy(uint32_t* dst, const uint32_t* src, uint32_t count);
+extern "C" void zero_fill_words(uint32_t* dst, uint32_t count);
+#endif
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Memory bandwidth and latency benchmark.
+//
+// All the tests run on a caller provided buffer (e.g. in VRAM or XRAM), and are timed with the
+// CLKCNTLO cycle counter. Bandwidths are given in MB/s (10^6 bytes per second), and latencies in
+// CPU cycles per access (including the loop overhead of a couple of instructions).
+//
+// The latency tests chase a chain of indices through the buffer (every load depends on the
+// previous load): sequential (consecutive words), strided (one word per 64 bytes) and random.
+class membench_t {
+public:
+  struct result_t {
+    uint32_t read;  // Scalar loads.
+    uint32_t write;
+    uint32_t copy;
+    uint32_t vread;  // Vector loads (same as the scalar results if there are no vector ops).
+    uint32_t vwrite;
+    uint32_t vcopy;
+    uint32_t seq_latency_x100;  // Cycles per access, times 100.
+    uint32_t stride_latency_x100;
+    uint32_t random_latency_x100;
+  };
+
+  // Run all the tests. size is the buffer size in bytes (a power of two, at least 4 KB).
+  static result_t run(uint32_t* buf, const uint32_t size) {
+    const auto count = size / 4U;
+    auto* half = &buf[count / 2U];
+    result_t r;
+
+    // Bandwidth.
+    auto t = start();
+    for (uint32_t k = 0U; k < PASSES; ++k) {
+      read_words(buf, count);
+    }
+    r.read = mbps(PASSES * size, t);
+
+    t = start();
+    for (uint32_t k = 0U; k < PASSES; ++k) {
+      write_words(buf, count);
+    }
+    r.write = mbps(PASSES * size, t);
+
+    t = start();
+    for (uint32_t k = 0U; k < PASSES; ++k) {
+      copy_words(half, buf, count / 2U);
+    }
+    r.copy = mbps(PASSES * size / 2U, t);
+
+#ifdef __MRISC32_VECTOR_OPS__
+    t = start();
+    for (uint32_t k = 0U; k < PASSES; ++k) {
+      membench_vread(buf, count);
+    }
+    r.vread = mbps(PASSES * size, t);
+
+    t = start();
+    for (uint32_t k = 0U; k < PASSES; ++k) {
+      zero_fill_words(buf, count);
+    }
+    r.vwrite = mbps(PASSES * size, t);
+
+    t = start();
+    for (uint32_t k = 0U; k < PASSES; ++k) {
+      membench_vcopy(half, buf, count / 2U);
+    }
+    r.vcopy = mbps(PASSES * size / 2U, t);
+#else
+    r.vread = r.read;
+    r.vwrite = r.write;
+    r.vcopy = r.copy;
+#endif
+
+    // Latency.
+    make_chain(buf, count, 1U);
+    r.seq_latency_x100 = chase(buf);
+    make_chain(buf, count, 16U);
+    r.stride_latency_x100 = chase(buf);
+    make_random_chain(buf, count);
+    r.random_latency_x100 = chase(buf);
+
+    return r;
+  }
+
+private:
+  static const uint32_t PASSES = 4U;
+  static const uint32_t CHASE_ACCESSES = 4096U;
+
+  static uint32_t start() {
+    return MMIO(CLKCNTLO);
+  }
+
+  static uint32_t mbps(const uint32_t bytes, const uint32_t start_cycles) {
+    const auto cycles = MMIO(CLKCNTLO) - start_cycles;
+    const auto seconds = static_cast<float>(cycles) / static_cast<float>(MMIO(CPUCLK));
+    return static_cast<uint32_t>(static_cast<float>(bytes) * 0.000001F / seconds);
+  }
+
+  static void read_words(const uint32_t* src, const uint32_t count) {
+    // Unroll four times, and keep the sum so that the loads are not optimized away.
+    uint32_t sum = 0U;
+    for (uint32_t i = 0U; i < count; i += 4U) {
+      sum += src[i] + src[i + 1U] + src[i + 2U] + src[i + 3U];
+    }
+    s_sink = sum;
+  }
+
+  static void write_words(uint32_t* dst, const uint32_t count) {
+    for (uint32_t i = 0U; i < count; i += 4U) {
+      dst[i] = i;
+      dst[i + 1U] = i;
+      dst[i + 2U] = i;
+      dst[i + 3U] = i;
+    }
+  }
+
+  static void copy_words(uint32_t* dst, const uint32_t* src, const uint32_t count) {
+    for (uint32_t i = 0U; i < count; i += 4U) {
+      const auto a = src[i];
+      const auto b = src[i + 1U];
+      const auto c = src[i + 2U];
+      const auto d = src[i + 3U];
+      dst[i] = a;
+      dst[i + 1U] = b;
+      dst[i + 2U] = c;
+      dst[i + 3U] = d;
+    }
+  }
+
+  // Make a chain of word indices through the buffer (each element holds the index of the next).
+  static void make_chain(uint32_t* buf, const uint32_t count, const uint32_t stride) {
+    for (uint32_t i = 0U; i < count; ++i) {
+      buf[i] = (i + stride) & (count - 1U);
+    }
+  }
+
+  // Make a single random cycle through all the words (Sattolo's algorithm).
+  static void make_random_chain(uint32_t* buf, const uint32_t count) {
+    for (uint32_t i = 0U; i < count; ++i) {
+      buf[i] = i;
+    }
+    uint32_t seed = 12345U;
+    for (uint32_t i = count - 1U; i > 0U; --i) {
+      seed = seed * 1103515245U + 12345U;
+      const auto j = (seed >> 8) % i;
+      const auto tmp = buf[i];
+      buf[i] = buf[j];
+      buf[j] = tmp;
+    }
+  }
+
+  static uint32_t chase(const uint32_t* buf) {
+    const auto t = start();
+    uint32_t idx = 0U;
+    for (uint32_t k = 0U; k < CHASE_ACCESSES; ++k) {
+      idx = buf[idx];
+    }
+    const auto cycles = MMIO(CLKCNTLO) - t;
+    s_sink = idx;
+    return (cycles * 100U) / CHASE_ACCESSES;
+  }
+
+  static volatile uint32_t s_sink;
+};
+
+volatile uint32_t membench_t::s_sink;
+
+}  // namespace
+
+#endif  // ROM_MEMBENCH_HPP_
@@ -0,0 +1,45 @@
+; -*- mode: mr32asm; tab-width: 4; indent-tabs-mode: nil; -*-
+; ----------------------------------------------------------------------------
+; Vector kernels for the memory benchmark (see membench.hpp).
+;
+; void membench_vread(const uint32_t* src, uint32_t count);
+; void membench_vcopy(uint32_t* dst, const uint32_t* src, uint32_t count);
+;
+; count is the number of words, and must be greater than zero. (The vector
+; write benchmark uses zero_fill_words() in zero_fill.s).
+; ----------------------------------------------------------------------------
+
+    .text
+
+    .globl  membench_vread
+    .p2align 2
+
+; r1 = src, r2 = count
+membench_vread:
+    getsr   vl, #0x10           ; vl = Max vector length
+1$:
+    minu    vl, vl, r2
+    sub     r2, r2, vl
+    ldw     v1, [r1, #4]
+    ldea    r1, [r1, vl*4]
+    bnz     r2, 1$
+
+    ret
+
+
+    .globl  membench_vcopy
+    .p2align 2
+
+; r1 = dst, r2 = src, r3 = count
+membench_vcopy:
+    getsr   vl, #0x10           ; vl = Max vector length
+1$:
+    minu    vl, vl, r3
+    sub     r3, r3, vl
+    ldw     v1, [r2, #4]
+    stw     v1, [r1, #4]
+    ldea    r2, [r2, vl*4]
+    ldea    r1, [r1, vl*4]
+    bnz     r3, 1$
+
+    ret
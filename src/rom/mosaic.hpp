@@ -21,6 +21,9 @@
 #ifndef ROM_MOSAIC_HPP_
 #define ROM_MOSAIC_HPP_
 
+#include "vcp_builder.hpp"
+#include "vram_arena.hpp"
+
 #include <mc1/mmio.h>
 #include <mc1/vcp.h>
 
@@ -28,72 +31,161 @@
 
 #include <cstdint>
 
+#if !defined(ENABLE_MOSAIC_GRADIENT) && defined(__MRISC32_VECTOR_OPS__) && \
+    defined(__MRISC32_PACKED_OPS__)
+// Vectorized row fill (implemented in mosaic_fill.s).
+extern "C" void mosaic_fill_row(uint32_t* dst,
+                                uint32_t c1,
+                                uint32_t c2,
+                                const uint32_t* weights,
+                                uint32_t count);
+#endif
+
 // Note: Using an anonymous namespace saves a few bytes of code size.
 namespace {
 
 // Mosaic background class.
+//
+// The mosaic is a bilinear blend of four animated corner colors, divided into MOSAIC_W x MOSAIC_H
+// tiles. There are three ways to draw it:
+//
+//  * With ENABLE_MOSAIC_GRADIENT (the Makefile default) the gradient color mode of the video
+//    hardware interpolates between GCOL0 and GCOL1 along each line without reading any memory. The
+//    VCP (double buffered) sets the left and right colors of every tile row, and that is all that
+//    is recalculated every frame. This takes precedence over ENABLE_MOSAIC_PAL8.
+//  * With ENABLE_MOSAIC_PAL8 the tiles are static PAL8 indices instead, where groups of tiles
+//    share one of 256 palette entries, and only the palette (in a double buffered VCP) is
+//    recalculated every frame.
+//  * Without ENABLE_MOSAIC_GRADIENT and ENABLE_MOSAIC_PAL8 every tile is an RGBA8888 pixel that is
+//    recalculated every frame (one row at a time, with the vector kernel in mosaic_fill.s).
 class mosaic_t {
 public:
-  void* init(void* mem) {
-    // "Allocate" memory.
-    auto* pixels = reinterpret_cast<uint32_t*>(mem);
-    auto* vcp_start = &pixels[MOSAIC_W * MOSAIC_H];
-
+  // Allocate memory and show the mosaic. Returns false if it does not fit in VRAM.
+  bool init(vram_arena_t& arena) {
     // Get the HW resolution.
-    const auto native_width = MMIO(VIDWIDTH);
-    const auto native_height = MMIO(VIDHEIGHT);
-
-    // VCP prologue.
-    auto* vcp = vcp_start;
-    *vcp++ = vcp_emit_setreg(VCR_XINCR, (0x010000 * MOSAIC_W) / native_width);
-    *vcp++ = vcp_emit_setreg(VCR_CMODE, CMODE_RGBA8888);
-
-    // Address pointers.
-    uint32_t vcp_pixels_addr = to_vcp_addr(reinterpret_cast<uintptr_t>(pixels));
-    *vcp++ = vcp_emit_waity(0);
-    *vcp++ = vcp_emit_setreg(VCR_HSTOP, native_width);
-    *vcp++ = vcp_emit_setreg(VCR_ADDR, vcp_pixels_addr);
-    for (int k = 1; k < MOSAIC_H; ++k) {
-      auto y = (static_cast<uint32_t>(k) * native_height) / static_cast<uint32_t>(MOSAIC_H);
-      vcp_pixels_addr += MOSAIC_W;
-      *vcp++ = vcp_emit_waity(y);
-      *vcp++ = vcp_emit_setreg(VCR_ADDR, vcp_pixels_addr);
-    }
+    m_native_width = MMIO(VIDWIDTH);
+    m_native_height = MMIO(VIDHEIGHT);
 
-    // VCP epilogue: Wait forever.
-    *vcp++ = vcp_emit_waity(32767);
+#ifdef ENABLE_MOSAIC_GRADIENT
+    auto* mem = arena.alloc<uint32_t>(2U * VCP_SIZE);
+    if (mem == nullptr) {
+      return false;
+    }
+    (void)m_vcp.init(mem, VCP_SIZE, true);
 
-    // Set up the VCP address.
-    vcp_set_prg(LAYER_1, vcp_start);
+    for (uint32_t buf = 0U; buf < m_vcp.num_buffers(); ++buf) {
+      auto vcp = m_vcp.build(buf);
+      build(vcp, 0U);
+    }
+#else
+    // The tiles, the interpolation weights and the VCP(s) are allocated as a single block.
+    const uint32_t num_vcp_words = (DOUBLE_BUFFERED ? 2U : 1U) * VCP_SIZE;
+    auto* pixels = arena.alloc<uint32_t>(PIXELS_WORDS + 2U * NUM_COLS + num_vcp_words);
+    if (pixels == nullptr) {
+      return false;
+    }
+    auto* weights = &pixels[PIXELS_WORDS];
+    (void)m_vcp.init(&weights[2 * NUM_COLS], VCP_SIZE, DOUBLE_BUFFERED);
 
+    // Precompute the horizontal interpolation weights (byte splatted): First the weights for the
+    // left color, then the weights for the right color.
+    for (int x = 0; x < NUM_COLS; ++x) {
+      const uint32_t wx = (static_cast<uint32_t>(x) << 8) / NUM_COLS;
+      weights[x] = (255U - wx) * 0x01010101U;
+      weights[NUM_COLS + x] = wx * 0x01010101U;
+    }
     m_pixels = pixels;
+    m_weights = weights;
+
+#ifdef ENABLE_MOSAIC_PAL8
+    // Static palette indices: Map each tile to the palette entry for its group of tiles.
+    auto* indices = reinterpret_cast<uint8_t*>(pixels);
+    for (int y = 0; y < MOSAIC_H; ++y) {
+      const auto row_idx = ((y * NUM_ROWS) / MOSAIC_H) * NUM_COLS;
+      for (int x = 0; x < MOSAIC_W; ++x) {
+        *indices++ = static_cast<uint8_t>(row_idx + (x * NUM_COLS) / MOSAIC_W);
+      }
+    }
+#endif
+
+    for (uint32_t buf = 0U; buf < m_vcp.num_buffers(); ++buf) {
+      // VCP prologue.
+      auto vcp = m_vcp.build(buf);
+      vcp.setreg(VCR_XINCR, (0x010000 * MOSAIC_W) / m_native_width);
+#ifdef ENABLE_MOSAIC_PAL8
+      vcp.setreg(VCR_CMODE, CMODE_PAL8);
+      auto* palette = vcp.setpal(0, NUM_COLS * NUM_ROWS);  // Filled in by fill().
+#else
+      vcp.setreg(VCR_CMODE, CMODE_RGBA8888);
+#endif
 
-    return reinterpret_cast<void*>(vcp);
+      // Address pointers: The hardware steps to the next tile row every native_height / MOSAIC_H
+      // lines (YSTEP is rounded up so that the rows do not drift towards the bottom).
+      const auto ystep = ((static_cast<uint32_t>(MOSAIC_H) << 16) + m_native_height - 1U) /
+                         m_native_height;
+      vcp.waity(0);
+      vcp.setreg(VCR_HSTOP, m_native_width);
+      vcp.setreg(VCR_ADDR, to_vcp_addr(reinterpret_cast<uintptr_t>(pixels)));
+      vcp.setreg(VCR_YINCR, ROW_WORDS);
+      vcp.setreg(VCR_YSTEP, ystep);
+
+      // VCP epilogue: Wait forever.
+      vcp.end();
+
+#ifdef ENABLE_MOSAIC_PAL8
+      // Make sure that the first frame has a valid palette.
+      if (palette != nullptr) {
+        fill(palette, 0U);
+      }
+#endif
+    }
+#ifndef ENABLE_MOSAIC_PAL8
+    fill(m_pixels, 0U);
+#endif
+#endif
+
+    // Set up the VCP address.
+    m_vcp.show(LAYER_1);
+
+    return true;
   }
 
   void deinit() {
-    vcp_set_prg(LAYER_1, nullptr);
+    vcp_program_t::hide(LAYER_1);
   }
 
   void update(const uint32_t t) {
-    // Define the four corner colors.
-    abgr32_t p11 = make_color(t);
-    abgr32_t p12 = make_color(t + 3433U);
-    abgr32_t p21 = make_color(1150U - t);
-    abgr32_t p22 = make_color(t + 13150U);
+#if defined(ENABLE_MOSAIC_GRADIENT)
+    // Regenerate the back buffer VCP and make it the front buffer.
+    auto vcp = m_vcp.back();
+    build(vcp, t);
+    m_vcp.swap();
+#elif defined(ENABLE_MOSAIC_PAL8)
+    // Recalculate the palette of the back buffer VCP and make it the front buffer.
+    auto vcp = m_vcp.back();
+    vcp.skip(2U);
+    auto* palette = vcp.setpal(0, NUM_COLS * NUM_ROWS);
+    if (palette != nullptr) {
+      fill(palette, t);
+    }
+    m_vcp.swap();
+#else
+    fill(m_pixels, t);
+#endif
+  }
 
-    // Interpolate all the "pixels" (tiles) in the mosaic.
-    uint32_t* pixels = m_pixels;
-    for (int y = 0; y < MOSAIC_H; ++y) {
-      uint32_t wy = (y << 8) / MOSAIC_H;
-      abgr32_t p1 = lerp(p11, p21, wy);
-      abgr32_t p2 = lerp(p12, p22, wy);
-      for (int x = 0; x < MOSAIC_W; ++x) {
-        uint32_t wx = (x << 8) / MOSAIC_W;
-        *pixels++ = lerp(p1, p2, wx);
-      }
+#ifndef ENABLE_MOSAIC_GRADIENT
+  // Scalar reference implementation of mosaic_fill_row() (bit exact for byte splatted weights).
+  static void fill_row_ref(uint32_t* dst,
+                           const uint32_t c1,
+                           const uint32_t c2,
+                           const uint32_t* weights,
+                           const uint32_t count) {
+    for (uint32_t x = 0U; x < count; ++x) {
+      dst[x] = mulhiu_b(weights[x], c1) + mulhiu_b(weights[count + x], c2);
     }
   }
+#endif
 
 private:
   // Color type.
@@ -102,6 +194,48 @@ private:
   static const int MOSAIC_W = 64;
   static const int MOSAIC_H = (MOSAIC_W * 9) / 16;
 
+#if defined(ENABLE_MOSAIC_GRADIENT)
+  // The gradient weight is the tile column shifted left by GSHIFT bits, i.e. the weight of the
+  // right color is (col << 8) / MOSAIC_W.
+  static const uint32_t GSHIFT = 2U;
+  static_assert((MOSAIC_W << GSHIFT) == 256, "MOSAIC_W does not match GSHIFT");
+
+  // Prologue (XINCR, CMODE, HSTOP), three words per tile row and the terminating WAITY.
+  static const uint32_t VCP_SIZE = 3U + 3U * MOSAIC_H + 1U;
+#elif defined(ENABLE_MOSAIC_PAL8)
+  // NUM_COLS x NUM_ROWS colors (one palette entry per color), and one byte per tile.
+  static const int NUM_COLS = 16;
+  static const int NUM_ROWS = 16;
+  static const uint32_t ROW_WORDS = MOSAIC_W / 4;
+  static const uint32_t VCP_SIZE = 9U + NUM_COLS * NUM_ROWS;
+  static const bool DOUBLE_BUFFERED = true;
+  static_assert(NUM_COLS * NUM_ROWS <= 256, "Too many palette colors");
+#else
+  // One color per tile.
+  static const int NUM_COLS = MOSAIC_W;
+  static const int NUM_ROWS = MOSAIC_H;
+  static const uint32_t ROW_WORDS = MOSAIC_W;
+  static const uint32_t VCP_SIZE = 8U;
+  static const bool DOUBLE_BUFFERED = false;
+#endif
+#ifndef ENABLE_MOSAIC_GRADIENT
+  static const uint32_t PIXELS_WORDS = ROW_WORDS * MOSAIC_H;
+#endif
+
+  // Packed unsigned byte multiply, high part (i.e. (w * c) >> 8 for each byte), where w is a byte
+  // splatted weight (0xwwwwwwww).
+  static uint32_t mulhiu_b(const uint32_t w, const uint32_t c) {
+#ifdef __MRISC32_PACKED_OPS__
+    return _mr32_mulhiu_b(w, c);
+#else
+    // Note: The 8x8-bit products fit in 16 bits, so two bytes can be multiplied at a time.
+    const auto w8 = w & 255U;
+    const auto even = ((w8 * (c & 0x00ff00ffU)) >> 8) & 0x00ff00ffU;
+    const auto odd = (w8 * ((c >> 8) & 0x00ff00ffU)) & 0xff00ff00U;
+    return even | odd;
+#endif
+  }
+
   static abgr32_t lerp(const abgr32_t c1, const abgr32_t c2, uint32_t w2) {
     uint32_t w1 = 255U - w2;
 #ifdef __MRISC32_PACKED_OPS__
@@ -109,11 +243,62 @@ private:
     uint8x4_t w2p = _mr32_shuf(w2, _MR32_SHUFCTL(0, 0, 0, 0, 0));
     return _mr32_mulhiu_b(w1p, c1) + _mr32_mulhiu_b(w2p, c2);
 #else
-    uint32_t br = ((w1 * (c1 & 0xff00ffU) + w2 * (c2 & 0xff00ffU)) >> 8) & 0xff00ffU;
-    uint32_t g = ((w1 * (c1 & 0x00ff00U) + w2 * (c2 & 0x00ff00U)) >> 8) & 0x00ff00U;
-    return br | g;
+    return mulhiu_b(w1 * 0x01010101U, c1) + mulhiu_b(w2 * 0x01010101U, c2);
+#endif
+  }
+
+#ifdef ENABLE_MOSAIC_GRADIENT
+  // Generate the VCP for time t.
+  void build(vcp_builder_t& vcp, const uint32_t t) {
+    // Define the four corner colors.
+    abgr32_t p11 = make_color(t);
+    abgr32_t p12 = make_color(t + 3433U);
+    abgr32_t p21 = make_color(1150U - t);
+    abgr32_t p22 = make_color(t + 13150U);
+
+    // VCP prologue: MOSAIC_W gradient segments per line.
+    vcp.setreg(VCR_XINCR, (0x010000 * MOSAIC_W) / m_native_width);
+    vcp.setreg(VCR_CMODE, CMODE_GRADIENT | CMODE_GSHIFT(GSHIFT));
+
+    // Interpolate the left and right colors vertically, one tile row at a time.
+    for (int y = 0; y < MOSAIC_H; ++y) {
+      const auto first_line =
+          (static_cast<uint32_t>(y) * m_native_height + MOSAIC_H - 1U) / MOSAIC_H;
+      vcp.waity(static_cast<int>(first_line));
+      if (y == 0) {
+        vcp.setreg(VCR_HSTOP, m_native_width);
+      }
+      uint32_t wy = (y << 8) / MOSAIC_H;
+      vcp.setreg(VCR_GCOL0, lerp(p11, p21, wy));
+      vcp.setreg(VCR_GCOL1, lerp(p12, p22, wy));
+    }
+
+    // VCP epilogue: Wait forever.
+    vcp.end();
+  }
+#else
+  // Calculate the NUM_COLS x NUM_ROWS colors for time t.
+  void fill(uint32_t* colors, const uint32_t t) {
+    // Define the four corner colors.
+    abgr32_t p11 = make_color(t);
+    abgr32_t p12 = make_color(t + 3433U);
+    abgr32_t p21 = make_color(1150U - t);
+    abgr32_t p22 = make_color(t + 13150U);
+
+    // Interpolate all the colors, one row at a time.
+    for (int y = 0; y < NUM_ROWS; ++y) {
+      uint32_t wy = (y << 8) / NUM_ROWS;
+      abgr32_t p1 = lerp(p11, p21, wy);
+      abgr32_t p2 = lerp(p12, p22, wy);
+#if defined(__MRISC32_VECTOR_OPS__) && defined(__MRISC32_PACKED_OPS__)
+      mosaic_fill_row(colors, p1, p2, m_weights, NUM_COLS);
+#else
+      fill_row_ref(colors, p1, p2, m_weights, NUM_COLS);
 #endif
+      colors += NUM_COLS;
+    }
   }
+#endif
 
   static uint32_t tri_wave(uint32_t t) {
     uint32_t t_mod = t & 511U;
@@ -130,7 +315,13 @@ private:
     return r | (g << 8) | (b << 16);
   }
 
+  uint32_t m_native_width;
+  uint32_t m_native_height;
+#ifndef ENABLE_MOSAIC_GRADIENT
   uint32_t* m_pixels;
+  uint32_t* m_weights;
+#endif
+  vcp_program_t m_vcp;
 };
 
 }  // namespace
@@ -0,0 +1,44 @@
+; -*- mode: mr32asm; tab-width: 4; indent-tabs-mode: nil; -*-
+; ----------------------------------------------------------------------------
+; Vectorized mosaic row fill (see mosaic_t in mosaic.hpp).
+;
+; void mosaic_fill_row(uint32_t* dst,
+;                      uint32_t c1,
+;                      uint32_t c2,
+;                      const uint32_t* weights,
+;                      uint32_t count);
+;
+; For x = 0 .. count-1:
+;   dst[x] = mulhiu.b(weights[x], c1) + mulhiu.b(weights[count + x], c2)
+;
+; The weights are byte splatted (i.e. 0xwwwwwwww), so each color channel is
+; interpolated with the same weight. count must be greater than zero.
+;
+; r1 = dst, r2 = c1, r3 = c2, r4 = weights, r5 = count
+; ----------------------------------------------------------------------------
+
+    .text
+
+    .globl  mosaic_fill_row
+    .p2align 2
+
+mosaic_fill_row:
+    ldea    r6, [r4, r5*4]      ; r6 = Weights for c2
+    getsr   vl, #0x10           ; vl = Max vector length
+1$:
+    minu    vl, vl, r5
+    sub     r5, r5, vl
+
+    ldw     v1, [r4, #4]
+    ldw     v2, [r6, #4]
+    mulhiu.b v1, v1, r2
+    mulhiu.b v2, v2, r3
+    add     v1, v1, v2
+    stw     v1, [r1, #4]
+
+    ldea    r4, [r4, vl*4]
+    ldea    r6, [r6, vl*4]
+    ldea    r1, [r1, vl*4]
+    bnz     r5, 1$
+
+    ret
@@ -0,0 +1,195 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_SD_SPI_HPP_
+#define ROM_SD_SPI_HPP_
+
+#include <mc1/mmio.h>
+#include <mc1/sdcard.h>
+
+#include <cstdint>
+#include <cstring>
+
+// SD card block reads with the SPI master (see rtl/spi_master.vhd).
+//
+// libmc1 initializes the card by bit banging SDOUT/SDWE, which is slow but only happens once. Block
+// reads, which is where the boot time goes, use the SPI master instead: Commands are pushed to the
+// TX FIFO, and the data is received in word mode with a single receive count per block, so the CPU
+// only has to drain the RX FIFO. If the SPI master is not present, or if a read fails, the blocks
+// are read with sdcard_read().
+
+// The SPI registers (for libmc1 versions that predate the SPI master).
+#ifndef SPICTL
+#define SPICTL 228
+#define SPIDIV 232
+#define SPITX 236
+#define SPIRX 240
+#define SPISTAT 244
+#define SPIRDCNT 248
+#define SPICTL_ENABLE 1
+#define SPICTL_CS 2
+#define SPICTL_WORD 4
+#define SPISTAT_TXFULL 2
+#define SPISTAT_RXEMPTY 4
+#define SPISTAT_RXLEVEL_SHIFT 8
+#define SPISTAT_PRESENT 0x80000000U
+#endif
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+const uint32_t SD_SPI_MAX_HZ = 25000000U;
+const uint32_t SD_SPI_BLOCK_SIZE = 512U;
+
+// Max number of bytes to wait for a response or a data token (more than 100 ms at 25 MHz).
+const uint32_t SD_SPI_TIMEOUT = 400000U;
+
+const uint32_t SD_CMD_STOP_TRANSMISSION = 12U;
+const uint32_t SD_CMD_READ_SINGLE_BLOCK = 17U;
+const uint32_t SD_CMD_READ_MULTIPLE_BLOCK = 18U;
+const uint32_t SD_DATA_TOKEN = 0xfeU;
+
+inline void sd_spi_send(const uint32_t byte) {
+  while ((MMIO(SPISTAT) & SPISTAT_TXFULL) != 0U) {
+  }
+  MMIO(SPITX) = byte;
+}
+
+inline uint32_t sd_spi_receive() {
+  MMIO(SPIRDCNT) = 1U;
+  while ((MMIO(SPISTAT) & SPISTAT_RXEMPTY) != 0U) {
+  }
+  return MMIO(SPIRX) & 255U;
+}
+
+// Wait for a byte that is not 0xff (a data token). Returns 0xff on timeout.
+inline uint32_t sd_spi_wait_byte() {
+  for (uint32_t i = 0U; i < SD_SPI_TIMEOUT; ++i) {
+    const auto byte = sd_spi_receive();
+    if (byte != 0xffU) {
+      return byte;
+    }
+  }
+  return 0xffU;
+}
+
+// Wait for an R1 response (bit 7 is clear). Returns 0xff on timeout.
+inline uint32_t sd_spi_wait_r1() {
+  for (uint32_t i = 0U; i < SD_SPI_TIMEOUT; ++i) {
+    const auto byte = sd_spi_receive();
+    if ((byte & 0x80U) == 0U) {
+      return byte;
+    }
+  }
+  return 0xffU;
+}
+
+// Send a command. The CRC is only checked for CMD0 and CMD8 in SPI mode, so it is not calculated.
+inline void sd_spi_send_command(const uint32_t cmd, const uint32_t arg) {
+  sd_spi_send(0x40U | cmd);
+  sd_spi_send(arg >> 24);
+  sd_spi_send(arg >> 16);
+  sd_spi_send(arg >> 8);
+  sd_spi_send(arg);
+  sd_spi_send(0x01U);  // Dummy CRC + stop bit.
+}
+
+// Send a command and return the R1 response.
+inline uint32_t sd_spi_command(const uint32_t cmd, const uint32_t arg) {
+  sd_spi_send_command(cmd, arg);
+  return sd_spi_wait_r1();
+}
+
+// Receive one data block (data token, data and CRC).
+inline bool sd_spi_read_data(uint8_t* ptr) {
+  if (sd_spi_wait_byte() != SD_DATA_TOKEN) {
+    return false;
+  }
+
+  // Receive the data as words, and drain the RX FIFO as it fills up.
+  MMIO(SPICTL) = SPICTL_ENABLE | SPICTL_CS | SPICTL_WORD;
+  MMIO(SPIRDCNT) = SD_SPI_BLOCK_SIZE / 4U;
+  for (uint32_t n = 0U; n < SD_SPI_BLOCK_SIZE;) {
+    auto level = (MMIO(SPISTAT) >> SPISTAT_RXLEVEL_SHIFT) & 255U;
+    for (; level > 0U; --level, n += 4U) {
+      const uint32_t word = MMIO(SPIRX);
+      std::memcpy(&ptr[n], &word, 4U);
+    }
+  }
+  MMIO(SPICTL) = SPICTL_ENABLE | SPICTL_CS;
+
+  // Skip the CRC.
+  (void)sd_spi_receive();
+  (void)sd_spi_receive();
+  return true;
+}
+
+inline bool sd_spi_read(sdctx_t* sdctx,
+                        uint8_t* ptr,
+                        const uint32_t first_block,
+                        const uint32_t num_blocks) {
+  // SCK = CPUCLK / (2 * (SPIDIV + 1)), which must not exceed 25 MHz.
+  MMIO(SPIDIV) = (MMIO(CPUCLK) - 1U) / (2U * SD_SPI_MAX_HZ);
+  MMIO(SPICTL) = SPICTL_ENABLE | SPICTL_CS;
+
+  // Standard capacity cards use byte addresses.
+  const auto addr = sdctx->is_sdhc ? first_block : first_block * SD_SPI_BLOCK_SIZE;
+  const auto multi = (num_blocks > 1U);
+  auto success = (sd_spi_command(multi ? SD_CMD_READ_MULTIPLE_BLOCK : SD_CMD_READ_SINGLE_BLOCK,
+                                 addr) == 0U);
+  for (uint32_t i = 0U; success && i < num_blocks; ++i) {
+    success = sd_spi_read_data(&ptr[i * SD_SPI_BLOCK_SIZE]);
+  }
+
+  if (multi) {
+    // Stop the transmission, and wait while the card is busy. The card keeps sending data while it
+    // receives the command, and the byte after the command is a stuff byte (which can have any
+    // value), so it is skipped before waiting for R1.
+    sd_spi_send_command(SD_CMD_STOP_TRANSMISSION, 0U);
+    (void)sd_spi_receive();
+    success = (sd_spi_wait_r1() == 0U) && success;
+    uint32_t i = 0U;
+    while (sd_spi_receive() != 0xffU && ++i < SD_SPI_TIMEOUT) {
+    }
+  }
+
+  // Hand the SD card pins back to libmc1.
+  MMIO(SPICTL) = 0U;
+  return success;
+}
+
+// Read num_blocks blocks, starting at first_block.
+inline bool sd_read(sdctx_t* sdctx,
+                    void* ptr,
+                    const uint32_t first_block,
+                    const uint32_t num_blocks) {
+  if (num_blocks == 0U) {
+    return true;
+  }
+  if ((MMIO(SPISTAT) & SPISTAT_PRESENT) != 0U &&
+      sd_spi_read(sdctx, static_cast<uint8_t*>(ptr), first_block, num_blocks)) {
+    return true;
+  }
+  return sdcard_read(sdctx, ptr, first_block, num_blocks);
+}
+
+}  // namespace
+
+#endif  // ROM_SD_SPI_HPP_
@@ -0,0 +1,195 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_SECTOR_CACHE_HPP_
+#define ROM_SECTOR_CACHE_HPP_
+
+#include "sd_spi.hpp"
+#include "vram_arena.hpp"
+
+#include <mc1/sdcard.h>
+
+#include <cstdint>
+#include <cstring>
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Read-only LRU cache for SD card blocks, with read-ahead.
+//
+// The cache has NUM_SLOTS block slots, divided into groups of READ_AHEAD consecutive slots. A
+// miss that continues a sequential run of block reads (e.g. a file that is being read) fills the
+// least recently used group with a single multi-block read, while other misses (e.g. FAT and
+// directory lookups) only read the requested block into the least recently used slot.
+class sector_cache_t {
+public:
+  static const uint32_t BLOCK_SIZE = 512U;
+  static const uint32_t READ_AHEAD = 8U;
+  static const uint32_t NUM_GROUPS = 2U;
+  static const uint32_t NUM_SLOTS = READ_AHEAD * NUM_GROUPS;
+
+  struct stats_t {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t read_cmds;    // Number of sd_read() calls.
+    uint32_t blocks_read;  // Number of blocks read from the SD card.
+  };
+
+  // Allocate memory for the cache. Returns false if it does not fit in VRAM, in which case the
+  // cache is disabled (i.e. blocks are read directly).
+  bool init(vram_arena_t& arena) {
+    m_data = arena.alloc<uint8_t>(NUM_SLOTS * BLOCK_SIZE, 4U);
+    m_enabled = (m_data != nullptr);
+    invalidate();
+    m_stats = stats_t();
+    return m_enabled;
+  }
+
+  // Forget all cached blocks (e.g. when a new SD card has been inserted).
+  void invalidate() {
+    for (uint32_t i = 0U; i < NUM_SLOTS; ++i) {
+      m_tags[i] = INVALID_TAG;
+      m_last_used[i] = 0U;
+    }
+    m_clock = 0U;
+    m_last_block = INVALID_TAG;
+  }
+
+  // Stop using the cache memory (e.g. when it may be overwritten), and read blocks directly.
+  void disable() {
+    invalidate();
+    m_enabled = false;
+  }
+
+  bool read(sdctx_t* sdctx, void* ptr, const uint32_t block_no) {
+    if (!m_enabled) {
+      count_read(1U);
+      return sd_read(sdctx, ptr, block_no, 1U);
+    }
+
+    const auto sequential = (m_last_block != INVALID_TAG && block_no == m_last_block + 1U);
+    m_last_block = block_no;
+    ++m_clock;
+
+    // Look up the block.
+    for (uint32_t i = 0U; i < NUM_SLOTS; ++i) {
+      if (m_tags[i] == block_no) {
+        ++m_stats.hits;
+        m_last_used[i] = m_clock;
+        std::memcpy(ptr, slot_data(i), BLOCK_SIZE);
+        return true;
+      }
+    }
+    ++m_stats.misses;
+
+    // Read ahead if this is part of a sequential run (falling back to a single block read, e.g. if
+    // we hit the end of the card).
+    if (sequential) {
+      const auto first = lru_group() * READ_AHEAD;
+      for (uint32_t i = 0U; i < READ_AHEAD; ++i) {
+        m_tags[first + i] = INVALID_TAG;
+      }
+      count_read(READ_AHEAD);
+      if (sd_read(sdctx, slot_data(first), block_no, READ_AHEAD)) {
+        for (uint32_t i = 0U; i < READ_AHEAD; ++i) {
+          m_tags[first + i] = block_no + i;
+          m_last_used[first + i] = m_clock;
+        }
+        std::memcpy(ptr, slot_data(first), BLOCK_SIZE);
+        return true;
+      }
+    }
+
+    // Read a single block into the least recently used slot.
+    const auto slot = lru_slot();
+    m_tags[slot] = INVALID_TAG;
+    count_read(1U);
+    if (!sd_read(sdctx, slot_data(slot), block_no, 1U)) {
+      return false;
+    }
+    m_tags[slot] = block_no;
+    m_last_used[slot] = m_clock;
+    std::memcpy(ptr, slot_data(slot), BLOCK_SIZE);
+    return true;
+  }
+
+  // The memory range that is used by the cache (empty if no memory was allocated).
+  const void* memory_begin() const {
+    return m_data;
+  }
+  const void* memory_end() const {
+    return m_data != nullptr ? m_data + NUM_SLOTS * BLOCK_SIZE : nullptr;
+  }
+
+  const stats_t& stats() const {
+    return m_stats;
+  }
+
+private:
+  static const uint32_t INVALID_TAG = 0xffffffffU;
+
+  uint8_t* slot_data(const uint32_t slot) {
+    return &m_data[slot * BLOCK_SIZE];
+  }
+
+  void count_read(const uint32_t num_blocks) {
+    ++m_stats.read_cmds;
+    m_stats.blocks_read += num_blocks;
+  }
+
+  uint32_t lru_slot() const {
+    uint32_t best = 0U;
+    for (uint32_t i = 1U; i < NUM_SLOTS; ++i) {
+      if (m_last_used[i] < m_last_used[best]) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  // The least recently used group is the group whose most recently used slot is the oldest.
+  uint32_t lru_group() const {
+    uint32_t best = 0U;
+    uint32_t best_time = 0xffffffffU;
+    for (uint32_t g = 0U; g < NUM_GROUPS; ++g) {
+      uint32_t time = 0U;
+      for (uint32_t i = g * READ_AHEAD; i < (g + 1U) * READ_AHEAD; ++i) {
+        time = m_last_used[i] > time ? m_last_used[i] : time;
+      }
+      if (time < best_time) {
+        best = g;
+        best_time = time;
+      }
+    }
+    return best;
+  }
+
+  uint8_t* m_data;
+  bool m_enabled;
+  uint32_t m_tags[NUM_SLOTS];
+  uint32_t m_last_used[NUM_SLOTS];
+  uint32_t m_clock;
+  uint32_t m_last_block;
+  stats_t m_stats;
+};
+
+}  // namespace
+
+#endif  // ROM_SECTOR_CACHE_HPP_
@@ -22,6 +22,8 @@
 #define ROM_SPLASH_HPP_
 
 #include "fp32.hpp"
+#include "vcp_builder.hpp"
+#include "vram_arena.hpp"
 
 #include <mc1/mci_decode.h>
 #include <mc1/mmio.h>
@@ -35,10 +37,52 @@ extern const unsigned char boot_splash_mci[] __attribute__((aligned(4)));
 // Note: Using an anonymous namespace saves a few bytes of code size.
 namespace {
 
+// Splash scaling as a function of time, for a 1080p screen (generated at compile time).
+//
+// The scaling simulates an x^2 "bouncing" motion with a period of 128 frames. The motion is
+// symmetric, so the table only holds the first half of the period.
+class splash_scale_table_t {
+public:
+  static const uint32_t SIZE = 64U;
+
+  struct entry_t {
+    fp32_t scale;
+    vcr_fp_t xincr;  // 1 / scale
+  };
+
+  constexpr splash_scale_table_t() : m_entries() {
+    for (uint32_t t = 0U; t < SIZE; ++t) {
+      const auto scale = 0.75_fp32 + 0.000126_fp32 * ((63U * 63U) - (t * t));
+      const auto one = static_cast<uint64_t>(1U) << (16U + 20U);
+      const auto xincr_bits = (one + (scale.bits() >> 1)) / scale.bits();
+      m_entries[t].scale = scale;
+      m_entries[t].xincr = vcr_fp_t::from_bits(static_cast<int32_t>(xincr_bits));
+    }
+  }
+
+  static constexpr uint32_t index_for_t(const uint32_t t) {
+    const auto t_mod = t & (2U * SIZE - 1U);
+    return t_mod < SIZE ? t_mod : (2U * SIZE - 1U) - t_mod;
+  }
+
+  constexpr const entry_t& operator[](const uint32_t idx) const {
+    return m_entries[idx];
+  }
+
+private:
+  entry_t m_entries[SIZE];
+};
+
+constexpr splash_scale_table_t SPLASH_SCALE_TABLE;
+static_assert(SPLASH_SCALE_TABLE[63].scale == 0.75_fp32, "Bad splash scale table");
+static_assert(SPLASH_SCALE_TABLE[63].xincr.bits() == 87381, "Bad splash scale table");
+
 // Splash display class.
 class splash_t {
 public:
-  void* init(void* mem) {
+  // Allocate memory for the image and the VCP, and show the splash screen. Returns false if it does
+  // not fit in VRAM.
+  bool init(vram_arena_t& arena) {
     // Decode the MCI header.
     auto* hdr = mci_get_header(boot_splash_mci);
     const auto pixels_size = mci_get_pixels_size(hdr);
@@ -48,99 +92,155 @@ public:
     m_img_fmt = hdr->pixel_format;
     m_img_word_stride = mci_get_stride(hdr) / 4;
 
-    // "Allocate" memory.
-    m_pixels = reinterpret_cast<uint32_t*>(mem);
-    m_vcp = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(mem) + pixels_size);
+    // Allocate memory (in a single block, so that nothing is left allocated if it does not fit):
+    // The pixels followed by the VCP (front and back buffers) and the frame parameter table.
+    const auto vcp_size = VCP_PALETTE_OFFS + m_num_palette_colors + VCP_VIEW_SIZE;
+    const auto pixels_words = (pixels_size + 3U) / 4U;
+    auto* mem = arena.alloc<uint32_t>(pixels_words + 2U * vcp_size +
+                                      (splash_scale_table_t::SIZE * sizeof(frame_params_t)) / 4U);
+    if (mem == nullptr) {
+      return false;
+    }
+    m_pixels = mem;
+    m_frames = reinterpret_cast<frame_params_t*>(m_vcp.init(&mem[pixels_words], vcp_size, true));
 
     // Decode the pixels.
     mci_decode_pixels(boot_splash_mci, m_pixels);
 
-    // Generate the VCP.
-    auto* mem_end = generate_vcp(scale_for_t(0));
+    // Calculate the VCP parameters for all frames of the animation, so that update() does not
+    // have to do any divisions.
+    for (uint32_t k = 0U; k < splash_scale_table_t::SIZE; ++k) {
+      calc_frame_params(SPLASH_SCALE_TABLE[k], m_frames[k]);
+    }
+
+    // Generate the VCP:s. The palette and all the words that do not depend on the scaling factor
+    // are only written here.
+    for (uint32_t k = 0U; k < m_vcp.num_buffers(); ++k) {
+      auto vcp = m_vcp.build(k);
+      generate_vcp(vcp);
+      auto patch = m_vcp.build(k);
+      patch_vcp(patch, m_frames[0]);
+    }
 
     // Set up the VCP address.
-    vcp_set_prg(LAYER_2, m_vcp);
+    m_vcp.show(LAYER_2);
 
-    return mem_end;
+    return true;
   }
 
   void deinit() {
-    vcp_set_prg(LAYER_2, nullptr);
+    vcp_program_t::hide(LAYER_2);
   }
 
   void update(const uint32_t t) {
-    (void)generate_vcp(scale_for_t(t));
+    // Patch the back buffer VCP and make it the front buffer (it takes effect in the next frame).
+    auto vcp = m_vcp.back();
+    patch_vcp(vcp, m_frames[splash_scale_table_t::index_for_t(t)]);
+    m_vcp.swap();
   }
 
 private:
-  static fp32_t scale_for_t(const uint32_t t) {
-    // Scaling as a function of time: Simulate an x^2 "bouncing" motion.
-    auto t_mod = t & 127U;
-    if (t_mod >= 64U) {
-      t_mod = 127U - t_mod;
-    }
-    return 0.75_fp32 + 0.000126_fp32 * ((63U * 63U) - (t_mod * t_mod));
-  }
-
-  void* generate_vcp(fp32_t scale_for_1080p) {
+  // VCP layout (word offsets). Words marked with * depend on the scaling factor.
+  //  0        SETREG XINCR *
+  //  1        SETREG XOFFS *
+  //  2        SETREG CMODE
+  //  3        SETPAL
+  //  4        The palette (num_palette_colors words)
+  //  N        WAITY view_top *
+  //  N+1      SETREG ADDR
+  //  N+2      SETREG YINCR
+  //  N+3      SETREG YSTEP *
+  //  N+4      SETREG HSTRT *
+  //  N+5      SETREG HSTOP *
+  //  N+6      WAITY view_bottom *
+  //  N+7      SETREG HSTOP 0
+  //  N+8      WAITY 32767
+  //
+  // The rows are stepped by the hardware (YINCR/YSTEP), so the program size does not depend on the
+  // image height.
+  static const uint32_t VCP_PALETTE_OFFS = 4U;
+  static const uint32_t VCP_VIEW_SIZE = 9U;
+
+  // The VCP parameters for one frame of the animation.
+  struct frame_params_t {
+    uint32_t xincr;  // VCR_XINCR
+    uint32_t xoffs;  // VCR_XOFFS (sub-pixel offset of the first pixel)
+    uint32_t hstrt;
+    uint32_t hstop;
+    uint32_t ystep;  // VCR_YSTEP
+    int view_top;
+    int view_bottom;
+  };
+
+  void calc_frame_params(const splash_scale_table_t::entry_t& entry, frame_params_t& params) {
     // Get the HW resolution and adjust the scaling factor.
     const auto native_width = MMIO(VIDWIDTH);
     const auto native_height = MMIO(VIDHEIGHT);
-    auto scale = (scale_for_1080p * native_height) / static_cast<uint32_t>(1080);
-
-    // Calculate the screen rectangle for the splash (centered, preserve aspect ratio).
-    const auto view_height = static_cast<uint32_t>(scale * m_img_height);
-    const auto view_width = static_cast<uint32_t>(scale * m_img_width);
-    const auto view_top = (native_height - view_height) / 2U;
-    const auto view_left = (native_width - view_width) / 2U;
-
-    auto* vcp = m_vcp;
-
-    // We add a wait here, and add a few NOP:s (to fill up the pipeline after the WAITY instruction)
-    // so that the VCP modifications that we do during the blanking interval has effect.
-    *vcp++ = vcp_emit_waity(0);
-    *vcp++ = vcp_emit_nop();
-    *vcp++ = vcp_emit_nop();
-    *vcp++ = vcp_emit_nop();
+    const auto scale = (entry.scale * native_height) / 1080U;
+    const auto xincr = (entry.xincr * 1080) / static_cast<int32_t>(native_height);
+
+    // Calculate the screen rectangle for the splash (centered, preserve aspect ratio). The first
+    // pixel starts at the first whole screen pixel, and XOFFS compensates for the fractional part
+    // of the left edge.
+    const auto view_width = scale * m_img_width;
+    const auto view_height = scale * m_img_height;
+    const auto view_left = (fp32_t(native_width) - view_width) / 2U;
+    const auto hstrt = view_left.ceil();
+    const auto xoffs = (fp32_t(hstrt) - view_left).convert<int32_t, 16U>() * xincr;
+
+    params.xincr = static_cast<uint32_t>(xincr.bits());
+    params.xoffs = static_cast<uint32_t>(xoffs.bits());
+    params.hstrt = hstrt;
+    params.hstop = (view_left + view_width).round();
+
+    // Pixels are square, so the vertical step is the same as the horizontal step. The view ends
+    // after the last raster line that shows a row of the image.
+    const auto ystep = static_cast<uint32_t>(xincr.bits());
+    const auto num_lines = ((m_img_height << 16) + ystep - 1U) / ystep;
+    params.ystep = ystep;
+    params.view_top = static_cast<int>(((fp32_t(native_height) - view_height) / 2U).round());
+    params.view_bottom = params.view_top + static_cast<int>(num_lines);
+  }
 
-    // VCP prologue.
-    // TODO(m): Use the fixed point width from the scaling and set VCR_XOFFS too for subpixel
-    // accuracy.
-    *vcp++ = vcp_emit_setreg(VCR_XINCR, (0x010000U * m_img_width) / view_width);
-    *vcp++ = vcp_emit_setreg(VCR_CMODE, m_img_fmt);
+  // Generate the parts of the VCP that do not depend on the scaling factor.
+  void generate_vcp(vcp_builder_t& vcp) {
+    vcp.skip(2U);
+    vcp.setreg(VCR_CMODE, m_img_fmt);
 
     // Palette.
-    *vcp++ = vcp_emit_setpal(0, m_num_palette_colors);
-    m_palette = vcp;
-    mci_decode_palette(boot_splash_mci, vcp);
-    vcp += m_num_palette_colors;
-
-    // Address pointers.
-    *vcp++ = vcp_emit_waity(view_top);
-    *vcp++ = vcp_emit_setreg(VCR_HSTRT, view_left);
-    *vcp++ = vcp_emit_setreg(VCR_HSTOP, view_left + view_width);
-    uint32_t vcp_pixels_addr = to_vcp_addr(reinterpret_cast<uintptr_t>(m_pixels));
-    const auto vcp_pixels_stride = m_img_word_stride;
-    auto y = fp32_t(view_top);
-    const auto y_step = fp32_t(view_height) / m_img_height;
-    for (uint32_t k = 0U; k < m_img_height; ++k) {
-      *vcp++ = vcp_emit_waity(static_cast<uint32_t>(y));
-      *vcp++ = vcp_emit_setreg(VCR_ADDR, vcp_pixels_addr);
-      y += y_step;
-      vcp_pixels_addr += vcp_pixels_stride;
+    auto* palette = vcp.setpal(0, m_num_palette_colors);
+    if (palette != nullptr) {
+      mci_decode_palette(boot_splash_mci, palette);
     }
-    *vcp++ = vcp_emit_waity(static_cast<uint32_t>(y));
-    *vcp++ = vcp_emit_setreg(VCR_HSTOP, 0);
+
+    // Image rows.
+    vcp.skip(1U);
+    vcp.setreg(VCR_ADDR, to_vcp_addr(reinterpret_cast<uintptr_t>(m_pixels)));
+    vcp.setreg(VCR_YINCR, m_img_word_stride);
+    vcp.skip(4U);
+    vcp.setreg(VCR_HSTOP, 0);
 
     // VCP epilogue: Wait forever.
-    *vcp++ = vcp_emit_waity(32767);
+    vcp.end();
+  }
 
-    return reinterpret_cast<void*>(vcp);
+  // Update the words of the VCP that depend on the scaling factor.
+  void patch_vcp(vcp_builder_t& vcp, const frame_params_t& params) {
+    vcp.setreg(VCR_XINCR, params.xincr);
+    vcp.setreg(VCR_XOFFS, params.xoffs);
+
+    vcp.skip(m_num_palette_colors + VCP_PALETTE_OFFS - 2U);
+    vcp.waity(params.view_top);
+    vcp.skip(2U);
+    vcp.setreg(VCR_YSTEP, params.ystep);
+    vcp.setreg(VCR_HSTRT, params.hstrt);
+    vcp.setreg(VCR_HSTOP, params.hstop);
+    vcp.waity(params.view_bottom);
   }
 
   uint32_t* m_pixels;
-  uint32_t* m_vcp;
-  uint32_t* m_palette;
+  vcp_program_t m_vcp;
+  frame_params_t* m_frames;
   uint32_t m_num_palette_colors;
   uint32_t m_img_width;
   uint32_t m_img_height;
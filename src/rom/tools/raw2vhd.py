@@ -4,6 +4,7 @@
 import argparse
 import math
 import struct
+import sys
 
 _RAW_BASE_ADDRESS = 512
 
@@ -15,7 +16,7 @@ def closest_pot(x):
     return res
 
 
-def convert(raw_filename, template_filename):
+def read_rom_words(raw_filename):
     # Read the raw rom file and pad start and end with zeros to account for start address and
     # a power-of-two size.
     with open(raw_filename, 'rb') as f:
@@ -23,38 +24,83 @@ def convert(raw_filename, template_filename):
     raw_data = bytearray(_RAW_BASE_ADDRESS) + raw_data
     rom_size = int(closest_pot(len(raw_data)))
     raw_data = raw_data + bytearray(rom_size - len(raw_data))
+    return struct.unpack('<' + ('I' * (rom_size // 4)), raw_data)
 
+
+def to_vhdl(words, template_filename, init_file):
     # Derive dynamic data.
-    ADDR_BITS = str(int(math.log(rom_size, 2) - 2))
-    DATA = ''
-    raw_data_32bit = struct.unpack('<' + ('I' * (rom_size // 4)), raw_data)
-    for x in range(0, len(raw_data_32bit)):
-        tail = '' if x == (len(raw_data_32bit) - 1) else ',\n'
-        word = raw_data_32bit[x]
-        DATA = DATA + (f'    x"{word:08x}"{tail}')
+    ADDR_BITS = str(int(math.log(len(words), 2)))
+    DATA = ',\n'.join(f'    x"{word:08x}"' for word in words)
 
     # Read the VHDL template.
     with open(template_filename, 'r', encoding='utf8') as f:
         template = f.readlines()
 
     # Generate the output.
+    lines = []
     for l in template:
         l = l.rstrip()
         l = l.replace("${ADDR_BITS}", ADDR_BITS)
+        l = l.replace("${INIT_FILE}", init_file)
         l = l.replace("${DATA}", DATA)
-        print(l)
+        lines.append(l)
+    return '\n'.join(lines) + '\n'
+
+
+def to_mif(words):
+    # Altera/Intel Memory Initialization File.
+    addr_digits = len(f'{len(words) - 1:x}')
+    lines = [
+        f'-- MC1 ROM ({len(words)} words)',
+        'WIDTH=32;',
+        f'DEPTH={len(words)};',
+        'ADDRESS_RADIX=HEX;',
+        'DATA_RADIX=HEX;',
+        'CONTENT BEGIN'
+    ]
+    lines.extend(f'  {addr:0{addr_digits}x} : {word:08x};' for addr, word in enumerate(words))
+    lines.append('END;')
+    return '\n'.join(lines) + '\n'
+
+
+def hex_record(addr, rec_type, data):
+    rec = bytes([len(data), (addr >> 8) & 255, addr & 255, rec_type]) + data
+    checksum = (-sum(rec)) & 255
+    return ':' + rec.hex().upper() + f'{checksum:02X}'
+
+
+def to_hex(words):
+    # Intel HEX, with one 32-bit word per record and word addresses (as used by Quartus).
+    if len(words) > 65536:
+        raise ValueError('The ROM is too large for 16-bit HEX addresses')
+    lines = [hex_record(addr, 0, struct.pack('>I', word)) for addr, word in enumerate(words)]
+    lines.append(hex_record(0, 1, b''))
+    return '\n'.join(lines) + '\n'
 
 
 def main():
     # Parse command line arguments.
     parser = argparse.ArgumentParser(
-            description='Convert a raw file to a VHDL ROM file')
+            description='Convert a raw file to a VHDL ROM file or a ROM initialization file')
     parser.add_argument('raw', metavar='RAW_FILE', help='the raw file to convert')
-    parser.add_argument('template', metavar='TEMPLATE_FILE', help='the VHDL template file')
+    parser.add_argument('template', metavar='TEMPLATE_FILE', nargs='?',
+                        help='the VHDL template file (for --format vhdl)')
+    parser.add_argument('--format', choices=['vhdl', 'mif', 'hex'], default='vhdl',
+                        help='output format (default: vhdl)')
+    parser.add_argument('--init-file', default='rom.mif',
+                        help='the ROM initialization file that the VHDL template refers to')
     args = parser.parse_args()
 
     # Convert the file.
-    convert(args.raw, args.template)
+    words = read_rom_words(args.raw)
+    if args.format == 'mif':
+        sys.stdout.write(to_mif(words))
+    elif args.format == 'hex':
+        sys.stdout.write(to_hex(words))
+    else:
+        if args.template is None:
+            parser.error('a template file is required for --format vhdl')
+        sys.stdout.write(to_vhdl(words, args.template, args.init_file))
 
 
 if __name__ == "__main__":
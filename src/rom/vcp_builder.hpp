@@ -0,0 +1,235 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_VCP_BUILDER_HPP_
+#define ROM_VCP_BUILDER_HPP_
+
+#include <mc1/mmio.h>
+#include <mc1/vcp.h>
+
+#include <cstdint>
+
+// Video control registers that are not yet defined by libmc1 (see rtl/vid_regs.vhd).
+#ifndef VCR_YINCR
+#define VCR_YINCR 9
+#define VCR_YSTEP 10
+#endif
+#ifndef VCR_GCOL0
+#define VCR_GCOL0 11
+#define VCR_GCOL1 12
+#define CMODE_GRADIENT 6
+#define CMODE_GSHIFT(n) ((n) << 4)
+#endif
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// VCP instruction encoders (see rtl/vid_vcpp.vhd). Unlike the vcp_emit_*() functions these are
+// constexpr, so instructions with constant operands are encoded at compile time.
+namespace vcp_op {
+constexpr uint32_t jmp(const uint32_t addr) {
+  return 0x00000000U | (addr & 0x00ffffffU);
+}
+
+constexpr uint32_t nop() {
+  return 0x30000000U;
+}
+
+constexpr uint32_t waitx(const int x) {
+  return 0x40000000U | (static_cast<uint32_t>(x) & 0x0000ffffU);
+}
+
+constexpr uint32_t waity(const int y) {
+  return 0x50000000U | (static_cast<uint32_t>(y) & 0x0000ffffU);
+}
+
+constexpr uint32_t setpal(const uint32_t first, const uint32_t count) {
+  return 0x60000000U | ((first & 255U) << 8) | ((count - 1U) & 255U);
+}
+
+constexpr uint32_t setreg(const uint32_t reg, const uint32_t value) {
+  return 0x80000000U | ((reg & 15U) << 24) | (value & 0x00ffffffU);
+}
+
+// The largest WAITY argument: Wait for the rest of the frame.
+constexpr int WAIT_FOREVER = 32767;
+}  // namespace vcp_op
+
+static_assert(vcp_op::waity(vcp_op::WAIT_FOREVER) == 0x50007fffU, "Bad WAITY encoding");
+static_assert(vcp_op::waitx(-1) == 0x4000ffffU, "Bad WAITX encoding");
+static_assert(vcp_op::setpal(0U, 256U) == 0x600000ffU, "Bad SETPAL encoding");
+static_assert(vcp_op::setreg(VCR_CMODE, CMODE_PAL4) == 0x85000003U, "Bad SETREG encoding");
+
+// Bounds checked VCP emitter.
+//
+// The builder writes at most capacity words. The last word of the buffer is reserved for the
+// terminating WAITY that end() emits, so a program that does not fit is truncated but is still a
+// valid VCP. Words that do not fit are counted but dropped, and ok() returns false. A builder
+// without any capacity writes nothing.
+class vcp_builder_t {
+public:
+  vcp_builder_t(uint32_t* buf, const uint32_t capacity)
+      : m_buf(buf),
+        m_capacity(capacity),
+        m_limit(capacity > 0U ? capacity - 1U : 0U),
+        m_size(0U),
+        m_overflow(false) {
+  }
+
+  void emit(const uint32_t word) {
+    if (m_size < m_limit) {
+      m_buf[m_size] = word;
+    } else {
+      m_overflow = true;
+    }
+    ++m_size;
+  }
+
+  // Leave count words as they are (e.g. when patching a previously generated program).
+  void skip(const uint32_t count) {
+    m_size += count;
+    if (m_size > m_limit) {
+      m_overflow = true;
+    }
+  }
+
+  void nop() {
+    emit(vcp_op::nop());
+  }
+
+  void waitx(const int x) {
+    emit(vcp_op::waitx(x));
+  }
+
+  void waity(const int y) {
+    emit(vcp_op::waity(y));
+  }
+
+  void setreg(const uint32_t reg, const uint32_t value) {
+    emit(vcp_op::setreg(reg, value));
+  }
+
+  // Emit a SETPAL instruction and reserve room for the colors. Returns a pointer to the palette
+  // words, or nullptr if they do not fit.
+  uint32_t* setpal(const uint32_t first, const uint32_t count) {
+    emit(vcp_op::setpal(first, count));
+    auto* colors = &m_buf[m_size];
+    skip(count);
+    return m_overflow ? nullptr : colors;
+  }
+
+  // Terminate the program: Wait for the rest of the frame.
+  void end() {
+    if (m_capacity > 0U) {
+      m_buf[m_size < m_limit ? m_size : m_limit] = vcp_op::waity(vcp_op::WAIT_FOREVER);
+    } else {
+      m_overflow = true;
+    }
+    ++m_size;
+  }
+
+  // Number of emitted words (including words that did not fit).
+  uint32_t size() const {
+    return m_size;
+  }
+
+  bool ok() const {
+    return !m_overflow;
+  }
+
+private:
+  uint32_t* const m_buf;
+  const uint32_t m_capacity;
+  const uint32_t m_limit;
+  uint32_t m_size;
+  bool m_overflow;
+};
+
+// A VCP program with a fixed capacity, optionally double buffered.
+//
+// A layer starts executing a new program at the start of the next frame (the VCPP reads the layer
+// entry point when the frame restarts), so a program buffer that was replaced by swap() may still
+// be running until the frame ends. back() therefore waits for VIDFRAMENO to change after a swap,
+// which guarantees that the VCP that is being executed is never modified.
+class vcp_program_t {
+public:
+  // "Allocate" memory for the program buffer(s). Returns a pointer to the first free byte after
+  // the buffer(s).
+  void* init(void* mem, const uint32_t capacity, const bool double_buffered) {
+    m_buf[0] = reinterpret_cast<uint32_t*>(mem);
+    m_buf[1] = double_buffered ? m_buf[0] + capacity : m_buf[0];
+    m_capacity = capacity;
+    m_back = double_buffered ? 1U : 0U;
+    m_swap_frame_no = MMIO(VIDFRAMENO) - 1U;
+    m_layer = LAYER_1;
+    return reinterpret_cast<void*>(m_buf[1] + capacity);
+  }
+
+  uint32_t num_buffers() const {
+    return m_buf[0] != m_buf[1] ? 2U : 1U;
+  }
+
+  // Build the contents of buffer k (call before show() to initialize all the buffers).
+  vcp_builder_t build(const uint32_t k) {
+    return vcp_builder_t(m_buf[k], m_capacity);
+  }
+
+  // Get a builder for the back buffer. Waits for the next frame if the back buffer may still be
+  // executing.
+  vcp_builder_t back() {
+    if (num_buffers() > 1U) {
+      while (MMIO(VIDFRAMENO) == m_swap_frame_no) {
+      }
+    }
+    return build(m_back);
+  }
+
+  // Show the front buffer on the given layer.
+  void show(const layer_t layer) {
+    m_layer = layer;
+    vcp_set_prg(layer, m_buf[m_back ^ (num_buffers() - 1U)]);
+  }
+
+  // Make the back buffer the front buffer. The new program takes effect at the next frame.
+  void swap() {
+    vcp_set_prg(m_layer, m_buf[m_back]);
+    m_swap_frame_no = MMIO(VIDFRAMENO);
+    m_back ^= num_buffers() - 1U;
+  }
+
+  static void hide(const layer_t layer) {
+    vcp_set_prg(layer, nullptr);
+  }
+
+  uint32_t capacity() const {
+    return m_capacity;
+  }
+
+private:
+  uint32_t* m_buf[2];
+  uint32_t m_capacity;
+  uint32_t m_back;
+  uint32_t m_swap_frame_no;
+  layer_t m_layer;
+};
+
+}  // namespace
+
+#endif  // ROM_VCP_BUILDER_HPP_
@@ -0,0 +1,167 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_VRAM_ARENA_HPP_
+#define ROM_VRAM_ARENA_HPP_
+
+#include <mc1/mmio.h>
+#include <mc1/vcp.h>
+
+#include <cstdint>
+
+// Defined by the linker script.
+extern char __vram_free_start;
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Bounds checked VRAM allocator.
+//
+// The arena covers the free VRAM, from __vram_free_start up to the stack at the top of VRAM (the
+// VRAM size is given by MMIO(VRAMSIZE)). Persistent allocations (VCP:s, image data, the sector
+// cache etc) are taken from the bottom of the arena and live until the arena is re-initialized.
+// Scratch allocations are taken from the top of the arena, and are all released by
+// release_scratch(), which the boot loop calls once per frame.
+//
+// An allocation that does not fit returns nullptr, and the caller is expected to do without it
+// (e.g. not show the splash screen). Failed allocations are counted in the statistics, so that
+// the overflow can be reported. The high-water mark tells how close we have been to running out.
+class vram_arena_t {
+public:
+  // Bytes reserved for the stack at the top of VRAM (crt0.s puts the stack pointer at the end of
+  // VRAM). Note that the ELF loader alone keeps a 512 byte block buffer on the stack.
+  static const uint32_t STACK_SIZE = 2048U;
+
+  struct stats_t {
+    uint32_t size;          // Size of the arena.
+    uint32_t used;          // Bytes used by persistent allocations (including alignment padding).
+    uint32_t scratch_used;  // Bytes used by scratch allocations.
+    uint32_t high_water;    // Max. number of bytes that have been used at the same time.
+    uint32_t num_failed;    // Number of allocations that did not fit.
+    uint32_t first_failed;  // Size of the first allocation that did not fit.
+  };
+
+  // Use the free VRAM of the machine.
+  void init() {
+    // Note: The CPU address of VRAM is derived from the VCP address, which works on the host too.
+    const auto begin = reinterpret_cast<uintptr_t>(&__vram_free_start);
+    const auto end = begin - 4U * to_vcp_addr(begin) + MMIO(VRAMSIZE);
+    const auto size = end >= begin + STACK_SIZE ? end - begin - STACK_SIZE : 0U;
+    init(&__vram_free_start, static_cast<uint32_t>(size));
+  }
+
+  // Use the memory range [mem, mem + size).
+  void init(void* mem, const uint32_t size) {
+    m_begin = reinterpret_cast<uintptr_t>(mem);
+    m_end = m_begin + size;
+    m_top = m_begin;
+    m_scratch = m_end;
+    m_stats = stats_t();
+    m_stats.size = size;
+  }
+
+  // Allocate memory for count objects of type T (the memory is not initialized). The alignment
+  // must be a power of two.
+  template <typename T>
+  T* alloc(const uint32_t count, const uint32_t align = alignof(T)) {
+    if (count > MAX_SIZE / sizeof(T)) {
+      return reinterpret_cast<T*>(fail(MAX_SIZE));
+    }
+    return reinterpret_cast<T*>(alloc_bytes(count * sizeof(T), align));
+  }
+
+  void* alloc_bytes(const uint32_t size, const uint32_t align = 4U) {
+    const auto addr = (m_top + (align - 1U)) & ~static_cast<uintptr_t>(align - 1U);
+    if (addr > m_scratch || size > m_scratch - addr) {
+      return fail(size);
+    }
+    m_top = addr + size;
+    update_stats();
+    return reinterpret_cast<void*>(addr);
+  }
+
+  // Allocate scratch memory, which is only valid until the next call to release_scratch().
+  template <typename T>
+  T* alloc_scratch(const uint32_t count, const uint32_t align = alignof(T)) {
+    if (count > MAX_SIZE / sizeof(T)) {
+      return reinterpret_cast<T*>(fail(MAX_SIZE));
+    }
+    return reinterpret_cast<T*>(alloc_scratch_bytes(count * sizeof(T), align));
+  }
+
+  void* alloc_scratch_bytes(const uint32_t size, const uint32_t align = 4U) {
+    if (size > m_scratch - m_top) {
+      return fail(size);
+    }
+    const auto addr = (m_scratch - size) & ~static_cast<uintptr_t>(align - 1U);
+    if (addr < m_top) {
+      return fail(size);
+    }
+    m_scratch = addr;
+    update_stats();
+    return reinterpret_cast<void*>(addr);
+  }
+
+  void release_scratch() {
+    m_scratch = m_end;
+    m_stats.scratch_used = 0U;
+  }
+
+  // Number of bytes that are available (for a single allocation, minus alignment padding).
+  uint32_t bytes_free() const {
+    return static_cast<uint32_t>(m_scratch - m_top);
+  }
+
+  bool overflowed() const {
+    return m_stats.num_failed != 0U;
+  }
+
+  const stats_t& stats() const {
+    return m_stats;
+  }
+
+private:
+  static const uint32_t MAX_SIZE = 0xffffffffU;
+
+  void* fail(const uint32_t size) {
+    if (m_stats.num_failed == 0U) {
+      m_stats.first_failed = size;
+    }
+    ++m_stats.num_failed;
+    return nullptr;
+  }
+
+  void update_stats() {
+    m_stats.used = static_cast<uint32_t>(m_top - m_begin);
+    m_stats.scratch_used = static_cast<uint32_t>(m_end - m_scratch);
+    const auto total = m_stats.used + m_stats.scratch_used;
+    m_stats.high_water = total > m_stats.high_water ? total : m_stats.high_water;
+  }
+
+  uintptr_t m_begin;
+  uintptr_t m_end;
+  uintptr_t m_top;      // End of the persistent allocations.
+  uintptr_t m_scratch;  // Start of the scratch allocations.
+  stats_t m_stats;
+};
+
+}  // namespace
+
+#endif  // ROM_VRAM_ARENA_HPP_
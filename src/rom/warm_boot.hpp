@@ -0,0 +1,140 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ROM_WARM_BOOT_HPP_
+#define ROM_WARM_BOOT_HPP_
+
+#include <mc1/sdcard.h>
+#include <mc1/vcp.h>
+
+#include <cstdint>
+
+// Defined by the linker script.
+extern char __vram_free_start;
+
+// Note: Using an anonymous namespace saves a few bytes of code size.
+namespace {
+
+// Warm restart handoff.
+//
+// Right before the ROM starts the boot executable, it saves the state of the initialized SD card
+// in a handoff block. When the boot executable returns and the ROM is restarted, a valid handoff
+// block lets the ROM skip the SD card initialization and the boot animation, and go straight to
+// mounting the file system and loading the boot executable.
+//
+// The block lives at a fixed address in the reserved area at the start of VRAM (after the VCP
+// layer entry points and before the ROM BSS, which crt0.s clears). It is only trusted if its
+// checksum is valid and the first block of the SD card is unchanged (i.e. it is the same card).
+// The block is consumed when it is read, so that a failed warm restart falls back to a cold start.
+//
+// Note: The FAT volume state and the cluster chains are private to MFAT, so the file system is
+// always mounted again (which only takes a few block reads, and which means that it is fine for
+// the boot executable to modify the file system, e.g. to replace itself).
+class warm_boot_t {
+public:
+  // Byte offset of the handoff block in VRAM, and the max size of the block.
+  static const uint32_t VRAM_OFFSET = 0x40U;
+  static const uint32_t MAX_SIZE = 0xc0U;
+
+  // Save the handoff block (call right before the boot executable is started).
+  static void save(sdctx_t* sdctx) {
+    auto& block = handoff_block();
+    block.magic = 0U;
+    if (!read_card_id(sdctx, block.card_id)) {
+      return;
+    }
+    block.sdctx = *sdctx;
+    block.size = sizeof(block_t);
+    block.magic = MAGIC;
+    block.checksum = block_checksum(block);
+  }
+
+  // Take the handoff block (i.e. read and invalidate it). Returns true if the block was valid and
+  // the same SD card is still inserted, in which case sdctx is ready to use.
+  static bool take(sdctx_t* sdctx, sdcard_log_func_t log_func) {
+    auto& block = handoff_block();
+    const auto valid = block.magic == MAGIC && block.size == sizeof(block_t) &&
+                       block.checksum == block_checksum(block);
+    block.magic = 0U;
+    if (!valid) {
+      return false;
+    }
+    *sdctx = block.sdctx;
+    sdctx->log_func = log_func;
+    uint32_t card_id;
+    return read_card_id(sdctx, card_id) && card_id == block.card_id;
+  }
+
+  // The memory range that is used by the handoff block.
+  static const void* memory_begin() {
+    return &handoff_block();
+  }
+  static const void* memory_end() {
+    return &handoff_block() + 1;
+  }
+
+private:
+  static const uint32_t MAGIC = 0x544f4257U;  // "WBOT"
+
+  struct block_t {
+    uint32_t checksum;  // Checksum of the rest of the block.
+    uint32_t magic;
+    uint32_t size;      // sizeof(block_t), to catch layout changes.
+    uint32_t card_id;   // Checksum of the first block of the SD card.
+    sdctx_t sdctx;
+  };
+
+  static_assert(sizeof(block_t) <= MAX_SIZE, "The warm boot handoff block is too large");
+  static_assert(sizeof(block_t) % 4U == 0U, "Bad warm boot handoff block size");
+
+  static block_t& handoff_block() {
+    // Note: The CPU address of VRAM is derived from the VCP address, which works on the host too.
+    const auto free_start = reinterpret_cast<uintptr_t>(&__vram_free_start);
+    const auto vram_start = free_start - 4U * to_vcp_addr(free_start);
+    return *reinterpret_cast<block_t*>(vram_start + VRAM_OFFSET);
+  }
+
+  // FNV-1a style hash of 32-bit words.
+  static uint32_t checksum(const uint32_t* words, const uint32_t count) {
+    uint32_t hash = 0x811c9dc5U;
+    for (uint32_t i = 0U; i < count; ++i) {
+      hash = (hash ^ words[i]) * 16777619U;
+    }
+    return hash;
+  }
+
+  static uint32_t block_checksum(const block_t& block) {
+    const auto* words = reinterpret_cast<const uint32_t*>(&block);
+    return checksum(&words[1], sizeof(block_t) / 4U - 1U);
+  }
+
+  static bool read_card_id(sdctx_t* sdctx, uint32_t& card_id) {
+    uint32_t buf[128];
+    if (!sdcard_read(sdctx, buf, 0U, 1U)) {
+      return false;
+    }
+    card_id = checksum(buf, 128U);
+    return true;
+  }
+};
+
+}  // namespace
+
+#endif  // ROM_WARM_BOOT_HPP_
@@ -0,0 +1,28 @@
+; -*- mode: mr32asm; tab-width: 4; indent-tabs-mode: nil; -*-
+; ----------------------------------------------------------------------------
+; Vectorized memory clear (see elf_loader_t in elf_loader.hpp).
+;
+; void zero_fill_words(uint32_t* dst, uint32_t count);
+;
+; Clear count words starting at dst (the same loop that crt0.s uses for
+; clearing the BSS). dst must be word aligned and count must be greater than
+; zero.
+;
+; r1 = dst, r2 = count
+; ----------------------------------------------------------------------------
+
+    .text
+
+    .globl  zero_fill_words
+    .p2align 2
+
+zero_fill_words:
+    getsr   vl, #0x10           ; vl = Max vector length
+1$:
+    minu    vl, vl, r2
+    sub     r2, r2, vl
+    stw     vz, [r1, #4]
+    ldea    r1, [r1, vl*4]
+    bnz     r2, 1$
+
+    ret
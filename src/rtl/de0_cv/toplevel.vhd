@@ -132,6 +132,7 @@ architecture rtl of toplevel is
   signal s_xram_ack : std_logic;
   signal s_xram_stall : std_logic;
   signal s_xram_err : std_logic;
+  signal s_xram_fifo_full : std_logic;
 
   signal s_io_switches : std_logic_vector(31 downto 0);
   signal s_io_buttons : std_logic_vector(31 downto 0);
@@ -254,6 +255,7 @@ begin
       i_xram_ack => s_xram_ack,
       i_xram_stall => s_xram_stall,
       i_xram_err => s_xram_err,
+      i_xram_fifo_full => s_xram_fifo_full,
 
       -- I/O registers.
       i_io_switches => s_io_switches,
@@ -301,6 +303,7 @@ begin
       o_wb_ack => s_xram_ack,
       o_wb_stall => s_xram_stall,
       o_wb_err => s_xram_err,
+      o_fifo_full => s_xram_fifo_full,
 
       o_sdram_a => DRAM_ADDR,
       o_sdram_ba => DRAM_BA,
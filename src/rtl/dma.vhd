@@ -0,0 +1,256 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- DMA engine for memory fills and copies (Wishbone B4 pipelined master).
+--
+-- A transfer is a rectangle of i_height rows with i_width words per row. Consecutive rows start
+-- i_src_stride and i_dst_stride bytes apart (signed), so a plain linear fill or copy is simply a
+-- single row. All addresses are byte addresses, and must be word aligned.
+--
+-- Fill transfers write i_fill_value to the destination, with one write request per cycle for an
+-- entire row. Copy transfers alternate between read bursts and write bursts of up to
+-- 2**LOG2_BURST_LEN words, via an internal buffer. Every burst waits for all of its responses
+-- before the next burst starts, so the source and destination may be different slaves, and other
+-- masters can be granted the bus between bursts. The bus cycle (CYC) is held from a read burst to
+-- the following write burst, and is released for at least one cycle after each write burst.
+--
+-- Copies are done in ascending address order. Overlapping copies where the destination starts
+-- inside the source range (src < dst < src + length) are NOT supported: source words are then
+-- overwritten before they have been read. Overlapping copies with dst <= src work as expected.
+--
+-- o_done is set when a transfer has finished, and is cleared when a new transfer is started. Bus
+-- errors are reported in o_err (the transfer is still completed).
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity dma is
+  generic(
+    LOG2_BURST_LEN : positive := 4
+  );
+  port(
+    i_rst : in std_logic;
+    i_clk : in std_logic;
+
+    -- Control interface.
+    i_start : in std_logic;
+    i_fill : in std_logic;
+    i_src_adr : in std_logic_vector(31 downto 0);
+    i_dst_adr : in std_logic_vector(31 downto 0);
+    i_width : in std_logic_vector(15 downto 0);
+    i_height : in std_logic_vector(15 downto 0);
+    i_src_stride : in std_logic_vector(31 downto 0);
+    i_dst_stride : in std_logic_vector(31 downto 0);
+    i_fill_value : in std_logic_vector(31 downto 0);
+    o_busy : out std_logic;
+    o_done : out std_logic;
+    o_err : out std_logic;
+
+    -- Wishbone master interface.
+    o_wb_cyc : out std_logic;
+    o_wb_stb : out std_logic;
+    o_wb_adr : out std_logic_vector(29 downto 0);
+    o_wb_dat : out std_logic_vector(31 downto 0);
+    o_wb_we : out std_logic;
+    o_wb_sel : out std_logic_vector(3 downto 0);
+    i_wb_dat : in std_logic_vector(31 downto 0);
+    i_wb_ack : in std_logic;
+    i_wb_stall : in std_logic;
+    i_wb_err : in std_logic
+  );
+end dma;
+
+architecture rtl of dma is
+  constant C_BURST_LEN : integer := 2**LOG2_BURST_LEN;
+
+  type T_STATE is (IDLE, NEXT_BURST, READ, WRITE);
+  type T_BUFFER is array (0 to C_BURST_LEN-1) of std_logic_vector(31 downto 0);
+
+  subtype T_WORD_ADR is unsigned(29 downto 0);
+  subtype T_COUNT is unsigned(15 downto 0);
+
+  signal s_state : T_STATE;
+  signal s_fill : std_logic;
+  signal s_width : T_COUNT;
+  signal s_src_stride : T_WORD_ADR;
+  signal s_dst_stride : T_WORD_ADR;
+  signal s_fill_value : std_logic_vector(31 downto 0);
+
+  signal s_row_src : T_WORD_ADR;
+  signal s_row_dst : T_WORD_ADR;
+  signal s_src : T_WORD_ADR;
+  signal s_dst : T_WORD_ADR;
+  signal s_rows_left : T_COUNT;
+  signal s_words_left : T_COUNT;
+  signal s_burst_len : T_COUNT;
+  signal s_issued : T_COUNT;
+  signal s_acked : T_COUNT;
+
+  signal s_buf : T_BUFFER;
+  signal s_done : std_logic;
+  signal s_err : std_logic;
+
+  signal s_cyc : std_logic;
+  signal s_stb : std_logic;
+  signal s_response : std_logic;
+  signal s_last_response : std_logic;
+
+  -- Ensure that the buffer is using registers, not BRAM (see fifo.vhd).
+  attribute RAMSTYLE : string;
+  attribute RAMSTYLE of s_buf : signal is "MLAB";  -- Intel/Altera
+  attribute RAM_STYLE : string;
+  attribute RAM_STYLE of s_buf : signal is "distributed";  -- Xilinx
+
+  function byte_to_word_adr(x : std_logic_vector(31 downto 0)) return T_WORD_ADR is
+  begin
+    return unsigned(x(31 downto 2));
+  end function;
+begin
+  s_cyc <= '1' when s_state = READ or s_state = WRITE else '0';
+  s_stb <= s_cyc when s_issued < s_burst_len else '0';
+  s_response <= i_wb_ack or i_wb_err;
+  s_last_response <= s_response when s_acked = s_burst_len - 1 else '0';
+
+  process(i_clk, i_rst)
+    variable v_burst_len : T_COUNT;
+  begin
+    if i_rst = '1' then
+      s_state <= IDLE;
+      s_fill <= '0';
+      s_width <= (others => '0');
+      s_src_stride <= (others => '0');
+      s_dst_stride <= (others => '0');
+      s_fill_value <= (others => '0');
+      s_row_src <= (others => '0');
+      s_row_dst <= (others => '0');
+      s_src <= (others => '0');
+      s_dst <= (others => '0');
+      s_rows_left <= (others => '0');
+      s_words_left <= (others => '0');
+      s_burst_len <= (others => '0');
+      s_issued <= (others => '0');
+      s_acked <= (others => '0');
+      s_done <= '0';
+      s_err <= '0';
+    elsif rising_edge(i_clk) then
+      case s_state is
+        when IDLE =>
+          if i_start = '1' then
+            s_fill <= i_fill;
+            s_width <= unsigned(i_width);
+            s_src_stride <= byte_to_word_adr(i_src_stride);
+            s_dst_stride <= byte_to_word_adr(i_dst_stride);
+            s_fill_value <= i_fill_value;
+            s_row_src <= byte_to_word_adr(i_src_adr);
+            s_row_dst <= byte_to_word_adr(i_dst_adr);
+            s_src <= byte_to_word_adr(i_src_adr);
+            s_dst <= byte_to_word_adr(i_dst_adr);
+            s_rows_left <= unsigned(i_height);
+            s_words_left <= unsigned(i_width);
+            s_done <= '0';
+            s_err <= '0';
+            if unsigned(i_width) = 0 or unsigned(i_height) = 0 then
+              s_done <= '1';
+            else
+              s_state <= NEXT_BURST;
+            end if;
+          end if;
+
+        when NEXT_BURST =>
+          -- Fills are done one row at a time, while copies are limited by the buffer size.
+          if s_fill = '0' and s_words_left > C_BURST_LEN then
+            v_burst_len := to_unsigned(C_BURST_LEN, v_burst_len'length);
+          else
+            v_burst_len := s_words_left;
+          end if;
+          s_burst_len <= v_burst_len;
+          s_words_left <= s_words_left - v_burst_len;
+          s_issued <= (others => '0');
+          s_acked <= (others => '0');
+          if s_fill = '1' then
+            s_state <= WRITE;
+          else
+            s_state <= READ;
+          end if;
+
+        when READ =>
+          if s_stb = '1' and i_wb_stall = '0' then
+            s_issued <= s_issued + 1;
+            s_src <= s_src + 1;
+          end if;
+          if s_response = '1' then
+            s_buf(to_integer(s_acked(LOG2_BURST_LEN-1 downto 0))) <= i_wb_dat;
+            s_acked <= s_acked + 1;
+          end if;
+          if s_last_response = '1' then
+            s_issued <= (others => '0');
+            s_acked <= (others => '0');
+            s_state <= WRITE;
+          end if;
+
+        when WRITE =>
+          if s_stb = '1' and i_wb_stall = '0' then
+            s_issued <= s_issued + 1;
+            s_dst <= s_dst + 1;
+          end if;
+          if s_response = '1' then
+            s_acked <= s_acked + 1;
+          end if;
+          if s_last_response = '1' then
+            if s_words_left /= 0 then
+              s_state <= NEXT_BURST;
+            elsif s_rows_left /= 1 then
+              -- Start the next row.
+              s_rows_left <= s_rows_left - 1;
+              s_words_left <= s_width;
+              s_row_src <= s_row_src + s_src_stride;
+              s_row_dst <= s_row_dst + s_dst_stride;
+              s_src <= s_row_src + s_src_stride;
+              s_dst <= s_row_dst + s_dst_stride;
+              s_state <= NEXT_BURST;
+            else
+              s_done <= '1';
+              s_state <= IDLE;
+            end if;
+          end if;
+      end case;
+
+      if s_cyc = '1' and i_wb_err = '1' then
+        s_err <= '1';
+      end if;
+    end if;
+  end process;
+
+  -- Wishbone outputs.
+  o_wb_cyc <= s_cyc;
+  o_wb_stb <= s_stb;
+  o_wb_adr <= std_logic_vector(s_dst) when s_state = WRITE else std_logic_vector(s_src);
+  o_wb_dat <= s_fill_value when s_fill = '1' else
+              s_buf(to_integer(s_issued(LOG2_BURST_LEN-1 downto 0)));
+  o_wb_we <= '1' when s_state = WRITE else '0';
+  o_wb_sel <= (others => '1');
+
+  -- Status outputs.
+  o_busy <= '1' when s_state /= IDLE else '0';
+  o_done <= s_done;
+  o_err <= s_err;
+end rtl;
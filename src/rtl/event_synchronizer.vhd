@@ -0,0 +1,111 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Event counter clock domain crossing.
+--
+-- Single cycle event pulses in the source clock domain are counted in a small Gray coded counter,
+-- which is passed to the target clock domain with a two-flip-flop synchronizer (since only one bit
+-- changes at a time, no multi-bit skew mitigation is required). o_count is the number of events
+-- that have arrived since the previous target clock cycle.
+--
+-- At most 2**BITS-1 events may occur in the source clock domain during one target clock cycle.
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity event_synchronizer is
+  generic(
+    BITS : positive := 4
+  );
+  port(
+    -- Source clock domain.
+    i_src_rst : in std_logic;
+    i_src_clk : in std_logic;
+    i_event : in std_logic;
+
+    -- Target clock domain.
+    i_rst : in std_logic;
+    i_clk : in std_logic;
+    o_count : out unsigned(BITS-1 downto 0)
+  );
+end event_synchronizer;
+
+architecture rtl of event_synchronizer is
+  signal s_src_count : unsigned(BITS-1 downto 0);
+  signal s_src_gray : std_logic_vector(BITS-1 downto 0);
+  signal s_gray : std_logic_vector(BITS-1 downto 0);
+  signal s_count : unsigned(BITS-1 downto 0);
+  signal s_prev_count : unsigned(BITS-1 downto 0);
+
+  function gray_to_binary(x : std_logic_vector) return unsigned is
+    variable v_result : unsigned(x'length-1 downto 0);
+  begin
+    v_result(x'length-1) := x(x'left);
+    for k in x'length-2 downto 0 loop
+      v_result(k) := v_result(k+1) xor x(x'right + k);
+    end loop;
+    return v_result;
+  end function;
+begin
+  -- Count events in the source clock domain. The Gray code is registered so that the synchronizer
+  -- never samples glitches.
+  process(i_src_clk, i_src_rst)
+    variable v_next_count : unsigned(BITS-1 downto 0);
+  begin
+    if i_src_rst = '1' then
+      s_src_count <= (others => '0');
+      s_src_gray <= (others => '0');
+    elsif rising_edge(i_src_clk) then
+      if i_event = '1' then
+        v_next_count := s_src_count + 1;
+        s_src_count <= v_next_count;
+        s_src_gray <= std_logic_vector(v_next_count xor shift_right(v_next_count, 1));
+      end if;
+    end if;
+  end process;
+
+  synchronizer_1: entity work.synchronizer
+    generic map (
+      BITS => BITS,
+      STEADY_CYCLES => 0
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_clk,
+      i_d => s_src_gray,
+      o_q => s_gray
+    );
+
+  -- Convert the counter back to binary and calculate the number of new events.
+  s_count <= gray_to_binary(s_gray);
+
+  process(i_clk, i_rst)
+  begin
+    if i_rst = '1' then
+      s_prev_count <= (others => '0');
+    elsif rising_edge(i_clk) then
+      s_prev_count <= s_count;
+    end if;
+  end process;
+
+  o_count <= s_count - s_prev_count;
+end rtl;
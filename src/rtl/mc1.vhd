@@ -28,6 +28,7 @@ use mrisc32.config.all;
 use mrisc32.debug.all;
 use work.mmio_types.all;
 use work.vid_types.all;
+use work.wb_types.all;
 
 entity mc1 is
   generic(
@@ -39,7 +40,14 @@ entity mc1 is
     LOG2_VRAM_SIZE : natural := 14;   -- VRAM size (log2 of number of bytes).
     XRAM_SIZE : natural := 0;         -- XRAM size (number of bytes).
     NUM_VIDEO_LAYERS : positive := 2; -- Number of video layers (1 or 2).
-    VIDEO_CONFIG : T_VIDEO_CONFIG     -- Native video resolution.
+    VIDEO_CONFIG : T_VIDEO_CONFIG;    -- Native video resolution.
+    XRAM_LINE_FETCH : boolean := false;    -- Enable the XRAM line buffer (video layer 1 only).
+    LOG2_XRAM_LINE_WORDS : positive := 10; -- XRAM line buffer size (log2 of words per row).
+    XBAR_ARB_POLICY : T_WB_ARB_POLICY := WB_ARB_FIXED;  -- CPU data vs instruction arbitration.
+    XBAR_ARB_WEIGHT_D : positive := 1;     -- Requests per turn for CPU data (WB_ARB_WEIGHTED).
+    XBAR_ARB_WEIGHT_I : positive := 1;     -- Requests per turn for CPU instr. (WB_ARB_WEIGHTED).
+    ENABLE_DMA : boolean := true;          -- Enable the DMA engine (fills and copies).
+    ENABLE_SPI : boolean := true           -- Enable the SPI master for the SD card interface.
   );
   port(
     -- CPU interface.
@@ -77,6 +85,7 @@ entity mc1 is
     i_xram_ack : in std_logic;
     i_xram_stall : in std_logic;
     i_xram_err : in std_logic;
+    i_xram_fifo_full : in std_logic := '0';  -- Optional performance counter event.
 
     -- Debug trace interface.
     o_debug_trace : out T_DEBUG_TRACE
@@ -107,6 +116,33 @@ architecture rtl of mc1 is
   signal s_cpud_stall : std_logic;
   signal s_cpud_err : std_logic;
 
+  -- Data master port of the crossbar (the CPU data port, optionally shared with the DMA engine).
+  signal s_data_cyc : std_logic;
+  signal s_data_stb : std_logic;
+  signal s_data_adr : std_logic_vector(29 downto 0);
+  signal s_data_dat_w : std_logic_vector(31 downto 0);
+  signal s_data_we : std_logic;
+  signal s_data_sel : std_logic_vector(3 downto 0);
+  signal s_data_dat : std_logic_vector(31 downto 0);
+  signal s_data_ack : std_logic;
+  signal s_data_stall : std_logic;
+  signal s_data_err : std_logic;
+
+  -- DMA engine control and status.
+  signal s_io_regs_w : T_MMIO_REGS_WO;
+  signal s_dma_start : std_logic;
+  signal s_dma_busy : std_logic;
+  signal s_dma_done : std_logic;
+  signal s_dma_err : std_logic;
+
+  -- SPI master control and status.
+  signal s_spi_tx_stb : std_logic;
+  signal s_spi_rd_stb : std_logic;
+  signal s_spi_wr_data : std_logic_vector(31 downto 0);
+  signal s_spi_rx_pop : std_logic;
+  signal s_spi_rx_data : std_logic_vector(31 downto 0);
+  signal s_spi_status : std_logic_vector(31 downto 0);
+
   -- ROM memory interface (Wishbone B4 pipelined slave).
   signal s_rom_cyc : std_logic;
   signal s_rom_stb : std_logic;
@@ -128,6 +164,21 @@ architecture rtl of mc1 is
   signal s_vram_stall : std_logic;
   signal s_vram_err : std_logic;
 
+  -- External RAM interface of the crossbar (Wishbone B4 pipelined slave).
+  signal s_xram_cyc : std_logic;
+  signal s_xram_stb : std_logic;
+  signal s_xram_adr : std_logic_vector(29 downto 0);
+  signal s_xram_dat_w : std_logic_vector(31 downto 0);
+  signal s_xram_we : std_logic;
+  signal s_xram_sel : std_logic_vector(3 downto 0);
+  signal s_xram_dat : std_logic_vector(31 downto 0);
+  signal s_xram_ack : std_logic;
+  signal s_xram_stall : std_logic;
+  signal s_xram_err : std_logic;
+
+  -- Crossbar statistics (for the performance counters).
+  signal s_xbar_stats : T_WB_XBAR_STATS;
+
   -- Memory mapped I/O interface (Wishbone B4 pipelined slave).
   signal s_io_cyc : std_logic;
   signal s_io_stb : std_logic;
@@ -144,6 +195,16 @@ architecture rtl of mc1 is
   signal s_video_adr : std_logic_vector(LOG2_VRAM_SIZE-3 downto 0);
   signal s_video_dat : std_logic_vector(31 downto 0);
   signal s_raster_y : std_logic_vector(15 downto 0);
+  signal s_layer1_stats : T_VID_LAYER_STATS;
+  signal s_layer2_stats : T_VID_LAYER_STATS;
+  signal s_line_fetch_req : std_logic;
+  signal s_line_fetch_adr : std_logic_vector(23 downto 0);
+  signal s_line_fetch_size : std_logic_vector(23 downto 0);
+  signal s_line_start : std_logic;
+  signal s_lbuf_read_adr : std_logic_vector(LOG2_XRAM_LINE_WORDS-1 downto 0);
+  signal s_lbuf_read_dat : std_logic_vector(31 downto 0);
+  signal s_line_fetch_min_margin : std_logic_vector(23 downto 0);
+  signal s_line_fetch_underruns : std_logic_vector(15 downto 0);
 
   -- Video logic signals in the CPU clock domain.
   signal s_raster_y_cpu : std_logic_vector(15 downto 0);
@@ -189,6 +250,110 @@ begin
   s_cpud_adr(29 downto 0) <= s_cpud_adr_cpu(31 downto 2);
 
 
+  --------------------------------------------------------------------------------------------------
+  -- DMA engine (optional)
+  --------------------------------------------------------------------------------------------------
+
+  DmaGen: if ENABLE_DMA generate
+    signal s_dma_cyc : std_logic;
+    signal s_dma_stb : std_logic;
+    signal s_dma_adr : std_logic_vector(29 downto 0);
+    signal s_dma_dat_w : std_logic_vector(31 downto 0);
+    signal s_dma_we : std_logic;
+    signal s_dma_sel : std_logic_vector(3 downto 0);
+    signal s_dma_dat : std_logic_vector(31 downto 0);
+    signal s_dma_ack : std_logic;
+    signal s_dma_stall : std_logic;
+    signal s_dma_wb_err : std_logic;
+  begin
+    dma_1: entity work.dma
+      port map (
+        i_rst => i_cpu_rst,
+        i_clk => i_cpu_clk,
+
+        i_start => s_dma_start,
+        i_fill => s_io_regs_w.DMACTL(1),
+        i_src_adr => s_io_regs_w.DMASRC,
+        i_dst_adr => s_io_regs_w.DMADST,
+        i_width => s_io_regs_w.DMAWIDTH(15 downto 0),
+        i_height => s_io_regs_w.DMAHEIGHT(15 downto 0),
+        i_src_stride => s_io_regs_w.DMASSTRIDE,
+        i_dst_stride => s_io_regs_w.DMADSTRIDE,
+        i_fill_value => s_io_regs_w.DMAFILL,
+        o_busy => s_dma_busy,
+        o_done => s_dma_done,
+        o_err => s_dma_err,
+
+        o_wb_cyc => s_dma_cyc,
+        o_wb_stb => s_dma_stb,
+        o_wb_adr => s_dma_adr,
+        o_wb_dat => s_dma_dat_w,
+        o_wb_we => s_dma_we,
+        o_wb_sel => s_dma_sel,
+        i_wb_dat => s_dma_dat,
+        i_wb_ack => s_dma_ack,
+        i_wb_stall => s_dma_stall,
+        i_wb_err => s_dma_wb_err
+      );
+
+    -- The DMA engine shares the data master port of the crossbar with the CPU. The CPU has
+    -- precedence, and the DMA engine releases the bus between bursts.
+    data_arbiter_1: entity work.wb_arbiter_2x1
+      port map (
+        i_rst => i_cpu_rst,
+        i_clk => i_cpu_clk,
+
+        i_cyc_a => s_cpud_cyc,
+        i_stb_a => s_cpud_stb,
+        i_adr_a => s_cpud_adr,
+        i_dat_a => s_cpud_dat_w,
+        i_we_a => s_cpud_we,
+        i_sel_a => s_cpud_sel,
+        o_dat_a => s_cpud_dat,
+        o_ack_a => s_cpud_ack,
+        o_stall_a => s_cpud_stall,
+        o_err_a => s_cpud_err,
+
+        i_cyc_b => s_dma_cyc,
+        i_stb_b => s_dma_stb,
+        i_adr_b => s_dma_adr,
+        i_dat_b => s_dma_dat_w,
+        i_we_b => s_dma_we,
+        i_sel_b => s_dma_sel,
+        o_dat_b => s_dma_dat,
+        o_ack_b => s_dma_ack,
+        o_stall_b => s_dma_stall,
+        o_err_b => s_dma_wb_err,
+
+        o_cyc => s_data_cyc,
+        o_stb => s_data_stb,
+        o_adr => s_data_adr,
+        o_dat => s_data_dat_w,
+        o_we => s_data_we,
+        o_sel => s_data_sel,
+        i_dat => s_data_dat,
+        i_ack => s_data_ack,
+        i_stall => s_data_stall,
+        i_err => s_data_err
+      );
+  else generate
+    s_dma_busy <= '0';
+    s_dma_done <= '0';
+    s_dma_err <= '0';
+
+    s_data_cyc <= s_cpud_cyc;
+    s_data_stb <= s_cpud_stb;
+    s_data_adr <= s_cpud_adr;
+    s_data_dat_w <= s_cpud_dat_w;
+    s_data_we <= s_cpud_we;
+    s_data_sel <= s_cpud_sel;
+    s_cpud_dat <= s_data_dat;
+    s_cpud_ack <= s_data_ack;
+    s_cpud_stall <= s_data_stall;
+    s_cpud_err <= s_data_err;
+  end generate;
+
+
   --------------------------------------------------------------------------------------------------
   -- Wishbone memory subsystem
   --------------------------------------------------------------------------------------------------
@@ -199,25 +364,28 @@ begin
     generic map (
       ADR_WIDTH => 30,
       DAT_WIDTH => 32,
-      GRANULARITY => 8
+      GRANULARITY => 8,
+      ARB_POLICY => XBAR_ARB_POLICY,
+      ARB_WEIGHT_A => XBAR_ARB_WEIGHT_D,
+      ARB_WEIGHT_B => XBAR_ARB_WEIGHT_I
     )
     port map (
       i_rst => i_cpu_rst,
       i_clk => i_cpu_clk,
 
-      -- Master interface A: CPU data.
-      -- This interface has precedence over interface B, and we want the data port to have
-      -- precedence.
-      i_cyc_a => s_cpud_cyc,
-      i_stb_a => s_cpud_stb,
-      i_adr_a => s_cpud_adr,
-      i_dat_a => s_cpud_dat_w,
-      i_we_a => s_cpud_we,
-      i_sel_a => s_cpud_sel,
-      o_dat_a => s_cpud_dat,
-      o_ack_a => s_cpud_ack,
-      o_stall_a => s_cpud_stall,
-      o_err_a => s_cpud_err,
+      -- Master interface A: CPU data (and DMA).
+      -- With the fixed arbitration policy this interface has precedence over interface B, and we
+      -- want the data port to have precedence.
+      i_cyc_a => s_data_cyc,
+      i_stb_a => s_data_stb,
+      i_adr_a => s_data_adr,
+      i_dat_a => s_data_dat_w,
+      i_we_a => s_data_we,
+      i_sel_a => s_data_sel,
+      o_dat_a => s_data_dat,
+      o_ack_a => s_data_ack,
+      o_stall_a => s_data_stall,
+      o_err_a => s_data_err,
 
       -- Master interface B: CPU instruction.
       i_cyc_b => s_cpui_cyc,
@@ -255,17 +423,17 @@ begin
       i_err_1 => s_vram_err,
 
       -- Slave interface 2 (0x80000000-0xbfffffff): External RAM interface
-      o_cyc_2 => o_xram_cyc,
-      o_stb_2 => o_xram_stb,
-      o_adr_2 => o_xram_adr,
-      o_dat_2 => o_xram_dat,
-      o_we_2 => o_xram_we,
-      o_sel_2 => o_xram_sel,
-      i_dat_2 => i_xram_dat,
-      i_ack_2 => i_xram_ack,
-      i_stall_2 => i_xram_stall,
+      o_cyc_2 => s_xram_cyc,
+      o_stb_2 => s_xram_stb,
+      o_adr_2 => s_xram_adr,
+      o_dat_2 => s_xram_dat_w,
+      o_we_2 => s_xram_we,
+      o_sel_2 => s_xram_sel,
+      i_dat_2 => s_xram_dat,
+      i_ack_2 => s_xram_ack,
+      i_stall_2 => s_xram_stall,
       i_rty_2 => '0',
-      i_err_2 => i_xram_err,
+      i_err_2 => s_xram_err,
 
       -- Slave interface 3 (0xc0000000-0xffffffff): Memory mapped I/O interface.
       o_cyc_3 => s_io_cyc,
@@ -278,7 +446,9 @@ begin
       i_ack_3 => s_io_ack,
       i_stall_3 => s_io_stall,
       i_rty_3 => '0',
-      i_err_3 => s_io_err
+      i_err_3 => s_io_err,
+
+      o_stats => s_xbar_stats
     );
 
   -- Internal ROM.
@@ -356,9 +526,75 @@ begin
       i_mousebtns => i_io_mousebtns,
       i_sdin => i_io_sdin,
 
-      o_regs_w => o_io_regs_w
+      i_xbar_stats => s_xbar_stats,
+      i_xram_fifo_full => i_xram_fifo_full,
+      i_vid_rst => i_vga_rst,
+      i_vid_clk => i_vga_clk,
+      i_layer1_stats => s_layer1_stats,
+      i_layer2_stats => s_layer2_stats,
+      i_line_fetch_min_margin => s_line_fetch_min_margin,
+      i_line_fetch_underruns => s_line_fetch_underruns,
+
+      o_dma_start => s_dma_start,
+      i_dma_busy => s_dma_busy,
+      i_dma_done => s_dma_done,
+      i_dma_err => s_dma_err,
+
+      o_spi_tx_stb => s_spi_tx_stb,
+      o_spi_rd_stb => s_spi_rd_stb,
+      o_spi_wr_data => s_spi_wr_data,
+      o_spi_rx_pop => s_spi_rx_pop,
+      i_spi_rx_data => s_spi_rx_data,
+      i_spi_status => s_spi_status,
+
+      o_regs_w => s_io_regs_w
     );
 
+  SpiGen: if ENABLE_SPI generate
+    signal s_spi_sck : std_logic;
+    signal s_spi_mosi : std_logic;
+    signal s_spi_cs_n : std_logic;
+  begin
+    spi_master_1: entity work.spi_master
+      port map (
+        i_rst => i_cpu_rst,
+        i_clk => i_cpu_clk,
+
+        i_enable => s_io_regs_w.SPICTL(0),
+        i_cs => s_io_regs_w.SPICTL(1),
+        i_word => s_io_regs_w.SPICTL(2),
+        i_duplex => s_io_regs_w.SPICTL(3),
+        i_div => s_io_regs_w.SPIDIV(15 downto 0),
+        i_tx_stb => s_spi_tx_stb,
+        i_rd_stb => s_spi_rd_stb,
+        i_wr_data => s_spi_wr_data,
+        i_rx_pop => s_spi_rx_pop,
+        o_rx_data => s_spi_rx_data,
+        o_status => s_spi_status,
+
+        o_sck => s_spi_sck,
+        o_mosi => s_spi_mosi,
+        o_cs_n => s_spi_cs_n,
+        i_miso => i_io_sdin(0)
+      );
+
+    -- When the SPI master is enabled it drives the SD card pins (via the same SDOUT/SDWE bits that
+    -- software uses for bit banging, so the board top levels need no changes): CLK/SCK, CMD/MOSI
+    -- and DAT3/SS* are outputs, and DAT0/MISO is an input.
+    process(s_io_regs_w, s_spi_sck, s_spi_mosi, s_spi_cs_n)
+    begin
+      o_io_regs_w <= s_io_regs_w;
+      if s_io_regs_w.SPICTL(0) = '1' then
+        o_io_regs_w.SDOUT <= 26x"0" & s_spi_sck & s_spi_mosi & s_spi_cs_n & "000";
+        o_io_regs_w.SDWE <= 27x"0" & "11000";
+      end if;
+    end process;
+  else generate
+    s_spi_rx_data <= (others => '0');
+    s_spi_status <= (others => '0');
+    o_io_regs_w <= s_io_regs_w;
+  end generate;
+
 
   --------------------------------------------------------------------------------------------------
   -- Video logic
@@ -370,7 +606,9 @@ begin
       COLOR_BITS_B => COLOR_BITS_B,
       ADR_BITS => LOG2_VRAM_SIZE-2,
       NUM_LAYERS => NUM_VIDEO_LAYERS,
-      VIDEO_CONFIG => VIDEO_CONFIG
+      VIDEO_CONFIG => VIDEO_CONFIG,
+      XRAM_LINE_FETCH => XRAM_LINE_FETCH,
+      LOG2_XRAM_LINE_WORDS => LOG2_XRAM_LINE_WORDS
     )
     port map (
       i_rst => i_vga_rst,
@@ -379,6 +617,13 @@ begin
       o_read_adr => s_video_adr,
       i_read_dat => s_video_dat,
 
+      o_line_fetch_req => s_line_fetch_req,
+      o_line_fetch_adr => s_line_fetch_adr,
+      o_line_fetch_size => s_line_fetch_size,
+      o_line_start => s_line_start,
+      o_lbuf_read_adr => s_lbuf_read_adr,
+      i_lbuf_read_dat => s_lbuf_read_dat,
+
       o_r => o_vga_r,
       o_g => o_vga_g,
       o_b => o_vga_b,
@@ -386,9 +631,108 @@ begin
       o_hsync => o_vga_hs,
       o_vsync => o_vga_vs,
 
-      o_raster_y => s_raster_y
+      o_raster_y => s_raster_y,
+
+      o_layer1_stats => s_layer1_stats,
+      o_layer2_stats => s_layer2_stats
     );
 
+  --------------------------------------------------------------------------------------------------
+  -- XRAM line buffer for video layer 1 (optional)
+  --
+  -- Only layer 1 can show rows from XRAM: There is a single line buffer, and only the layer 1 read
+  -- port of video.vhd is routed to it. Layer 2 always reads from VRAM.
+  --------------------------------------------------------------------------------------------------
+  LineFetchGen: if XRAM_LINE_FETCH generate
+    signal s_fetch_cyc : std_logic;
+    signal s_fetch_stb : std_logic;
+    signal s_fetch_adr : std_logic_vector(29 downto 0);
+    signal s_fetch_dat : std_logic_vector(31 downto 0);
+    signal s_fetch_ack : std_logic;
+    signal s_fetch_stall : std_logic;
+  begin
+    line_fetch_1: entity work.vid_line_fetch
+      generic map (
+        LOG2_LINE_WORDS => LOG2_XRAM_LINE_WORDS
+      )
+      port map (
+        i_vid_rst => i_vga_rst,
+        i_vid_clk => i_vga_clk,
+        i_fetch_req => s_line_fetch_req,
+        i_fetch_adr => s_line_fetch_adr,
+        i_fetch_size => s_line_fetch_size,
+        i_line_start => s_line_start,
+        i_read_adr => s_lbuf_read_adr,
+        o_read_dat => s_lbuf_read_dat,
+        o_min_margin => s_line_fetch_min_margin,
+        o_underruns => s_line_fetch_underruns,
+
+        i_rst => i_cpu_rst,
+        i_wb_clk => i_cpu_clk,
+        o_wb_cyc => s_fetch_cyc,
+        o_wb_stb => s_fetch_stb,
+        o_wb_adr => s_fetch_adr,
+        i_wb_dat => s_fetch_dat,
+        i_wb_ack => s_fetch_ack,
+        i_wb_stall => s_fetch_stall
+      );
+
+    -- The line fetch has precedence over the CPU.
+    xram_arbiter_1: entity work.wb_arbiter_2x1
+      port map (
+        i_rst => i_cpu_rst,
+        i_clk => i_cpu_clk,
+
+        i_cyc_a => s_fetch_cyc,
+        i_stb_a => s_fetch_stb,
+        i_adr_a => s_fetch_adr,
+        i_dat_a => (others => '0'),
+        i_we_a => '0',
+        i_sel_a => (others => '1'),
+        o_dat_a => s_fetch_dat,
+        o_ack_a => s_fetch_ack,
+        o_stall_a => s_fetch_stall,
+        o_err_a => open,
+
+        i_cyc_b => s_xram_cyc,
+        i_stb_b => s_xram_stb,
+        i_adr_b => s_xram_adr,
+        i_dat_b => s_xram_dat_w,
+        i_we_b => s_xram_we,
+        i_sel_b => s_xram_sel,
+        o_dat_b => s_xram_dat,
+        o_ack_b => s_xram_ack,
+        o_stall_b => s_xram_stall,
+        o_err_b => s_xram_err,
+
+        o_cyc => o_xram_cyc,
+        o_stb => o_xram_stb,
+        o_adr => o_xram_adr,
+        o_dat => o_xram_dat,
+        o_we => o_xram_we,
+        o_sel => o_xram_sel,
+        i_dat => i_xram_dat,
+        i_ack => i_xram_ack,
+        i_stall => i_xram_stall,
+        i_err => i_xram_err
+      );
+  else generate
+    s_lbuf_read_dat <= (others => '0');
+    s_line_fetch_min_margin <= (others => '1');
+    s_line_fetch_underruns <= (others => '0');
+
+    o_xram_cyc <= s_xram_cyc;
+    o_xram_stb <= s_xram_stb;
+    o_xram_adr <= s_xram_adr;
+    o_xram_dat <= s_xram_dat_w;
+    o_xram_we <= s_xram_we;
+    o_xram_sel <= s_xram_sel;
+    s_xram_dat <= i_xram_dat;
+    s_xram_ack <= i_xram_ack;
+    s_xram_stall <= i_xram_stall;
+    s_xram_err <= i_xram_err;
+  end generate;
+
 
   --------------------------------------------------------------------------------------------------
   -- Clock domain crossing
@@ -26,6 +26,7 @@ use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 use work.mmio_types.all;
 use work.vid_types.all;
+use work.wb_types.all;
 
 entity mmio is
   generic(
@@ -63,6 +64,30 @@ entity mmio is
     i_mousebtns : in std_logic_vector(31 downto 0);
     i_sdin : in std_logic_vector(31 downto 0);
 
+    -- Event sources for the performance counters.
+    i_xbar_stats : in T_WB_XBAR_STATS;
+    i_xram_fifo_full : in std_logic;
+    i_vid_rst : in std_logic;
+    i_vid_clk : in std_logic;
+    i_layer1_stats : in T_VID_LAYER_STATS;  -- Video clock domain.
+    i_layer2_stats : in T_VID_LAYER_STATS;  -- Video clock domain.
+    i_line_fetch_min_margin : in std_logic_vector(23 downto 0);  -- Video clock domain.
+    i_line_fetch_underruns : in std_logic_vector(15 downto 0);   -- Video clock domain.
+
+    -- DMA engine control and status.
+    o_dma_start : out std_logic;
+    i_dma_busy : in std_logic;
+    i_dma_done : in std_logic;
+    i_dma_err : in std_logic;
+
+    -- SPI master control and status. The strobes are set in the same cycle as the bus request.
+    o_spi_tx_stb : out std_logic;
+    o_spi_rd_stb : out std_logic;
+    o_spi_wr_data : out std_logic_vector(31 downto 0);
+    o_spi_rx_pop : out std_logic;
+    i_spi_rx_data : in std_logic_vector(31 downto 0);
+    i_spi_status : in std_logic_vector(31 downto 0);
+
     -- All output registers are exported externally.
     o_regs_w: out T_MMIO_REGS_WO
   );
@@ -106,8 +131,28 @@ architecture rtl of mmio is
   constant C_ADR_LEDS       : T_REG_ADR := reg_adr(24);
   constant C_ADR_SDOUT      : T_REG_ADR := reg_adr(25);
   constant C_ADR_SDWE       : T_REG_ADR := reg_adr(26);
-
-  constant C_ADR_KEYBUF     : T_REG_ADR := reg_adr(32);
+  constant C_ADR_PERFSEL    : T_REG_ADR := reg_adr(27);
+  constant C_ADR_PERFCNT    : T_REG_ADR := reg_adr(28);
+  constant C_ADR_PERFCTL    : T_REG_ADR := reg_adr(29);
+
+  constant C_ADR_KEYBUF     : T_REG_ADR := reg_adr(32);  -- 32-47: Key buffer
+
+  constant C_ADR_DMASRC     : T_REG_ADR := reg_adr(48);
+  constant C_ADR_DMADST     : T_REG_ADR := reg_adr(49);
+  constant C_ADR_DMAWIDTH   : T_REG_ADR := reg_adr(50);
+  constant C_ADR_DMAHEIGHT  : T_REG_ADR := reg_adr(51);
+  constant C_ADR_DMASSTRIDE : T_REG_ADR := reg_adr(52);
+  constant C_ADR_DMADSTRIDE : T_REG_ADR := reg_adr(53);
+  constant C_ADR_DMAFILL    : T_REG_ADR := reg_adr(54);
+  constant C_ADR_DMACTL     : T_REG_ADR := reg_adr(55);
+  constant C_ADR_DMASTAT    : T_REG_ADR := reg_adr(56);
+
+  constant C_ADR_SPICTL     : T_REG_ADR := reg_adr(57);
+  constant C_ADR_SPIDIV     : T_REG_ADR := reg_adr(58);
+  constant C_ADR_SPITX      : T_REG_ADR := reg_adr(59);  -- Write: Push to the TX FIFO
+  constant C_ADR_SPIRX      : T_REG_ADR := reg_adr(60);
+  constant C_ADR_SPISTAT    : T_REG_ADR := reg_adr(61);
+  constant C_ADR_SPIRDCNT   : T_REG_ADR := reg_adr(62);  -- Write: Number of entries to receive
 
   -- Keyboard events are stored in a circular buffer.
   constant C_LOG2_KEY_BUF_SIZE : integer := 4;
@@ -116,6 +161,35 @@ architecture rtl of mmio is
   type T_KEY_BUF is array (0 to C_KEY_BUF_SIZE-1) of T_KEY_EVENT;
   subtype T_KEY_BUF_ADR is integer range 0 to C_KEY_BUF_SIZE-1;
 
+  -- Performance counters. Each counter is incremented by the number of events per cycle, and is
+  -- read by writing the counter index to PERFSEL and reading PERFCNT.
+  --   0-2:   Crossbar master A (CPU data): Granted requests, stall cycles, pending requests.
+  --   3-5:   Crossbar master B (CPU instruction): Same as for master A.
+  --   6-8:   Crossbar slave 0 (ROM): Granted requests, stall cycles, pending requests.
+  --   9-11:  Crossbar slave 1 (VRAM): Same as for slave 0.
+  --   12-14: Crossbar slave 2 (XRAM): Same as for slave 0.
+  --   15-17: Crossbar slave 3 (MMIO): Same as for slave 0.
+  --   18-20: Video layer 1 pixel prefetch: Cache hits, cache misses, speculative reads.
+  --   21:    Video layer 1 VCPP: Instruction fetch stall cycles (video clock cycles).
+  --   22:    Video layer 2 VCPP: Instruction fetch stall cycles (video clock cycles).
+  --   23:    XRAM: Request FIFO full cycles.
+  -- The following indices are not counters, but read-only values from the XRAM line fetch of video
+  -- layer 1 (see vid_line_fetch.vhd). They are not affected by PERFCTL, and are kept until reset.
+  --   24:    Smallest bandwidth margin in video clock cycles (0xffffff if no row has been shown).
+  --   25:    Number of rows that were not fetched in time (saturating).
+  -- The "pending requests" counters accumulate the number of pending requests every cycle, so
+  -- dividing by the number of granted requests gives the average request latency.
+  --
+  -- PERFCTL controls all the counters:
+  --   bit 0: Freeze (the counters keep their values while this bit is set).
+  --   bit 1: Clear (writing a 1 clears all the counters, the bit always reads as 0).
+  constant C_NUM_PERF_COUNTERS : integer := 24;
+  subtype T_PERF_COUNTER is unsigned(31 downto 0);
+  type T_PERF_COUNTERS is array (0 to C_NUM_PERF_COUNTERS-1) of T_PERF_COUNTER;
+  type T_PERF_INCREMENTS is array (0 to C_NUM_PERF_COUNTERS-1) of T_WB_REQ_COUNT;
+  constant C_PERF_LINE_FETCH_MIN_MARGIN : integer := 24;
+  constant C_PERF_LINE_FETCH_UNDERRUNS : integer := 25;
+
   -- Clock and counter signals.
   signal s_vidy_msb : std_logic;
   signal s_prev_vidy_msb : std_logic;
@@ -130,6 +204,16 @@ architecture rtl of mmio is
   -- Registers.
   signal s_regs_r : T_MMIO_REGS_RO;
   signal s_regs_w : T_MMIO_REGS_WO;
+  signal s_dma_start : std_logic;
+
+  -- Line fetch statistics in the CPU clock domain.
+  signal s_line_fetch_min_margin : std_logic_vector(23 downto 0);
+  signal s_line_fetch_underruns : std_logic_vector(15 downto 0);
+
+  -- Performance counters.
+  signal s_perf_inc : T_PERF_INCREMENTS;
+  signal s_perf_counters : T_PERF_COUNTERS;
+  signal s_perf_clear : std_logic;
 
   -- Keyboard input circular buffer.
   signal s_key_buf : T_KEY_BUF;
@@ -148,6 +232,14 @@ architecture rtl of mmio is
     return v_ext;
   end function;
 
+  function event_count(x : std_logic) return T_WB_REQ_COUNT is
+  begin
+    if x = '1' then
+      return to_unsigned(1, T_WB_REQ_COUNT'length);
+    end if;
+    return to_unsigned(0, T_WB_REQ_COUNT'length);
+  end function;
+
   function reg_adr_to_key_buf_adr(x : T_REG_ADR) return T_KEY_BUF_ADR is
   begin
     -- NOTE: This is a simplification that works since C_ADR_KEYBUF is
@@ -205,6 +297,103 @@ begin
   s_regs_r.MOUSEBTNS <= i_mousebtns;
   s_regs_r.SDIN <= i_sdin;
 
+  -- Performance counters.
+  s_perf_inc(0) <= event_count(i_xbar_stats.grant_a);
+  s_perf_inc(1) <= event_count(i_xbar_stats.stall_a);
+  s_perf_inc(2) <= i_xbar_stats.pending_a;
+  s_perf_inc(3) <= event_count(i_xbar_stats.grant_b);
+  s_perf_inc(4) <= event_count(i_xbar_stats.stall_b);
+  s_perf_inc(5) <= i_xbar_stats.pending_b;
+  SlavePerfGen: for k in 0 to 3 generate
+  begin
+    s_perf_inc(6 + 3*k) <= event_count(i_xbar_stats.slave_grant(k));
+    s_perf_inc(7 + 3*k) <= event_count(i_xbar_stats.slave_stall(k));
+    s_perf_inc(8 + 3*k) <= i_xbar_stats.slave_pending(k);
+  end generate;
+  s_perf_inc(23) <= event_count(i_xram_fifo_full);
+
+  -- Video events are passed over from the video clock domain.
+  VidPerfGen: for k in 0 to 4 generate
+    signal s_event : std_logic;
+    signal s_count : unsigned(3 downto 0);
+  begin
+    s_event <= i_layer1_stats.pix_hit when k = 0 else
+               i_layer1_stats.pix_miss when k = 1 else
+               i_layer1_stats.pix_speculative when k = 2 else
+               i_layer1_stats.vcpp_stall when k = 3 else
+               i_layer2_stats.vcpp_stall;
+
+    event_synchronizer_1: entity work.event_synchronizer
+      generic map (
+        BITS => s_count'length
+      )
+      port map (
+        i_src_rst => i_vid_rst,
+        i_src_clk => i_vid_clk,
+        i_event => s_event,
+        i_rst => i_rst,
+        i_clk => i_wb_clk,
+        o_count => s_count
+      );
+
+    s_perf_inc(18 + k) <= resize(s_count, T_WB_REQ_COUNT'length);
+  end generate;
+
+  process(i_rst, i_wb_clk)
+  begin
+    if i_rst = '1' then
+      s_perf_counters <= (others => (others => '0'));
+    elsif rising_edge(i_wb_clk) then
+      if s_perf_clear = '1' then
+        s_perf_counters <= (others => (others => '0'));
+      elsif s_regs_w.PERFCTL(0) = '0' then
+        for k in 0 to C_NUM_PERF_COUNTERS-1 loop
+          s_perf_counters(k) <= s_perf_counters(k) + s_perf_inc(k);
+        end loop;
+      end if;
+    end if;
+  end process;
+
+  s_perf_clear <= s_we and i_wb_dat(1) when s_reg_adr = C_ADR_PERFCTL else '0';
+
+  s_regs_r.DMASTAT <= 29x"0" & i_dma_err & i_dma_done & i_dma_busy;
+
+  s_regs_r.SPIRX <= i_spi_rx_data;
+  s_regs_r.SPISTAT <= i_spi_status;
+
+  -- The line fetch statistics change at most once per raster line, so the synchronizers will see
+  -- steady values.
+  sync_line_fetch_min_margin: entity work.synchronizer
+    generic map (
+      BITS => s_line_fetch_min_margin'length
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_wb_clk,
+      i_d => i_line_fetch_min_margin,
+      o_q => s_line_fetch_min_margin
+    );
+
+  sync_line_fetch_underruns: entity work.synchronizer
+    generic map (
+      BITS => s_line_fetch_underruns'length
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_wb_clk,
+      i_d => i_line_fetch_underruns,
+      o_q => s_line_fetch_underruns
+    );
+
+  s_regs_r.PERFCNT <=
+      std_logic_vector(s_perf_counters(to_integer(unsigned(s_regs_w.PERFSEL))))
+      when unsigned(s_regs_w.PERFSEL) < C_NUM_PERF_COUNTERS else
+      x"00" & s_line_fetch_min_margin
+      when unsigned(s_regs_w.PERFSEL) = C_PERF_LINE_FETCH_MIN_MARGIN else
+      x"0000" & s_line_fetch_underruns
+      when unsigned(s_regs_w.PERFSEL) = C_PERF_LINE_FETCH_UNDERRUNS else
+      (others => '0');
+
   -- Key event circular buffer.
   process(i_rst, i_wb_clk)
     variable v_new_keyptr : unsigned(31 downto 0);
@@ -270,6 +459,19 @@ begin
       s_regs_w.LEDS <= (others => '0');
       s_regs_w.SDOUT <= (others => '0');
       s_regs_w.SDWE <= (others => '0');
+      s_regs_w.PERFSEL <= (others => '0');
+      s_regs_w.PERFCTL <= (others => '0');
+      s_regs_w.DMASRC <= (others => '0');
+      s_regs_w.DMADST <= (others => '0');
+      s_regs_w.DMAWIDTH <= (others => '0');
+      s_regs_w.DMAHEIGHT <= (others => '0');
+      s_regs_w.DMASSTRIDE <= (others => '0');
+      s_regs_w.DMADSTRIDE <= (others => '0');
+      s_regs_w.DMAFILL <= (others => '0');
+      s_regs_w.DMACTL <= (others => '0');
+      s_regs_w.SPICTL <= (others => '0');
+      s_regs_w.SPIDIV <= (others => '0');
+      s_dma_start <= '0';
     elsif rising_edge(i_wb_clk) then
       -- All registers are readable.
       if s_reg_adr = C_ADR_CLKCNTLO then
@@ -326,7 +528,39 @@ begin
         o_wb_dat <= s_regs_w.SDOUT;
       elsif s_reg_adr = C_ADR_SDWE then
         o_wb_dat <= s_regs_w.SDWE;
-      elsif s_reg_adr >= C_ADR_KEYBUF then
+      elsif s_reg_adr = C_ADR_PERFSEL then
+        o_wb_dat <= s_regs_w.PERFSEL;
+      elsif s_reg_adr = C_ADR_PERFCNT then
+        o_wb_dat <= s_regs_r.PERFCNT;
+      elsif s_reg_adr = C_ADR_PERFCTL then
+        o_wb_dat <= s_regs_w.PERFCTL;
+      elsif s_reg_adr = C_ADR_DMASRC then
+        o_wb_dat <= s_regs_w.DMASRC;
+      elsif s_reg_adr = C_ADR_DMADST then
+        o_wb_dat <= s_regs_w.DMADST;
+      elsif s_reg_adr = C_ADR_DMAWIDTH then
+        o_wb_dat <= s_regs_w.DMAWIDTH;
+      elsif s_reg_adr = C_ADR_DMAHEIGHT then
+        o_wb_dat <= s_regs_w.DMAHEIGHT;
+      elsif s_reg_adr = C_ADR_DMASSTRIDE then
+        o_wb_dat <= s_regs_w.DMASSTRIDE;
+      elsif s_reg_adr = C_ADR_DMADSTRIDE then
+        o_wb_dat <= s_regs_w.DMADSTRIDE;
+      elsif s_reg_adr = C_ADR_DMAFILL then
+        o_wb_dat <= s_regs_w.DMAFILL;
+      elsif s_reg_adr = C_ADR_DMACTL then
+        o_wb_dat <= s_regs_w.DMACTL;
+      elsif s_reg_adr = C_ADR_DMASTAT then
+        o_wb_dat <= s_regs_r.DMASTAT;
+      elsif s_reg_adr = C_ADR_SPICTL then
+        o_wb_dat <= s_regs_w.SPICTL;
+      elsif s_reg_adr = C_ADR_SPIDIV then
+        o_wb_dat <= s_regs_w.SPIDIV;
+      elsif s_reg_adr = C_ADR_SPIRX then
+        o_wb_dat <= s_regs_r.SPIRX;
+      elsif s_reg_adr = C_ADR_SPISTAT then
+        o_wb_dat <= s_regs_r.SPISTAT;
+      elsif s_reg_adr >= C_ADR_KEYBUF and s_reg_adr < C_ADR_KEYBUF + C_KEY_BUF_SIZE then
         v_key_event := s_key_buf(reg_adr_to_key_buf_adr(s_reg_adr));
         o_wb_dat <= v_key_event(9) & "0000000000000000000000" & v_key_event(8 downto 0);
       else
@@ -357,9 +591,41 @@ begin
           s_regs_w.SDOUT <= i_wb_dat;
         elsif s_reg_adr = C_ADR_SDWE then
           s_regs_w.SDWE <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_PERFSEL then
+          s_regs_w.PERFSEL <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_PERFCTL then
+          s_regs_w.PERFCTL <= 31x"0" & i_wb_dat(0);
+        elsif s_reg_adr = C_ADR_DMASRC then
+          s_regs_w.DMASRC <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMADST then
+          s_regs_w.DMADST <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMAWIDTH then
+          s_regs_w.DMAWIDTH <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMAHEIGHT then
+          s_regs_w.DMAHEIGHT <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMASSTRIDE then
+          s_regs_w.DMASSTRIDE <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMADSTRIDE then
+          s_regs_w.DMADSTRIDE <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMAFILL then
+          s_regs_w.DMAFILL <= i_wb_dat;
+        elsif s_reg_adr = C_ADR_DMACTL then
+          s_regs_w.DMACTL <= 30x"0" & i_wb_dat(1) & '0';
+        elsif s_reg_adr = C_ADR_SPICTL then
+          s_regs_w.SPICTL <= 28x"0" & i_wb_dat(3 downto 0);
+        elsif s_reg_adr = C_ADR_SPIDIV then
+          s_regs_w.SPIDIV <= 16x"0" & i_wb_dat(15 downto 0);
         end if;
       end if;
 
+      -- Start the DMA engine in the cycle after DMACTL has been written, so that it sees the new
+      -- transfer mode.
+      if s_we = '1' and s_reg_adr = C_ADR_DMACTL then
+        s_dma_start <= i_wb_dat(0);
+      else
+        s_dma_start <= '0';
+      end if;
+
       -- Instant ack!
       o_wb_ack <= s_request;
     end if;
@@ -371,4 +637,13 @@ begin
   --------------------------------------------------------------------------------------------------
 
   o_regs_w <= s_regs_w;
+  o_dma_start <= s_dma_start;
+
+  -- The SPI FIFOs are pushed and popped in the same cycle as the request, so that a status read
+  -- that follows right after a push or a pop sees the new FIFO state. Note that the RX data is
+  -- registered by the read mux above before the pop takes effect.
+  o_spi_tx_stb <= s_we when s_reg_adr = C_ADR_SPITX else '0';
+  o_spi_rd_stb <= s_we when s_reg_adr = C_ADR_SPIRDCNT else '0';
+  o_spi_wr_data <= i_wb_dat;
+  o_spi_rx_pop <= s_request and not i_wb_we when s_reg_adr = C_ADR_SPIRX else '0';
 end rtl;
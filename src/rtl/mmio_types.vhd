@@ -56,6 +56,16 @@ package mmio_types is
                                    --   2: DAT2
                                    --   3: DAT3/SS*
                                    --   4: CMD/MOSI
+
+    -- Performance counters.
+    PERFCNT : T_MMIO_REG_WORD;     -- The performance counter that is selected by PERFSEL.
+
+    -- DMA engine.
+    DMASTAT : T_MMIO_REG_WORD;     -- DMA status (bit 0: busy, bit 1: done, bit 2: bus error).
+
+    -- SPI master.
+    SPIRX : T_MMIO_REG_WORD;       -- Received data (reading pops the RX FIFO).
+    SPISTAT : T_MMIO_REG_WORD;     -- SPI status (see spi_master.vhd).
   end record T_MMIO_REGS_RO;
 
   --------------------------------------------------------------------------------------------------
@@ -85,5 +95,27 @@ package mmio_types is
                                    --   5: CLK/SCK   (always unmasked)
     SDWE : T_MMIO_REG_WORD;        -- SD card write enable bit mask (bits 0-4).
 
+    -- Performance counters.
+    PERFSEL : T_MMIO_REG_WORD;     -- Performance counter index (see mmio.vhd).
+    PERFCTL : T_MMIO_REG_WORD;     -- Performance counter control (bit 0: freeze).
+
+    -- DMA engine (see dma.vhd).
+    DMASRC : T_MMIO_REG_WORD;      -- Source byte address.
+    DMADST : T_MMIO_REG_WORD;      -- Destination byte address.
+    DMAWIDTH : T_MMIO_REG_WORD;    -- Number of words per row.
+    DMAHEIGHT : T_MMIO_REG_WORD;   -- Number of rows.
+    DMASSTRIDE : T_MMIO_REG_WORD;  -- Source row stride in bytes.
+    DMADSTRIDE : T_MMIO_REG_WORD;  -- Destination row stride in bytes.
+    DMAFILL : T_MMIO_REG_WORD;     -- Fill value.
+    DMACTL : T_MMIO_REG_WORD;      -- DMA control (bit 1: fill). Writing bit 0 starts a transfer.
+
+    -- SPI master (see spi_master.vhd).
+    SPICTL : T_MMIO_REG_WORD;      -- SPI control:
+                                   --   0: Enable (the SPI master drives the SD card pins)
+                                   --   1: Chip select (active high)
+                                   --   2: Word transfers (four bytes per FIFO entry)
+                                   --   3: Duplex (store the data received during TX transfers)
+    SPIDIV : T_MMIO_REG_WORD;      -- SCK half period in CPU clock cycles, minus one (min. 1).
+
   end record T_MMIO_REGS_WO;
 end package;
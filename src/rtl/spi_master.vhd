@@ -0,0 +1,281 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- SPI master (mode 0, MSB first) with TX and RX FIFOs, for the SD card interface.
+--
+-- Each FIFO entry is one transfer of either a byte (bits 7..0) or a word (four bytes in memory
+-- order, i.e. bits 7..0 first), as selected by i_word when the transfer starts. Entries that are
+-- pushed to the TX FIFO are sent, and the received data is only pushed to the RX FIFO if i_duplex
+-- is set. Writing a count with i_rd_stb requests that many receive-only transfers (MOSI is held
+-- high, which is what an SD card expects while it sends data). They start once the TX FIFO is
+-- empty. The clock is stopped while the RX FIFO is full, so no received data is ever lost.
+--
+-- SCK is low for i_div+1 cycles and high for i_div+1 cycles (i_div is at least 1). MOSI changes on
+-- the falling edge of SCK. MISO is also sampled at the falling edge (rather than at the rising
+-- edge), which leaves room for the latency of the input synchronizer.
+--
+-- o_status:
+--   bit 0:     Busy (a transfer is in progress or pending).
+--   bit 1:     The TX FIFO is full (writes are dropped).
+--   bit 2:     The RX FIFO is empty.
+--   bits 15-8: Number of entries in the RX FIFO.
+--   bit 31:    Always 1 (the SPI master is present).
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity spi_master is
+  generic(
+    LOG2_FIFO_DEPTH : positive := 4
+  );
+  port(
+    i_rst : in std_logic;
+    i_clk : in std_logic;
+
+    -- Control interface.
+    i_enable : in std_logic;
+    i_cs : in std_logic;
+    i_word : in std_logic;
+    i_duplex : in std_logic;
+    i_div : in std_logic_vector(15 downto 0);
+    i_tx_stb : in std_logic;
+    i_rd_stb : in std_logic;
+    i_wr_data : in std_logic_vector(31 downto 0);  -- TX data (i_tx_stb) or count (i_rd_stb).
+    i_rx_pop : in std_logic;
+    o_rx_data : out std_logic_vector(31 downto 0);
+    o_status : out std_logic_vector(31 downto 0);
+
+    -- SPI interface.
+    o_sck : out std_logic;
+    o_mosi : out std_logic;
+    o_cs_n : out std_logic;
+    i_miso : in std_logic
+  );
+end spi_master;
+
+architecture rtl of spi_master is
+  constant C_FIFO_DEPTH : integer := 2**LOG2_FIFO_DEPTH;
+
+  type T_STATE is (IDLE, SHIFT);
+
+  subtype T_COUNT is unsigned(15 downto 0);
+
+  signal s_state : T_STATE;
+  signal s_miso : std_logic;
+  signal s_div : T_COUNT;
+  signal s_half_cnt : T_COUNT;
+  signal s_sck : std_logic;
+  signal s_shift_out : std_logic_vector(31 downto 0);
+  signal s_shift_in : std_logic_vector(31 downto 0);
+  signal s_bits_left : unsigned(5 downto 0);
+  signal s_word : std_logic;
+  signal s_store_rx : std_logic;
+  signal s_rd_count : T_COUNT;
+
+  signal s_start_tx : std_logic;
+  signal s_start_rd : std_logic;
+  signal s_rx_blocked : std_logic;
+
+  signal s_tx_push : std_logic;
+  signal s_tx_pop : std_logic;
+  signal s_tx_data : std_logic_vector(31 downto 0);
+  signal s_tx_full : std_logic;
+  signal s_tx_empty : std_logic;
+
+  signal s_rx_push : std_logic;
+  signal s_rx_pop : std_logic;
+  signal s_rx_push_data : std_logic_vector(31 downto 0);
+  signal s_rx_full : std_logic;
+  signal s_rx_empty : std_logic;
+  signal s_rx_level : unsigned(LOG2_FIFO_DEPTH downto 0);
+
+  -- Words are transferred in memory order, so swap the bytes to and from the shift registers
+  -- (which shift out and in at the most significant end).
+  function byte_swap(x : std_logic_vector(31 downto 0)) return std_logic_vector is
+  begin
+    return x(7 downto 0) & x(15 downto 8) & x(23 downto 16) & x(31 downto 24);
+  end function;
+begin
+  assert LOG2_FIFO_DEPTH <= 7 report "The FIFO level must fit in 8 status bits" severity failure;
+
+  miso_sync: entity work.bit_synchronizer
+    generic map (
+      STEADY_CYCLES => 0
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_clk,
+      i_d => i_miso,
+      o_q => s_miso
+    );
+
+  tx_fifo: entity work.fifo
+    generic map (
+      G_WIDTH => 32,
+      G_DEPTH => C_FIFO_DEPTH
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_clk,
+      i_wr_en => s_tx_push,
+      i_wr_data => i_wr_data,
+      o_full => s_tx_full,
+      i_rd_en => s_tx_pop,
+      o_rd_data => s_tx_data,
+      o_empty => s_tx_empty
+    );
+
+  rx_fifo: entity work.fifo
+    generic map (
+      G_WIDTH => 32,
+      G_DEPTH => C_FIFO_DEPTH
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_clk,
+      i_wr_en => s_rx_push,
+      i_wr_data => s_rx_push_data,
+      o_full => s_rx_full,
+      i_rd_en => s_rx_pop,
+      o_rd_data => o_rx_data,
+      o_empty => s_rx_empty
+    );
+
+  s_tx_push <= i_tx_stb and not s_tx_full;
+  s_rx_pop <= i_rx_pop and not s_rx_empty;
+
+  -- Only start a transfer that stores its received data if there is room for it in the RX FIFO
+  -- (including the entry that is about to be pushed).
+  s_rx_blocked <= s_rx_full or s_rx_push;
+  s_start_tx <= '1' when s_state = IDLE and i_enable = '1' and s_tx_empty = '0' and
+                         (i_duplex = '0' or s_rx_blocked = '0') else '0';
+  s_start_rd <= '1' when s_state = IDLE and i_enable = '1' and s_tx_empty = '1' and
+                         s_rd_count /= 0 and s_rx_blocked = '0' else '0';
+  s_tx_pop <= s_start_tx;
+
+  process(i_rst, i_clk)
+  begin
+    if i_rst = '1' then
+      s_state <= IDLE;
+      s_div <= to_unsigned(1, T_COUNT'length);
+      s_half_cnt <= (others => '0');
+      s_sck <= '0';
+      s_shift_out <= (others => '1');
+      s_shift_in <= (others => '0');
+      s_bits_left <= (others => '0');
+      s_word <= '0';
+      s_store_rx <= '0';
+      s_rd_count <= (others => '0');
+      s_rx_push <= '0';
+    elsif rising_edge(i_clk) then
+      s_rx_push <= '0';
+
+      if i_rd_stb = '1' then
+        s_rd_count <= unsigned(i_wr_data(15 downto 0));
+      elsif s_start_rd = '1' then
+        s_rd_count <= s_rd_count - 1;
+      end if;
+
+      case s_state is
+        when IDLE =>
+          if s_start_tx = '1' or s_start_rd = '1' then
+            if s_start_rd = '1' then
+              s_shift_out <= (others => '1');
+              s_store_rx <= '1';
+            elsif i_word = '1' then
+              s_shift_out <= byte_swap(s_tx_data);
+              s_store_rx <= i_duplex;
+            else
+              s_shift_out <= s_tx_data(7 downto 0) & x"ffffff";
+              s_store_rx <= i_duplex;
+            end if;
+            s_word <= i_word;
+            if i_word = '1' then
+              s_bits_left <= to_unsigned(32, s_bits_left'length);
+            else
+              s_bits_left <= to_unsigned(8, s_bits_left'length);
+            end if;
+
+            -- The clock divider is latched for the entire transfer.
+            if unsigned(i_div) = 0 then
+              s_div <= to_unsigned(1, T_COUNT'length);
+              s_half_cnt <= to_unsigned(1, T_COUNT'length);
+            else
+              s_div <= unsigned(i_div);
+              s_half_cnt <= unsigned(i_div);
+            end if;
+            s_state <= SHIFT;
+          end if;
+
+        when SHIFT =>
+          if s_half_cnt /= 0 then
+            s_half_cnt <= s_half_cnt - 1;
+          else
+            s_half_cnt <= s_div;
+            if s_sck = '0' then
+              -- Rising edge (the slave samples MOSI).
+              s_sck <= '1';
+            else
+              -- Falling edge: Sample MISO and shift out the next bit.
+              s_sck <= '0';
+              s_shift_in <= s_shift_in(30 downto 0) & s_miso;
+              s_shift_out <= s_shift_out(30 downto 0) & '1';
+              s_bits_left <= s_bits_left - 1;
+              if s_bits_left = 1 then
+                s_rx_push <= s_store_rx;
+                s_state <= IDLE;
+              end if;
+            end if;
+          end if;
+      end case;
+    end if;
+  end process;
+
+  s_rx_push_data <= byte_swap(s_shift_in) when s_word = '1' else x"000000" & s_shift_in(7 downto 0);
+
+  -- Keep track of the RX FIFO level (for the status register).
+  process(i_rst, i_clk)
+  begin
+    if i_rst = '1' then
+      s_rx_level <= (others => '0');
+    elsif rising_edge(i_clk) then
+      if s_rx_push = '1' and s_rx_pop = '0' then
+        s_rx_level <= s_rx_level + 1;
+      elsif s_rx_push = '0' and s_rx_pop = '1' then
+        s_rx_level <= s_rx_level - 1;
+      end if;
+    end if;
+  end process;
+
+  o_status(0) <= '1' when s_state /= IDLE or s_tx_empty = '0' or s_rd_count /= 0 or
+                          s_rx_push = '1' else '0';
+  o_status(1) <= s_tx_full;
+  o_status(2) <= s_rx_empty;
+  o_status(7 downto 3) <= (others => '0');
+  o_status(15 downto 8) <= std_logic_vector(resize(s_rx_level, 8));
+  o_status(30 downto 16) <= (others => '0');
+  o_status(31) <= '1';
+
+  o_sck <= s_sck;
+  o_mosi <= s_shift_out(31);
+  o_cs_n <= not i_cs;
+end rtl;
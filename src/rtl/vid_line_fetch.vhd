@@ -0,0 +1,275 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- XRAM scanline prefetch engine (for video layer 1, which is the only layer that can show XRAM).
+--
+-- The pixel pipeline can not read XRAM directly (the SDRAM latency is far too long), so instead
+-- whole rows are fetched into a double buffered line buffer one raster line ahead of time:
+--
+--  * When the VCP writes LADDR (the XRAM word address of a row), LSIZE words are fetched from
+--    XRAM into the back half of the line buffer, using pipelined Wishbone reads (which the XRAM
+--    controller turns into burst reads).
+--  * At the start of the next raster line the halves are swapped, and the layer reads the row from
+--    the front half. If LADDR is not written during a line, the current row is repeated.
+--
+-- The engine also measures the bandwidth margin: o_min_margin is the smallest number of video
+-- clock cycles between the end of a row fetch and the start of the line that displays the row, and
+-- o_underruns is the number of rows that were not completely fetched in time. The CPU can read
+-- both values with the performance counter registers (see mmio.vhd).
+--
+-- The request is passed to the Wishbone clock domain with a toggle handshake. The request
+-- registers are stable for several cycles before the toggle is seen in the Wishbone clock domain,
+-- and at most one request per raster line is supported.
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity vid_line_fetch is
+  generic(
+    LOG2_LINE_WORDS : positive := 10  -- The line buffer holds 2**LOG2_LINE_WORDS words per row.
+  );
+  port(
+    -- Video clock domain.
+    i_vid_rst : in std_logic;
+    i_vid_clk : in std_logic;
+    i_fetch_req : in std_logic;
+    i_fetch_adr : in std_logic_vector(23 downto 0);
+    i_fetch_size : in std_logic_vector(23 downto 0);
+    i_line_start : in std_logic;
+    i_read_adr : in std_logic_vector(LOG2_LINE_WORDS-1 downto 0);
+    o_read_dat : out std_logic_vector(31 downto 0);
+    o_min_margin : out std_logic_vector(23 downto 0);
+    o_underruns : out std_logic_vector(15 downto 0);
+
+    -- Wishbone master interface (b4 pipelined, read only).
+    i_rst : in std_logic;
+    i_wb_clk : in std_logic;
+    o_wb_cyc : out std_logic;
+    o_wb_stb : out std_logic;
+    o_wb_adr : out std_logic_vector(29 downto 0);
+    i_wb_dat : in std_logic_vector(31 downto 0);
+    i_wb_ack : in std_logic;
+    i_wb_stall : in std_logic
+  );
+end vid_line_fetch;
+
+architecture rtl of vid_line_fetch is
+  constant C_LINE_WORDS : integer := 2**LOG2_LINE_WORDS;
+  constant C_MAX_MARGIN : unsigned(23 downto 0) := (others => '1');
+  constant C_MAX_UNDERRUNS : unsigned(15 downto 0) := (others => '1');
+
+  subtype T_COUNT is unsigned(LOG2_LINE_WORDS downto 0);
+
+  -- Video clock domain.
+  signal s_req_toggle : std_logic;
+  signal s_req_adr : std_logic_vector(23 downto 0);
+  signal s_req_size : T_COUNT;
+  signal s_req_half : std_logic;
+  signal s_show_pending : std_logic;
+  signal s_front_half : std_logic;
+  signal s_done_toggle_vid : std_logic;
+  signal s_done : std_logic;
+  signal s_prev_done : std_logic;
+  signal s_margin : unsigned(23 downto 0);
+  signal s_min_margin : unsigned(23 downto 0);
+  signal s_underruns : unsigned(15 downto 0);
+
+  -- Wishbone clock domain.
+  signal s_req_toggle_wb : std_logic;
+  signal s_served_toggle : std_logic;
+  signal s_done_toggle : std_logic;
+  signal s_busy : std_logic;
+  signal s_adr : unsigned(23 downto 0);
+  signal s_issue_left : T_COUNT;
+  signal s_ack_left : T_COUNT;
+  signal s_stb : std_logic;
+  signal s_wr_half : std_logic;
+  signal s_wr_idx : unsigned(LOG2_LINE_WORDS-1 downto 0);
+  signal s_wr_en : std_logic;
+  signal s_wr_adr : std_logic_vector(LOG2_LINE_WORDS downto 0);
+  signal s_rd_adr : std_logic_vector(LOG2_LINE_WORDS downto 0);
+begin
+  --------------------------------------------------------------------------------------------------
+  -- Video clock domain: Requests, line buffer swapping and statistics.
+  --------------------------------------------------------------------------------------------------
+
+  -- The requested row has been fetched when the Wishbone side has served the latest request.
+  s_done <= '1' when s_done_toggle_vid = s_req_toggle else '0';
+
+  process(i_vid_clk, i_vid_rst)
+    variable v_front_half : std_logic;
+  begin
+    if i_vid_rst = '1' then
+      s_req_toggle <= '0';
+      s_req_adr <= (others => '0');
+      s_req_size <= (others => '0');
+      s_req_half <= '1';
+      s_show_pending <= '0';
+      s_front_half <= '0';
+      s_prev_done <= '1';
+      s_margin <= (others => '0');
+      s_min_margin <= C_MAX_MARGIN;
+      s_underruns <= (others => '0');
+    elsif rising_edge(i_vid_clk) then
+      -- Count the cycles since the last row fetch was completed.
+      s_prev_done <= s_done;
+      if s_done = '1' and s_prev_done = '0' then
+        s_margin <= (others => '0');
+      elsif s_margin /= C_MAX_MARGIN then
+        s_margin <= s_margin + 1;
+      end if;
+
+      -- Show the new row (if any) at the start of the raster line.
+      v_front_half := s_front_half;
+      if i_line_start = '1' and s_show_pending = '1' then
+        v_front_half := s_req_half;
+        s_show_pending <= '0';
+        if s_done = '1' then
+          if s_margin < s_min_margin then
+            s_min_margin <= s_margin;
+          end if;
+        elsif s_underruns /= C_MAX_UNDERRUNS then
+          s_underruns <= s_underruns + 1;
+        end if;
+      end if;
+      s_front_half <= v_front_half;
+
+      -- Request a new row into the back half of the line buffer.
+      if i_fetch_req = '1' then
+        s_req_adr <= i_fetch_adr;
+        if unsigned(i_fetch_size) > C_LINE_WORDS then
+          s_req_size <= to_unsigned(C_LINE_WORDS, s_req_size'length);
+        else
+          s_req_size <= resize(unsigned(i_fetch_size), s_req_size'length);
+        end if;
+        s_req_half <= not v_front_half;
+        s_req_toggle <= not s_req_toggle;
+        s_show_pending <= '1';
+      end if;
+    end if;
+  end process;
+
+  s_rd_adr <= s_front_half & i_read_adr;
+
+  o_min_margin <= std_logic_vector(s_min_margin);
+  o_underruns <= std_logic_vector(s_underruns);
+
+  --------------------------------------------------------------------------------------------------
+  -- Clock domain crossing.
+  --------------------------------------------------------------------------------------------------
+
+  req_sync: entity work.bit_synchronizer
+    generic map (
+      STEADY_CYCLES => 0
+    )
+    port map (
+      i_rst => i_rst,
+      i_clk => i_wb_clk,
+      i_d => s_req_toggle,
+      o_q => s_req_toggle_wb
+    );
+
+  done_sync: entity work.bit_synchronizer
+    generic map (
+      STEADY_CYCLES => 0
+    )
+    port map (
+      i_rst => i_vid_rst,
+      i_clk => i_vid_clk,
+      i_d => s_done_toggle,
+      o_q => s_done_toggle_vid
+    );
+
+  --------------------------------------------------------------------------------------------------
+  -- Wishbone clock domain: Fetch rows from XRAM.
+  --------------------------------------------------------------------------------------------------
+
+  process(i_wb_clk, i_rst)
+  begin
+    if i_rst = '1' then
+      s_served_toggle <= '0';
+      s_done_toggle <= '0';
+      s_busy <= '0';
+      s_adr <= (others => '0');
+      s_issue_left <= (others => '0');
+      s_ack_left <= (others => '0');
+      s_wr_half <= '0';
+      s_wr_idx <= (others => '0');
+    elsif rising_edge(i_wb_clk) then
+      if s_busy = '0' then
+        if s_req_toggle_wb /= s_served_toggle then
+          -- Start a new row fetch.
+          s_served_toggle <= s_req_toggle_wb;
+          s_adr <= unsigned(s_req_adr);
+          s_issue_left <= s_req_size;
+          s_ack_left <= s_req_size;
+          s_wr_half <= s_req_half;
+          s_wr_idx <= (others => '0');
+          s_busy <= '1';
+        end if;
+      else
+        if s_stb = '1' and i_wb_stall = '0' then
+          s_adr <= s_adr + 1;
+          s_issue_left <= s_issue_left - 1;
+        end if;
+        if i_wb_ack = '1' then
+          s_wr_idx <= s_wr_idx + 1;
+          s_ack_left <= s_ack_left - 1;
+        end if;
+        if s_ack_left = 0 or (s_ack_left = 1 and i_wb_ack = '1') then
+          s_busy <= '0';
+          s_done_toggle <= s_served_toggle;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  s_stb <= s_busy when s_issue_left /= 0 else '0';
+  s_wr_en <= s_busy and i_wb_ack;
+  s_wr_adr <= s_wr_half & std_logic_vector(s_wr_idx);
+
+  -- XRAM starts at 0x80000000.
+  o_wb_cyc <= s_busy;
+  o_wb_stb <= s_stb;
+  o_wb_adr <= "100000" & std_logic_vector(s_adr);
+
+  --------------------------------------------------------------------------------------------------
+  -- Line buffer (two rows).
+  --------------------------------------------------------------------------------------------------
+
+  line_buf: entity work.ram_true_dual_port
+    generic map (
+      DATA_BITS => 32,
+      ADR_BITS => LOG2_LINE_WORDS + 1
+    )
+    port map (
+      i_clk_a => i_wb_clk,
+      i_we_a => s_wr_en,
+      i_adr_a => s_wr_adr,
+      i_data_a => i_wb_dat,
+      o_data_a => open,
+
+      i_clk_b => i_vid_clk,
+      i_adr_b => s_rd_adr,
+      o_data_b => o_read_dat
+    );
+end rtl;
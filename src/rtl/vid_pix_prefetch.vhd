@@ -45,7 +45,12 @@ entity vid_pix_prefetch is
     o_read_en : out std_logic;
     o_read_adr : out std_logic_vector(23 downto 0);
     i_read_ack : in std_logic;
-    i_read_dat : in std_logic_vector(31 downto 0)
+    i_read_dat : in std_logic_vector(31 downto 0);
+
+    -- Statistics (one pulse per event).
+    o_stat_hit : out std_logic;
+    o_stat_miss : out std_logic;
+    o_stat_speculative : out std_logic
   );
 end vid_pix_prefetch;
 
@@ -122,4 +127,9 @@ begin
   o_read_ack <= s_prev_read_en and (s_cache_hit or i_read_ack);
   o_read_dat <= s_cached_dat when s_cache_hit = '1' else
                 i_read_dat;
+
+  -- Statistics. A speculative read is a memory cycle that was not requested by the pixel pipeline.
+  o_stat_hit <= s_prev_read_en and s_cache_hit;
+  o_stat_miss <= s_prev_read_en and not s_cache_hit;
+  o_stat_speculative <= s_speculative_read_en and not i_read_en;
 end rtl;
@@ -29,6 +29,16 @@ use work.vid_types.all;
 -- the VCR:s). The source pixels are transformed into 32-bit ABGR32 color values based on the video
 -- mode, which may or may not involve color palette lookup.
 --
+-- The gradient color mode does not read memory. Instead the color is interpolated between GCOL0
+-- and GCOL1 (BGR888, opaque) with the weight w = (x << CMODE[6:4]) mod 256, where x is the integer
+-- part of the x coordinate:
+--
+--   color = ((255 - w) * GCOL0) / 256 + (w * GCOL1) / 256  (per color component, rounded down)
+--
+-- With XINCR = N / width (16.16) and CMODE[6:4] = log2(256 / N) the line is divided into N
+-- segments of constant color, and the VCP can change GCOL0/GCOL1 between lines for vertical
+-- gradients.
+--
 -- The output color format is ABGR32 (little endian):
 --    3      2        1
 --    1      4        6        8        0
@@ -48,7 +58,7 @@ use work.vid_types.all;
 --   Request the pixel word from RAM.
 --
 -- PIXFETCH2:
---   Get the pixel word from RAM.
+--   Get the pixel word from RAM (and scale the gradient colors).
 --
 -- SHIFT:
 --   Shift the relevant bits from the pixel word into the least significant part, according to the
@@ -96,14 +106,6 @@ architecture rtl of vid_pixel is
   -- Fixed point configuration (16.16 bits).
   constant C_FP_BITS : positive := 32;
 
-  -- Color modes.
-  constant C_CMODE_RGBA32 : std_logic_vector(3 downto 0) := 4X"0";
-  constant C_CMODE_RGBA16 : std_logic_vector(3 downto 0) := 4X"1";
-  constant C_CMODE_PAL8 : std_logic_vector(3 downto 0) := 4X"2";
-  constant C_CMODE_PAL4 : std_logic_vector(3 downto 0) := 4X"3";
-  constant C_CMODE_PAL2 : std_logic_vector(3 downto 0) := 4X"4";
-  constant C_CMODE_PAL1 : std_logic_vector(3 downto 0) := 4X"5";
-
   signal s_xc_hpos : signed(23 downto 0);
   signal s_xc_next_active : std_logic;
   signal s_xc_active : std_logic;
@@ -125,6 +127,7 @@ architecture rtl of vid_pixel is
   signal s_pa_addr : std_logic_vector(23 downto 0);
   signal s_pa_prev_addr : std_logic_vector(23 downto 0);
   signal s_pa_addr_is_new : std_logic;
+  signal s_pa_is_gradient : std_logic;
   signal s_pa_next_mem_read_en : std_logic;
   signal s_pa_next_shift_32 : std_logic_vector(4 downto 0);
   signal s_pa_next_shift_16 : std_logic_vector(4 downto 0);
@@ -135,20 +138,26 @@ architecture rtl of vid_pixel is
   signal s_pa_next_shift : std_logic_vector(4 downto 0);
   signal s_pa_mem_read_en : std_logic;
   signal s_pa_shift : std_logic_vector(4 downto 0);
+  signal s_pa_next_gweight : unsigned(7 downto 0);
+  signal s_pa_gweight : unsigned(7 downto 0);
   signal s_pa_active : std_logic;
   signal s_pa_in_blanking_area : std_logic;
 
   signal s_pf1_shift : std_logic_vector(4 downto 0);
+  signal s_pf1_gweight : unsigned(7 downto 0);
   signal s_pf1_active : std_logic;
   signal s_pf1_in_blanking_area : std_logic;
 
   signal s_pf2_data : std_logic_vector(31 downto 0);
   signal s_pf2_shift : std_logic_vector(4 downto 0);
+  signal s_pf2_gterm0 : std_logic_vector(23 downto 0);
+  signal s_pf2_gterm1 : std_logic_vector(23 downto 0);
   signal s_pf2_active : std_logic;
   signal s_pf2_in_blanking_area : std_logic;
 
   signal s_sh_shifted_idx : std_logic_vector(7 downto 0);
   signal s_sh_shifted_rgba16 : std_logic_vector(15 downto 0);
+  signal s_sh_gradient : std_logic_vector(31 downto 0);
   signal s_sh_next_data : std_logic_vector(31 downto 0);
   signal s_sh_data : std_logic_vector(31 downto 0);
   signal s_sh_next_is_truecolor : std_logic;
@@ -187,6 +196,20 @@ architecture rtl of vid_pixel is
     return v_a & v_b & v_g & v_r;
   end;
 
+  -- Scale each 8-bit component of a BGR888 color by w/256 (rounding down).
+  function scale_bgr888(c: std_logic_vector; w: unsigned) return std_logic_vector is
+    variable v_c : std_logic_vector(23 downto 0);
+    variable v_product : unsigned(15 downto 0);
+    variable v_result : std_logic_vector(23 downto 0);
+  begin
+    v_c := c;
+    for k in 0 to 2 loop
+      v_product := unsigned(v_c(8*k+7 downto 8*k)) * w;
+      v_result(8*k+7 downto 8*k) := std_logic_vector(v_product(15 downto 8));
+    end loop;
+    return v_result;
+  end;
+
   function shr_8bits(x: std_logic_vector; s: std_logic_vector) return std_logic_vector is
     variable v_shift : integer;
     variable v_shr32 : unsigned(31 downto 0);
@@ -276,7 +299,10 @@ begin
   -- Note: We assume that there are no wait-states from the memory, so we do
   -- not have to consider whether or not we got an ACK for the last request.
   s_pa_addr_is_new <= '1' when s_pa_addr(8 downto 0) /= s_pa_prev_addr(8 downto 0) else '0';
-  s_pa_next_mem_read_en <= s_xc_active and (s_pa_addr_is_new or s_xc_is_hstrt);
+  -- Note: The gradient color mode does not read any memory.
+  s_pa_is_gradient <= '1' when i_regs.CMODE(3 downto 0) = C_CMODE_GRADIENT else '0';
+  s_pa_next_mem_read_en <= s_xc_active and (s_pa_addr_is_new or s_xc_is_hstrt) and
+                           not s_pa_is_gradient;
 
   -- Determine the bit shift amount.
   s_pa_next_shift_32 <= "00000";
@@ -296,17 +322,23 @@ begin
         s_pa_next_shift_1 when C_CMODE_PAL1,
         (others => '-') when others;
 
+  -- Determine the gradient weight.
+  s_pa_next_gweight <= shift_left(unsigned(s_xc_pos(23 downto 16)),
+                                  to_integer(unsigned(i_regs.CMODE(6 downto 4))));
+
   -- PIXADDR registers.
   process(i_clk, i_rst)
   begin
     if i_rst = '1' then
       s_pa_shift <= (others => '0');
+      s_pa_gweight <= (others => '0');
       s_pa_active <= '0';
       s_pa_in_blanking_area <= '1';
       s_pa_prev_addr <=  24x"123456";  -- Unlikely address.
       s_pa_mem_read_en <= '0';
     elsif rising_edge(i_clk) then
       s_pa_shift <= s_pa_next_shift;
+      s_pa_gweight <= s_pa_next_gweight;
       s_pa_active <= s_xc_active;
       s_pa_in_blanking_area <= s_xc_in_blanking_area;
       if s_pa_next_mem_read_en then
@@ -330,10 +362,12 @@ begin
   begin
     if i_rst = '1' then
       s_pf1_shift <= (others => '0');
+      s_pf1_gweight <= (others => '0');
       s_pf1_active <= '0';
       s_pf1_in_blanking_area <= '1';
     elsif rising_edge(i_clk) then
       s_pf1_shift <= s_pa_shift;
+      s_pf1_gweight <= s_pa_gweight;
       s_pf1_active <= s_pa_active;
       s_pf1_in_blanking_area <= s_pa_in_blanking_area;
     end if;
@@ -350,6 +384,8 @@ begin
     if i_rst = '1' then
       s_pf2_data <= (others => '0');
       s_pf2_shift <= (others => '0');
+      s_pf2_gterm0 <= (others => '0');
+      s_pf2_gterm1 <= (others => '0');
       s_pf2_active <= '0';
       s_pf2_in_blanking_area <= '1';
     elsif rising_edge(i_clk) then
@@ -360,6 +396,8 @@ begin
         s_pf2_data <= i_mem_data;
       end if;
       s_pf2_shift <= s_pf1_shift;
+      s_pf2_gterm0 <= scale_bgr888(i_regs.GCOL0, not s_pf1_gweight);  -- 255 - w
+      s_pf2_gterm1 <= scale_bgr888(i_regs.GCOL1, s_pf1_gweight);
       s_pf2_active <= s_pf1_active;
       s_pf2_in_blanking_area <= s_pf1_in_blanking_area;
     end if;
@@ -387,14 +425,19 @@ begin
   -- RGBA16, based on the shift amount (which can only be 0 or 16).
   s_sh_shifted_rgba16 <= s_pf2_data(31 downto 16) when s_pf2_shift(4) = '1' else
                          s_pf2_data(15 downto 0);
+  -- Gradient color: Each color component sum is less than 255, so there are no carries between
+  -- the components.
+  s_sh_gradient <= x"ff" & std_logic_vector(unsigned(s_pf2_gterm0) + unsigned(s_pf2_gterm1));
+
   s_sh_next_data <= s_pf2_data when i_regs.CMODE(3 downto 0) = C_CMODE_RGBA32 else
+                    s_sh_gradient when i_regs.CMODE(3 downto 0) = C_CMODE_GRADIENT else
                     abgr16_to_abgr32(s_sh_shifted_rgba16);
 
   -- Is this a palette lookup or truecolor pixel?
   -- Note: We force palette mode in the inactive area.
   IsTruecolorMux: with i_regs.CMODE(3 downto 0) select
     s_sh_next_is_truecolor <=
-        s_pf2_active when C_CMODE_RGBA32 | C_CMODE_RGBA16,
+        s_pf2_active when C_CMODE_RGBA32 | C_CMODE_RGBA16 | C_CMODE_GRADIENT,
         '0' when others;
 
   -- SHIFT registers.
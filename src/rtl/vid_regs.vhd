@@ -19,10 +19,23 @@
 
 library ieee;
 use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
 use work.vid_types.all;
 
 ----------------------------------------------------------------------------------------------------
 -- Video control registers.
+--
+-- ADDR can be advanced automatically at the start of each raster line, which lets a VCP scale an
+-- image vertically without setting ADDR for every row:
+--
+--   YSTEP is the number of image rows per raster line (unsigned 8.16 fixed point). It is added to a
+--   fractional row accumulator at the start of each line, and ADDR is incremented by YINCR (the
+--   signed row stride, in words) once for every whole row, at a rate of one row per clock cycle.
+--
+-- Writing to ADDR clears the accumulator. YINCR is zero by default, i.e. ADDR is not changed.
+--
+-- GCOL0 and GCOL1 are the left and right colors (BGR888) of the gradient color mode (see
+-- vid_pixel.vhd).
 ----------------------------------------------------------------------------------------------------
 
 entity vid_regs is
@@ -31,8 +44,9 @@ entity vid_regs is
     i_clk : in std_logic;
 
     i_restart_frame : in std_logic;
+    i_next_line : in std_logic;
     i_write_enable : in std_logic;
-    i_write_addr : in std_logic_vector(2 downto 0);
+    i_write_addr : in std_logic_vector(3 downto 0);
     i_write_data : in std_logic_vector(23 downto 0);
 
     o_regs : out T_VID_REGS
@@ -47,32 +61,84 @@ architecture rtl of vid_regs is
   constant C_DEFAULT_HSTOP : std_logic_vector(23 downto 0) := x"000000";
   constant C_DEFAULT_CMODE : std_logic_vector(23 downto 0) := x"000002";
   constant C_DEFAULT_RMODE : std_logic_vector(23 downto 0) := x"000135";
+  constant C_DEFAULT_LADDR : std_logic_vector(23 downto 0) := x"000000";
+  constant C_DEFAULT_LSIZE : std_logic_vector(23 downto 0) := x"000000";
+  constant C_DEFAULT_YINCR : std_logic_vector(23 downto 0) := x"000000";
+  constant C_DEFAULT_YSTEP : std_logic_vector(23 downto 0) := x"010000";
+  constant C_DEFAULT_GCOL0 : std_logic_vector(23 downto 0) := x"000000";
+  constant C_DEFAULT_GCOL1 : std_logic_vector(23 downto 0) := x"000000";
 
   signal s_regs : T_VID_REGS;
   signal s_next_regs : T_VID_REGS;
+
+  signal s_write_addr_reg : std_logic;
+  signal s_yfrac : unsigned(15 downto 0);
+  signal s_ysteps_left : unsigned(7 downto 0);
 begin
   -- Write logic.
-  s_next_regs.ADDR <= i_write_data when i_write_enable = '1' and i_write_addr = "000" else
+  s_write_addr_reg <= i_write_enable when i_write_addr = "0000" else '0';
+  s_next_regs.ADDR <= i_write_data when s_write_addr_reg = '1' else
                       C_DEFAULT_ADDR when i_restart_frame = '1' else
+                      std_logic_vector(unsigned(s_regs.ADDR) + unsigned(s_regs.YINCR))
+                          when s_ysteps_left /= 0 else
                       s_regs.ADDR;
-  s_next_regs.XOFFS <= i_write_data when i_write_enable = '1' and i_write_addr = "001" else
+  s_next_regs.XOFFS <= i_write_data when i_write_enable = '1' and i_write_addr = "0001" else
                        C_DEFAULT_XOFFS when i_restart_frame = '1' else
                        s_regs.XOFFS;
-  s_next_regs.XINCR <= i_write_data when i_write_enable = '1' and i_write_addr = "010" else
+  s_next_regs.XINCR <= i_write_data when i_write_enable = '1' and i_write_addr = "0010" else
                        C_DEFAULT_XINCR when i_restart_frame = '1' else
                        s_regs.XINCR;
-  s_next_regs.HSTRT <= i_write_data when i_write_enable = '1' and i_write_addr = "011" else
+  s_next_regs.HSTRT <= i_write_data when i_write_enable = '1' and i_write_addr = "0011" else
                        C_DEFAULT_HSTRT when i_restart_frame = '1' else
                        s_regs.HSTRT;
-  s_next_regs.HSTOP <= i_write_data when i_write_enable = '1' and i_write_addr = "100" else
+  s_next_regs.HSTOP <= i_write_data when i_write_enable = '1' and i_write_addr = "0100" else
                        C_DEFAULT_HSTOP when i_restart_frame = '1' else
                        s_regs.HSTOP;
-  s_next_regs.CMODE <= i_write_data when i_write_enable = '1' and i_write_addr = "101" else
+  s_next_regs.CMODE <= i_write_data when i_write_enable = '1' and i_write_addr = "0101" else
                        C_DEFAULT_CMODE when i_restart_frame = '1' else
                        s_regs.CMODE;
-  s_next_regs.RMODE <= i_write_data when i_write_enable = '1' and i_write_addr = "110" else
+  s_next_regs.RMODE <= i_write_data when i_write_enable = '1' and i_write_addr = "0110" else
                        C_DEFAULT_RMODE when i_restart_frame = '1' else
                        s_regs.RMODE;
+  s_next_regs.LADDR <= i_write_data when i_write_enable = '1' and i_write_addr = "0111" else
+                       C_DEFAULT_LADDR when i_restart_frame = '1' else
+                       s_regs.LADDR;
+  s_next_regs.LSIZE <= i_write_data when i_write_enable = '1' and i_write_addr = "1000" else
+                       C_DEFAULT_LSIZE when i_restart_frame = '1' else
+                       s_regs.LSIZE;
+  s_next_regs.YINCR <= i_write_data when i_write_enable = '1' and i_write_addr = "1001" else
+                       C_DEFAULT_YINCR when i_restart_frame = '1' else
+                       s_regs.YINCR;
+  s_next_regs.YSTEP <= i_write_data when i_write_enable = '1' and i_write_addr = "1010" else
+                       C_DEFAULT_YSTEP when i_restart_frame = '1' else
+                       s_regs.YSTEP;
+  s_next_regs.GCOL0 <= i_write_data when i_write_enable = '1' and i_write_addr = "1011" else
+                       C_DEFAULT_GCOL0 when i_restart_frame = '1' else
+                       s_regs.GCOL0;
+  s_next_regs.GCOL1 <= i_write_data when i_write_enable = '1' and i_write_addr = "1100" else
+                       C_DEFAULT_GCOL1 when i_restart_frame = '1' else
+                       s_regs.GCOL1;
+
+  -- Per-line row accumulator.
+  process(i_clk, i_rst)
+    variable v_acc : unsigned(23 downto 0);
+  begin
+    if i_rst = '1' then
+      s_yfrac <= (others => '0');
+      s_ysteps_left <= (others => '0');
+    elsif rising_edge(i_clk) then
+      if i_restart_frame = '1' or s_write_addr_reg = '1' then
+        s_yfrac <= (others => '0');
+        s_ysteps_left <= (others => '0');
+      elsif i_next_line = '1' then
+        v_acc := unsigned(s_regs.YSTEP) + resize(s_yfrac, 24);
+        s_yfrac <= v_acc(15 downto 0);
+        s_ysteps_left <= v_acc(23 downto 16);
+      elsif s_ysteps_left /= 0 then
+        s_ysteps_left <= s_ysteps_left - 1;
+      end if;
+    end if;
+  end process;
 
   -- Clocked registers.
   process(i_clk, i_rst)
@@ -85,6 +151,12 @@ begin
       s_regs.HSTOP <= C_DEFAULT_HSTOP;
       s_regs.CMODE <= C_DEFAULT_CMODE;
       s_regs.RMODE <= C_DEFAULT_RMODE;
+      s_regs.LADDR <= C_DEFAULT_LADDR;
+      s_regs.LSIZE <= C_DEFAULT_LSIZE;
+      s_regs.YINCR <= C_DEFAULT_YINCR;
+      s_regs.YSTEP <= C_DEFAULT_YSTEP;
+      s_regs.GCOL0 <= C_DEFAULT_GCOL0;
+      s_regs.GCOL1 <= C_DEFAULT_GCOL1;
     elsif rising_edge(i_clk) then
       s_regs <= s_next_regs;
     end if;
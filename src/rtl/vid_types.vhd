@@ -36,8 +36,36 @@ package vid_types is
     HSTOP : std_logic_vector(23 downto 0);
     CMODE : std_logic_vector(23 downto 0);
     RMODE : std_logic_vector(23 downto 0);
+    LADDR : std_logic_vector(23 downto 0);
+    LSIZE : std_logic_vector(23 downto 0);
+    YINCR : std_logic_vector(23 downto 0);
+    YSTEP : std_logic_vector(23 downto 0);
+    GCOL0 : std_logic_vector(23 downto 0);
+    GCOL1 : std_logic_vector(23 downto 0);
   end record T_VID_REGS;
 
+  -- Color modes (CMODE bits 3..0).
+  constant C_CMODE_RGBA32 : std_logic_vector(3 downto 0) := 4X"0";
+  constant C_CMODE_RGBA16 : std_logic_vector(3 downto 0) := 4X"1";
+  constant C_CMODE_PAL8 : std_logic_vector(3 downto 0) := 4X"2";
+  constant C_CMODE_PAL4 : std_logic_vector(3 downto 0) := 4X"3";
+  constant C_CMODE_PAL2 : std_logic_vector(3 downto 0) := 4X"4";
+  constant C_CMODE_PAL1 : std_logic_vector(3 downto 0) := 4X"5";
+  constant C_CMODE_GRADIENT : std_logic_vector(3 downto 0) := 4X"6";
+
+
+  --------------------------------------------------------------------------------------------------
+  -- Video layer statistics (event pulses in the video clock domain).
+  --------------------------------------------------------------------------------------------------
+  type T_VID_LAYER_STATS is record
+    pix_hit : std_logic;          -- Pixel read served by the prefetch cache.
+    pix_miss : std_logic;         -- Pixel read served by the RAM.
+    pix_speculative : std_logic;  -- Speculative (prefetch) RAM read cycle.
+    vcpp_stall : std_logic;       -- VCPP instruction fetch stall cycle.
+  end record T_VID_LAYER_STATS;
+
+  constant C_VID_LAYER_STATS_NONE : T_VID_LAYER_STATS := ('0', '0', '0', '0');
+
 
   ------------------------------------------------------------------------------------------------
   -- Supported video resolution configurations.
@@ -70,7 +70,10 @@ entity vid_vcpp is
     o_reg_write_enable : out std_logic;
     o_pal_write_enable : out std_logic;
     o_write_addr : out std_logic_vector(7 downto 0);
-    o_write_data : out std_logic_vector(31 downto 0)
+    o_write_data : out std_logic_vector(31 downto 0);
+
+    -- High during cycles when an instruction fetch is stalled by the memory system.
+    o_fetch_stall : out std_logic
   );
 end vid_vcpp;
 
@@ -413,4 +416,5 @@ begin
   o_pal_write_enable <= s_ex_pal_write_enable;
   o_write_addr <= s_ex_write_addr;
   o_write_data <= s_ex_write_data;
+  o_fetch_stall <= s_retry_mem_request;
 end rtl;
@@ -29,7 +29,9 @@ entity video is
     COLOR_BITS_B : positive;
     ADR_BITS : positive;
     NUM_LAYERS : positive;
-    VIDEO_CONFIG : T_VIDEO_CONFIG
+    VIDEO_CONFIG : T_VIDEO_CONFIG;
+    XRAM_LINE_FETCH : boolean := false;   -- Enable the layer 1 XRAM line buffer.
+    LOG2_XRAM_LINE_WORDS : positive := 10
   );
   port(
     i_rst : in std_logic;
@@ -38,6 +40,14 @@ entity video is
     o_read_adr : out std_logic_vector(ADR_BITS-1 downto 0);
     i_read_dat : in std_logic_vector(31 downto 0);
 
+    -- XRAM line buffer interface (see vid_line_fetch.vhd).
+    o_line_fetch_req : out std_logic;
+    o_line_fetch_adr : out std_logic_vector(23 downto 0);
+    o_line_fetch_size : out std_logic_vector(23 downto 0);
+    o_line_start : out std_logic;
+    o_lbuf_read_adr : out std_logic_vector(LOG2_XRAM_LINE_WORDS-1 downto 0);
+    i_lbuf_read_dat : in std_logic_vector(31 downto 0);
+
     o_r : out std_logic_vector(COLOR_BITS_R-1 downto 0);
     o_g : out std_logic_vector(COLOR_BITS_G-1 downto 0);
     o_b : out std_logic_vector(COLOR_BITS_B-1 downto 0);
@@ -45,7 +55,11 @@ entity video is
     o_hsync : out std_logic;
     o_vsync : out std_logic;
 
-    o_raster_y : out std_logic_vector(15 downto 0)
+    o_raster_y : out std_logic_vector(15 downto 0);
+
+    -- Layer statistics for the performance counters (video clock domain).
+    o_layer1_stats : out T_VID_LAYER_STATS;
+    o_layer2_stats : out T_VID_LAYER_STATS
   );
 end video;
 
@@ -83,10 +97,14 @@ architecture rtl of video is
   signal s_hsync : std_logic;
   signal s_vsync : std_logic;
   signal s_restart_frame : std_logic;
+  signal s_prev_raster_y : std_logic_vector(11 downto 0);
 
   signal s_layer1_read_en : std_logic;
   signal s_layer1_read_adr : std_logic_vector(23 downto 0);
   signal s_layer1_read_ack : std_logic;
+  signal s_layer1_read_dat : std_logic_vector(31 downto 0);
+  signal s_layer1_lbuf_read : std_logic;
+  signal s_layer1_lbuf_ack : std_logic;
   signal s_layer1_rmode : std_logic_vector(23 downto 0);
   signal s_layer1_color : std_logic_vector(31 downto 0);
 
@@ -140,9 +158,13 @@ begin
       o_read_en => s_layer1_read_en,
       o_read_adr => s_layer1_read_adr,
       i_read_ack => s_layer1_read_ack,
-      i_read_dat  => i_read_dat,
+      i_read_dat  => s_layer1_read_dat,
+      o_line_fetch_req => o_line_fetch_req,
+      o_line_fetch_adr => o_line_fetch_adr,
+      o_line_fetch_size => o_line_fetch_size,
       o_rmode => s_layer1_rmode,
-      o_color => s_layer1_color
+      o_color => s_layer1_color,
+      o_stats => o_layer1_stats
     );
 
   Layer2Gen: if NUM_LAYERS >= 2 generate
@@ -165,8 +187,12 @@ begin
         o_read_adr => s_layer2_read_adr,
         i_read_ack => s_layer2_read_ack,
         i_read_dat  => i_read_dat,
+        o_line_fetch_req => open,
+        o_line_fetch_adr => open,
+        o_line_fetch_size => open,
         o_rmode => s_layer2_rmode,
-        o_color => s_layer2_color
+        o_color => s_layer2_color,
+        o_stats => o_layer2_stats
       );
 
     -- Instantiate the layer blending logic.
@@ -183,6 +209,7 @@ begin
     s_layer2_read_en <= '0';
     s_layer2_read_adr <= (others => '0');
     s_final_color <= s_layer1_color;
+    o_layer2_stats <= C_VID_LAYER_STATS_NONE;
   end generate;
 
 
@@ -194,18 +221,44 @@ begin
   o_read_adr <= s_layer2_read_adr(ADR_BITS-1 downto 0) when s_layer2_read_en = '1' else
                 s_layer1_read_adr(ADR_BITS-1 downto 0);
 
+  -- Layer 1 reads from the XRAM line buffer instead of VRAM when bit 23 of the address is set.
+  -- The line buffer has its own read port, so those reads never conflict with layer 2.
+  s_layer1_lbuf_read <= s_layer1_read_adr(23) when XRAM_LINE_FETCH else '0';
+  o_lbuf_read_adr <= s_layer1_read_adr(LOG2_XRAM_LINE_WORDS-1 downto 0);
+
   -- Respond with an ack to the serviced layer (one cycle after the request).
   process(i_clk, i_rst)
   begin
     if i_rst = '1' then
       s_layer1_read_ack <= '0';
+      s_layer1_lbuf_ack <= '0';
       s_layer2_read_ack <= '0';
     elsif rising_edge(i_clk) then
-      s_layer1_read_ack <= s_layer1_read_en and not s_layer2_read_en;
+      s_layer1_read_ack <= s_layer1_read_en and (s_layer1_lbuf_read or not s_layer2_read_en);
+      s_layer1_lbuf_ack <= s_layer1_read_en and s_layer1_lbuf_read;
       s_layer2_read_ack <= s_layer2_read_en;
     end if;
   end process;
 
+  s_layer1_read_dat <= i_lbuf_read_dat when s_layer1_lbuf_ack = '1' else i_read_dat;
+
+  -- Signal the start of a new raster line to the XRAM line buffer (the raster Y coordinate is
+  -- incremented at the start of the horizontal blanking period).
+  process(i_clk, i_rst)
+  begin
+    if i_rst = '1' then
+      s_prev_raster_y <= (others => '0');
+      o_line_start <= '0';
+    elsif rising_edge(i_clk) then
+      s_prev_raster_y <= s_raster_y;
+      if s_raster_y /= s_prev_raster_y then
+        o_line_start <= '1';
+      else
+        o_line_start <= '0';
+      end if;
+    end if;
+  end process;
+
 
   --------------------------------------------------------------------------------------------------
   -- Video signal output logic.
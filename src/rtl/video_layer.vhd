@@ -42,8 +42,16 @@ entity video_layer is
     i_read_ack : in std_logic;
     i_read_dat : in std_logic_vector(31 downto 0);
 
+    -- XRAM line fetch requests (see vid_line_fetch.vhd).
+    o_line_fetch_req : out std_logic;
+    o_line_fetch_adr : out std_logic_vector(23 downto 0);
+    o_line_fetch_size : out std_logic_vector(23 downto 0);
+
     o_rmode : out std_logic_vector(23 downto 0);
-    o_color : out std_logic_vector(31 downto 0)
+    o_color : out std_logic_vector(31 downto 0);
+
+    -- Statistics for the performance counters.
+    o_stats : out T_VID_LAYER_STATS
   );
 end video_layer;
 
@@ -58,6 +66,9 @@ architecture rtl of video_layer is
   signal s_vcpp_write_data : std_logic_vector(31 downto 0);
 
   signal s_regs : T_VID_REGS;
+  signal s_prev_raster_y : std_logic_vector(Y_COORD_BITS-1 downto 0);
+  signal s_next_line : std_logic;
+  signal s_line_fetch_req : std_logic;
 
   signal s_pix_mem_read_en : std_logic;
   signal s_pix_mem_read_adr : std_logic_vector(23 downto 0);
@@ -126,7 +137,8 @@ begin
       o_reg_write_enable => s_vcpp_reg_write_enable,
       o_pal_write_enable => s_vcpp_pal_write_enable,
       o_write_addr => s_vcpp_write_adr,
-      o_write_data => s_vcpp_write_data
+      o_write_data => s_vcpp_write_data,
+      o_fetch_stall => o_stats.vcpp_stall
     );
 
   -- Instantiate the video control registers.
@@ -135,12 +147,24 @@ begin
       i_rst => i_rst,
       i_clk => i_clk,
       i_restart_frame => i_restart_frame,
+      i_next_line => s_next_line,
       i_write_enable => s_vcpp_reg_write_enable,
-      i_write_addr => s_vcpp_write_adr(2 downto 0),
+      i_write_addr => s_vcpp_write_adr(3 downto 0),
       i_write_data => s_vcpp_write_data(23 downto 0),
       o_regs => s_regs
     );
 
+  -- Detect the start of a new raster line (for the per-line ADDR increment).
+  process(i_clk, i_rst)
+  begin
+    if i_rst = '1' then
+      s_prev_raster_y <= (others => '0');
+    elsif rising_edge(i_clk) then
+      s_prev_raster_y <= i_raster_y;
+    end if;
+  end process;
+  s_next_line <= '1' when i_raster_y /= s_prev_raster_y else '0';
+
   -- Instantiate the video palette.
   palette_1: entity work.vid_palette
     port map(
@@ -178,7 +202,9 @@ begin
   begin
     -- Provide the prefetcher with pixel sampling information.
     s_pix_decremental_read <= s_regs.XINCR(23);
-    s_pix_row_start_imminent <= is_row_start_imminent(i_raster_x);
+    -- Note: The gradient color mode does not read any memory, so there is nothing to prefetch.
+    s_pix_row_start_imminent <= is_row_start_imminent(i_raster_x)
+                                when s_regs.CMODE(3 downto 0) /= C_CMODE_GRADIENT else '0';
     s_pix_row_start_addr <= calc_row_start_addr(s_regs.ADDR, s_regs.XOFFS, s_regs.CMODE);
 
     -- Instantiate the pixel prefetch cache.
@@ -196,7 +222,10 @@ begin
         o_read_en => s_pix_cache_read_en,
         o_read_adr => s_pix_cache_read_adr,
         i_read_ack => s_pix_cache_ack,
-        i_read_dat => i_read_dat
+        i_read_dat => i_read_dat,
+        o_stat_hit => o_stats.pix_hit,
+        o_stat_miss => o_stats.pix_miss,
+        o_stat_speculative => o_stats.pix_speculative
       );
   else generate
     -- Bypass the pixel prefetch cache (uses less memory cycles). The top layer should not need a
@@ -205,11 +234,32 @@ begin
     s_pix_cache_read_adr <= s_pix_mem_read_adr;
     s_pix_mem_ack <= s_pix_cache_ack;
     s_pix_mem_dat <= i_read_dat;
+    o_stats.pix_hit <= '0';
+    o_stats.pix_miss <= '0';
+    o_stats.pix_speculative <= '0';
   end generate;
 
   -- Output the render mode (used by the blending and dithering logic).
   o_rmode <= s_regs.RMODE;
 
+  -- Request an XRAM line fetch when LADDR is written (the request is delayed by one cycle so that
+  -- it is aligned with the updated register value).
+  process(i_clk, i_rst)
+  begin
+    if i_rst = '1' then
+      s_line_fetch_req <= '0';
+    elsif rising_edge(i_clk) then
+      if s_vcpp_reg_write_enable = '1' and s_vcpp_write_adr(3 downto 0) = "0111" then
+        s_line_fetch_req <= '1';
+      else
+        s_line_fetch_req <= '0';
+      end if;
+    end if;
+  end process;
+  o_line_fetch_req <= s_line_fetch_req;
+  o_line_fetch_adr <= s_regs.LADDR;
+  o_line_fetch_size <= s_regs.LSIZE;
+
 
   --------------------------------------------------------------------------------------------------
   -- VRAM read logic - only one entity may access VRAM during each clock cycle.
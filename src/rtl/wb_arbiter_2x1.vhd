@@ -0,0 +1,144 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- This is a 2 x 1 arbiter that lets two Wishbone masters share a single slave:
+--   * Wishbone B4 pipelined interface (see: https://cdn.opencores.org/downloads/wbspec_b4.pdf)
+--   * Master A has precedence over master B.
+--   * The slave is only handed over to the other master when all pending requests have been
+--     responded to, so responses (ACK/ERR) are always routed to the master that owns the slave.
+--   * Requests from master B are stalled while master A is requesting, so that master B can not
+--     keep the slave busy indefinitely.
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity wb_arbiter_2x1 is
+  generic(
+    ADR_WIDTH : positive := 30;            -- Address bus width
+    DAT_WIDTH : positive := 32;            -- Must be a multiple of GRANULARITY
+    GRANULARITY : positive := 8;           -- Usually 8 (for byte granularity)
+    LOG2_MAX_PENDING_REQS : positive := 6  -- Max pending reqs = 2**LOG2_MAX_PENDING_REQS-1
+  );
+  port(
+    -- Common control signals.
+    i_rst : in std_logic;
+    i_clk : in std_logic;
+
+    -- Signals from/to MASTER A.
+    i_cyc_a : in std_logic;
+    i_stb_a : in std_logic;
+    i_adr_a : in std_logic_vector(ADR_WIDTH-1 downto 0);
+    i_dat_a : in std_logic_vector(DAT_WIDTH-1 downto 0);
+    i_we_a : in std_logic;
+    i_sel_a : in std_logic_vector(DAT_WIDTH/GRANULARITY-1 downto 0);
+    o_dat_a : out std_logic_vector(DAT_WIDTH-1 downto 0);
+    o_ack_a : out std_logic;
+    o_stall_a : out std_logic;
+    o_err_a : out std_logic;
+
+    -- Signals from/to MASTER B.
+    i_cyc_b : in std_logic;
+    i_stb_b : in std_logic;
+    i_adr_b : in std_logic_vector(ADR_WIDTH-1 downto 0);
+    i_dat_b : in std_logic_vector(DAT_WIDTH-1 downto 0);
+    i_we_b : in std_logic;
+    i_sel_b : in std_logic_vector(DAT_WIDTH/GRANULARITY-1 downto 0);
+    o_dat_b : out std_logic_vector(DAT_WIDTH-1 downto 0);
+    o_ack_b : out std_logic;
+    o_stall_b : out std_logic;
+    o_err_b : out std_logic;
+
+    -- Signals from/to the SLAVE.
+    o_cyc : out std_logic;
+    o_stb : out std_logic;
+    o_adr : out std_logic_vector(ADR_WIDTH-1 downto 0);
+    o_dat : out std_logic_vector(DAT_WIDTH-1 downto 0);
+    o_we : out std_logic;
+    o_sel : out std_logic_vector(DAT_WIDTH/GRANULARITY-1 downto 0);
+    i_dat : in std_logic_vector(DAT_WIDTH-1 downto 0);
+    i_ack : in std_logic;
+    i_stall : in std_logic;
+    i_err : in std_logic
+  );
+end wb_arbiter_2x1;
+
+architecture rtl of wb_arbiter_2x1 is
+  constant C_MAX_PENDING_REQS : unsigned(LOG2_MAX_PENDING_REQS-1 downto 0) := (others => '1');
+
+  signal s_req_a : std_logic;
+  signal s_req_b : std_logic;
+  signal s_idle : std_logic;
+  signal s_select_a : std_logic;
+  signal s_stb : std_logic;
+  signal s_full : std_logic;
+  signal s_stall : std_logic;
+  signal s_response : std_logic;
+
+  signal s_owner_is_b : std_logic;
+  signal s_pending_reqs : unsigned(LOG2_MAX_PENDING_REQS-1 downto 0);
+begin
+  s_req_a <= i_cyc_a and i_stb_a;
+  s_req_b <= i_cyc_b and i_stb_b;
+  s_response <= i_ack or i_err;
+
+  -- The owner of the slave may only change when there are no pending requests.
+  s_idle <= '1' when s_pending_reqs = 0 else '0';
+  s_select_a <= s_req_a when s_idle = '1' else not s_owner_is_b;
+
+  -- Forward the request from the selected master.
+  s_stb <= s_req_a when s_select_a = '1' else s_req_b and not s_req_a;
+  s_full <= '1' when s_pending_reqs = C_MAX_PENDING_REQS else '0';
+  s_stall <= i_stall or s_full;
+
+  o_cyc <= i_cyc_a or i_cyc_b or not s_idle;
+  o_stb <= s_stb and not s_full;
+  o_adr <= i_adr_a when s_select_a = '1' else i_adr_b;
+  o_dat <= i_dat_a when s_select_a = '1' else i_dat_b;
+  o_we <= i_we_a when s_select_a = '1' else i_we_b;
+  o_sel <= i_sel_a when s_select_a = '1' else i_sel_b;
+
+  o_stall_a <= s_stall when s_select_a = '1' else '1';
+  o_stall_b <= s_stall when s_select_a = '0' and s_req_a = '0' else '1';
+
+  -- Route the responses to the owner of the slave.
+  o_dat_a <= i_dat;
+  o_ack_a <= i_ack and not s_owner_is_b;
+  o_err_a <= i_err and not s_owner_is_b;
+  o_dat_b <= i_dat;
+  o_ack_b <= i_ack and s_owner_is_b;
+  o_err_b <= i_err and s_owner_is_b;
+
+  process(i_rst, i_clk)
+  begin
+    if i_rst = '1' then
+      s_owner_is_b <= '0';
+      s_pending_reqs <= (others => '0');
+    elsif rising_edge(i_clk) then
+      s_owner_is_b <= not s_select_a;
+      if s_stb = '1' and s_stall = '0' and s_response = '0' then
+        s_pending_reqs <= s_pending_reqs + 1;
+      elsif (s_stb = '0' or s_stall = '1') and s_response = '1' then
+        s_pending_reqs <= s_pending_reqs - 1;
+      end if;
+    end if;
+  end process;
+end rtl;
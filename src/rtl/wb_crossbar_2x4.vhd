@@ -24,11 +24,22 @@
 --   * The two most significant bits of the address are used to select which slave to access (this
 --     scheme can easily be changed by altering address_to_port()).
 --   * A master may only have pending requests to at most one slave at a time.
---   * When the two masters are competing to access the same slave, master A has precedence.
+--   * When the two masters are competing to access the same slave, the arbitration policy decides
+--     which master gets access (see T_WB_ARB_POLICY):
+--     - WB_ARB_FIXED: Master A has precedence.
+--     - WB_ARB_ROUND_ROBIN: The precedence alternates between the masters after each request that
+--       was granted while the other master was waiting for the same slave.
+--     - WB_ARB_WEIGHTED: Like round robin, but master A and master B get ARB_WEIGHT_A and
+--       ARB_WEIGHT_B requests per turn, respectively.
+--     With the round robin and weighted policies, a master that has precedence also makes the
+--     other master yield a slave that it is currently using (the other master is stalled until
+--     its pending requests have been responded to).
 --   * A request (STB) from a master will be stalled (STALL) if:
 --     - It tries to access a slave that is busy with the other master.
 --     - It tries to access a new slave while it has pending requests from another slave.
 --     - It tries to issue more than the maximum allowed number of pending requests. (*)
+--   * Per-master and per-slave statistics are output every cycle (o_stats), for performance
+--     counters.
 --
 -- (*) A pending request is one that has been issued by a master but not yet responded to.
 ----------------------------------------------------------------------------------------------------
@@ -36,13 +47,17 @@
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.wb_types.all;
 
 entity wb_crossbar_2x4 is
   generic(
     ADR_WIDTH : positive := 30;            -- Address bus width
     DAT_WIDTH : positive := 32;            -- Must be a multiple of GRANULARITY
     GRANULARITY : positive := 8;           -- Usually 8 (for byte granularity)
-    LOG2_MAX_PENDING_REQS : positive := 6  -- Max pending reqs = 2**LOG2_MAX_PENDING_REQS-1
+    LOG2_MAX_PENDING_REQS : positive := 6; -- Max pending reqs = 2**LOG2_MAX_PENDING_REQS-1 (max 8)
+    ARB_POLICY : T_WB_ARB_POLICY := WB_ARB_FIXED;
+    ARB_WEIGHT_A : positive := 1;          -- Requests per turn for master A (WB_ARB_WEIGHTED)
+    ARB_WEIGHT_B : positive := 1           -- Requests per turn for master B (WB_ARB_WEIGHTED)
   );
   port(
     -- Common control signals.
@@ -125,7 +140,10 @@ entity wb_crossbar_2x4 is
     i_ack_3 : in std_logic;
     i_stall_3 : in std_logic;
     i_rty_3 : in std_logic;
-    i_err_3 : in std_logic
+    i_err_3 : in std_logic;
+
+    -- Statistics.
+    o_stats : out T_WB_XBAR_STATS
   );
 end wb_crossbar_2x4;
 
@@ -169,9 +187,17 @@ architecture rtl of wb_crossbar_2x4 is
   signal s_rty_from_slave_b : std_logic;
   signal s_err_from_slave_b : std_logic;
 
+  -- Arbitration signals.
+  signal s_prio_a : std_logic;
+  signal s_prio_b : std_logic;
+  signal s_same_port : std_logic;
+  signal s_turn_count : integer range 0 to ARB_WEIGHT_A + ARB_WEIGHT_B;
+
   -- Request arbiter signals for master A.
   signal s_req_a : std_logic;
   signal s_no_pending_req_a : std_logic;
+  signal s_free_a : std_logic;
+  signal s_block_a : std_logic;
   signal s_can_honor_req_a : std_logic;
   signal s_req_validated_a : std_logic;
   signal s_req_port_a : T_PORT;
@@ -182,6 +208,8 @@ architecture rtl of wb_crossbar_2x4 is
   -- Request arbiter signals for master B.
   signal s_req_b : std_logic;
   signal s_no_pending_req_b : std_logic;
+  signal s_free_b : std_logic;
+  signal s_block_b : std_logic;
   signal s_can_honor_req_b : std_logic;
   signal s_req_validated_b : std_logic;
   signal s_req_port_b : T_PORT;
@@ -220,6 +248,18 @@ architecture rtl of wb_crossbar_2x4 is
     return p(2) = '0';
   end;
 
+  -- Number of contended requests that a master may issue per turn.
+  function turn_length(is_b : std_logic) return integer is
+  begin
+    if ARB_POLICY = WB_ARB_WEIGHTED then
+      if is_b = '1' then
+        return ARB_WEIGHT_B;
+      end if;
+      return ARB_WEIGHT_A;
+    end if;
+    return 1;
+  end function;
+
 begin
   --------------------------------------------------------------------------------------------------
   -- Slave to master A MUX.
@@ -293,6 +333,51 @@ begin
       '0' when others;
 
 
+  --------------------------------------------------------------------------------------------------
+  -- Arbitration between the masters.
+  -- Note: The blocking conditions only depend on the requests, never on the decisions for the other
+  -- master, to avoid combinatorial loops.
+  --------------------------------------------------------------------------------------------------
+
+  s_same_port <= '1' when s_req_port_a = s_req_port_b else '0';
+
+  -- Master A is blocked when master B has precedence and wants the same port.
+  s_block_a <= s_prio_b and s_req_b and s_same_port;
+
+  -- Master B is blocked when master A has precedence and wants the same port. With the fixed
+  -- policy (where master A never yields a port), this only happens if master A can take the port.
+  s_block_b <= s_req_a and s_same_port and not s_prio_b and
+               (s_prio_a or (s_free_a and not s_pending_reqs_is_max_a));
+
+  FixedArbGen: if ARB_POLICY = WB_ARB_FIXED generate
+  begin
+    s_prio_a <= '0';
+    s_prio_b <= '0';
+  else generate
+    -- The master with precedence keeps it for turn_length() requests that are granted while the
+    -- other master is waiting for the same port.
+    process(i_rst, i_clk)
+    begin
+      if i_rst = '1' then
+        s_prio_b <= '0';
+        s_turn_count <= 0;
+      elsif rising_edge(i_clk) then
+        if s_req_a = '1' and s_req_b = '1' and s_same_port = '1' and
+           ((s_prio_b = '0' and s_req_validated_a = '1' and s_stall_from_slave_a = '0') or
+            (s_prio_b = '1' and s_req_validated_b = '1' and s_stall_from_slave_b = '0')) then
+          if s_turn_count >= turn_length(s_prio_b) - 1 then
+            s_prio_b <= not s_prio_b;
+            s_turn_count <= 0;
+          else
+            s_turn_count <= s_turn_count + 1;
+          end if;
+        end if;
+      end if;
+    end process;
+    s_prio_a <= not s_prio_b;
+  end generate;
+
+
   --------------------------------------------------------------------------------------------------
   -- Master A slave selection logic.
   -- Note: These signals are non-registered, so keep the logic complexity to a minimum, and NO
@@ -306,11 +391,14 @@ begin
   s_req_a <= i_cyc_a and i_stb_a;
   s_req_port_a <= address_to_port(i_adr_a);
 
-  -- Can we honor the request from master A?
-  s_can_honor_req_a <= not s_pending_reqs_is_max_a when
+  -- Is the requested port available to master A (disregarding requests from master B)?
+  s_free_a <= '1' when
       s_req_port_a = s_active_port_a or
       (s_no_pending_req_a = '1' and (s_req_port_a /= s_active_port_b or s_no_pending_req_b = '1'))
       else '0';
+
+  -- Can we honor the request from master A?
+  s_can_honor_req_a <= s_free_a and not s_pending_reqs_is_max_a and not s_block_a;
   s_req_validated_a <= s_req_a and s_can_honor_req_a;
 
   -- Determine the next slave port for master A.
@@ -339,12 +427,14 @@ begin
   s_req_b <= i_cyc_b and i_stb_b;
   s_req_port_b <= address_to_port(i_adr_b);
 
-  -- Can we honor the request from master B?
-  -- TODO(m): Can we optimize the collision detection logic (s_next_port_a is expensive)?
-  s_can_honor_req_b <= not s_pending_reqs_is_max_b when
-      s_req_port_b /= s_next_port_a and
-      (s_req_port_b = s_active_port_b or s_no_pending_req_b = '1')
+  -- Is the requested port available to master B (disregarding requests from master A)?
+  s_free_b <= '1' when
+      s_req_port_b = s_active_port_b or
+      (s_no_pending_req_b = '1' and (s_req_port_b /= s_active_port_a or s_no_pending_req_a = '1'))
       else '0';
+
+  -- Can we honor the request from master B?
+  s_can_honor_req_b <= s_free_b and not s_pending_reqs_is_max_b and not s_block_b;
   s_req_validated_b <= s_req_b and s_can_honor_req_b;
 
   -- Determine the next slave port for master B.
@@ -382,6 +472,35 @@ begin
   o_err_b <= s_err_from_slave_b;
 
 
+  --------------------------------------------------------------------------------------------------
+  -- Statistics.
+  --------------------------------------------------------------------------------------------------
+
+  o_stats.grant_a <= s_stb_a and not s_stall_from_slave_a;
+  o_stats.stall_a <= s_req_a and s_stall_a;
+  o_stats.pending_a <= resize(s_pending_reqs_a, T_WB_REQ_COUNT'length);
+  o_stats.grant_b <= s_stb_b and not s_stall_from_slave_b;
+  o_stats.stall_b <= s_req_b and s_stall_b;
+  o_stats.pending_b <= resize(s_pending_reqs_b, T_WB_REQ_COUNT'length);
+
+  SlaveStatsGen: for k in 0 to 3 generate
+    constant C_PORT : T_PORT := std_logic_vector(to_unsigned(k, T_PORT'length));
+  begin
+    o_stats.slave_grant(k) <=
+        '1' when (s_next_port_a = C_PORT and s_stb_a = '1' and s_stall_from_slave_a = '0') or
+                 (s_next_port_b = C_PORT and s_stb_b = '1' and s_stall_from_slave_b = '0') else
+        '0';
+    o_stats.slave_stall(k) <=
+        '1' when (s_req_port_a = C_PORT and s_req_a = '1' and s_stall_a = '1') or
+                 (s_req_port_b = C_PORT and s_req_b = '1' and s_stall_b = '1') else
+        '0';
+    o_stats.slave_pending(k) <=
+        resize(s_pending_reqs_a, T_WB_REQ_COUNT'length) when s_active_port_a = C_PORT else
+        resize(s_pending_reqs_b, T_WB_REQ_COUNT'length) when s_active_port_b = C_PORT else
+        (others => '0');
+  end generate;
+
+
   --------------------------------------------------------------------------------------------------
   -- Send the signals to slave 0.
   --------------------------------------------------------------------------------------------------
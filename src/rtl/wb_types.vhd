@@ -0,0 +1,55 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- This file contains common types for the Wishbone interconnect.
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+package wb_types is
+  --------------------------------------------------------------------------------------------------
+  -- Arbitration policy for masters that compete for the same slave.
+  --------------------------------------------------------------------------------------------------
+  type T_WB_ARB_POLICY is (
+    WB_ARB_FIXED,        -- Master A always has precedence.
+    WB_ARB_ROUND_ROBIN,  -- The masters take turns (one request each).
+    WB_ARB_WEIGHTED      -- Like round robin, but with a configurable number of requests per turn.
+  );
+
+  --------------------------------------------------------------------------------------------------
+  -- Crossbar statistics (updated every cycle, e.g. for performance counters).
+  --------------------------------------------------------------------------------------------------
+  subtype T_WB_REQ_COUNT is unsigned(7 downto 0);
+  type T_WB_REQ_COUNTS is array (0 to 3) of T_WB_REQ_COUNT;
+
+  type T_WB_XBAR_STATS is record
+    grant_a : std_logic;                         -- A request from master A was accepted.
+    stall_a : std_logic;                         -- A request from master A was stalled.
+    pending_a : T_WB_REQ_COUNT;                  -- Number of pending requests for master A.
+    grant_b : std_logic;                         -- A request from master B was accepted.
+    stall_b : std_logic;                         -- A request from master B was stalled.
+    pending_b : T_WB_REQ_COUNT;                  -- Number of pending requests for master B.
+    slave_grant : std_logic_vector(3 downto 0);  -- A request to the slave was accepted.
+    slave_stall : std_logic_vector(3 downto 0);  -- A request to the slave was stalled.
+    slave_pending : T_WB_REQ_COUNTS;             -- Number of pending requests per slave.
+  end record T_WB_XBAR_STATS;
+end package;
@@ -20,7 +20,14 @@
 ----------------------------------------------------------------------------------------------------
 -- This is an XRAM implementation for SDRAM memories.
 --
--- TODO(m): Add a simple caching mechanism, and transfer more than 32 bits per request.
+-- Reads go through a direct mapped read cache with CACHE_NUM_LINES lines of CACHE_LINE_WORDS
+-- 32-bit words. A cache miss fills the entire line with a single SDRAM burst read.
+--
+-- Writes are acknowledged right away and are passed on to the SDRAM through a write-combining
+-- buffer that holds one cache line. Consecutive stores to the same line are merged, and the buffer
+-- is written to the SDRAM as a single (byte masked) burst write when a store goes to another line,
+-- before a cache miss is served, when the buffer is full, or when there have been no requests for
+-- a few cycles. Stores also update the cache if the line is cached (there is no write allocation).
 ----------------------------------------------------------------------------------------------------
 
 library ieee;
@@ -49,7 +56,12 @@ entity xram_sdram is
     T_REF : real := 64_000_000.0;
 
     -- FIFO configuration.
-    FIFO_DEPTH : integer := 16
+    FIFO_DEPTH : integer := 16;
+
+    -- Cache configuration (both must be powers of two). A cache line is transferred as a single
+    -- SDRAM burst, so CACHE_LINE_WORDS * 32 / SDRAM_DATA_WIDTH must be 2, 4 or 8.
+    CACHE_LINE_WORDS : integer := 4;
+    CACHE_NUM_LINES : integer := 256
   );
   port (
     -- Reset signal.
@@ -69,6 +81,9 @@ entity xram_sdram is
     o_wb_stall : out std_logic;
     o_wb_err : out std_logic;
 
+    -- High when the request FIFO is full (for performance counters).
+    o_fifo_full : out std_logic;
+
     -- SDRAM interface.
     o_sdram_a : out std_logic_vector(SDRAM_ADDR_WIDTH-1 downto 0);
     o_sdram_ba : out std_logic_vector(SDRAM_BANK_WIDTH-1 downto 0);
@@ -83,17 +98,36 @@ entity xram_sdram is
 end xram_sdram;
 
 architecture rtl of xram_sdram is
+  function ilog2(n : natural) return natural is
+  begin
+    return natural(ceil(log2(real(n))));
+  end ilog2;
+
   constant C_ADDR_WIDTH : integer := SDRAM_COL_WIDTH+SDRAM_ROW_WIDTH+SDRAM_BANK_WIDTH-1;
   constant C_DATA_WIDTH : integer := i_wb_dat'length;
   constant C_SEL_WIDTH : integer := C_DATA_WIDTH/8;
 
   constant C_MEM_OP_WIDTH : integer := C_ADDR_WIDTH + C_DATA_WIDTH + C_SEL_WIDTH + 1;
 
+  -- Cache geometry. The word address is split into tag | index | word.
+  constant C_WORD_BITS : integer := ilog2(CACHE_LINE_WORDS);
+  constant C_INDEX_BITS : integer := ilog2(CACHE_NUM_LINES);
+  constant C_LINE_ADDR_WIDTH : integer := C_ADDR_WIDTH - C_WORD_BITS;
+  constant C_TAG_WIDTH : integer := C_LINE_ADDR_WIDTH - C_INDEX_BITS;
+  constant C_LINE_WIDTH : integer := C_DATA_WIDTH * CACHE_LINE_WORDS;
+  constant C_LINE_SEL_WIDTH : integer := C_LINE_WIDTH/8;
+  constant C_BURST_LENGTH : integer := C_LINE_WIDTH / SDRAM_DATA_WIDTH;
+  constant C_LINE_SEL_NONE : std_logic_vector(C_LINE_SEL_WIDTH-1 downto 0) := (others => '0');
+  constant C_LINE_SEL_ALL : std_logic_vector(C_LINE_SEL_WIDTH-1 downto 0) := (others => '1');
+
+  -- Number of idle cycles before a partially filled write-combining buffer is written to the SDRAM.
+  constant C_WC_IDLE_CYCLES : integer := 4;
+
   -- Input signals.
-  signal s_adr : std_logic_vector(C_ADDR_WIDTH-1 downto 0);
-  signal s_dat_w : std_logic_vector(C_DATA_WIDTH-1 downto 0);
+  signal s_adr : std_logic_vector(C_LINE_ADDR_WIDTH-1 downto 0);
+  signal s_dat_w : std_logic_vector(C_LINE_WIDTH-1 downto 0);
   signal s_we : std_logic;
-  signal s_sel : std_logic_vector(C_SEL_WIDTH-1 downto 0);
+  signal s_sel : std_logic_vector(C_LINE_SEL_WIDTH-1 downto 0);
   signal s_req : std_logic;
 
   -- FIFO signals.
@@ -110,11 +144,108 @@ architecture rtl of xram_sdram is
   alias a_fifo_rd_sel : std_logic_vector(C_SEL_WIDTH-1 downto 0) is s_fifo_rd_data(C_SEL_WIDTH+1-1 downto 1);
   alias a_fifo_rd_we : std_logic is s_fifo_rd_data(0);
 
-  -- Result signals.
+  -- Result signals from the SDRAM controller.
   signal s_busy : std_logic;
+  signal s_mem_ack : std_logic;
+  signal s_mem_dat : std_logic_vector(C_LINE_WIDTH-1 downto 0);
+
+  -- The request that is currently being served.
+  signal s_req_adr : std_logic_vector(C_ADDR_WIDTH-1 downto 0);
+  signal s_req_dat : std_logic_vector(C_DATA_WIDTH-1 downto 0);
+  signal s_req_sel : std_logic_vector(C_SEL_WIDTH-1 downto 0);
+  signal s_req_we : std_logic;
+
+  alias a_req_line : std_logic_vector(C_LINE_ADDR_WIDTH-1 downto 0) is s_req_adr(C_ADDR_WIDTH-1 downto C_WORD_BITS);
+  alias a_req_tag : std_logic_vector(C_TAG_WIDTH-1 downto 0) is s_req_adr(C_ADDR_WIDTH-1 downto C_WORD_BITS+C_INDEX_BITS);
+  alias a_req_index : std_logic_vector(C_INDEX_BITS-1 downto 0) is s_req_adr(C_WORD_BITS+C_INDEX_BITS-1 downto C_WORD_BITS);
+  alias a_req_word : std_logic_vector(C_WORD_BITS-1 downto 0) is s_req_adr(C_WORD_BITS-1 downto 0);
+
+  -- Cache memories (the data and tag memories have registered outputs so that they can be
+  -- inferred as block RAM).
+  type T_LINE_ARRAY is array (0 to CACHE_NUM_LINES-1) of std_logic_vector(C_LINE_WIDTH-1 downto 0);
+  type T_TAG_ARRAY is array (0 to CACHE_NUM_LINES-1) of std_logic_vector(C_TAG_WIDTH-1 downto 0);
+  signal s_cache_data : T_LINE_ARRAY;
+  signal s_cache_tags : T_TAG_ARRAY;
+  signal s_cache_valid : std_logic_vector(CACHE_NUM_LINES-1 downto 0);
+
+  signal s_cache_rd_index : std_logic_vector(C_INDEX_BITS-1 downto 0);
+  signal s_cache_line : std_logic_vector(C_LINE_WIDTH-1 downto 0);
+  signal s_cache_tag : std_logic_vector(C_TAG_WIDTH-1 downto 0);
+  signal s_cache_wr_en : std_logic;
+  signal s_cache_wr_line : std_logic_vector(C_LINE_WIDTH-1 downto 0);
+  signal s_cache_hit : std_logic;
+
+  -- Write-combining buffer.
+  signal s_wc_dirty : std_logic;
+  signal s_wc_line : std_logic_vector(C_LINE_ADDR_WIDTH-1 downto 0);
+  signal s_wc_dat : std_logic_vector(C_LINE_WIDTH-1 downto 0);
+  signal s_wc_sel : std_logic_vector(C_LINE_SEL_WIDTH-1 downto 0);
+  signal s_wc_idle_count : integer range 0 to C_WC_IDLE_CYCLES;
+  signal s_wc_conflict : std_logic;
+
+  -- State machine.
+  type T_STATE is (IDLE, LOOKUP, FLUSH, FLUSH_WAIT, FILL, FILL_WAIT);
+  signal s_state : T_STATE;
+  signal s_flush_next_state : T_STATE;
+
+  -- Wishbone result signals.
   signal s_ack : std_logic;
   signal s_dat : std_logic_vector(C_DATA_WIDTH-1 downto 0);
+
+  -- Extract a word from a cache line.
+  function get_word(line : std_logic_vector; word_no : std_logic_vector) return std_logic_vector is
+    variable v_result : std_logic_vector(C_DATA_WIDTH-1 downto 0);
+  begin
+    v_result := (others => '0');
+    for i in 0 to CACHE_LINE_WORDS-1 loop
+      if to_integer(unsigned(word_no)) = i then
+        v_result := line((i+1)*C_DATA_WIDTH-1 downto i*C_DATA_WIDTH);
+      end if;
+    end loop;
+    return v_result;
+  end function;
+
+  -- Merge the selected bytes of a word into a cache line.
+  function merge_word(line : std_logic_vector;
+                      word_no : std_logic_vector;
+                      dat : std_logic_vector;
+                      sel : std_logic_vector) return std_logic_vector is
+    variable v_result : std_logic_vector(C_LINE_WIDTH-1 downto 0);
+    variable v_lo : integer;
+  begin
+    v_result := line;
+    for i in 0 to CACHE_LINE_WORDS-1 loop
+      for j in 0 to C_SEL_WIDTH-1 loop
+        if to_integer(unsigned(word_no)) = i and sel(j) = '1' then
+          v_lo := i*C_DATA_WIDTH + j*8;
+          v_result(v_lo+7 downto v_lo) := dat(j*8+7 downto j*8);
+        end if;
+      end loop;
+    end loop;
+    return v_result;
+  end function;
+
+  -- Merge the byte select bits of a word into the byte select bits of a cache line.
+  function merge_sel(line_sel : std_logic_vector;
+                     word_no : std_logic_vector;
+                     sel : std_logic_vector) return std_logic_vector is
+    variable v_result : std_logic_vector(C_LINE_SEL_WIDTH-1 downto 0);
+  begin
+    v_result := line_sel;
+    for i in 0 to CACHE_LINE_WORDS-1 loop
+      if to_integer(unsigned(word_no)) = i then
+        v_result((i+1)*C_SEL_WIDTH-1 downto i*C_SEL_WIDTH) :=
+            v_result((i+1)*C_SEL_WIDTH-1 downto i*C_SEL_WIDTH) or sel;
+      end if;
+    end loop;
+    return v_result;
+  end function;
 begin
+  assert C_BURST_LENGTH = 2 or C_BURST_LENGTH = 4 or C_BURST_LENGTH = 8
+    report "Unsupported cache line size (must be 2, 4 or 8 SDRAM words)" severity failure;
+  assert 2**C_WORD_BITS = CACHE_LINE_WORDS and 2**C_INDEX_BITS = CACHE_NUM_LINES
+    report "The cache dimensions must be powers of two" severity failure;
+
   -- Instantiate the memory operation FIFO.
   fifo_1: entity work.fifo
     generic map (
@@ -139,20 +270,163 @@ begin
                     i_wb_sel &
                     i_wb_we;
 
-  -- Read from the FIFO and send to the SDRAM controller.
-  s_fifo_rd_en <= (not s_busy) and (not s_fifo_empty);
-  s_req <= (not s_busy) and (not s_fifo_empty);
-  s_adr <= a_fifo_rd_adr;
-  s_dat_w <= a_fifo_rd_dat;
-  s_sel <= a_fifo_rd_sel;
-  s_we <= a_fifo_rd_we;
+  -- Read the next request from the FIFO when we're idle, or right after a cache read hit (which
+  -- does not modify the cache, so the next request can be looked up immediately).
+  s_cache_hit <= '1' when s_cache_valid(to_integer(unsigned(a_req_index))) = '1' and
+                          s_cache_tag = a_req_tag else '0';
+  s_fifo_rd_en <= not s_fifo_empty when s_state = IDLE or
+                                        (s_state = LOOKUP and s_req_we = '0' and s_cache_hit = '1')
+                                   else '0';
+
+  -- A store to another line than the one in the write-combining buffer must wait for a flush.
+  s_wc_conflict <= s_wc_dirty when s_wc_line /= a_req_line else '0';
+
+  -- Cache memories.
+  s_cache_rd_index <= a_fifo_rd_adr(C_WORD_BITS+C_INDEX_BITS-1 downto C_WORD_BITS)
+                      when s_fifo_rd_en = '1' else a_req_index;
+  s_cache_wr_en <= '1' when (s_state = LOOKUP and s_req_we = '1' and s_cache_hit = '1' and
+                             s_wc_conflict = '0') or
+                            (s_state = FILL_WAIT and s_mem_ack = '1') else '0';
+  s_cache_wr_line <= s_mem_dat when s_state = FILL_WAIT else
+                     merge_word(s_cache_line, a_req_word, s_req_dat, s_req_sel);
+
+  process (i_wb_clk)
+  begin
+    if rising_edge(i_wb_clk) then
+      if s_cache_wr_en = '1' then
+        s_cache_data(to_integer(unsigned(a_req_index))) <= s_cache_wr_line;
+        s_cache_tags(to_integer(unsigned(a_req_index))) <= a_req_tag;
+      end if;
+      s_cache_line <= s_cache_data(to_integer(unsigned(s_cache_rd_index)));
+      s_cache_tag <= s_cache_tags(to_integer(unsigned(s_cache_rd_index)));
+    end if;
+  end process;
+
+  -- Main state machine.
+  process (i_rst, i_wb_clk)
+  begin
+    if i_rst = '1' then
+      s_state <= IDLE;
+      s_flush_next_state <= IDLE;
+      s_req_adr <= (others => '0');
+      s_req_dat <= (others => '0');
+      s_req_sel <= (others => '0');
+      s_req_we <= '0';
+      s_cache_valid <= (others => '0');
+      s_wc_dirty <= '0';
+      s_wc_line <= (others => '0');
+      s_wc_dat <= (others => '0');
+      s_wc_sel <= (others => '0');
+      s_wc_idle_count <= 0;
+      s_ack <= '0';
+      s_dat <= (others => '0');
+    elsif rising_edge(i_wb_clk) then
+      s_ack <= '0';
+
+      -- Latch the next request from the FIFO.
+      if s_fifo_rd_en = '1' then
+        s_req_adr <= a_fifo_rd_adr;
+        s_req_dat <= a_fifo_rd_dat;
+        s_req_sel <= a_fifo_rd_sel;
+        s_req_we <= a_fifo_rd_we;
+      end if;
+
+      if s_cache_wr_en = '1' then
+        s_cache_valid(to_integer(unsigned(a_req_index))) <= '1';
+      end if;
+
+      -- Count idle cycles while there is data in the write-combining buffer.
+      if s_state = IDLE and s_fifo_empty = '1' and s_wc_dirty = '1' then
+        if s_wc_idle_count /= C_WC_IDLE_CYCLES then
+          s_wc_idle_count <= s_wc_idle_count + 1;
+        end if;
+      else
+        s_wc_idle_count <= 0;
+      end if;
 
-  -- Instantiate the SDRAM controller.
+      case s_state is
+        when IDLE =>
+          if s_fifo_empty = '0' then
+            s_state <= LOOKUP;
+          elsif s_wc_dirty = '1' and
+                (s_wc_idle_count = C_WC_IDLE_CYCLES or s_wc_sel = C_LINE_SEL_ALL) then
+            s_state <= FLUSH;
+            s_flush_next_state <= IDLE;
+          end if;
+
+        when LOOKUP =>
+          if s_req_we = '0' then
+            if s_cache_hit = '1' then
+              -- Read hit. Continue with the next request (if any).
+              s_ack <= '1';
+              s_dat <= get_word(s_cache_line, a_req_word);
+              if s_fifo_empty = '1' then
+                s_state <= IDLE;
+              end if;
+            elsif s_wc_dirty = '1' then
+              -- Read miss: Flush pending writes before reading from the SDRAM.
+              s_state <= FLUSH;
+              s_flush_next_state <= LOOKUP;
+            else
+              s_state <= FILL;
+            end if;
+          elsif s_wc_conflict = '1' then
+            s_state <= FLUSH;
+            s_flush_next_state <= LOOKUP;
+          else
+            -- Merge the store into the write-combining buffer (the cache is updated by the cache
+            -- memory process if this is a cache hit).
+            if s_wc_dirty = '1' then
+              s_wc_sel <= merge_sel(s_wc_sel, a_req_word, s_req_sel);
+            else
+              s_wc_sel <= merge_sel(C_LINE_SEL_NONE, a_req_word, s_req_sel);
+            end if;
+            s_wc_dat <= merge_word(s_wc_dat, a_req_word, s_req_dat, s_req_sel);
+            s_wc_line <= a_req_line;
+            s_wc_dirty <= '1';
+            s_ack <= '1';
+            s_state <= IDLE;
+          end if;
+
+        when FLUSH =>
+          if s_busy = '0' then
+            s_state <= FLUSH_WAIT;
+          end if;
+
+        when FLUSH_WAIT =>
+          if s_mem_ack = '1' then
+            s_wc_dirty <= '0';
+            s_state <= s_flush_next_state;
+          end if;
+
+        when FILL =>
+          if s_busy = '0' then
+            s_state <= FILL_WAIT;
+          end if;
+
+        when FILL_WAIT =>
+          if s_mem_ack = '1' then
+            s_ack <= '1';
+            s_dat <= get_word(s_mem_dat, a_req_word);
+            s_state <= IDLE;
+          end if;
+      end case;
+    end if;
+  end process;
+
+  -- SDRAM requests: Line writes from the write-combining buffer, and line reads for cache fills.
+  s_req <= '1' when s_state = FLUSH or s_state = FILL else '0';
+  s_we <= '1' when s_state = FLUSH else '0';
+  s_adr <= s_wc_line when s_state = FLUSH else a_req_line;
+  s_dat_w <= s_wc_dat;
+  s_sel <= s_wc_sel;
+
+  -- Instantiate the SDRAM controller (with one cache line per request).
   sdram_controller_1: entity work.sdram
     generic map (
       G_CLK_FREQ_HZ => CPU_CLK_HZ,
-      G_ADDR_WIDTH => C_ADDR_WIDTH,
-      G_DATA_WIDTH => C_DATA_WIDTH,
+      G_ADDR_WIDTH => C_LINE_ADDR_WIDTH,
+      G_DATA_WIDTH => C_LINE_WIDTH,
       G_SDRAM_A_WIDTH => SDRAM_ADDR_WIDTH,
       G_SDRAM_DQ_WIDTH => SDRAM_DATA_WIDTH,
       G_SDRAM_BA_WIDTH => SDRAM_BANK_WIDTH,
@@ -178,8 +452,8 @@ begin
       i_sel => s_sel,
       i_req => s_req,
       o_busy => s_busy,
-      o_ack => s_ack,
-      o_dat => s_dat,
+      o_ack => s_mem_ack,
+      o_dat => s_mem_dat,
 
       -- External SDRAM interface.
       o_sdram_a => o_sdram_a,
@@ -195,8 +469,8 @@ begin
 
   -- Wishbone outputs.
   o_wb_stall <= s_fifo_full;
+  o_fifo_full <= s_fifo_full;
   o_wb_ack <= s_ack;
   o_wb_dat <= s_dat;
   o_wb_err <= '0';
 end rtl;
-
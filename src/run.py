@@ -26,11 +26,15 @@ def main():
     lib.add_source_files("test/*_tb.vhd")
 
     # Add simulation models.
+    lib.add_source_files("test/sd_card_model.vhd")
     lib.add_source_files("test/sdram_model.vhd")
 
     # Add the MC1 design.
     lib.add_source_files("rtl/bit_synchronizer.vhd")
     lib.add_source_files("rtl/dither.vhd")
+    lib.add_source_files("rtl/dma.vhd")
+    lib.add_source_files("rtl/event_synchronizer.vhd")
+    lib.add_source_files("rtl/fifo.vhd")
     lib.add_source_files("rtl/mc1.vhd")
     lib.add_source_files("rtl/mmio_types.vhd")
     lib.add_source_files("rtl/mmio.vhd")
@@ -41,8 +45,10 @@ def main():
     lib.add_source_files("rtl/reset_conditioner.vhd")
     lib.add_source_files("rtl/reset_stabilizer.vhd")
     lib.add_source_files("rtl/sdram.vhd")
+    lib.add_source_files("rtl/spi_master.vhd")
     lib.add_source_files("rtl/synchronizer.vhd")
     lib.add_source_files("rtl/vid_blend.vhd")
+    lib.add_source_files("rtl/vid_line_fetch.vhd")
     lib.add_source_files("rtl/video_layer.vhd")
     lib.add_source_files("rtl/video.vhd")
     lib.add_source_files("rtl/vid_palette.vhd")
@@ -54,7 +60,9 @@ def main():
     lib.add_source_files("rtl/vid_vcpp_stack.vhd")
     lib.add_source_files("rtl/vid_vcpp.vhd")
     lib.add_source_files("rtl/vram.vhd")
+    lib.add_source_files("rtl/wb_arbiter_2x1.vhd")
     lib.add_source_files("rtl/wb_crossbar_2x4.vhd")
+    lib.add_source_files("rtl/wb_types.vhd")
     lib.add_source_files("rtl/xram_sdram.vhd")
 
     # Add the MC1 boot ROM (must be generated with "make").
@@ -71,6 +79,11 @@ def main():
     mrisc32.add_source_files("mrisc32-a1/rtl/pipeline/*.vhd")
     mrisc32.add_source_files("mrisc32-a1/rtl/sau/*.vhd")
 
+    # Run the crossbar test bench with all the arbitration policies.
+    xbar_tb = lib.test_bench("wb_crossbar_2x4_tb")
+    for policy in ["fixed", "round_robin", "weighted"]:
+        xbar_tb.add_config(name=policy, generics=dict(arb_policy=policy))
+
     # Bake the video_tb test data.
     bake_video_tb_vram()
 
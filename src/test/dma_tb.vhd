@@ -0,0 +1,347 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Functional and throughput test for the DMA engine (with a VRAM slave).
+--
+-- The test bench writes source data to the VRAM via its own Wishbone master (while the DMA engine
+-- is idle), and checks the result via the read port of the VRAM. The tests report the number of
+-- bytes per cycle for each transfer.
+----------------------------------------------------------------------------------------------------
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity dma_tb is
+  generic (runner_cfg : string);
+end entity;
+
+architecture tb of dma_tb is
+  constant C_ADR_BITS : positive := 12;  -- 4096 words
+  constant C_CLK_HALF_PERIOD : time := 5 ns;
+
+  signal s_rst : std_logic;
+  signal s_clk : std_logic := '0';
+  signal s_done : boolean := false;
+
+  -- DMA control interface.
+  signal s_start : std_logic;
+  signal s_fill : std_logic;
+  signal s_src_adr : std_logic_vector(31 downto 0);
+  signal s_dst_adr : std_logic_vector(31 downto 0);
+  signal s_width : std_logic_vector(15 downto 0);
+  signal s_height : std_logic_vector(15 downto 0);
+  signal s_src_stride : std_logic_vector(31 downto 0);
+  signal s_dst_stride : std_logic_vector(31 downto 0);
+  signal s_fill_value : std_logic_vector(31 downto 0);
+  signal s_busy : std_logic;
+  signal s_dma_done : std_logic;
+  signal s_err : std_logic;
+
+  -- DMA Wishbone master.
+  signal s_dma_cyc : std_logic;
+  signal s_dma_stb : std_logic;
+  signal s_dma_adr : std_logic_vector(29 downto 0);
+  signal s_dma_dat_w : std_logic_vector(31 downto 0);
+  signal s_dma_we : std_logic;
+  signal s_dma_sel : std_logic_vector(3 downto 0);
+
+  -- Test bench Wishbone master (used for initializing the memory).
+  signal s_tb_cyc : std_logic;
+  signal s_tb_stb : std_logic;
+  signal s_tb_adr : std_logic_vector(29 downto 0);
+  signal s_tb_dat_w : std_logic_vector(31 downto 0);
+
+  -- VRAM slave.
+  signal s_wb_cyc : std_logic;
+  signal s_wb_stb : std_logic;
+  signal s_wb_adr : std_logic_vector(29 downto 0);
+  signal s_wb_dat_w : std_logic_vector(31 downto 0);
+  signal s_wb_we : std_logic;
+  signal s_wb_sel : std_logic_vector(3 downto 0);
+  signal s_wb_dat : std_logic_vector(31 downto 0);
+  signal s_wb_ack : std_logic;
+  signal s_wb_stall : std_logic;
+
+  signal s_read_adr : std_logic_vector(C_ADR_BITS-1 downto 0);
+  signal s_read_dat : std_logic_vector(31 downto 0);
+
+  -- The value that is written to (and expected from) a word address.
+  function pattern(adr : integer) return std_logic_vector is
+  begin
+    return not std_logic_vector(to_unsigned(adr mod 65536, 16)) &
+           std_logic_vector(to_unsigned(adr mod 65536, 16));
+  end function;
+
+  function to_word(x : integer) return std_logic_vector is
+  begin
+    return std_logic_vector(to_signed(x, 32));
+  end function;
+begin
+  dma_1: entity work.dma
+    port map (
+      i_rst => s_rst,
+      i_clk => s_clk,
+
+      i_start => s_start,
+      i_fill => s_fill,
+      i_src_adr => s_src_adr,
+      i_dst_adr => s_dst_adr,
+      i_width => s_width,
+      i_height => s_height,
+      i_src_stride => s_src_stride,
+      i_dst_stride => s_dst_stride,
+      i_fill_value => s_fill_value,
+      o_busy => s_busy,
+      o_done => s_dma_done,
+      o_err => s_err,
+
+      o_wb_cyc => s_dma_cyc,
+      o_wb_stb => s_dma_stb,
+      o_wb_adr => s_dma_adr,
+      o_wb_dat => s_dma_dat_w,
+      o_wb_we => s_dma_we,
+      o_wb_sel => s_dma_sel,
+      i_wb_dat => s_wb_dat,
+      i_wb_ack => s_wb_ack,
+      i_wb_stall => s_wb_stall,
+      i_wb_err => '0'
+    );
+
+  -- The test bench master only uses the bus while the DMA engine is idle.
+  s_wb_cyc <= s_dma_cyc or s_tb_cyc;
+  s_wb_stb <= s_dma_stb or s_tb_stb;
+  s_wb_adr <= s_dma_adr when s_dma_cyc = '1' else s_tb_adr;
+  s_wb_dat_w <= s_dma_dat_w when s_dma_cyc = '1' else s_tb_dat_w;
+  s_wb_we <= s_dma_we when s_dma_cyc = '1' else s_tb_stb;
+  s_wb_sel <= s_dma_sel when s_dma_cyc = '1' else "1111";
+
+  vram_1: entity work.vram
+    generic map (
+      ADR_BITS => C_ADR_BITS
+    )
+    port map (
+      i_rst => s_rst,
+
+      i_wb_clk => s_clk,
+      i_wb_cyc => s_wb_cyc,
+      i_wb_stb => s_wb_stb,
+      i_wb_adr => s_wb_adr(C_ADR_BITS-1 downto 0),
+      i_wb_dat => s_wb_dat_w,
+      i_wb_we => s_wb_we,
+      i_wb_sel => s_wb_sel,
+      o_wb_dat => s_wb_dat,
+      o_wb_ack => s_wb_ack,
+      o_wb_stall => s_wb_stall,
+
+      i_read_clk => s_clk,
+      i_read_adr => s_read_adr,
+      o_read_dat => s_read_dat
+    );
+
+  s_clk <= not s_clk after C_CLK_HALF_PERIOD when not s_done else s_clk;
+
+  main : process
+    -- Write pattern() to count words, starting at the word address base.
+    procedure write_pattern(constant c_base : integer; constant c_count : integer) is
+    begin
+      s_tb_cyc <= '1';
+      s_tb_stb <= '1';
+      for i in c_base to c_base + c_count - 1 loop
+        s_tb_adr <= std_logic_vector(to_unsigned(i, 30));
+        s_tb_dat_w <= pattern(i);
+        wait until rising_edge(s_clk);
+      end loop;
+      s_tb_stb <= '0';
+      wait until rising_edge(s_clk);
+      s_tb_cyc <= '0';
+    end procedure;
+
+    -- Write the same value to count words, starting at the word address base.
+    procedure write_value(constant c_base : integer;
+                          constant c_count : integer;
+                          constant c_value : std_logic_vector(31 downto 0)) is
+    begin
+      s_tb_cyc <= '1';
+      s_tb_stb <= '1';
+      s_tb_dat_w <= c_value;
+      for i in c_base to c_base + c_count - 1 loop
+        s_tb_adr <= std_logic_vector(to_unsigned(i, 30));
+        wait until rising_edge(s_clk);
+      end loop;
+      s_tb_stb <= '0';
+      wait until rising_edge(s_clk);
+      s_tb_cyc <= '0';
+    end procedure;
+
+    -- Read a word via the read port of the VRAM.
+    procedure check_word(constant c_adr : integer;
+                         constant c_expected : std_logic_vector(31 downto 0)) is
+    begin
+      s_read_adr <= std_logic_vector(to_unsigned(c_adr, C_ADR_BITS));
+      wait until rising_edge(s_clk);
+      wait until rising_edge(s_clk);
+      check_equal(s_read_dat, c_expected, "Bad data for word address " & integer'image(c_adr));
+    end procedure;
+
+    -- Start a transfer (byte addresses and strides) and wait for it to finish. Returns the number
+    -- of cycles from the start request until the done flag is set.
+    procedure transfer(constant c_fill : std_logic;
+                       constant c_src : integer;
+                       constant c_dst : integer;
+                       constant c_width : integer;
+                       constant c_height : integer;
+                       constant c_src_stride : integer;
+                       constant c_dst_stride : integer;
+                       constant c_fill_value : std_logic_vector(31 downto 0);
+                       variable v_cycles : out integer) is
+    begin
+      s_fill <= c_fill;
+      s_src_adr <= to_word(c_src);
+      s_dst_adr <= to_word(c_dst);
+      s_width <= std_logic_vector(to_unsigned(c_width, 16));
+      s_height <= std_logic_vector(to_unsigned(c_height, 16));
+      s_src_stride <= to_word(c_src_stride);
+      s_dst_stride <= to_word(c_dst_stride);
+      s_fill_value <= c_fill_value;
+      s_start <= '1';
+      wait until rising_edge(s_clk);
+      s_start <= '0';
+      v_cycles := 0;
+      loop
+        wait until rising_edge(s_clk);
+        v_cycles := v_cycles + 1;
+        exit when s_dma_done = '1';
+        check(v_cycles < 100000, "DMA transfer timed out");
+      end loop;
+      check_equal(s_busy, '0', "The DMA engine is still busy");
+      check_equal(s_err, '0', "Unexpected bus error");
+    end procedure;
+
+    procedure report_rate(constant c_name : string;
+                          constant c_cycles : integer;
+                          constant c_words : integer) is
+    begin
+      info(c_name & ": " & integer'image(c_cycles) & " cycles for " &
+           integer'image(4 * c_words) & " bytes (" &
+           integer'image((400 * c_words) / c_cycles) & " bytes/100 cycles)");
+    end procedure;
+
+    constant C_NUM_WORDS : integer := 1024;
+    constant C_MARKER : std_logic_vector(31 downto 0) := x"deadbeef";
+    constant C_FILL : std_logic_vector(31 downto 0) := x"12345678";
+    variable v_cycles : integer;
+    variable v_src : integer;
+    variable v_dst : integer;
+  begin
+    test_runner_setup(runner, runner_cfg);
+
+    s_start <= '0';
+    s_fill <= '0';
+    s_src_adr <= (others => '0');
+    s_dst_adr <= (others => '0');
+    s_width <= (others => '0');
+    s_height <= (others => '0');
+    s_src_stride <= (others => '0');
+    s_dst_stride <= (others => '0');
+    s_fill_value <= (others => '0');
+    s_tb_cyc <= '0';
+    s_tb_stb <= '0';
+    s_tb_adr <= (others => '0');
+    s_tb_dat_w <= (others => '0');
+    s_read_adr <= (others => '0');
+
+    s_rst <= '1';
+    wait until rising_edge(s_clk);
+    wait until rising_edge(s_clk);
+    s_rst <= '0';
+    wait until rising_edge(s_clk);
+
+    while test_suite loop
+      if run("fill") then
+        write_value(1000, C_NUM_WORDS + 2, C_MARKER);
+        transfer('1', 0, 4 * 1001, C_NUM_WORDS, 1, 0, 0, C_FILL, v_cycles);
+        report_rate("Fill", v_cycles, C_NUM_WORDS);
+        check(v_cycles * 3 <= C_NUM_WORDS * 4, "The fill is too slow");  -- >= 3 bytes/cycle
+
+        check_word(1000, C_MARKER);
+        for i in 1001 to 1000 + C_NUM_WORDS loop
+          check_word(i, C_FILL);
+        end loop;
+        check_word(1001 + C_NUM_WORDS, C_MARKER);
+
+      elsif run("copy") then
+        -- Use a length that is not a multiple of the burst length.
+        write_pattern(0, C_NUM_WORDS + 4);
+        write_value(2000, C_NUM_WORDS + 5, C_MARKER);
+        transfer('0', 4 * 1, 4 * 2001, C_NUM_WORDS + 3, 1, 0, 0, C_FILL, v_cycles);
+        report_rate("Copy", v_cycles, C_NUM_WORDS + 3);
+        check(v_cycles * 3 <= (C_NUM_WORDS + 3) * 8, "The copy is too slow");  -- >= 1.5 bytes/cycle
+
+        check_word(2000, C_MARKER);
+        for i in 0 to C_NUM_WORDS + 2 loop
+          check_word(2001 + i, pattern(1 + i));
+        end loop;
+        check_word(2004 + C_NUM_WORDS, C_MARKER);
+
+      elsif run("rect") then
+        -- Copy a 21x7 word rectangle from a 64 word wide image to a 32 word wide image, with the
+        -- destination rows in reverse order (negative stride).
+        write_pattern(0, 64 * 8);
+        write_value(1024, 32 * 8, C_MARKER);
+        transfer('0', 4 * (64 + 3), 4 * (1024 + 6 * 32 + 5), 21, 7, 4 * 64, -4 * 32, C_FILL,
+                 v_cycles);
+        report_rate("Rectangle copy", v_cycles, 21 * 7);
+
+        for y in 0 to 7 loop
+          for x in 0 to 31 loop
+            v_dst := 1024 + y * 32 + x;
+            if y < 7 and x >= 5 and x < 5 + 21 then
+              v_src := (64 + 3) + (6 - y) * 64 + (x - 5);
+              check_word(v_dst, pattern(v_src));
+            else
+              check_word(v_dst, C_MARKER);
+            end if;
+          end loop;
+        end loop;
+
+        -- Rectangle fill with an empty transfer in between (which must finish immediately).
+        transfer('1', 0, 4 * 1024, 0, 7, 0, 0, C_FILL, v_cycles);
+        check_word(1024, C_MARKER);
+        transfer('1', 0, 4 * (1024 + 32 + 1), 2, 3, 0, 4 * 32, C_FILL, v_cycles);
+        for y in 0 to 4 loop
+          for x in 0 to 3 loop
+            if y >= 1 and y < 4 and x >= 1 and x < 3 then
+              check_word(1024 + y * 32 + x, C_FILL);
+            else
+              check_word(1024 + y * 32 + x, C_MARKER);
+            end if;
+          end loop;
+        end loop;
+      end if;
+    end loop;
+
+    s_done <= true;
+    test_runner_cleanup(runner);
+  end process;
+end architecture;
@@ -0,0 +1,229 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Behavioral model of an SD card (SDHC) in SPI mode.
+--
+-- The model supports the commands that are needed for initializing the card and for reading
+-- blocks: CMD0, CMD8, CMD12, CMD17, CMD18, CMD55, ACMD41 and CMD58. CRCs are neither checked nor
+-- generated. Byte n of block b has the value (b * 31 + n) mod 256.
+--
+-- During a multi-block read, the card keeps sending data while it receives CMD12. The byte after
+-- the command is a stuff byte that is not 0xff (bit 7 is clear, so a host that does not skip it
+-- reads a bad R1), followed by NCR, R1 and a busy period.
+--
+-- All bytes are sent MSB first (SPI mode 0): MISO changes after the falling edge of SCK, and MOSI
+-- is sampled at the rising edge of SCK. Clock edges while CS_n is high are ignored.
+----------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity sd_card_model is
+  generic (
+    READ_WAIT_BYTES : natural := 4  -- Number of 0xff bytes before a data token.
+  );
+  port (
+    i_sck : in std_logic;
+    i_cs_n : in std_logic;
+    i_mosi : in std_logic;
+    o_miso : out std_logic
+  );
+end sd_card_model;
+
+architecture behavioral of sd_card_model is
+  subtype T_BYTE is std_logic_vector(7 downto 0);
+
+  constant C_CMD12 : T_BYTE := x"4c";  -- Start bit + transmission bit + command index 12.
+  constant C_STUFF_BYTE : T_BYTE := x"3f";
+
+  function data_byte(block_no : integer; offset : integer) return T_BYTE is
+  begin
+    return std_logic_vector(to_unsigned((block_no * 31 + offset) mod 256, 8));
+  end function;
+begin
+  process
+    variable v_rx : T_BYTE;
+    variable v_cmd : std_logic_vector(47 downto 0);
+    variable v_idx : integer;
+    variable v_arg : std_logic_vector(31 downto 0);
+    variable v_idle : boolean := true;
+    variable v_app_cmd : boolean := false;
+    variable v_init_tries : integer := 0;
+    variable v_r1 : T_BYTE;
+    variable v_block : integer;
+    variable v_stop : boolean;
+    variable v_stop_count : integer := 0;  -- Remaining CMD12 bytes.
+
+    -- Transfer one byte in each direction.
+    procedure xfer(constant c_tx : T_BYTE; variable v_byte : out T_BYTE) is
+    begin
+      for i in 7 downto 0 loop
+        o_miso <= c_tx(i);
+        wait until rising_edge(i_sck) and i_cs_n = '0';
+        v_byte(i) := i_mosi;
+        wait until falling_edge(i_sck);
+      end loop;
+    end procedure;
+
+    procedure send(constant c_tx : T_BYTE) is
+      variable v_dummy : T_BYTE;
+    begin
+      xfer(c_tx, v_dummy);
+    end procedure;
+
+    -- Send a byte of a multi-block read, and handle CMD12 (STOP_TRANSMISSION) if the host sends it.
+    procedure send_data(constant c_tx : T_BYTE; variable v_stopped : inout boolean) is
+      variable v_byte : T_BYTE;
+    begin
+      xfer(c_tx, v_byte);
+      if v_stop_count > 0 then
+        -- Keep sending data while the argument and the CRC are received.
+        v_stop_count := v_stop_count - 1;
+        if v_stop_count = 0 then
+          send(C_STUFF_BYTE);
+          send(x"ff");  -- NCR
+          send(x"00");  -- R1
+          send(x"00");  -- Busy
+          send(x"00");
+          v_stopped := true;
+        end if;
+      elsif v_byte = C_CMD12 then
+        v_stop_count := 5;
+      end if;
+    end procedure;
+
+    procedure send_block(constant c_block : integer; variable v_stopped : inout boolean) is
+    begin
+      for i in 1 to READ_WAIT_BYTES loop
+        send_data(x"ff", v_stopped);
+        if v_stopped then
+          return;
+        end if;
+      end loop;
+      send_data(x"fe", v_stopped);
+      if v_stopped then
+        return;
+      end if;
+      for i in 0 to 511 loop
+        send_data(data_byte(c_block, i), v_stopped);
+        if v_stopped then
+          return;
+        end if;
+      end loop;
+      send_data(x"00", v_stopped);  -- CRC (not checked by the host).
+      if v_stopped then
+        return;
+      end if;
+      send_data(x"00", v_stopped);
+    end procedure;
+  begin
+    o_miso <= '1';
+
+    loop
+      -- Wait for a command (start bit = 0, transmission bit = 1).
+      xfer(x"ff", v_rx);
+      if v_rx(7 downto 6) = "01" then
+        v_cmd(47 downto 40) := v_rx;
+        for i in 4 downto 0 loop
+          xfer(x"ff", v_rx);
+          v_cmd(i*8+7 downto i*8) := v_rx;
+        end loop;
+        v_idx := to_integer(unsigned(v_cmd(45 downto 40)));
+        v_arg := v_cmd(39 downto 8);
+
+        -- NCR (one byte before the response).
+        send(x"ff");
+
+        if v_app_cmd and v_idx = 41 then
+          -- ACMD41 (SD_SEND_OP_COND): The card is ready after the second try.
+          v_init_tries := v_init_tries + 1;
+          v_idle := v_init_tries < 2;
+          v_app_cmd := false;
+          if v_idle then
+            send(x"01");
+          else
+            send(x"00");
+          end if;
+        else
+          v_app_cmd := false;
+          v_r1 := x"00";
+          if v_idle then
+            v_r1 := x"01";
+          end if;
+
+          case v_idx is
+            when 0 =>
+              -- GO_IDLE_STATE
+              v_idle := true;
+              v_init_tries := 0;
+              send(x"01");
+
+            when 8 =>
+              -- SEND_IF_COND: Echo the check pattern.
+              send(v_r1);
+              send(x"00");
+              send(x"00");
+              send(x"01");
+              send(v_arg(7 downto 0));
+
+            when 12 =>
+              -- STOP_TRANSMISSION (when no transmission is in progress).
+              send(v_r1);
+
+            when 17 =>
+              -- READ_SINGLE_BLOCK
+              send(v_r1);
+              v_stop := false;
+              send_block(to_integer(unsigned(v_arg)), v_stop);
+
+            when 18 =>
+              -- READ_MULTIPLE_BLOCK: Send blocks until CMD12 is received.
+              send(v_r1);
+              v_stop := false;
+              v_stop_count := 0;
+              v_block := to_integer(unsigned(v_arg));
+              while not v_stop loop
+                send_block(v_block, v_stop);
+                v_block := v_block + 1;
+              end loop;
+
+            when 55 =>
+              -- APP_CMD
+              v_app_cmd := true;
+              send(v_r1);
+
+            when 58 =>
+              -- READ_OCR: Powered up, CCS = 1 (SDHC), 2.7-3.6 V.
+              send(v_r1);
+              send(x"c0");
+              send(x"ff");
+              send(x"80");
+              send(x"00");
+
+            when others =>
+              -- Illegal command.
+              send(v_r1 or x"04");
+          end case;
+        end if;
+      end if;
+    end loop;
+  end process;
+end architecture;
@@ -0,0 +1,409 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Functional and throughput test for spi_master (with the SD card simulation model).
+--
+-- The test drives the control interface the same way as the ROM SD card driver: Commands are sent
+-- through the TX FIFO, responses are read one byte at a time, and data blocks are read in word
+-- mode with a single receive count.
+----------------------------------------------------------------------------------------------------
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity spi_master_tb is
+  generic (runner_cfg : string);
+end entity;
+
+architecture tb of spi_master_tb is
+  constant C_CPU_CLK_HZ : positive := 100_000_000;
+  constant C_CLK_HALF_PERIOD : time := 1000 ms / (2 * C_CPU_CLK_HZ);
+  constant C_LOG2_FIFO_DEPTH : positive := 4;
+  constant C_FIFO_DEPTH : positive := 2**C_LOG2_FIFO_DEPTH;
+
+  subtype T_BYTE is std_logic_vector(7 downto 0);
+
+  signal s_rst : std_logic;
+  signal s_clk : std_logic := '0';
+  signal s_done : boolean := false;
+
+  signal s_enable : std_logic;
+  signal s_cs : std_logic;
+  signal s_word : std_logic;
+  signal s_duplex : std_logic;
+  signal s_div : std_logic_vector(15 downto 0);
+  signal s_tx_stb : std_logic;
+  signal s_rd_stb : std_logic;
+  signal s_wr_data : std_logic_vector(31 downto 0);
+  signal s_rx_pop : std_logic;
+  signal s_rx_data : std_logic_vector(31 downto 0);
+  signal s_status : std_logic_vector(31 downto 0);
+
+  signal s_sck : std_logic;
+  signal s_mosi : std_logic;
+  signal s_cs_n : std_logic;
+  signal s_miso : std_logic;
+
+  -- The block data of the SD card model.
+  function data_byte(block_no : integer; offset : integer) return T_BYTE is
+  begin
+    return std_logic_vector(to_unsigned((block_no * 31 + offset) mod 256, 8));
+  end function;
+
+  -- Four bytes in memory order.
+  function data_word(block_no : integer; word_no : integer) return std_logic_vector is
+  begin
+    return data_byte(block_no, word_no * 4 + 3) & data_byte(block_no, word_no * 4 + 2) &
+           data_byte(block_no, word_no * 4 + 1) & data_byte(block_no, word_no * 4);
+  end function;
+begin
+  spi_master_1: entity work.spi_master
+    generic map (
+      LOG2_FIFO_DEPTH => C_LOG2_FIFO_DEPTH
+    )
+    port map (
+      i_rst => s_rst,
+      i_clk => s_clk,
+      i_enable => s_enable,
+      i_cs => s_cs,
+      i_word => s_word,
+      i_duplex => s_duplex,
+      i_div => s_div,
+      i_tx_stb => s_tx_stb,
+      i_rd_stb => s_rd_stb,
+      i_wr_data => s_wr_data,
+      i_rx_pop => s_rx_pop,
+      o_rx_data => s_rx_data,
+      o_status => s_status,
+      o_sck => s_sck,
+      o_mosi => s_mosi,
+      o_cs_n => s_cs_n,
+      i_miso => s_miso
+    );
+
+  sd_card_model_1: entity work.sd_card_model
+    port map (
+      i_sck => s_sck,
+      i_cs_n => s_cs_n,
+      i_mosi => s_mosi,
+      o_miso => s_miso
+    );
+
+  s_clk <= not s_clk after C_CLK_HALF_PERIOD when not s_done else s_clk;
+
+  main : process
+    -- Push a byte or a word to the TX FIFO (waiting while it is full).
+    -- Note: The signals that are sampled after a clock edge are the values from before the edge.
+    procedure push(constant c_data : std_logic_vector(31 downto 0)) is
+    begin
+      s_tx_stb <= '1';
+      s_wr_data <= c_data;
+      loop
+        wait until rising_edge(s_clk);
+        exit when s_status(1) = '0';
+      end loop;
+      s_tx_stb <= '0';
+    end procedure;
+
+    -- Pop an entry from the RX FIFO (waiting while it is empty).
+    procedure pop(variable v_data : out std_logic_vector(31 downto 0)) is
+    begin
+      s_rx_pop <= '1';
+      loop
+        wait until rising_edge(s_clk);
+        exit when s_status(2) = '0';
+      end loop;
+      v_data := s_rx_data;
+      s_rx_pop <= '0';
+    end procedure;
+
+    -- Request c_count receive-only transfers.
+    procedure receive(constant c_count : integer) is
+    begin
+      s_rd_stb <= '1';
+      s_wr_data <= std_logic_vector(to_unsigned(c_count, 32));
+      wait until rising_edge(s_clk);
+      s_rd_stb <= '0';
+    end procedure;
+
+    procedure wait_idle is
+    begin
+      loop
+        wait until rising_edge(s_clk);
+        exit when s_status(0) = '0';
+      end loop;
+    end procedure;
+
+    procedure read_byte(variable v_byte : out T_BYTE) is
+      variable v_data : std_logic_vector(31 downto 0);
+    begin
+      receive(1);
+      pop(v_data);
+      v_byte := v_data(7 downto 0);
+    end procedure;
+
+    procedure send_cmd(constant c_idx : integer; constant c_arg : std_logic_vector(31 downto 0)) is
+    begin
+      push(x"000000" & "01" & std_logic_vector(to_unsigned(c_idx, 6)));
+      push(x"000000" & c_arg(31 downto 24));
+      push(x"000000" & c_arg(23 downto 16));
+      push(x"000000" & c_arg(15 downto 8));
+      push(x"000000" & c_arg(7 downto 0));
+      push(x"00000001");  -- Dummy CRC + stop bit.
+    end procedure;
+
+    -- Read bytes until a non-0xff byte (a data token) is received.
+    procedure read_response(variable v_byte : out T_BYTE) is
+      variable v_tmp : T_BYTE;
+    begin
+      for i in 1 to 16 loop
+        read_byte(v_tmp);
+        exit when v_tmp /= x"ff";
+      end loop;
+      v_byte := v_tmp;
+    end procedure;
+
+    -- Read bytes until an R1 response (bit 7 clear) is received.
+    procedure read_r1(variable v_byte : out T_BYTE) is
+      variable v_tmp : T_BYTE;
+    begin
+      for i in 1 to 16 loop
+        read_byte(v_tmp);
+        exit when v_tmp(7) = '0';
+      end loop;
+      v_byte := v_tmp;
+    end procedure;
+
+    procedure command(constant c_idx : integer;
+                      constant c_arg : std_logic_vector(31 downto 0);
+                      constant c_expected_r1 : T_BYTE) is
+      variable v_r1 : T_BYTE;
+    begin
+      send_cmd(c_idx, c_arg);
+      read_r1(v_r1);
+      check_equal(v_r1, c_expected_r1, "Bad R1 for CMD" & integer'image(c_idx));
+    end procedure;
+
+    procedure init_card is
+      variable v_byte : T_BYTE;
+      variable v_r1 : T_BYTE;
+    begin
+      -- At least 74 clock cycles with CS deasserted.
+      s_cs <= '0';
+      for i in 1 to 10 loop
+        read_byte(v_byte);
+      end loop;
+      s_cs <= '1';
+
+      command(0, x"00000000", x"01");
+      command(8, x"000001aa", x"01");
+      for i in 1 to 4 loop
+        read_byte(v_byte);
+      end loop;
+      check_equal(v_byte, std_logic_vector'(x"aa"), "Bad CMD8 check pattern");
+
+      for i in 1 to 10 loop
+        command(55, x"00000000", x"01");
+        send_cmd(41, x"40000000");
+        read_r1(v_r1);
+        exit when v_r1 = x"00";
+      end loop;
+      check_equal(v_r1, std_logic_vector'(x"00"), "The card did not leave the idle state");
+
+      command(58, x"00000000", x"00");
+      read_byte(v_byte);
+      check_equal(v_byte(6), '1', "Not an SDHC card");
+      for i in 1 to 3 loop
+        read_byte(v_byte);
+      end loop;
+    end procedure;
+
+    -- Read the data token, the data and the CRC of one block. Returns the number of cycles that
+    -- were spent on the data (after the token).
+    procedure read_block_data(constant c_block : integer; variable v_cycles : out integer) is
+      variable v_token : T_BYTE;
+      variable v_data : std_logic_vector(31 downto 0);
+      variable v_start : time;
+    begin
+      read_response(v_token);
+      check_equal(v_token, std_logic_vector'(x"fe"), "Bad data token");
+
+      wait_idle;
+      s_word <= '1';
+      v_start := now;
+      receive(128);
+      for i in 0 to 127 loop
+        pop(v_data);
+        check_equal(v_data, data_word(c_block, i),
+                    "Bad data for block " & integer'image(c_block) & ", word " & integer'image(i));
+      end loop;
+      v_cycles := (now - v_start) / (2 * C_CLK_HALF_PERIOD);
+
+      wait_idle;
+      s_word <= '0';
+      read_byte(v_token);  -- CRC
+      read_byte(v_token);
+    end procedure;
+
+    -- Measure the SCK period (and check the data) while sending a byte.
+    procedure check_clock(constant c_div : integer; constant c_expected_cycles : integer) is
+      variable v_rise : time;
+      variable v_byte : T_BYTE;
+    begin
+      s_div <= std_logic_vector(to_unsigned(c_div, 16));
+      push(x"000000a5");
+      for i in 7 downto 0 loop
+        wait until rising_edge(s_sck);
+        if i < 7 then
+          check_equal((now - v_rise) / (2 * C_CLK_HALF_PERIOD), c_expected_cycles,
+                      "Bad SCK period for div = " & integer'image(c_div));
+        end if;
+        v_rise := now;
+        v_byte(i) := s_mosi;
+      end loop;
+      check_equal(v_byte, std_logic_vector'(x"a5"), "Bad MOSI data");
+      wait_idle;
+    end procedure;
+
+    variable v_cycles : integer;
+    variable v_bits : integer;
+    variable v_data : std_logic_vector(31 downto 0);
+    variable v_byte : T_BYTE;
+  begin
+    test_runner_setup(runner, runner_cfg);
+
+    s_enable <= '1';
+    s_cs <= '0';
+    s_word <= '0';
+    s_duplex <= '0';
+    s_div <= std_logic_vector(to_unsigned(1, 16));  -- SCK = 25 MHz
+    s_tx_stb <= '0';
+    s_rd_stb <= '0';
+    s_wr_data <= (others => '0');
+    s_rx_pop <= '0';
+
+    s_rst <= '1';
+    wait until rising_edge(s_clk);
+    wait until rising_edge(s_clk);
+    s_rst <= '0';
+
+    while test_suite loop
+      if run("init") then
+        init_card;
+        wait_idle;
+        check_equal(s_status(2), '1', "The RX FIFO is not empty");
+
+      elsif run("read_block") then
+        init_card;
+        command(17, x"00000005", x"00");
+        read_block_data(5, v_cycles);
+
+        -- The transfer should be limited by the SCK rate (four cycles per bit), with less than
+        -- 12.5% overhead between the words.
+        v_bits := 512 * 8;
+        info("Block read: " & integer'image(v_cycles) & " cycles for " & integer'image(v_bits) &
+             " bits");
+        check(v_cycles < (v_bits * 4 * 9) / 8, "The block read is too slow");
+
+      elsif run("multi_block") then
+        init_card;
+        command(18, x"00000064", x"00");
+        for b in 100 to 102 loop
+          read_block_data(b, v_cycles);
+        end loop;
+
+        -- The card keeps sending data while it receives CMD12, and the stuff byte that follows
+        -- must not be taken for R1.
+        send_cmd(12, x"00000000");
+        read_byte(v_byte);
+        check_equal(v_byte, std_logic_vector'(x"3f"), "Bad stuff byte after CMD12");
+        read_r1(v_byte);
+        check_equal(v_byte, std_logic_vector'(x"00"), "Bad R1 for CMD12");
+
+        -- Wait for the card to be ready (the busy signal is 0x00).
+        for i in 1 to 16 loop
+          read_byte(v_byte);
+          exit when v_byte = x"ff";
+        end loop;
+        check_equal(v_byte, std_logic_vector'(x"ff"), "The card is busy");
+
+        -- The card should be back in the command state.
+        command(17, x"00000007", x"00");
+        read_block_data(7, v_cycles);
+
+      elsif run("clock_divider") then
+        check_clock(1, 4);
+        check_clock(4, 10);
+        check_clock(0, 4);  -- Divider 0 is treated as 1.
+
+      elsif run("duplex") then
+        -- Every sent byte results in a received byte (the card sends 0xff when it is idle).
+        s_duplex <= '1';
+        for i in 1 to 3 loop
+          push(x"000000ff");
+        end loop;
+        for i in 1 to 3 loop
+          pop(v_data);
+          check_equal(v_data, std_logic_vector'(x"000000ff"), "Bad duplex data");
+        end loop;
+        wait_idle;
+        check_equal(s_status(2), '1', "The RX FIFO is not empty");
+
+      elsif run("rx_flow_control") then
+        init_card;
+        command(17, x"00000009", x"00");
+        read_response(v_byte);
+        check_equal(v_byte, std_logic_vector'(x"fe"), "Bad data token");
+
+        -- Request the whole block without reading anything: The clock must stop when the RX FIFO
+        -- is full.
+        wait_idle;
+        s_word <= '1';
+        receive(128);
+        -- Wait long enough for one word more than the RX FIFO can hold (four cycles per bit).
+        for i in 1 to (C_FIFO_DEPTH + 1) * 32 * 4 loop
+          wait until rising_edge(s_clk);
+        end loop;
+        check_equal(to_integer(unsigned(s_status(15 downto 8))), C_FIFO_DEPTH,
+                    "The RX FIFO is not full");
+        check_equal(s_status(0), '1', "The transfer is not pending");
+        for i in 1 to 100 loop
+          wait until rising_edge(s_clk);
+          check_equal(s_sck, '0', "SCK is running while the RX FIFO is full");
+        end loop;
+
+        -- No data may have been lost.
+        for i in 0 to 127 loop
+          pop(v_data);
+          check_equal(v_data, data_word(9, i), "Bad data for word " & integer'image(i));
+        end loop;
+        wait_idle;
+        check_equal(s_status(2), '1', "The RX FIFO is not empty");
+      end if;
+    end loop;
+
+    s_done <= true;
+    test_runner_cleanup(runner);
+  end process;
+end architecture;
@@ -0,0 +1,416 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Test for the XRAM scanline prefetch engine (with the XRAM controller and the SDRAM simulation
+-- model).
+--
+-- The video side emulates the timing of a 640x480 display (800 video clock cycles per raster line),
+-- and each displayed row of 320 words is checked against the XRAM contents. The tests also report
+-- the smallest bandwidth margin (in video clock cycles), with and without competing CPU traffic.
+----------------------------------------------------------------------------------------------------
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity vid_line_fetch_tb is
+  generic (runner_cfg : string);
+end entity;
+
+architecture tb of vid_line_fetch_tb is
+  constant C_CPU_CLK_HZ : positive := 100_000_000;
+  constant C_CLK_HALF_PERIOD : time := 1000 ms / (2 * C_CPU_CLK_HZ);
+  constant C_VID_CLK_HALF_PERIOD : time := 20 ns;
+
+  constant C_LOG2_LINE_WORDS : positive := 9;
+  constant C_LINE_CYCLES : integer := 800;
+  constant C_BLANK_CYCLES : integer := 160;
+  constant C_ROW_WORDS : integer := 320;
+  constant C_ROW_STRIDE : integer := 512;
+  constant C_NUM_ROWS : integer := 8;
+  constant C_CPU_BASE : integer := 65536;
+  constant C_CPU_WORDS : integer := 64;
+
+  signal s_rst : std_logic := '1';
+  signal s_clk : std_logic := '0';
+  signal s_vid_clk : std_logic := '0';
+  signal s_done : boolean := false;
+  signal s_prefilled : boolean := false;
+  signal s_cpu_traffic : boolean := false;
+
+  -- Video side.
+  signal s_fetch_req : std_logic;
+  signal s_fetch_adr : std_logic_vector(23 downto 0);
+  signal s_fetch_size : std_logic_vector(23 downto 0);
+  signal s_line_start : std_logic;
+  signal s_read_adr : std_logic_vector(C_LOG2_LINE_WORDS-1 downto 0);
+  signal s_read_dat : std_logic_vector(31 downto 0);
+  signal s_min_margin : std_logic_vector(23 downto 0);
+  signal s_underruns : std_logic_vector(15 downto 0);
+
+  -- Line fetch Wishbone master.
+  signal s_fetch_cyc : std_logic;
+  signal s_fetch_stb : std_logic;
+  signal s_fetch_wb_adr : std_logic_vector(29 downto 0);
+  signal s_fetch_dat : std_logic_vector(31 downto 0);
+  signal s_fetch_ack : std_logic;
+  signal s_fetch_stall : std_logic;
+
+  -- CPU Wishbone master.
+  signal s_wb_cyc : std_logic;
+  signal s_wb_stb : std_logic;
+  signal s_wb_adr : std_logic_vector(29 downto 0);
+  signal s_wb_dat_w : std_logic_vector(31 downto 0);
+  signal s_wb_we : std_logic;
+  signal s_wb_sel : std_logic_vector(3 downto 0);
+  signal s_wb_dat : std_logic_vector(31 downto 0);
+  signal s_wb_ack : std_logic;
+  signal s_wb_stall : std_logic;
+  signal s_wb_err : std_logic;
+
+  -- XRAM Wishbone slave.
+  signal s_xram_cyc : std_logic;
+  signal s_xram_stb : std_logic;
+  signal s_xram_adr : std_logic_vector(29 downto 0);
+  signal s_xram_dat_w : std_logic_vector(31 downto 0);
+  signal s_xram_we : std_logic;
+  signal s_xram_sel : std_logic_vector(3 downto 0);
+  signal s_xram_dat : std_logic_vector(31 downto 0);
+  signal s_xram_ack : std_logic;
+  signal s_xram_stall : std_logic;
+  signal s_xram_err : std_logic;
+
+  signal s_sdram_clk : std_logic;
+  signal s_sdram_addr : std_logic_vector(12 downto 0);
+  signal s_sdram_ba : std_logic_vector(1 downto 0);
+  signal s_sdram_dq : std_logic_vector(15 downto 0);
+  signal s_sdram_cs_n : std_logic;
+  signal s_sdram_cke : std_logic;
+  signal s_sdram_ras_n : std_logic;
+  signal s_sdram_cas_n : std_logic;
+  signal s_sdram_we_n : std_logic;
+  signal s_sdram_dqm : std_logic_vector(1 downto 0);
+
+  -- The value that is written to (and expected from) a word address.
+  function pattern(adr : integer) return std_logic_vector is
+  begin
+    return not std_logic_vector(to_unsigned(adr mod 65536, 16)) &
+           std_logic_vector(to_unsigned(adr mod 65536, 16));
+  end function;
+begin
+  line_fetch_1: entity work.vid_line_fetch
+    generic map (
+      LOG2_LINE_WORDS => C_LOG2_LINE_WORDS
+    )
+    port map (
+      i_vid_rst => s_rst,
+      i_vid_clk => s_vid_clk,
+      i_fetch_req => s_fetch_req,
+      i_fetch_adr => s_fetch_adr,
+      i_fetch_size => s_fetch_size,
+      i_line_start => s_line_start,
+      i_read_adr => s_read_adr,
+      o_read_dat => s_read_dat,
+      o_min_margin => s_min_margin,
+      o_underruns => s_underruns,
+
+      i_rst => s_rst,
+      i_wb_clk => s_clk,
+      o_wb_cyc => s_fetch_cyc,
+      o_wb_stb => s_fetch_stb,
+      o_wb_adr => s_fetch_wb_adr,
+      i_wb_dat => s_fetch_dat,
+      i_wb_ack => s_fetch_ack,
+      i_wb_stall => s_fetch_stall
+    );
+
+  arbiter_1: entity work.wb_arbiter_2x1
+    port map (
+      i_rst => s_rst,
+      i_clk => s_clk,
+
+      i_cyc_a => s_fetch_cyc,
+      i_stb_a => s_fetch_stb,
+      i_adr_a => s_fetch_wb_adr,
+      i_dat_a => (others => '0'),
+      i_we_a => '0',
+      i_sel_a => (others => '1'),
+      o_dat_a => s_fetch_dat,
+      o_ack_a => s_fetch_ack,
+      o_stall_a => s_fetch_stall,
+      o_err_a => open,
+
+      i_cyc_b => s_wb_cyc,
+      i_stb_b => s_wb_stb,
+      i_adr_b => s_wb_adr,
+      i_dat_b => s_wb_dat_w,
+      i_we_b => s_wb_we,
+      i_sel_b => s_wb_sel,
+      o_dat_b => s_wb_dat,
+      o_ack_b => s_wb_ack,
+      o_stall_b => s_wb_stall,
+      o_err_b => s_wb_err,
+
+      o_cyc => s_xram_cyc,
+      o_stb => s_xram_stb,
+      o_adr => s_xram_adr,
+      o_dat => s_xram_dat_w,
+      o_we => s_xram_we,
+      o_sel => s_xram_sel,
+      i_dat => s_xram_dat,
+      i_ack => s_xram_ack,
+      i_stall => s_xram_stall,
+      i_err => s_xram_err
+    );
+
+  xram_1: entity work.xram_sdram
+    generic map (
+      CPU_CLK_HZ => C_CPU_CLK_HZ,
+      SDRAM_ADDR_WIDTH => s_sdram_addr'length,
+      SDRAM_DATA_WIDTH => s_sdram_dq'length,
+      SDRAM_COL_WIDTH => 10,                -- 1k cols
+      SDRAM_ROW_WIDTH => 13,                -- 8k rows
+      SDRAM_BANK_WIDTH => s_sdram_ba'length,
+      T_DESL => 1000.0  -- Use shorter wait times to speed up init
+    )
+    port map (
+      i_rst  => s_rst,
+
+      i_wb_clk => s_clk,
+      i_wb_cyc => s_xram_cyc,
+      i_wb_stb => s_xram_stb,
+      i_wb_adr => s_xram_adr,
+      i_wb_dat => s_xram_dat_w,
+      i_wb_we => s_xram_we,
+      i_wb_sel => s_xram_sel,
+      o_wb_dat => s_xram_dat,
+      o_wb_ack => s_xram_ack,
+      o_wb_stall => s_xram_stall,
+      o_wb_err => s_xram_err,
+
+      o_sdram_a => s_sdram_addr,
+      o_sdram_ba => s_sdram_ba,
+      io_sdram_dq => s_sdram_dq,
+      o_sdram_cke => s_sdram_cke,
+      o_sdram_cs_n => s_sdram_cs_n,
+      o_sdram_ras_n => s_sdram_ras_n,
+      o_sdram_cas_n => s_sdram_cas_n,
+      o_sdram_we_n => s_sdram_we_n,
+      o_sdram_dqm => s_sdram_dqm
+    );
+
+  sdram_model_1: entity work.sdram_model
+    generic map (
+      ADDR_WIDTH => s_sdram_addr'length,
+      DATA_WIDTH => s_sdram_dq'length,
+      COL_WIDTH => 10,                -- 1k cols
+      ROW_WIDTH => 13,                -- 8k rows
+      BANK_WIDTH => s_sdram_ba'length
+    )
+    port map (
+      i_rst => s_rst,
+      i_clk => s_sdram_clk,
+      i_a => s_sdram_addr,
+      i_ba => s_sdram_ba,
+      io_dq => s_sdram_dq,
+      i_cke => s_sdram_cke,
+      i_cs_n => s_sdram_cs_n,
+      i_ras_n => s_sdram_ras_n,
+      i_cas_n => s_sdram_cas_n,
+      i_we_n => s_sdram_we_n,
+      i_dqm => s_sdram_dqm
+    );
+
+  -- The SDRAM clock is 180 degrees phase delayed (for simplicity).
+  s_sdram_clk <= not s_clk;
+
+  s_clk <= not s_clk after C_CLK_HALF_PERIOD when not s_done else s_clk;
+  s_vid_clk <= not s_vid_clk after C_VID_CLK_HALF_PERIOD when not s_done else s_vid_clk;
+
+  -- The CPU fills the XRAM with test data, and then optionally competes with the line fetch.
+  cpu : process
+    -- Issue count requests starting at the word address base, and wait for all the acks. Read data
+    -- is checked against pattern().
+    procedure transfer(constant c_we : std_logic;
+                       constant c_base : integer;
+                       constant c_count : integer) is
+      variable v_issued : integer := 0;
+      variable v_acked : integer := 0;
+    begin
+      while v_acked < c_count loop
+        if v_issued < c_count then
+          s_wb_cyc <= '1';
+          s_wb_stb <= '1';
+          s_wb_adr <= std_logic_vector(to_unsigned(c_base + v_issued, 30));
+          s_wb_dat_w <= pattern(c_base + v_issued);
+          s_wb_we <= c_we;
+          s_wb_sel <= "1111";
+        else
+          s_wb_stb <= '0';
+        end if;
+
+        -- Note: The signals that are sampled here are the values from before the clock edge.
+        wait until rising_edge(s_clk);
+        if s_wb_stb = '1' and s_wb_stall = '0' then
+          v_issued := v_issued + 1;
+        end if;
+        if s_wb_ack = '1' then
+          if c_we = '0' then
+            check_equal(s_wb_dat, pattern(c_base + v_acked),
+                        "Bad CPU data for word address " & integer'image(c_base + v_acked));
+          end if;
+          v_acked := v_acked + 1;
+        end if;
+      end loop;
+      s_wb_cyc <= '0';
+      s_wb_stb <= '0';
+    end procedure;
+  begin
+    s_wb_cyc <= '0';
+    s_wb_stb <= '0';
+    s_wb_adr <= (others => '0');
+    s_wb_dat_w <= (others => '0');
+    s_wb_we <= '0';
+    s_wb_sel <= (others => '0');
+    wait until s_rst = '0';
+
+    for row in 0 to C_NUM_ROWS-1 loop
+      transfer('1', row * C_ROW_STRIDE, C_ROW_WORDS);
+    end loop;
+    transfer('1', C_CPU_BASE, C_CPU_WORDS);
+    s_prefilled <= true;
+
+    loop
+      wait until rising_edge(s_clk) and (s_cpu_traffic or s_done);
+      exit when s_done;
+      transfer('0', C_CPU_BASE, C_CPU_WORDS);
+    end loop;
+    wait;
+  end process;
+
+  main : process
+    procedure wait_vid_cycles(constant c_cycles : integer) is
+    begin
+      for k in 1 to c_cycles loop
+        wait until rising_edge(s_vid_clk);
+      end loop;
+    end procedure;
+
+    -- Request a row (just like a VCP that writes LSIZE and LADDR).
+    procedure request_row(constant c_row : integer) is
+    begin
+      s_fetch_adr <= std_logic_vector(to_unsigned(c_row * C_ROW_STRIDE, 24));
+      s_fetch_size <= std_logic_vector(to_unsigned(C_ROW_WORDS, 24));
+      s_fetch_req <= '1';
+      wait until rising_edge(s_vid_clk);
+      s_fetch_req <= '0';
+    end procedure;
+
+    -- Emulate a number of raster lines. Line k displays row c_rows(k), and the row for the next
+    -- line is requested early in each line (a negative row number means that no row is requested,
+    -- i.e. that the current row is repeated).
+    type T_ROWS is array (natural range <>) of integer;
+    procedure show_lines(constant c_rows : T_ROWS) is
+      variable v_row : integer;
+    begin
+      for k in c_rows'range loop
+        s_line_start <= '1';
+        wait until rising_edge(s_vid_clk);
+        s_line_start <= '0';
+        wait_vid_cycles(8);
+        if k < c_rows'high and c_rows(k + 1) /= c_rows(k) then
+          request_row(c_rows(k + 1));
+        else
+          wait_vid_cycles(1);
+        end if;
+        wait_vid_cycles(C_BLANK_CYCLES - 10);
+
+        -- Read the visible pixels (the line buffer has one cycle of read latency).
+        v_row := c_rows(k);
+        for x in 0 to C_ROW_WORDS loop
+          if x < C_ROW_WORDS then
+            s_read_adr <= std_logic_vector(to_unsigned(x, C_LOG2_LINE_WORDS));
+          end if;
+          wait until rising_edge(s_vid_clk);
+          if x > 0 then
+            check_equal(s_read_dat, pattern(v_row * C_ROW_STRIDE + x - 1),
+                        "Bad pixel data for row " & integer'image(v_row) & ", word " &
+                        integer'image(x - 1));
+          end if;
+        end loop;
+        wait_vid_cycles(C_LINE_CYCLES - C_BLANK_CYCLES - C_ROW_WORDS - 1);
+      end loop;
+    end procedure;
+
+    procedure report_margin(constant c_name : string) is
+    begin
+      info(c_name & ": Min margin = " & integer'image(to_integer(unsigned(s_min_margin))) &
+           " video cycles, underruns = " & integer'image(to_integer(unsigned(s_underruns))));
+    end procedure;
+  begin
+    test_runner_setup(runner, runner_cfg);
+
+    s_fetch_req <= '0';
+    s_fetch_adr <= (others => '0');
+    s_fetch_size <= (others => '0');
+    s_line_start <= '0';
+    s_read_adr <= (others => '0');
+
+    s_rst <= '1';
+    wait until rising_edge(s_clk);
+    wait until rising_edge(s_clk);
+    s_rst <= '0';
+
+    wait until s_prefilled;
+    wait until rising_edge(s_vid_clk);
+
+    while test_suite loop
+      if run("scanlines") then
+        request_row(0);
+        wait_vid_cycles(C_LINE_CYCLES);
+        show_lines((0, 1, 2, 3, 4, 5, 6, 7));
+        report_margin("Scanlines");
+        check_equal(to_integer(unsigned(s_underruns)), 0, "Line fetch underrun");
+
+      elsif run("repeated_rows") then
+        -- Vertical scaling: Each row is shown on two consecutive lines.
+        request_row(3);
+        wait_vid_cycles(C_LINE_CYCLES);
+        show_lines((3, 3, 4, 4, 5, 5));
+        check_equal(to_integer(unsigned(s_underruns)), 0, "Line fetch underrun");
+
+      elsif run("cpu_traffic") then
+        s_cpu_traffic <= true;
+        request_row(0);
+        wait_vid_cycles(C_LINE_CYCLES);
+        show_lines((0, 1, 2, 3, 4, 5, 6, 7));
+        s_cpu_traffic <= false;
+        report_margin("Scanlines with CPU traffic");
+        check_equal(to_integer(unsigned(s_underruns)), 0, "Line fetch underrun");
+      end if;
+    end loop;
+
+    s_done <= true;
+    test_runner_cleanup(runner);
+  end process;
+end architecture;
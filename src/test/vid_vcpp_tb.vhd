@@ -22,6 +22,7 @@ context vunit_lib.vunit_context;
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.vid_types.all;
 
 entity vid_vcpp_tb is
   generic (runner_cfg : string);
@@ -41,6 +42,12 @@ architecture tb of vid_vcpp_tb is
   signal s_pal_write_enable : std_logic;
   signal s_write_addr : std_logic_vector(7 downto 0);
   signal s_write_data : std_logic_vector(31 downto 0);
+
+  signal s_next_line : std_logic;
+  signal s_regs_write_enable : std_logic;
+  signal s_regs_write_addr : std_logic_vector(3 downto 0);
+  signal s_regs_write_data : std_logic_vector(23 downto 0);
+  signal s_regs : T_VID_REGS;
 begin
   vid_vcpp_0: entity work.vid_vcpp
     generic map(
@@ -64,6 +71,18 @@ begin
       o_write_data => s_write_data
     );
 
+  vid_regs_0: entity work.vid_regs
+    port map(
+      i_rst => s_rst,
+      i_clk => s_clk,
+      i_restart_frame => s_restart_frame,
+      i_next_line => s_next_line,
+      i_write_enable => s_regs_write_enable,
+      i_write_addr => s_regs_write_addr,
+      i_write_data => s_regs_write_data,
+      o_regs => s_regs
+    );
+
   main : process
     -- The VCPP program.
     type program_array is array (natural range <>) of std_logic_vector(31 downto 0);
@@ -258,6 +277,40 @@ begin
         )
       );
     variable v_write_en : std_logic;
+
+    -- Tick the clock, and return right after the rising edge (like the pattern loop does), so
+    -- that the inputs that are set next are sampled at the following rising edge.
+    procedure clock_cycle is
+    begin
+      wait for 0.5 ps;
+      s_clk <= '0';
+      wait for 0.5 ps;
+      s_clk <= '1';
+      wait until s_clk = '1';
+    end procedure;
+
+    procedure write_reg(constant c_addr : integer;
+                        constant c_data : std_logic_vector(23 downto 0)) is
+    begin
+      s_regs_write_enable <= '1';
+      s_regs_write_addr <= std_logic_vector(to_unsigned(c_addr, 4));
+      s_regs_write_data <= c_data;
+      clock_cycle;
+      s_regs_write_enable <= '0';
+    end procedure;
+
+    -- Start a new raster line, and check ADDR a few cycles later.
+    procedure check_next_line(constant c_expected_addr : std_logic_vector(23 downto 0)) is
+    begin
+      s_next_line <= '1';
+      clock_cycle;
+      s_next_line <= '0';
+      for k in 1 to 4 loop
+        clock_cycle;
+      end loop;
+      wait for 0.5 ps;
+      check(s_regs.ADDR = c_expected_addr, "ADDR is incorrect after a new line");
+    end procedure;
   begin
     test_runner_setup(runner, runner_cfg);
 
@@ -272,6 +325,10 @@ begin
     s_raster_y <= (others => '0');
     s_mem_data <= (others => '1');
     s_mem_ack <= '0';
+    s_next_line <= '0';
+    s_regs_write_enable <= '0';
+    s_regs_write_addr <= (others => '0');
+    s_regs_write_data <= (others => '0');
 
     wait for 0.5 ps;
     s_clk <= '1';
@@ -313,6 +370,41 @@ begin
       s_clk <= '1';
     end loop;
 
+    -- Test the per-line ADDR increment of the video control registers (YINCR = 9, YSTEP = 10).
+    wait until s_clk = '1';
+    s_restart_frame <= '0';
+    write_reg(9, x"000040");
+    write_reg(10, x"008000");  -- 0.5 rows per line
+    write_reg(0, x"001000");
+    check_next_line(x"001000");
+    check_next_line(x"001040");
+    check_next_line(x"001040");
+    write_reg(10, x"018000");  -- 1.5 rows per line
+    check_next_line(x"0010c0");
+    check_next_line(x"001100");
+    write_reg(9, x"ffffc0");   -- Negative stride
+    check_next_line(x"001080");
+
+    -- Writing to ADDR clears the row accumulator.
+    write_reg(0, x"002000");
+    check_next_line(x"001fc0");
+
+    -- The gradient colors (GCOL0 = 11, GCOL1 = 12).
+    write_reg(11, x"123456");
+    write_reg(12, x"abcdef");
+    wait for 0.5 ps;
+    check(s_regs.GCOL0 = x"123456", "GCOL0 is incorrect");
+    check(s_regs.GCOL1 = x"abcdef", "GCOL1 is incorrect");
+
+    -- A new frame restores the defaults (no increment).
+    s_restart_frame <= '1';
+    clock_cycle;
+    s_restart_frame <= '0';
+    check_next_line(x"000000");
+    check(s_regs.YINCR = x"000000", "YINCR is not reset");
+    check(s_regs.YSTEP = x"010000", "YSTEP is not reset");
+    check(s_regs.GCOL0 = x"000000", "GCOL0 is not reset");
+
     test_runner_cleanup(runner);
   end process;
 end architecture;
\ No newline at end of file
@@ -77,6 +77,12 @@ begin
       i_clk => s_clk,
       o_read_adr => s_read_adr,
       i_read_dat => s_read_dat,
+      o_line_fetch_req => open,
+      o_line_fetch_adr => open,
+      o_line_fetch_size => open,
+      o_line_start => open,
+      o_lbuf_read_adr => open,
+      i_lbuf_read_dat => (others => '0'),
       o_r => s_r,
       o_g => s_g,
       o_b => s_b,
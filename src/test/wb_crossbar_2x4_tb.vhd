@@ -0,0 +1,285 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Arbitration test for wb_crossbar_2x4.
+--
+-- Both masters issue a request every cycle to the same slave, and the test checks how the granted
+-- requests are distributed between the masters for the selected arbitration policy. The test bench
+-- is run once per policy (see run.py).
+----------------------------------------------------------------------------------------------------
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.wb_types.all;
+
+entity wb_crossbar_2x4_tb is
+  generic (
+    runner_cfg : string;
+    arb_policy : string := "fixed"
+  );
+end entity;
+
+architecture tb of wb_crossbar_2x4_tb is
+  function to_policy(x : string) return T_WB_ARB_POLICY is
+  begin
+    if x = "round_robin" then
+      return WB_ARB_ROUND_ROBIN;
+    elsif x = "weighted" then
+      return WB_ARB_WEIGHTED;
+    end if;
+    return WB_ARB_FIXED;
+  end function;
+
+  constant C_POLICY : T_WB_ARB_POLICY := to_policy(arb_policy);
+  constant C_WEIGHT_A : positive := 3;
+  constant C_WEIGHT_B : positive := 1;
+  constant C_TEST_CYCLES : integer := 2000;
+
+  type T_ADR_ARRAY is array (0 to 1) of std_logic_vector(29 downto 0);
+  type T_DAT_ARRAY is array (0 to 1) of std_logic_vector(31 downto 0);
+  type T_COUNT_ARRAY is array (0 to 1) of integer;
+
+  signal s_rst : std_logic;
+  signal s_clk : std_logic := '0';
+  signal s_done : boolean := false;
+  signal s_run : boolean := false;
+
+  -- Masters (0 = A, 1 = B).
+  signal s_m_cyc : std_logic_vector(0 to 1);
+  signal s_m_stb : std_logic_vector(0 to 1);
+  signal s_m_adr : T_ADR_ARRAY;
+  signal s_m_dat : T_DAT_ARRAY;
+  signal s_m_ack : std_logic_vector(0 to 1);
+  signal s_m_stall : std_logic_vector(0 to 1);
+  signal s_m_acked : T_COUNT_ARRAY := (0, 0);
+
+  -- Slave 1 (the other slaves are not used).
+  signal s_s_cyc : std_logic;
+  signal s_s_stb : std_logic;
+  signal s_s_adr : std_logic_vector(29 downto 0);
+  signal s_s_dat : std_logic_vector(31 downto 0);
+  signal s_s_ack : std_logic;
+
+  signal s_stats : T_WB_XBAR_STATS;
+  signal s_stats_grants : T_COUNT_ARRAY := (0, 0);
+
+  -- Master k uses its own address range within slave 1.
+  function master_adr(k : integer; n : integer) return std_logic_vector is
+  begin
+    return std_logic_vector(to_unsigned(16#10000000# + k * 16#100000# + n, 30));
+  end function;
+begin
+  xbar_1: entity work.wb_crossbar_2x4
+    generic map (
+      ARB_POLICY => C_POLICY,
+      ARB_WEIGHT_A => C_WEIGHT_A,
+      ARB_WEIGHT_B => C_WEIGHT_B
+    )
+    port map (
+      i_rst => s_rst,
+      i_clk => s_clk,
+
+      i_adr_a => s_m_adr(0),
+      i_dat_a => (others => '0'),
+      i_we_a => '0',
+      i_sel_a => (others => '1'),
+      i_cyc_a => s_m_cyc(0),
+      i_stb_a => s_m_stb(0),
+      o_dat_a => s_m_dat(0),
+      o_ack_a => s_m_ack(0),
+      o_stall_a => s_m_stall(0),
+      o_rty_a => open,
+      o_err_a => open,
+
+      i_adr_b => s_m_adr(1),
+      i_dat_b => (others => '0'),
+      i_we_b => '0',
+      i_sel_b => (others => '1'),
+      i_cyc_b => s_m_cyc(1),
+      i_stb_b => s_m_stb(1),
+      o_dat_b => s_m_dat(1),
+      o_ack_b => s_m_ack(1),
+      o_stall_b => s_m_stall(1),
+      o_rty_b => open,
+      o_err_b => open,
+
+      o_adr_0 => open,
+      o_dat_0 => open,
+      o_we_0 => open,
+      o_sel_0 => open,
+      o_cyc_0 => open,
+      o_stb_0 => open,
+      i_dat_0 => (others => '0'),
+      i_ack_0 => '0',
+      i_stall_0 => '0',
+      i_rty_0 => '0',
+      i_err_0 => '0',
+
+      o_adr_1 => s_s_adr,
+      o_dat_1 => open,
+      o_we_1 => open,
+      o_sel_1 => open,
+      o_cyc_1 => s_s_cyc,
+      o_stb_1 => s_s_stb,
+      i_dat_1 => s_s_dat,
+      i_ack_1 => s_s_ack,
+      i_stall_1 => '0',
+      i_rty_1 => '0',
+      i_err_1 => '0',
+
+      o_adr_2 => open,
+      o_dat_2 => open,
+      o_we_2 => open,
+      o_sel_2 => open,
+      o_cyc_2 => open,
+      o_stb_2 => open,
+      i_dat_2 => (others => '0'),
+      i_ack_2 => '0',
+      i_stall_2 => '0',
+      i_rty_2 => '0',
+      i_err_2 => '0',
+
+      o_adr_3 => open,
+      o_dat_3 => open,
+      o_we_3 => open,
+      o_sel_3 => open,
+      o_cyc_3 => open,
+      o_stb_3 => open,
+      i_dat_3 => (others => '0'),
+      i_ack_3 => '0',
+      i_stall_3 => '0',
+      i_rty_3 => '0',
+      i_err_3 => '0',
+
+      o_stats => s_stats
+    );
+
+  s_clk <= not s_clk after 5 ns when not s_done else s_clk;
+
+  -- Slave 1: Never stalls, and responds with the address one cycle after each request.
+  process(s_clk, s_rst)
+  begin
+    if s_rst = '1' then
+      s_s_ack <= '0';
+      s_s_dat <= (others => '0');
+    elsif rising_edge(s_clk) then
+      s_s_ack <= s_s_cyc and s_s_stb;
+      s_s_dat <= "00" & s_s_adr;
+    end if;
+  end process;
+
+  -- The masters issue one request per cycle (while s_run is true), and check the responses.
+  MasterGen: for k in 0 to 1 generate
+  begin
+    process
+      variable v_issued : integer := 0;
+      variable v_acked : integer := 0;
+    begin
+      s_m_cyc(k) <= '0';
+      s_m_stb(k) <= '0';
+      s_m_adr(k) <= (others => '0');
+      wait until s_run;
+      while s_run or v_acked < v_issued loop
+        s_m_cyc(k) <= '1';
+        if s_run then
+          s_m_stb(k) <= '1';
+          s_m_adr(k) <= master_adr(k, v_issued);
+        else
+          s_m_stb(k) <= '0';
+        end if;
+        wait until rising_edge(s_clk);
+        if s_m_stb(k) = '1' and s_m_stall(k) = '0' then
+          v_issued := v_issued + 1;
+        end if;
+        if s_m_ack(k) = '1' then
+          check_equal(s_m_dat(k), "00" & master_adr(k, v_acked),
+                      "Bad response for master " & integer'image(k));
+          v_acked := v_acked + 1;
+          s_m_acked(k) <= v_acked;
+        end if;
+      end loop;
+      s_m_cyc(k) <= '0';
+      wait;
+    end process;
+  end generate;
+
+  -- Count the granted requests according to the crossbar statistics.
+  process(s_clk)
+  begin
+    if rising_edge(s_clk) then
+      if s_stats.grant_a = '1' then
+        s_stats_grants(0) <= s_stats_grants(0) + 1;
+      end if;
+      if s_stats.grant_b = '1' then
+        s_stats_grants(1) <= s_stats_grants(1) + 1;
+      end if;
+    end if;
+  end process;
+
+  main : process
+    variable v_a : integer;
+    variable v_b : integer;
+  begin
+    test_runner_setup(runner, runner_cfg);
+
+    s_rst <= '1';
+    wait until rising_edge(s_clk);
+    s_rst <= '0';
+    wait until rising_edge(s_clk);
+
+    while test_suite loop
+      if run("contention") then
+        s_run <= true;
+        for k in 1 to C_TEST_CYCLES loop
+          wait until rising_edge(s_clk);
+        end loop;
+        s_run <= false;
+        for k in 1 to 10 loop
+          wait until rising_edge(s_clk);
+        end loop;
+
+        v_a := s_m_acked(0);
+        v_b := s_m_acked(1);
+        info(arb_policy & ": Master A got " & integer'image(v_a) & " requests, master B got " &
+             integer'image(v_b) & " requests");
+        check_equal(s_stats_grants(0), v_a, "Bad grant count for master A");
+        check_equal(s_stats_grants(1), v_b, "Bad grant count for master B");
+        check(v_a + v_b > C_TEST_CYCLES / 4, "Too few requests were granted");
+
+        case C_POLICY is
+          when WB_ARB_FIXED =>
+            check(v_b < v_a / 20, "Master A should have precedence");
+          when WB_ARB_ROUND_ROBIN =>
+            check(abs(v_a - v_b) <= (v_a + v_b) / 10, "The masters should get equal shares");
+          when WB_ARB_WEIGHTED =>
+            check(abs(C_WEIGHT_B * v_a - C_WEIGHT_A * v_b) <= (v_a + v_b) / 10,
+                  "The requests should be distributed according to the weights");
+        end case;
+      end if;
+    end loop;
+
+    s_done <= true;
+    test_runner_cleanup(runner);
+  end process;
+end architecture;
@@ -0,0 +1,295 @@
+----------------------------------------------------------------------------------------------------
+-- Copyright (c) 2022 Marcus Geelnard
+--
+-- This software is provided 'as-is', without any express or implied warranty. In no event will the
+-- authors be held liable for any damages arising from the use of this software.
+--
+-- Permission is granted to anyone to use this software for any purpose, including commercial
+-- applications, and to alter it and redistribute it freely, subject to the following restrictions:
+--
+--  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+--     the original software. If you use this software in a product, an acknowledgment in the
+--     product documentation would be appreciated but is not required.
+--
+--  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+--     being the original software.
+--
+--  3. This notice may not be removed or altered from any source distribution.
+----------------------------------------------------------------------------------------------------
+
+----------------------------------------------------------------------------------------------------
+-- Functional and throughput test for xram_sdram (with the SDRAM simulation model).
+--
+-- The Wishbone master issues one request per cycle (unless stalled), and the tests report the
+-- number of cycles per word for different access patterns.
+----------------------------------------------------------------------------------------------------
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity xram_sdram_tb is
+  generic (runner_cfg : string);
+end entity;
+
+architecture tb of xram_sdram_tb is
+  constant C_CPU_CLK_HZ : positive := 100_000_000;
+  constant C_CLK_HALF_PERIOD : time := 1000 ms / (2 * C_CPU_CLK_HZ);
+
+  signal s_rst : std_logic;
+  signal s_clk : std_logic := '0';
+  signal s_done : boolean := false;
+
+  signal s_wb_cyc : std_logic;
+  signal s_wb_stb : std_logic;
+  signal s_wb_adr : std_logic_vector(29 downto 0);
+  signal s_wb_dat_w : std_logic_vector(31 downto 0);
+  signal s_wb_we : std_logic;
+  signal s_wb_sel : std_logic_vector(3 downto 0);
+  signal s_wb_dat : std_logic_vector(31 downto 0);
+  signal s_wb_ack : std_logic;
+  signal s_wb_stall : std_logic;
+  signal s_wb_err : std_logic;
+
+  signal s_sdram_clk : std_logic;
+  signal s_sdram_addr : std_logic_vector(12 downto 0);
+  signal s_sdram_ba : std_logic_vector(1 downto 0);
+  signal s_sdram_dq : std_logic_vector(15 downto 0);
+  signal s_sdram_cs_n : std_logic;
+  signal s_sdram_cke : std_logic;
+  signal s_sdram_ras_n : std_logic;
+  signal s_sdram_cas_n : std_logic;
+  signal s_sdram_we_n : std_logic;
+  signal s_sdram_dqm : std_logic_vector(1 downto 0);
+
+  -- The value that is written to (and expected from) a word address. It is returned via a
+  -- (31 downto 0) variable so that it can be sliced (a concatenation has the range 0 to 31).
+  function pattern(adr : integer) return std_logic_vector is
+    variable v_result : std_logic_vector(31 downto 0);
+  begin
+    v_result := not std_logic_vector(to_unsigned(adr mod 65536, 16)) &
+                std_logic_vector(to_unsigned(adr mod 65536, 16));
+    return v_result;
+  end function;
+begin
+  xram_1: entity work.xram_sdram
+    generic map (
+      CPU_CLK_HZ => C_CPU_CLK_HZ,
+      SDRAM_ADDR_WIDTH => s_sdram_addr'length,
+      SDRAM_DATA_WIDTH => s_sdram_dq'length,
+      SDRAM_COL_WIDTH => 10,                -- 1k cols
+      SDRAM_ROW_WIDTH => 13,                -- 8k rows
+      SDRAM_BANK_WIDTH => s_sdram_ba'length,
+      T_DESL => 1000.0  -- Use shorter wait times to speed up init
+    )
+    port map (
+      i_rst  => s_rst,
+
+      i_wb_clk => s_clk,
+      i_wb_cyc => s_wb_cyc,
+      i_wb_stb => s_wb_stb,
+      i_wb_adr => s_wb_adr,
+      i_wb_dat => s_wb_dat_w,
+      i_wb_we => s_wb_we,
+      i_wb_sel => s_wb_sel,
+      o_wb_dat => s_wb_dat,
+      o_wb_ack => s_wb_ack,
+      o_wb_stall => s_wb_stall,
+      o_wb_err => s_wb_err,
+
+      o_sdram_a => s_sdram_addr,
+      o_sdram_ba => s_sdram_ba,
+      io_sdram_dq => s_sdram_dq,
+      o_sdram_cke => s_sdram_cke,
+      o_sdram_cs_n => s_sdram_cs_n,
+      o_sdram_ras_n => s_sdram_ras_n,
+      o_sdram_cas_n => s_sdram_cas_n,
+      o_sdram_we_n => s_sdram_we_n,
+      o_sdram_dqm => s_sdram_dqm
+    );
+
+  sdram_model_1: entity work.sdram_model
+    generic map (
+      ADDR_WIDTH => s_sdram_addr'length,
+      DATA_WIDTH => s_sdram_dq'length,
+      COL_WIDTH => 10,                -- 1k cols
+      ROW_WIDTH => 13,                -- 8k rows
+      BANK_WIDTH => s_sdram_ba'length
+    )
+    port map (
+      i_rst => s_rst,
+      i_clk => s_sdram_clk,
+      i_a => s_sdram_addr,
+      i_ba => s_sdram_ba,
+      io_dq => s_sdram_dq,
+      i_cke => s_sdram_cke,
+      i_cs_n => s_sdram_cs_n,
+      i_ras_n => s_sdram_ras_n,
+      i_cas_n => s_sdram_cas_n,
+      i_we_n => s_sdram_we_n,
+      i_dqm => s_sdram_dqm
+    );
+
+  -- The SDRAM clock is 180 degrees phase delayed (for simplicity).
+  s_sdram_clk <= not s_clk;
+
+  s_clk <= not s_clk after C_CLK_HALF_PERIOD when not s_done else s_clk;
+
+  main : process
+    -- Issue count requests, starting at the word address base with the given stride, and wait
+    -- for all the acks. Read data is checked against pattern(). Returns the number of cycles.
+    procedure transfer(constant c_we : std_logic;
+                       constant c_base : integer;
+                       constant c_count : integer;
+                       constant c_stride : integer;
+                       variable v_cycles : out integer) is
+      variable v_issued : integer := 0;
+      variable v_acked : integer := 0;
+      variable v_adr : integer;
+    begin
+      v_cycles := 0;
+      while v_acked < c_count loop
+        if v_issued < c_count then
+          v_adr := c_base + v_issued * c_stride;
+          s_wb_cyc <= '1';
+          s_wb_stb <= '1';
+          s_wb_adr <= std_logic_vector(to_unsigned(v_adr, 30));
+          s_wb_dat_w <= pattern(v_adr);
+          s_wb_we <= c_we;
+          s_wb_sel <= "1111";
+        else
+          s_wb_stb <= '0';
+        end if;
+
+        -- Note: The signals that are sampled here are the values from before the clock edge.
+        wait until rising_edge(s_clk);
+        v_cycles := v_cycles + 1;
+        if s_wb_stb = '1' and s_wb_stall = '0' then
+          v_issued := v_issued + 1;
+        end if;
+        if s_wb_ack = '1' then
+          if c_we = '0' then
+            v_adr := c_base + v_acked * c_stride;
+            check_equal(s_wb_dat, pattern(v_adr),
+                        "Bad data for word address " & integer'image(v_adr));
+          end if;
+          v_acked := v_acked + 1;
+        end if;
+      end loop;
+      s_wb_cyc <= '0';
+      s_wb_stb <= '0';
+    end procedure;
+
+    -- Single (byte masked) write.
+    procedure write_word(constant c_adr : integer;
+                         constant c_dat : std_logic_vector(31 downto 0);
+                         constant c_sel : std_logic_vector(3 downto 0)) is
+    begin
+      s_wb_cyc <= '1';
+      s_wb_stb <= '1';
+      s_wb_adr <= std_logic_vector(to_unsigned(c_adr, 30));
+      s_wb_dat_w <= c_dat;
+      s_wb_we <= '1';
+      s_wb_sel <= c_sel;
+      wait until rising_edge(s_clk) and s_wb_stall = '0';
+      s_wb_stb <= '0';
+      wait until rising_edge(s_clk) and s_wb_ack = '1';
+      s_wb_cyc <= '0';
+    end procedure;
+
+    -- Single read.
+    procedure check_word(constant c_adr : integer;
+                         constant c_expected : std_logic_vector(31 downto 0)) is
+    begin
+      s_wb_cyc <= '1';
+      s_wb_stb <= '1';
+      s_wb_adr <= std_logic_vector(to_unsigned(c_adr, 30));
+      s_wb_we <= '0';
+      s_wb_sel <= "1111";
+      wait until rising_edge(s_clk) and s_wb_stall = '0';
+      s_wb_stb <= '0';
+      wait until rising_edge(s_clk) and s_wb_ack = '1';
+      s_wb_cyc <= '0';
+      check_equal(s_wb_dat, c_expected, "Bad data for word address " & integer'image(c_adr));
+    end procedure;
+
+    procedure report_rate(constant c_name : string;
+                          constant c_cycles : integer;
+                          constant c_count : integer) is
+    begin
+      info(c_name & ": " & integer'image(c_cycles) & " cycles for " & integer'image(c_count) &
+           " words (" & integer'image((100 * c_cycles) / c_count) & " cycles/100 words)");
+    end procedure;
+
+    constant C_NUM_WORDS : integer := 1024;
+    constant C_HOT_WORDS : integer := 256;
+    variable v_cycles : integer;
+  begin
+    test_runner_setup(runner, runner_cfg);
+
+    s_wb_cyc <= '0';
+    s_wb_stb <= '0';
+    s_wb_adr <= (others => '0');
+    s_wb_dat_w <= (others => '0');
+    s_wb_we <= '0';
+    s_wb_sel <= (others => '0');
+
+    s_rst <= '1';
+    wait until rising_edge(s_clk);
+    wait until rising_edge(s_clk);
+    s_rst <= '0';
+
+    -- Wait for the SDRAM to be initialized.
+    transfer('1', 0, 1, 1, v_cycles);
+    transfer('0', 0, 1, 1, v_cycles);
+
+    while test_suite loop
+      if run("sequential") then
+        transfer('1', 0, C_NUM_WORDS, 1, v_cycles);
+        report_rate("Sequential write", v_cycles, C_NUM_WORDS);
+        transfer('0', 0, C_NUM_WORDS, 1, v_cycles);
+        report_rate("Sequential read (cold)", v_cycles, C_NUM_WORDS);
+
+        -- The hot region fits in the cache.
+        transfer('0', 0, C_HOT_WORDS, 1, v_cycles);
+        transfer('0', 0, C_HOT_WORDS, 1, v_cycles);
+        report_rate("Sequential read (cached)", v_cycles, C_HOT_WORDS);
+        check(v_cycles < 2 * C_HOT_WORDS, "Cached reads are too slow");
+
+      elsif run("strided") then
+        -- Stride 5 touches every line in a different order than the fill order.
+        transfer('1', 0, C_NUM_WORDS, 1, v_cycles);
+        transfer('0', 3, C_NUM_WORDS / 5, 5, v_cycles);
+        report_rate("Strided read", v_cycles, C_NUM_WORDS / 5);
+
+        -- Scattered writes (one word per line) must not be combined with other lines.
+        transfer('1', 8192 + 2, C_NUM_WORDS / 8, 7, v_cycles);
+        report_rate("Strided write", v_cycles, C_NUM_WORDS / 8);
+        transfer('0', 8192 + 2, C_NUM_WORDS / 8, 7, v_cycles);
+
+      elsif run("byte_writes") then
+        transfer('1', 100, 8, 1, v_cycles);
+
+        -- Partial writes to a cached line and to the write-combining buffer.
+        check_word(101, pattern(101));
+        write_word(101, x"11223344", "0001");
+        write_word(101, x"55667788", "1000");
+        write_word(102, x"99aabbcc", "0110");
+        check_word(101, x"55" & pattern(101)(23 downto 8) & x"44");
+        check_word(102, pattern(102)(31 downto 24) & x"aabb" & pattern(102)(7 downto 0));
+
+        -- Re-read the line from the SDRAM after it has been evicted from the cache.
+        transfer('1', 100 + 256 * 4, 1, 1, v_cycles);
+        transfer('0', 100 + 256 * 4, 1, 1, v_cycles);
+        check_word(102, pattern(102)(31 downto 24) & x"aabb" & pattern(102)(7 downto 0));
+        check_word(103, pattern(103));
+      end if;
+    end loop;
+
+    s_done <= true;
+    test_runner_cleanup(runner);
+  end process;
+end architecture;